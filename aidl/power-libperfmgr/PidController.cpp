@@ -0,0 +1,110 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+
+#include "PidController.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+static inline int64_t ns_to_100us(int64_t ns) {
+    return ns / 100000;
+}
+
+static inline int64_t windowStart(int64_t window, int64_t length) {
+    return window == 0 || window > length ? 0 : length - window;
+}
+
+}  // namespace
+
+ControllerOutput PidController::update(const WorkDuration *actualDurations, size_t length,
+                                       int64_t targetDurationNanos) {
+    const int64_t n = static_cast<int64_t>(length);
+    const int64_t p_start = windowStart(kGains.pWindow, n);
+    const int64_t i_start = windowStart(kGains.iWindow, n);
+    const int64_t d_start = windowStart(kGains.dWindow, n);
+    const int64_t first = std::min({p_start, i_start, d_start});
+    const int64_t dt = ns_to_100us(targetDurationNanos);
+
+    // One pass: each error is computed once, P sums its window and I is clamped after every
+    // sample of its window, as the per-sample loop did. Selects keep the window checks
+    // branch-free.
+    int64_t err_sum = 0;
+    int64_t integral = mIntegralError;
+    for (int64_t i = first; i < n; i++) {
+        const int64_t actualDurationNanos = actualDurations[i].durationNanos;
+        if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
+            ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64 ")",
+                  actualDurationNanos, targetDurationNanos);
+        }
+        const int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
+        err_sum += i >= p_start ? error : 0;
+        const int64_t clamped =
+                std::max(kGains.iLowLimit, std::min(kGains.iHighLimit, integral + error * dt));
+        integral = i >= i_start ? clamped : integral;
+    }
+
+    // D: the sum of error deltas over the window is last error minus the one before the window.
+    const int64_t last_error =
+            ns_to_100us(actualDurations[n - 1].durationNanos - targetDurationNanos);
+    const int64_t error_before_d =
+            d_start > first
+                    ? ns_to_100us(actualDurations[d_start - 1].durationNanos - targetDurationNanos)
+                    : mPreviousError;
+    const int64_t derivative_sum = last_error - error_before_d;
+    mIntegralError = integral;
+    mPreviousError = last_error;
+
+    ControllerOutput out;
+    out.errSum = err_sum;
+    out.errAvg = err_sum / (n - p_start);
+    out.derivativeAvg = derivative_sum / dt / (n - d_start);
+    out.pOut = static_cast<int64_t>((err_sum > 0 ? kGains.pOver : kGains.pUnder) * err_sum /
+                                    (n - p_start));
+    out.iOut = static_cast<int64_t>(kGains.i * mIntegralError);
+    out.dOut = static_cast<int64_t>((derivative_sum > 0 ? kGains.dOver : kGains.dUnder) *
+                                    derivative_sum / dt / (n - d_start));
+    out.output = out.pOut + out.iOut + out.dOut;
+    return out;
+}
+
+void PidController::reset() {
+    mIntegralError = std::max(kGains.iInit, mIntegralError);
+}
+
+void PidController::retarget(double ratio) {
+    mIntegralError = std::max(kGains.iInit, static_cast<int64_t>(mIntegralError * ratio));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
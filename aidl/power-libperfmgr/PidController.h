@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "WorkDurationController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+struct PidGains {
+    double pOver;
+    double pUnder;
+    double i;
+    double dOver;
+    double dUnder;
+    // integral limits, already divided by i
+    int64_t iInit;
+    int64_t iHighLimit;
+    int64_t iLowLimit;
+    // number of latest samples used by each term, 0 means the whole batch
+    int64_t pWindow;
+    int64_t iWindow;
+    int64_t dWindow;
+};
+
+/*
+ * PID controller on the error between the actual and target work duration, in 100us units.
+ *
+ * A report is processed as one batch in a single pass, which computes each error once for the
+ * windowed P sum and the I term, clamped after every step. The D sum telescopes to last error
+ * minus the error before the window, so it needs no loop. Results are identical to the
+ * per-sample loop it replaces.
+ */
+class PidController : public WorkDurationController {
+  public:
+    explicit PidController(const PidGains &gains)
+        : kGains(gains), mIntegralError(0), mPreviousError(0) {}
+    ControllerOutput update(const WorkDuration *actualDurations, size_t length,
+                            int64_t targetDurationNanos) override;
+    // Raises the integral to its initial value.
+    void reset() override;
+    void retarget(double ratio) override;
+    int64_t getState() const override { return mIntegralError; }
+    const char *getName() const override { return "pid"; }
+
+  private:
+    const PidGains kGains;
+    int64_t mIntegralError;
+    int64_t mPreviousError;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
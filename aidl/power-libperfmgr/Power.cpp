@@ -30,6 +30,7 @@
 
 #include "PowerHintSession.h"
 #include "PowerSessionManager.h"
+#include "UclampApplier.h"
 
 namespace aidl {
 namespace google {
@@ -251,6 +252,10 @@ binder_status_t Power::dump(int fd, const char **, uint32_t) {
             "SustainedPerformanceMode: %s\n",
             boolToString(mHintManager->IsRunning()), boolToString(mVRModeOn),
             boolToString(mSustainedPerfModeOn)));
+    if (mAdpfRateNs > 0) {
+        UclampApplier::getInstance()->dump(&buf);
+        PowerSessionManager::getInstance()->dump(&buf);
+    }
     // Dump nodes through libperfmgr
     mHintManager->DumpToFd(fd);
     if (!::android::base::WriteStringToFd(buf, fd)) {
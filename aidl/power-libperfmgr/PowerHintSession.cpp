@@ -21,13 +21,15 @@
 #include <android-base/parsedouble.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
-#include <sys/syscall.h>
 #include <time.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <atomic>
 
 #include "PowerHintSession.h"
 #include "PowerSessionManager.h"
+#include "PredictiveController.h"
+#include "UclampApplier.h"
 
 namespace aidl {
 namespace google {
@@ -49,7 +51,6 @@ constexpr char kPowerHalAdpfPidDUnder[] = "vendor.powerhal.adpf.pid_d.under";
 constexpr char kPowerHalAdpfPidIInit[] = "vendor.powerhal.adpf.pid_i.init";
 constexpr char kPowerHalAdpfPidIHighLimit[] = "vendor.powerhal.adpf.pid_i.high_limit";
 constexpr char kPowerHalAdpfPidILowLimit[] = "vendor.powerhal.adpf.pid_i.low_limit";
-constexpr char kPowerHalAdpfUclampEnable[] = "vendor.powerhal.adpf.uclamp";
 constexpr char kPowerHalAdpfUclampMinGranularity[] = "vendor.powerhal.adpf.uclamp_min.granularity";
 constexpr char kPowerHalAdpfUclampMinHighLimit[] = "vendor.powerhal.adpf.uclamp_min.high_limit";
 constexpr char kPowerHalAdpfUclampMinLowLimit[] = "vendor.powerhal.adpf.uclamp_min.low_limit";
@@ -57,36 +58,11 @@ constexpr char kPowerHalAdpfStaleTimeFactor[] = "vendor.powerhal.adpf.stale_time
 constexpr char kPowerHalAdpfPSamplingWindow[] = "vendor.powerhal.adpf.p.window";
 constexpr char kPowerHalAdpfISamplingWindow[] = "vendor.powerhal.adpf.i.window";
 constexpr char kPowerHalAdpfDSamplingWindow[] = "vendor.powerhal.adpf.d.window";
+constexpr char kPowerHalAdpfController[] = "vendor.powerhal.adpf.controller";
+constexpr char kPowerHalAdpfPredictiveAlpha[] = "vendor.powerhal.adpf.predictive.alpha";
+constexpr char kPowerHalAdpfPredictiveMargin[] = "vendor.powerhal.adpf.predictive.margin";
 
 namespace {
-/* there is no glibc or bionic wrapper */
-struct sched_attr {
-    __u32 size;
-    __u32 sched_policy;
-    __u64 sched_flags;
-    __s32 sched_nice;
-    __u32 sched_priority;
-    __u64 sched_runtime;
-    __u64 sched_deadline;
-    __u64 sched_period;
-    __u32 sched_util_min;
-    __u32 sched_util_max;
-};
-
-static int sched_setattr(int pid, struct sched_attr *attr, unsigned int flags) {
-    static const bool kPowerHalAdpfUclamp =
-            ::android::base::GetBoolProperty(kPowerHalAdpfUclampEnable, true);
-    if (!kPowerHalAdpfUclamp) {
-        ALOGV("PowerHintSession:%s: skip", __func__);
-        return 0;
-    }
-    return syscall(__NR_sched_setattr, pid, attr, flags);
-}
-
-static inline int64_t ns_to_100us(int64_t ns) {
-    return ns / 100000;
-}
-
 static double getDoubleProperty(const char *prop, double value) {
     std::string result = ::android::base::GetProperty(prop, std::to_string(value).c_str());
     if (!::android::base::ParseDouble(result.c_str(), &value)) {
@@ -129,25 +105,54 @@ static const int64_t sISamplingWindow =
         ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfISamplingWindow, 0);
 static const int64_t sDSamplingWindow =
         ::android::base::GetUintProperty<uint32_t>(kPowerHalAdpfDSamplingWindow, 1);
+static const PidGains sPidGains = {
+        .pOver = sPidPOver,
+        .pUnder = sPidPUnder,
+        .i = sPidI,
+        .dOver = sPidDOver,
+        .dUnder = sPidDUnder,
+        .iInit = sPidIInit,
+        .iHighLimit = sPidIHighLimit,
+        .iLowLimit = sPidILowLimit,
+        .pWindow = sPSamplingWindow,
+        .iWindow = sISamplingWindow,
+        .dWindow = sDSamplingWindow,
+};
+static const PredictiveGains sPredictiveGains = {
+        .alpha = std::clamp(getDoubleProperty(kPowerHalAdpfPredictiveAlpha, 0.5), 0.01, 1.0),
+        .margin = getDoubleProperty(kPowerHalAdpfPredictiveMargin, 3.5),
+};
+static const std::string sController = ::android::base::GetProperty(kPowerHalAdpfController, "pid");
+
+// "vendor.powerhal.adpf.controller.<uid>" overrides the default for one app.
+static std::unique_ptr<WorkDurationController> createController(int32_t uid) {
+    const std::string name = ::android::base::GetProperty(
+            StringPrintf("%s.%" PRId32, kPowerHalAdpfController, uid), sController);
+    if (name == "predictive") {
+        return std::make_unique<PredictiveController>(sPidGains, sPredictiveGains);
+    }
+    if (name != "pid") {
+        ALOGW("PowerHintSession: unknown controller %s for uid %" PRId32 ", use pid",
+              name.c_str(), uid);
+    }
+    return std::make_unique<PidController>(sPidGains);
+}
 
 }  // namespace
 
 PowerHintSession::PowerHintSession(int32_t tgid, int32_t uid, const std::vector<int32_t> &threadIds,
                                    int64_t durationNanos, const nanoseconds adpfRate)
-    : kAdpfRate(adpfRate) {
+    : kAdpfRate(adpfRate), mController(createController(uid)) {
     mDescriptor = new AppHintDesc(tgid, uid, threadIds);
     mDescriptor->duration = std::chrono::nanoseconds(durationNanos);
     mStaleHandler = sp<StaleHandler>(new StaleHandler(this));
     mPowerManagerHandler = PowerSessionManager::getInstance();
+    updateTraceNames();
 
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
-        sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
-        sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), isStale());
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.stale.c_str(), isStale());
     }
     PowerSessionManager::getInstance()->addPowerSession(this);
     // init boost
@@ -159,13 +164,9 @@ PowerHintSession::~PowerHintSession() {
     close();
     ALOGV("PowerHintSession deleted: %s", mDescriptor->toString().c_str());
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
-        sz = StringPrintf("adpf.%s-actl_last", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
-        sz = sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 0);
+        ATRACE_INT(mTraceNames.target.c_str(), 0);
+        ATRACE_INT(mTraceNames.actlLast.c_str(), 0);
+        ATRACE_INT(mTraceNames.active.c_str(), 0);
     }
     delete mDescriptor;
 }
@@ -176,6 +177,33 @@ std::string PowerHintSession::getIdString() const {
     return idstr;
 }
 
+void PowerHintSession::updateTraceNames() {
+    const std::string idstr = getIdString();
+    mTraceNames.build(idstr);
+}
+
+void AdpfTraceNames::build(const std::string &idstr) {
+    auto name = [&idstr](const char *suffix) {
+        return StringPrintf("adpf.%s-%s", idstr.c_str(), suffix);
+    };
+    target = name("target");
+    active = name("active");
+    stale = name("stale");
+    actlLast = name("actl_last");
+    min = name("min");
+    wakeup = name("wakeup");
+    err = name("err");
+    integral = name("integral");
+    derivative = name("derivative");
+    sampleSize = name("sample_size");
+    pidCount = name("pid.count");
+    pidPOut = name("pid.pOut");
+    pidIOut = name("pid.iOut");
+    pidDOut = name("pid.dOut");
+    pidOutput = name("pid.output");
+    pidOvertime = name("pid.overtime");
+}
+
 void PowerHintSession::updateUniveralBoostMode() {
     PowerHintMonitor::getInstance()->getLooper()->sendMessage(mPowerManagerHandler, NULL);
 }
@@ -187,25 +215,12 @@ int PowerHintSession::setUclamp(int32_t min, int32_t max) {
     max = std::max(0, max);
     max = std::max(min, max);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-min", idstr.c_str());
-        ATRACE_INT(sz.c_str(), min);
-    }
-    for (const auto tid : mDescriptor->threadIds) {
-        sched_attr attr = {};
-        attr.size = sizeof(attr);
-
-        attr.sched_flags = (SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP);
-        attr.sched_util_min = min;
-        attr.sched_util_max = max;
-
-        int ret = sched_setattr(tid, &attr, 0);
-        if (ret) {
-            ALOGW("sched_setattr failed for thread %d, err=%d", tid, errno);
-        }
-        ALOGV("PowerHintSession tid: %d, uclamp(%d, %d)", tid, min, max);
+        ATRACE_INT(mTraceNames.min.c_str(), min);
     }
+    UclampApplier::getInstance()->request(mDescriptor->threadIds, min, max);
+    ALOGV("PowerHintSession %s: uclamp(%d, %d)", getIdString().c_str(), min, max);
     mDescriptor->current_min = min;
+    mStats.recordUclamp(min);
     return 0;
 }
 
@@ -216,9 +231,7 @@ ndk::ScopedAStatus PowerHintSession::pause() {
     setUclamp(0);
     mDescriptor->is_active.store(false);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
     }
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
@@ -228,13 +241,11 @@ ndk::ScopedAStatus PowerHintSession::resume() {
     if (mDescriptor->is_active.load())
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     mDescriptor->is_active.store(true);
-    mDescriptor->integral_error = std::max(sPidIInit, mDescriptor->integral_error);
+    mController->reset();
     // resume boost
     setUclamp(sUclampMinHighLimit);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-active", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->is_active.load());
+        ATRACE_INT(mTraceNames.active.c_str(), mDescriptor->is_active.load());
     }
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
@@ -247,6 +258,8 @@ ndk::ScopedAStatus PowerHintSession::close() {
     }
     PowerHintMonitor::getInstance()->getLooper()->removeMessages(mStaleHandler);
     setUclamp(0);
+    // uclamp has to be reset before the task profile of threads is switched back
+    UclampApplier::getInstance()->flush();
     PowerSessionManager::getInstance()->removePowerSession(this);
     updateUniveralBoostMode();
     return ndk::ScopedAStatus::ok();
@@ -260,14 +273,11 @@ ndk::ScopedAStatus PowerHintSession::updateTargetWorkDuration(int64_t targetDura
     ALOGV("update target duration: %" PRId64 " ns", targetDurationNanos);
     double ratio =
             targetDurationNanos == 0 ? 1.0 : mDescriptor->duration.count() / targetDurationNanos;
-    mDescriptor->integral_error =
-            std::max(sPidIInit, static_cast<int64_t>(mDescriptor->integral_error * ratio));
+    mController->retarget(ratio);
 
     mDescriptor->duration = std::chrono::nanoseconds(targetDurationNanos);
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
     }
 
     return ndk::ScopedAStatus::ok();
@@ -288,85 +298,33 @@ ndk::ScopedAStatus PowerHintSession::reportActualWorkDuration(
         return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
     }
     if (PowerHintMonitor::getInstance()->isRunning() && isStale()) {
-        mDescriptor->integral_error = std::max(sPidIInit, mDescriptor->integral_error);
+        mController->reset();
         if (ATRACE_ENABLED()) {
-            const std::string idstr = getIdString();
-            std::string sz = StringPrintf("adpf.%s-wakeup", idstr.c_str());
-            ATRACE_INT(sz.c_str(), mDescriptor->integral_error);
-            ATRACE_INT(sz.c_str(), 0);
+            ATRACE_INT(mTraceNames.wakeup.c_str(), mController->getState());
+            ATRACE_INT(mTraceNames.wakeup.c_str(), 0);
         }
     }
     int64_t targetDurationNanos = (int64_t)mDescriptor->duration.count();
     int64_t length = actualDurations.size();
-    int64_t p_start =
-            sPSamplingWindow == 0 || sPSamplingWindow > length ? 0 : length - sPSamplingWindow;
-    int64_t i_start =
-            sISamplingWindow == 0 || sISamplingWindow > length ? 0 : length - sISamplingWindow;
-    int64_t d_start =
-            sDSamplingWindow == 0 || sDSamplingWindow > length ? 0 : length - sDSamplingWindow;
-    int64_t dt = ns_to_100us(targetDurationNanos);
-    int64_t err_sum = 0;
-    int64_t derivative_sum = 0;
-    for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
-        int64_t actualDurationNanos = actualDurations[i].durationNanos;
-        if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
-            ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64 ")",
-                  actualDurationNanos, targetDurationNanos);
-        }
-        // PID control algorithm
-        int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
-        if (i >= d_start) {
-            derivative_sum += error - mDescriptor->previous_error;
-        }
-        if (i >= p_start) {
-            err_sum += error;
-        }
-        if (i >= i_start) {
-            mDescriptor->integral_error = mDescriptor->integral_error + error * dt;
-            mDescriptor->integral_error = std::min(sPidIHighLimit, mDescriptor->integral_error);
-            mDescriptor->integral_error = std::max(sPidILowLimit, mDescriptor->integral_error);
-        }
-        mDescriptor->previous_error = error;
-    }
-    if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-err", idstr.c_str());
-        ATRACE_INT(sz.c_str(), err_sum / (length - p_start));
-        sz = StringPrintf("adpf.%s-integral", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->integral_error);
-        sz = StringPrintf("adpf.%s-derivative", idstr.c_str());
-        ATRACE_INT(sz.c_str(), derivative_sum / dt / (length - d_start));
-    }
-    int64_t pOut = static_cast<int64_t>((err_sum > 0 ? sPidPOver : sPidPUnder) * err_sum /
-                                        (length - p_start));
-    int64_t iOut = static_cast<int64_t>(sPidI * mDescriptor->integral_error);
-    int64_t dOut = static_cast<int64_t>((derivative_sum > 0 ? sPidDOver : sPidDUnder) *
-                                        derivative_sum / dt / (length - d_start));
-
-    int64_t output = pOut + iOut + dOut;
+    mStats.recordReport(actualDurations.data(), length, targetDurationNanos);
+    const ControllerOutput ctl =
+            mController->update(actualDurations.data(), length, targetDurationNanos);
+    int64_t output = ctl.output;
 
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-actl_last", idstr.c_str());
-        ATRACE_INT(sz.c_str(), actualDurations[length - 1].durationNanos);
-        sz = StringPrintf("adpf.%s-target", idstr.c_str());
-        ATRACE_INT(sz.c_str(), (int64_t)mDescriptor->duration.count());
-        sz = StringPrintf("adpf.%s-sample_size", idstr.c_str());
-        ATRACE_INT(sz.c_str(), length);
-        sz = StringPrintf("adpf.%s-pid.count", idstr.c_str());
-        ATRACE_INT(sz.c_str(), mDescriptor->update_count);
-        sz = StringPrintf("adpf.%s-pid.pOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), pOut);
-        sz = StringPrintf("adpf.%s-pid.iOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), iOut);
-        sz = StringPrintf("adpf.%s-pid.dOut", idstr.c_str());
-        ATRACE_INT(sz.c_str(), dOut);
-        sz = StringPrintf("adpf.%s-pid.output", idstr.c_str());
-        ATRACE_INT(sz.c_str(), output);
-        sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), isStale());
-        sz = StringPrintf("adpf.%s-pid.overtime", idstr.c_str());
-        ATRACE_INT(sz.c_str(), err_sum > 0);
+        ATRACE_INT(mTraceNames.err.c_str(), ctl.errAvg);
+        ATRACE_INT(mTraceNames.integral.c_str(), mController->getState());
+        ATRACE_INT(mTraceNames.derivative.c_str(), ctl.derivativeAvg);
+        ATRACE_INT(mTraceNames.actlLast.c_str(), actualDurations[length - 1].durationNanos);
+        ATRACE_INT(mTraceNames.target.c_str(), (int64_t)mDescriptor->duration.count());
+        ATRACE_INT(mTraceNames.sampleSize.c_str(), length);
+        ATRACE_INT(mTraceNames.pidCount.c_str(), mDescriptor->update_count);
+        ATRACE_INT(mTraceNames.pidPOut.c_str(), ctl.pOut);
+        ATRACE_INT(mTraceNames.pidIOut.c_str(), ctl.iOut);
+        ATRACE_INT(mTraceNames.pidDOut.c_str(), ctl.dOut);
+        ATRACE_INT(mTraceNames.pidOutput.c_str(), output);
+        ATRACE_INT(mTraceNames.stale.c_str(), isStale());
+        ATRACE_INT(mTraceNames.pidOvertime.c_str(), ctl.errSum > 0);
     }
     mDescriptor->update_count++;
 
@@ -418,12 +376,15 @@ const std::vector<int> &PowerHintSession::getTidList() const {
     return mDescriptor->threadIds;
 }
 
+AdpfStatsSnapshot PowerHintSession::getStats() const {
+    return mStats.snapshot();
+}
+
 void PowerHintSession::setStale() {
     if (ATRACE_ENABLED()) {
-        const std::string idstr = getIdString();
-        std::string sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-        ATRACE_INT(sz.c_str(), 1);
+        ATRACE_INT(mTraceNames.stale.c_str(), 1);
     }
+    mStats.recordStale();
     // Reset to default uclamp value.
     setUclamp(0);
     // Deliver a task to check if all sessions are inactive.
@@ -446,9 +407,7 @@ void PowerHintSession::StaleHandler::updateStaleTimer() {
             mIsMonitoringStale.store(true);
         }
         if (ATRACE_ENABLED()) {
-            const std::string idstr = mSession->getIdString();
-            std::string sz = StringPrintf("adpf.%s-stale", idstr.c_str());
-            ATRACE_INT(sz.c_str(), 0);
+            ATRACE_INT(mSession->mTraceNames.stale.c_str(), 0);
         }
     }
 }
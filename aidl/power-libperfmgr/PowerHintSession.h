@@ -21,9 +21,13 @@
 #include <utils/Looper.h>
 #include <utils/Thread.h>
 
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
+#include "SessionStats.h"
+#include "WorkDurationController.h"
+
 namespace aidl {
 namespace google {
 namespace hardware {
@@ -50,9 +54,7 @@ struct AppHintDesc {
           duration(0LL),
           current_min(0),
           is_active(true),
-          update_count(0),
-          integral_error(0),
-          previous_error(0) {}
+          update_count(0) {}
     std::string toString() const;
     const int32_t tgid;
     const int32_t uid;
@@ -63,8 +65,27 @@ struct AppHintDesc {
     std::atomic<bool> is_active;
     // pid
     uint64_t update_count;
-    int64_t integral_error;
-    int64_t previous_error;
+};
+
+// ATRACE counter names of a session, built once so tracing does not allocate per report.
+struct AdpfTraceNames {
+    void build(const std::string &idstr);
+    std::string target;
+    std::string active;
+    std::string stale;
+    std::string actlLast;
+    std::string min;
+    std::string wakeup;
+    std::string err;
+    std::string integral;
+    std::string derivative;
+    std::string sampleSize;
+    std::string pidCount;
+    std::string pidPOut;
+    std::string pidIOut;
+    std::string pidDOut;
+    std::string pidOutput;
+    std::string pidOvertime;
 };
 
 class PowerHintSession : public BnPowerHintSession {
@@ -81,6 +102,8 @@ class PowerHintSession : public BnPowerHintSession {
     bool isActive();
     bool isStale();
     const std::vector<int> &getTidList() const;
+    std::string getIdString() const;
+    AdpfStatsSnapshot getStats() const;
 
   private:
     class StaleHandler : public MessageHandler {
@@ -102,13 +125,17 @@ class PowerHintSession : public BnPowerHintSession {
     void setStale();
     void updateUniveralBoostMode();
     int setUclamp(int32_t min, int32_t max = kMaxUclampValue);
-    std::string getIdString() const;
+    // Must be called again if tgid, uid or the session address ever change.
+    void updateTraceNames();
     AppHintDesc *mDescriptor = nullptr;
     sp<StaleHandler> mStaleHandler;
     sp<MessageHandler> mPowerManagerHandler;
     std::mutex mLock;
     const nanoseconds kAdpfRate;
     std::atomic<bool> mSessionClosed = false;
+    AdpfTraceNames mTraceNames;
+    std::unique_ptr<WorkDurationController> mController;
+    AdpfSessionStats mStats;
 };
 
 }  // namespace pixel
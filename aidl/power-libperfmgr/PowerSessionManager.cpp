@@ -17,11 +17,15 @@
 #define LOG_TAG "powerhal-libperfmgr"
 #define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
 
+#include <android-base/stringprintf.h>
 #include <log/log.h>
 #include <processgroup/processgroup.h>
 #include <utils/Trace.h>
 
+#include <cinttypes>
+
 #include "PowerSessionManager.h"
+#include "UclampApplier.h"
 
 namespace aidl {
 namespace google {
@@ -30,6 +34,8 @@ namespace power {
 namespace impl {
 namespace pixel {
 
+using ::android::base::StringPrintf;
+
 void PowerSessionManager::setHintManager(std::shared_ptr<HintManager> const &hint_manager) {
     // Only initialize hintmanager instance if hint is supported.
     if (hint_manager->IsHintSupported(kDisableBoostHintName)) {
@@ -63,6 +69,7 @@ void PowerSessionManager::addPowerSession(PowerHintSession *session) {
             } else {
                 mTidRefCountMap[t] = 1;
             }
+            UclampApplier::getInstance()->forget(t);
             continue;
         }
         if (mTidRefCountMap[t] <= 0) {
@@ -86,10 +93,35 @@ void PowerSessionManager::removePowerSession(PowerHintSession *session) {
             if (!SetTaskProfiles(t, {"NoResetUclampGrp"})) {
                 ALOGW("Failed to set NoResetUclampGrp task profile for tid:%d", t);
             }
+            UclampApplier::getInstance()->forget(t);
             mTidRefCountMap.erase(t);
         }
     }
-    mSessions.erase(session);
+    if (mSessions.erase(session)) {
+        mClosedStats.merge(session->getStats());
+    }
+}
+
+void PowerSessionManager::dump(std::string *out) {
+    std::lock_guard<std::mutex> guard(mLock);
+    AdpfStatsSnapshot total = mClosedStats;
+    std::string sessions;
+    std::string json;
+    for (PowerHintSession *s : mSessions) {
+        const AdpfStatsSnapshot stats = s->getStats();
+        total.merge(stats);
+        sessions.append(StringPrintf("ADPF session %s:\n", s->getIdString().c_str()));
+        sessions.append(stats.toString());
+        json.append(StringPrintf("%s{\"id\":\"%s\",\"stats\":%s}", json.empty() ? "" : ",",
+                                 s->getIdString().c_str(), stats.toJson().c_str()));
+    }
+    out->append(StringPrintf("ADPF sessions: %zu open, %" PRIu64 " closed\n", mSessions.size(),
+                             mClosedStats.sessions));
+    out->append(total.toString());
+    out->append(sessions);
+    out->append(StringPrintf(
+            "ADPF stats json: {\"total\":%s,\"closed\":%s,\"sessions\":[%s]}\n",
+            total.toJson().c_str(), mClosedStats.toJson().c_str(), json.c_str()));
 }
 
 std::optional<bool> PowerSessionManager::isAnySessionActive() {
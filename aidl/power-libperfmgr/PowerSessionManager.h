@@ -52,6 +52,7 @@ class PowerSessionManager : public MessageHandler {
 
     void handleMessage(const Message &message) override;
     void setHintManager(std::shared_ptr<HintManager> const &hint_manager);
+    void dump(std::string *out);
 
     // Singleton
     static sp<PowerSessionManager> getInstance() {
@@ -67,6 +68,7 @@ class PowerSessionManager : public MessageHandler {
     std::shared_ptr<HintManager> mHintManager;
     std::unordered_set<PowerHintSession *> mSessions;  // protected by mLock
     std::unordered_map<int, int> mTidRefCountMap;      // protected by mLock
+    AdpfStatsSnapshot mClosedStats;                    // protected by mLock
     std::mutex mLock;
     int mDisplayRefreshRate;
     bool mActive;  // protected by mLock
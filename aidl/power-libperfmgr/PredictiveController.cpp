@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PredictiveController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+static inline int64_t ns_to_100us(int64_t ns) {
+    return ns / 100000;
+}
+
+}  // namespace
+
+ControllerOutput PredictiveController::update(const WorkDuration *actualDurations, size_t length,
+                                              int64_t targetDurationNanos) {
+    const int64_t n = static_cast<int64_t>(length);
+    const int64_t i_start =
+            kPidGains.iWindow == 0 || kPidGains.iWindow > n ? 0 : n - kPidGains.iWindow;
+    const int64_t dt = ns_to_100us(targetDurationNanos);
+
+    int64_t err_sum = 0;
+    int64_t integral = mIntegralError;
+    for (int64_t i = 0; i < n; i++) {
+        const int64_t actual = actualDurations[i].durationNanos;
+        const int64_t error = ns_to_100us(actual - targetDurationNanos);
+        if (!mForecastValid) {
+            mForecastNanos = actual;
+            mDeviationNanos = 0;
+            mForecastValid = true;
+        } else {
+            mDeviationNanos +=
+                    kGains.alpha * (std::abs(actual - mForecastNanos) - mDeviationNanos);
+            mForecastNanos += kGains.alpha * (actual - mForecastNanos);
+        }
+        err_sum += error;
+        if (i >= i_start) {
+            integral = std::max(kPidGains.iLowLimit,
+                                std::min(kPidGains.iHighLimit, integral + error * dt));
+        }
+    }
+    mIntegralError = integral;
+
+    const int64_t predicted_error = ns_to_100us(
+            static_cast<int64_t>(mForecastNanos + kGains.margin * mDeviationNanos) -
+            targetDurationNanos);
+
+    ControllerOutput out;
+    out.errSum = err_sum;
+    out.errAvg = err_sum / n;
+    out.derivativeAvg = 0;
+    out.pOut = static_cast<int64_t>(
+            (predicted_error > 0 ? kPidGains.pOver : kPidGains.pUnder) * predicted_error);
+    out.iOut = static_cast<int64_t>(kPidGains.i * mIntegralError);
+    out.dOut = 0;
+    out.output = out.pOut + out.iOut;
+    return out;
+}
+
+void PredictiveController::reset() {
+    mIntegralError = std::max(kPidGains.iInit, mIntegralError);
+    mForecastValid = false;
+}
+
+void PredictiveController::retarget(double ratio) {
+    mIntegralError = std::max(kPidGains.iInit, static_cast<int64_t>(mIntegralError * ratio));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "PidController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+struct PredictiveGains {
+    // EWMA weight of the newest sample, in (0, 1]
+    double alpha;
+    // headroom above the forecast, in mean absolute deviations
+    double margin;
+};
+
+/*
+ * Feed-forward variant of the PID controller.
+ *
+ * Frame durations are tracked with an EWMA of the mean and of the absolute deviation, and the
+ * P term acts on the forecast error of the next frame (mean + margin * deviation - target)
+ * instead of on the errors already reported, so the boost rises before a slow frame misses its
+ * deadline. The I term and its limits are the same as the PID one; there is no D term, the
+ * forecast already reacts to trends.
+ */
+class PredictiveController : public WorkDurationController {
+  public:
+    PredictiveController(const PidGains &pidGains, const PredictiveGains &gains)
+        : kPidGains(pidGains),
+          kGains(gains),
+          mIntegralError(0),
+          mForecastValid(false),
+          mForecastNanos(0),
+          mDeviationNanos(0) {}
+    ControllerOutput update(const WorkDuration *actualDurations, size_t length,
+                            int64_t targetDurationNanos) override;
+    // Raises the integral to its initial value and drops the frame history.
+    void reset() override;
+    void retarget(double ratio) override;
+    int64_t getState() const override { return mIntegralError; }
+    const char *getName() const override { return "predictive"; }
+
+  private:
+    const PidGains kPidGains;
+    const PredictiveGains kGains;
+    int64_t mIntegralError;
+    bool mForecastValid;
+    double mForecastNanos;
+    double mDeviationNanos;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
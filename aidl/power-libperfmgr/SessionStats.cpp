@@ -0,0 +1,226 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SessionStats.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::base::StringPrintf;
+
+namespace {
+
+static inline int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+// Reports are serialized by the session, like the controller update next to them, so their
+// counters have a single writer and need no atomic read-modify-write. Readers still load whole
+// values.
+static inline void addSingleWriter(std::atomic<uint64_t> *counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// permille = actual * 1000 / target is above a bound once actual * 1000 reaches (bound + 1) * target
+static inline void ratioThresholds(int64_t targetDurationNanos,
+                                   int64_t (&thresholds)[kAdpfRatioBuckets - 1]) {
+    for (size_t i = 0; i < kAdpfRatioBuckets - 1; i++) {
+        thresholds[i] = (kAdpfRatioBounds[i] + 1) * targetDurationNanos;
+    }
+}
+
+// Bounds are ascending, so the bucket is the number of them the ratio is above: a branch-free
+// binary search over the 8 bounds, and a last step for the open bucket.
+static_assert(kAdpfRatioBuckets - 1 == 8, "ratioBucket() searches exactly 8 bounds");
+static inline size_t ratioBucket(int64_t actualPermilleNanos,
+                                 const int64_t (&thresholds)[kAdpfRatioBuckets - 1]) {
+    size_t bucket = (actualPermilleNanos >= thresholds[3]) * 4;
+    bucket += (actualPermilleNanos >= thresholds[bucket + 1]) * 2;
+    bucket += actualPermilleNanos >= thresholds[bucket];
+    return bucket + (actualPermilleNanos >= thresholds[7]);
+}
+
+static inline int32_t uclampBucket(int32_t min) {
+    if (min <= 0) {
+        return 0;
+    }
+    return std::min<int32_t>(kAdpfUclampBuckets - 1, 1 + (min - 1) / kAdpfUclampStep);
+}
+
+template <typename T, size_t N>
+static std::string toJsonArray(const T (&values)[N], uint64_t divisor = 1) {
+    std::string out = "[";
+    for (size_t i = 0; i < N; i++) {
+        out.append(StringPrintf("%s%" PRIu64, i ? "," : "",
+                                static_cast<uint64_t>(values[i]) / divisor));
+    }
+    out.append("]");
+    return out;
+}
+
+}  // namespace
+
+AdpfSessionStats::AdpfSessionStats()
+    : kCreatedNs(nowNs()),
+      mReports(0),
+      mSamples(0),
+      mMisses(0),
+      mStaleTransitions(0),
+      mUclampBucket(0),
+      mUclampSinceNs(kCreatedNs) {
+    for (auto &bucket : mRatioHist) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    for (auto &bucket : mUclampResidencyNs) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AdpfSessionStats::recordReport(const WorkDuration *actualDurations, size_t length,
+                                    int64_t targetDurationNanos) {
+    // Counted locally first, so a report stores once per bucket it hit, not per sample, and
+    // compared against thresholds scaled by the target, so no sample needs a division.
+    int64_t thresholds[kAdpfRatioBuckets - 1];
+    ratioThresholds(targetDurationNanos, thresholds);
+    uint64_t misses = 0;
+    uint64_t hist[kAdpfRatioBuckets] = {};
+    for (size_t i = 0; i < length; i++) {
+        const int64_t actual = actualDurations[i].durationNanos;
+        misses += actual > targetDurationNanos;
+        hist[ratioBucket(actual * 1000, thresholds)]++;
+    }
+    for (size_t bucket = 0; bucket < kAdpfRatioBuckets; bucket++) {
+        if (hist[bucket]) {
+            addSingleWriter(&mRatioHist[bucket], hist[bucket]);
+        }
+    }
+    addSingleWriter(&mReports, 1);
+    addSingleWriter(&mSamples, length);
+    addSingleWriter(&mMisses, misses);
+}
+
+void AdpfSessionStats::recordStale() {
+    mStaleTransitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Called with the session lock held, so level changes are serialized.
+void AdpfSessionStats::recordUclamp(int32_t min) {
+    const int64_t now = nowNs();
+    const int32_t previous = mUclampBucket.exchange(uclampBucket(min), std::memory_order_relaxed);
+    const int64_t since = mUclampSinceNs.exchange(now, std::memory_order_relaxed);
+    mUclampResidencyNs[previous].fetch_add(now - since, std::memory_order_relaxed);
+}
+
+AdpfStatsSnapshot AdpfSessionStats::snapshot() const {
+    const int64_t now = nowNs();
+    AdpfStatsSnapshot s;
+    s.sessions = 1;
+    s.reports = mReports.load(std::memory_order_relaxed);
+    s.samples = mSamples.load(std::memory_order_relaxed);
+    s.misses = mMisses.load(std::memory_order_relaxed);
+    s.staleTransitions = mStaleTransitions.load(std::memory_order_relaxed);
+    s.lifetimeNs = now - kCreatedNs;
+    for (size_t i = 0; i < kAdpfRatioBuckets; i++) {
+        s.ratioHist[i] = mRatioHist[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < kAdpfUclampBuckets; i++) {
+        s.uclampResidencyNs[i] = mUclampResidencyNs[i].load(std::memory_order_relaxed);
+    }
+    // account the level currently in effect
+    const int64_t since = mUclampSinceNs.load(std::memory_order_relaxed);
+    if (now > since) {
+        s.uclampResidencyNs[mUclampBucket.load(std::memory_order_relaxed)] += now - since;
+    }
+    return s;
+}
+
+void AdpfStatsSnapshot::merge(const AdpfStatsSnapshot &other) {
+    sessions += other.sessions;
+    reports += other.reports;
+    samples += other.samples;
+    misses += other.misses;
+    staleTransitions += other.staleTransitions;
+    lifetimeNs += other.lifetimeNs;
+    for (size_t i = 0; i < kAdpfRatioBuckets; i++) {
+        ratioHist[i] += other.ratioHist[i];
+    }
+    for (size_t i = 0; i < kAdpfUclampBuckets; i++) {
+        uclampResidencyNs[i] += other.uclampResidencyNs[i];
+    }
+}
+
+std::string AdpfStatsSnapshot::toString() const {
+    std::string out = StringPrintf(
+            "  reports: %" PRIu64 " (%.1f/s), samples: %" PRIu64 ", deadline misses: %" PRIu64
+            " (%.1f%%), stale transitions: %" PRIu64 "\n",
+            reports, lifetimeNs ? reports * 1e9 / lifetimeNs : 0.0, samples, misses,
+            samples ? 100.0 * misses / samples : 0.0, staleTransitions);
+    out.append("  actual/target:");
+    for (size_t i = 0; i < kAdpfRatioBuckets; i++) {
+        if (i < kAdpfRatioBuckets - 1) {
+            out.append(StringPrintf(" <=%.2f:%" PRIu64, kAdpfRatioBounds[i] / 1000.0,
+                                    ratioHist[i]));
+        } else {
+            out.append(StringPrintf(" >%.2f:%" PRIu64, kAdpfRatioBounds[i - 1] / 1000.0,
+                                    ratioHist[i]));
+        }
+    }
+    out.append("\n  uclamp.min residency (ms):");
+    for (size_t i = 0; i < kAdpfUclampBuckets; i++) {
+        if (!uclampResidencyNs[i]) {
+            continue;
+        }
+        if (i == 0) {
+            out.append(StringPrintf(" 0:%" PRIu64, uclampResidencyNs[i] / 1000000));
+        } else {
+            out.append(StringPrintf(" %zu-%zu:%" PRIu64, (i - 1) * kAdpfUclampStep + 1,
+                                    i * kAdpfUclampStep, uclampResidencyNs[i] / 1000000));
+        }
+    }
+    out.append("\n");
+    return out;
+}
+
+std::string AdpfStatsSnapshot::toJson() const {
+    return StringPrintf("{\"sessions\":%" PRIu64 ",\"reports\":%" PRIu64
+                        ",\"samples\":%" PRIu64 ",\"deadline_misses\":%" PRIu64
+                        ",\"stale_transitions\":%" PRIu64 ",\"lifetime_ms\":%" PRIu64
+                        ",\"ratio_bounds_permille\":%s,\"ratio_hist\":%s"
+                        ",\"uclamp_step\":%d,\"uclamp_residency_ms\":%s}",
+                        sessions, reports, samples, misses, staleTransitions,
+                        lifetimeNs / 1000000, toJsonArray(kAdpfRatioBounds).c_str(),
+                        toJsonArray(ratioHist).c_str(), kAdpfUclampStep,
+                        toJsonArray(uclampResidencyNs, 1000000).c_str());
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/power/WorkDuration.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using aidl::android::hardware::power::WorkDuration;
+
+// actual/target ratio histogram, upper bounds in permille; the last bucket is open
+constexpr size_t kAdpfRatioBuckets = 9;
+constexpr int64_t kAdpfRatioBounds[kAdpfRatioBuckets - 1] = {500,  750,  900,  1000,
+                                                              1100, 1250, 1500, 2000};
+// uclamp.min residency: level 0, then 64 wide steps up to 1024
+constexpr size_t kAdpfUclampBuckets = 17;
+constexpr int32_t kAdpfUclampStep = 64;
+
+struct AdpfStatsSnapshot {
+    uint64_t sessions = 0;
+    uint64_t reports = 0;
+    uint64_t samples = 0;
+    uint64_t misses = 0;
+    uint64_t staleTransitions = 0;
+    uint64_t lifetimeNs = 0;
+    uint64_t ratioHist[kAdpfRatioBuckets] = {};
+    uint64_t uclampResidencyNs[kAdpfUclampBuckets] = {};
+    void merge(const AdpfStatsSnapshot &other);
+    std::string toString() const;
+    std::string toJson() const;
+};
+
+/*
+ * Statistics of one session. Writers only do relaxed atomic updates, so the report path never
+ * blocks on dump; a snapshot may be a few updates apart between fields. recordReport() must not
+ * run concurrently with itself, as the session already serializes reports.
+ */
+class AdpfSessionStats {
+  public:
+    AdpfSessionStats();
+    void recordReport(const WorkDuration *actualDurations, size_t length,
+                      int64_t targetDurationNanos);
+    void recordStale();
+    void recordUclamp(int32_t min);
+    AdpfStatsSnapshot snapshot() const;
+
+  private:
+    const int64_t kCreatedNs;
+    std::atomic<uint64_t> mReports;
+    std::atomic<uint64_t> mSamples;
+    std::atomic<uint64_t> mMisses;
+    std::atomic<uint64_t> mStaleTransitions;
+    std::atomic<uint64_t> mRatioHist[kAdpfRatioBuckets];
+    std::atomic<uint64_t> mUclampResidencyNs[kAdpfUclampBuckets];
+    std::atomic<int32_t> mUclampBucket;
+    std::atomic<int64_t> mUclampSinceNs;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "powerhal-libperfmgr"
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include "UclampApplier.h"
+
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <utils/Trace.h>
+
+#include <cerrno>
+#include <cinttypes>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::base::StringPrintf;
+
+constexpr char kPowerHalAdpfUclampEnable[] = "vendor.powerhal.adpf.uclamp";
+
+namespace {
+/* there is no glibc or bionic wrapper */
+struct sched_attr {
+    __u32 size;
+    __u32 sched_policy;
+    __u64 sched_flags;
+    __s32 sched_nice;
+    __u32 sched_priority;
+    __u64 sched_runtime;
+    __u64 sched_deadline;
+    __u64 sched_period;
+    __u32 sched_util_min;
+    __u32 sched_util_max;
+};
+
+static int sched_setattr(int pid, struct sched_attr *attr, unsigned int flags) {
+    static const bool kPowerHalAdpfUclamp =
+            ::android::base::GetBoolProperty(kPowerHalAdpfUclampEnable, true);
+    if (!kPowerHalAdpfUclamp) {
+        ALOGV("UclampApplier:%s: skip", __func__);
+        return 0;
+    }
+    return syscall(__NR_sched_setattr, pid, attr, flags);
+}
+
+static void atomicMax(std::atomic<uint64_t> *target, uint64_t value) {
+    uint64_t current = target->load(std::memory_order_relaxed);
+    while (value > current &&
+           !target->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+void UclampApplier::start() {
+    if (!isRunning()) {
+        run("UclampApplier", ::android::PRIORITY_HIGHEST);
+    }
+}
+
+void UclampApplier::request(const std::vector<int> &tids, int32_t min, int32_t max) {
+    uint64_t coalesced = 0;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        if (mPending.empty()) {
+            mPendingSince = std::chrono::steady_clock::now();
+        }
+        for (const auto tid : tids) {
+            if (!mPending.insert_or_assign(tid, UclampValue{min, max}).second) {
+                coalesced++;
+            }
+        }
+        mRequestSeq++;
+    }
+    mRequests.fetch_add(tids.size(), std::memory_order_relaxed);
+    mCoalesced.fetch_add(coalesced, std::memory_order_relaxed);
+    mCv.notify_one();
+}
+
+void UclampApplier::flush() {
+    if (!isRunning()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mLock);
+    const uint64_t seq = mRequestSeq;
+    mFlushCv.wait(lock, [this, seq] { return mAppliedSeq >= seq; });
+}
+
+void UclampApplier::forget(int tid) {
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mForget.push_back(tid);
+    }
+    mCv.notify_one();
+}
+
+bool UclampApplier::threadLoop() {
+    std::unordered_map<int, UclampValue> batch;
+    std::vector<int> forget;
+    std::chrono::steady_clock::time_point since;
+    uint64_t seq;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCv.wait(lock, [this] { return !mPending.empty() || !mForget.empty(); });
+        batch.swap(mPending);
+        forget.swap(mForget);
+        since = mPendingSince;
+        seq = mRequestSeq;
+    }
+
+    for (const auto tid : forget) {
+        mApplied.erase(tid);
+    }
+    if (!batch.empty()) {
+        applyBatch(batch);
+        const uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                           std::chrono::steady_clock::now() - since)
+                                           .count();
+        mBatches.fetch_add(1, std::memory_order_relaxed);
+        mLatencySumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+        atomicMax(&mLatencyMaxUs, latencyUs);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mAppliedSeq = seq;
+    }
+    mFlushCv.notify_all();
+    return true;
+}
+
+void UclampApplier::applyBatch(const std::unordered_map<int, UclampValue> &batch) {
+    ATRACE_NAME("UclampApplier::apply");
+    for (const auto &[tid, value] : batch) {
+        auto it = mApplied.find(tid);
+        if (it != mApplied.end() && it->second == value) {
+            mSkipped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        sched_attr attr = {};
+        attr.size = sizeof(attr);
+
+        attr.sched_flags = (SCHED_FLAG_KEEP_ALL | SCHED_FLAG_UTIL_CLAMP);
+        attr.sched_util_min = value.min;
+        attr.sched_util_max = value.max;
+
+        mWrites.fetch_add(1, std::memory_order_relaxed);
+        int ret = sched_setattr(tid, &attr, 0);
+        if (ret) {
+            ALOGW("sched_setattr failed for thread %d, err=%d", tid, errno);
+            mFailures.fetch_add(1, std::memory_order_relaxed);
+            mApplied.erase(tid);
+            continue;
+        }
+        mApplied[tid] = value;
+        ALOGV("UclampApplier tid: %d, uclamp(%d, %d)", tid, value.min, value.max);
+    }
+}
+
+void UclampApplier::dump(std::string *out) const {
+    const uint64_t requests = mRequests.load(std::memory_order_relaxed);
+    const uint64_t coalesced = mCoalesced.load(std::memory_order_relaxed);
+    const uint64_t batches = mBatches.load(std::memory_order_relaxed);
+    out->append(StringPrintf(
+            "UclampApplier: requests %" PRIu64 ", coalesced %" PRIu64 " (%.1f%%), writes %" PRIu64
+            ", skipped %" PRIu64 ", failures %" PRIu64 "\n",
+            requests, coalesced, requests ? 100.0 * coalesced / requests : 0.0,
+            mWrites.load(std::memory_order_relaxed), mSkipped.load(std::memory_order_relaxed),
+            mFailures.load(std::memory_order_relaxed)));
+    out->append(StringPrintf("UclampApplier: batches %" PRIu64 ", apply latency avg %" PRIu64
+                             " us, max %" PRIu64 " us\n",
+                             batches,
+                             batches ? mLatencySumUs.load(std::memory_order_relaxed) / batches : 0,
+                             mLatencyMaxUs.load(std::memory_order_relaxed)));
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Thread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using ::android::sp;
+using ::android::Thread;
+
+/*
+ * Applies uclamp to session threads off the binder thread.
+ *
+ * Requests are merged per tid until the applier thread picks them up, so only the newest
+ * value of a tid is written. The value last written to each tid is cached and identical
+ * writes are skipped.
+ */
+class UclampApplier : public Thread {
+  public:
+    void start();
+    bool threadLoop() override;
+    void request(const std::vector<int> &tids, int32_t min, int32_t max);
+    // Waits until every request made before the call has been written. Returns at once if the
+    // applier thread is not running.
+    void flush();
+    // The tid left all sessions, or its task profile was reset: drop its cached value.
+    // Wakes the applier thread, so the next request of the tid is always written.
+    void forget(int tid);
+    void dump(std::string *out) const;
+    // Singleton
+    static sp<UclampApplier> getInstance() {
+        static sp<UclampApplier> instance = new UclampApplier();
+        return instance;
+    }
+    UclampApplier(UclampApplier const &) = delete;
+    void operator=(UclampApplier const &) = delete;
+
+  private:
+    struct UclampValue {
+        int32_t min;
+        int32_t max;
+        bool operator==(const UclampValue &other) const {
+            return min == other.min && max == other.max;
+        }
+    };
+
+    void applyBatch(const std::unordered_map<int, UclampValue> &batch);
+
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::condition_variable mFlushCv;
+    std::unordered_map<int, UclampValue> mPending;                  // protected by mLock
+    std::vector<int> mForget;                                       // protected by mLock
+    std::chrono::steady_clock::time_point mPendingSince;            // protected by mLock
+    uint64_t mRequestSeq;                                           // protected by mLock
+    uint64_t mAppliedSeq;                                           // protected by mLock
+    std::unordered_map<int, UclampValue> mApplied;                  // applier thread only
+    // statistics
+    std::atomic<uint64_t> mRequests;
+    std::atomic<uint64_t> mCoalesced;
+    std::atomic<uint64_t> mWrites;
+    std::atomic<uint64_t> mSkipped;
+    std::atomic<uint64_t> mFailures;
+    std::atomic<uint64_t> mBatches;
+    std::atomic<uint64_t> mLatencySumUs;
+    std::atomic<uint64_t> mLatencyMaxUs;
+    // Singleton
+    UclampApplier()
+        : Thread(false),
+          mRequestSeq(0),
+          mAppliedSeq(0),
+          mRequests(0),
+          mCoalesced(0),
+          mWrites(0),
+          mSkipped(0),
+          mFailures(0),
+          mBatches(0),
+          mLatencySumUs(0),
+          mLatencyMaxUs(0) {}
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
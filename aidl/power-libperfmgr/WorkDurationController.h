@@ -0,0 +1,69 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/power/WorkDuration.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+using aidl::android::hardware::power::WorkDuration;
+
+struct ControllerOutput {
+    // uclamp.min request, before the session applies its limits
+    int64_t output;
+    // terms of the output; controllers without a D term leave dOut at 0
+    int64_t pOut;
+    int64_t iOut;
+    int64_t dOut;
+    // raw terms, for tracing
+    int64_t errSum;
+    int64_t errAvg;
+    int64_t derivativeAvg;
+};
+
+/*
+ * Turns reported work durations into a uclamp.min request for one session.
+ * Not thread safe, the session serializes calls.
+ */
+class WorkDurationController {
+  public:
+    virtual ~WorkDurationController() = default;
+    virtual ControllerOutput update(const WorkDuration *actualDurations, size_t length,
+                                    int64_t targetDurationNanos) = 0;
+    // Session resumed or woke up from stale: start again from the initial boost.
+    virtual void reset() = 0;
+    // Target duration changed by the given old/new ratio.
+    virtual void retarget(double ratio) = 0;
+    // Internal accumulator (e.g. PID integral), for tracing.
+    virtual int64_t getState() const = 0;
+    virtual const char *getName() const = 0;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
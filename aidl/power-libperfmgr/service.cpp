@@ -26,11 +26,13 @@
 #include "Power.h"
 #include "PowerExt.h"
 #include "PowerSessionManager.h"
+#include "UclampApplier.h"
 
 using aidl::google::hardware::power::impl::pixel::Power;
 using aidl::google::hardware::power::impl::pixel::PowerExt;
 using aidl::google::hardware::power::impl::pixel::PowerHintMonitor;
 using aidl::google::hardware::power::impl::pixel::PowerSessionManager;
+using aidl::google::hardware::power::impl::pixel::UclampApplier;
 using ::android::perfmgr::HintManager;
 
 constexpr std::string_view kPowerHalInitProp("vendor.powerhal.init");
@@ -70,6 +72,7 @@ int main() {
 
     if (::android::base::GetIntProperty("vendor.powerhal.adpf.rate", -1) != -1) {
         PowerHintMonitor::getInstance()->start();
+        UclampApplier::getInstance()->start();
         PowerSessionManager::getInstance()->setHintManager(hm);
     }
 
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_POWER | ATRACE_TAG_HAL)
+
+#include <benchmark/benchmark.h>
+#include <cutils/trace.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "PidController.h"
+#include "PowerHintSession.h"
+#include "ReferencePid.h"
+#include "SessionStats.h"
+
+// Counts every operator new of the process, so a benchmark can report allocations per iteration.
+static std::atomic<uint64_t> sAllocations{0};
+
+void *operator new(size_t size) {
+    sAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr int64_t kTarget60Hz = 16666666;
+constexpr size_t kReports = 64;
+constexpr size_t kFramesPerReport = 8;
+
+// Frames between 0.7 and 1.4 of the target, so the PID output and uclamp.min keep moving.
+std::vector<std::vector<WorkDuration>> makeReports() {
+    std::mt19937_64 rng(21);
+    std::uniform_real_distribution<double> ratio(0.7, 1.4);
+    std::vector<std::vector<WorkDuration>> reports(kReports);
+    int64_t now = 0;
+    for (auto &report : reports) {
+        for (size_t f = 0; f < kFramesPerReport; f++) {
+            now += kTarget60Hz;
+            report.push_back(
+                    WorkDuration{now, static_cast<int64_t>(kTarget60Hz * ratio(rng))});
+        }
+    }
+    return reports;
+}
+
+/*
+ * Turns the power and HAL atrace tags on or off for this process while in scope. Tags are
+ * read once from debug.atrace.tags.enableflags, so they are forced after that first read.
+ * Without access to trace_marker the counters are still formatted and the write fails.
+ */
+class ScopedTracing {
+  public:
+    explicit ScopedTracing(bool enable) : mSaved(atrace_get_enabled_tags()) {
+        atrace_enabled_tags = enable ? (mSaved | ATRACE_TAG) : (mSaved & ~ATRACE_TAG);
+    }
+    ~ScopedTracing() { atrace_enabled_tags = mSaved; }
+
+  private:
+    const uint64_t mSaved;
+};
+
+/*
+ * One reportActualWorkDuration() of 8 frames per iteration on a session of this thread, with
+ * the controller, statistics and uclamp.min requests as in the service. UclampApplier is not
+ * started, so no sched_setattr() is made, and PowerHintMonitor is not either, so the session
+ * never goes stale.
+ */
+void BM_ReportActualWorkDuration(benchmark::State &state, bool tracing) {
+    const std::vector<std::vector<WorkDuration>> reports = makeReports();
+    std::shared_ptr<PowerHintSession> session = ndk::SharedRefBase::make<PowerHintSession>(
+            getpid(), getuid(), std::vector<int32_t>{gettid()}, kTarget60Hz,
+            std::chrono::nanoseconds(kTarget60Hz));
+    ScopedTracing scopedTracing(tracing);
+    if (ATRACE_ENABLED() != tracing) {
+        state.SkipWithError("atrace tags cannot be set");
+        return;
+    }
+
+    size_t i = 0;
+    const uint64_t allocations = sAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        session->reportActualWorkDuration(reports[i++ % kReports]);
+    }
+    state.counters["allocs_per_report"] =
+            benchmark::Counter(sAllocations.load(std::memory_order_relaxed) - allocations,
+                               benchmark::Counter::kAvgIterations);
+    session->close();
+}
+BENCHMARK_CAPTURE(BM_ReportActualWorkDuration, TracingOff, false);
+BENCHMARK_CAPTURE(BM_ReportActualWorkDuration, TracingOn, true);
+
+// Batches of the given length, frames between 0.5 and 2.0 of the target, spikes of 4 times.
+std::vector<std::vector<WorkDuration>> makeBatches(size_t length) {
+    std::mt19937_64 rng(22);
+    std::uniform_real_distribution<double> ratio(0.5, 2.0);
+    std::vector<std::vector<WorkDuration>> batches(kReports, std::vector<WorkDuration>(length));
+    for (auto &batch : batches) {
+        for (auto &w : batch) {
+            w.durationNanos = static_cast<int64_t>(kTarget60Hz * ratio(rng));
+            if (rng() % 40 == 0) {
+                w.durationNanos *= 4;
+            }
+        }
+    }
+    return batches;
+}
+
+// Windows of the service defaults, or 0 so that every term runs over the whole batch.
+PidGains benchmarkGains(bool wholeBatch) {
+    return wholeBatch ? makeGains(0, 0, 0) : makeGains(1, 0, 1);
+}
+
+/*
+ * PID update of one report per iteration, batch length from the argument, by the per-sample
+ * loop that PidController replaced and by PidController. Throughput is in frames.
+ */
+void BM_PidSerial(benchmark::State &state, bool wholeBatch) {
+    const std::vector<std::vector<WorkDuration>> batches = makeBatches(state.range(0));
+    ReferencePid pid(benchmarkGains(wholeBatch));
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(pid.update(batches[i++ % kReports], kTarget60Hz));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_PidSerial, DefaultWindows, false)->RangeMultiplier(4)->Range(1, 64);
+BENCHMARK_CAPTURE(BM_PidSerial, WholeBatch, true)->RangeMultiplier(4)->Range(1, 64);
+
+void BM_PidBatched(benchmark::State &state, bool wholeBatch) {
+    const std::vector<std::vector<WorkDuration>> batches = makeBatches(state.range(0));
+    PidController pid(benchmarkGains(wholeBatch));
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const std::vector<WorkDuration> &batch = batches[i++ % kReports];
+        benchmark::DoNotOptimize(pid.update(batch.data(), batch.size(), kTarget60Hz));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_PidBatched, DefaultWindows, false)->RangeMultiplier(4)->Range(1, 64);
+BENCHMARK_CAPTURE(BM_PidBatched, WholeBatch, true)->RangeMultiplier(4)->Range(1, 64);
+
+// Statistics of one report per iteration, batch length from the argument, as the report path
+// records them before the controller runs.
+void BM_SessionStatsRecordReport(benchmark::State &state) {
+    const std::vector<std::vector<WorkDuration>> batches = makeBatches(state.range(0));
+    AdpfSessionStats stats;
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const std::vector<WorkDuration> &batch = batches[i++ % kReports];
+        stats.recordReport(batch.data(), batch.size(), kTarget60Hz);
+    }
+    benchmark::DoNotOptimize(stats.snapshot());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SessionStatsRecordReport)->RangeMultiplier(4)->Range(1, 64);
+
+// uclamp.min change, as setUclamp() records it with the session lock held
+void BM_SessionStatsRecordUclamp(benchmark::State &state) {
+    AdpfSessionStats stats;
+
+    int32_t min = 0;
+    for (auto _ : state) {
+        stats.recordUclamp(min);
+        min = (min + 37) % 1024;
+    }
+}
+BENCHMARK(BM_SessionStatsRecordUclamp);
+
+// Snapshot that dump takes of each session, here while another thread keeps reporting.
+void BM_SessionStatsSnapshot(benchmark::State &state, bool reporting) {
+    const std::vector<std::vector<WorkDuration>> batches = makeBatches(kFramesPerReport);
+    AdpfSessionStats stats;
+    std::atomic<bool> done{false};
+    std::thread reporter;
+    if (reporting) {
+        reporter = std::thread([&] {
+            for (size_t i = 0; !done.load(std::memory_order_relaxed); i++) {
+                const std::vector<WorkDuration> &batch = batches[i % kReports];
+                stats.recordReport(batch.data(), batch.size(), kTarget60Hz);
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stats.snapshot());
+    }
+    done.store(true);
+    if (reporter.joinable()) {
+        reporter.join();
+    }
+}
+BENCHMARK_CAPTURE(BM_SessionStatsSnapshot, Idle, false);
+BENCHMARK_CAPTURE(BM_SessionStatsSnapshot, WhileReporting, true)->UseRealTime();
+
+}  // namespace
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
+
+BENCHMARK_MAIN();
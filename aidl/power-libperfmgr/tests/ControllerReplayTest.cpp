@@ -0,0 +1,172 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "PidController.h"
+#include "PredictiveController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+constexpr int64_t kTarget60Hz = 16666666;
+constexpr size_t kFrames = 100000;
+
+// Defaults of PowerHintSession.
+constexpr int kUclampMinHighLimit = 384;
+constexpr int kUclampMinLowLimit = 2;
+constexpr int kUclampMinGranularity = 5;
+constexpr PredictiveGains kPredictiveGains = {.alpha = 0.5, .margin = 3.5};
+
+PidGains makeGains() {
+    const double i = 0.001;
+    return PidGains{
+            .pOver = 2.0,
+            .pUnder = 1.0,
+            .i = i,
+            .dOver = 500.0,
+            .dUnder = 0.0,
+            .iInit = static_cast<int64_t>(200 / i),
+            .iHighLimit = static_cast<int64_t>(512 / i),
+            .iLowLimit = static_cast<int64_t>(-30 / i),
+            .pWindow = 1,
+            .iWindow = 0,
+            .dWindow = 1,
+    };
+}
+
+enum class Load { kSlowWave, kSteadyOver, kStep, kSpiky };
+
+const char *loadName(Load load) {
+    switch (load) {
+        case Load::kSlowWave:
+            return "slow wave";
+        case Load::kSteadyOver:
+            return "steady over";
+        case Load::kStep:
+            return "step";
+        case Load::kSpiky:
+            return "spiky";
+    }
+    return "?";
+}
+
+/*
+ * Per-frame work in ns at uclamp.min 0. Fixed seeds keep the trace, and so the result, the
+ * same on every run.
+ */
+std::vector<double> makeTrace(Load load) {
+    std::mt19937_64 rng(7 + static_cast<int>(load));
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<double> work(kFrames);
+    for (size_t f = 0; f < kFrames; f++) {
+        double w = 0;
+        switch (load) {
+            case Load::kSlowWave:
+                w = kTarget60Hz * (1.1 + 0.35 * std::sin(f / 300.0)) +
+                    kTarget60Hz * 0.08 * noise(rng);
+                if (rng() % 50 == 0) w *= 1.6;
+                break;
+            case Load::kSteadyOver:
+                w = kTarget60Hz * 1.2 + kTarget60Hz * 0.05 * noise(rng);
+                break;
+            case Load::kStep:
+                w = kTarget60Hz * ((f / 2000) % 2 ? 1.5 : 0.8) + kTarget60Hz * 0.06 * noise(rng);
+                break;
+            case Load::kSpiky:
+                w = kTarget60Hz * 0.9 + kTarget60Hz * 0.15 * noise(rng);
+                if (rng() % 20 == 0) w *= 1.8;
+                break;
+        }
+        work[f] = std::max(w, 1000000.0);
+    }
+    return work;
+}
+
+struct ReplayResult {
+    double missRate;
+    double avgUclamp;
+};
+
+/*
+ * Replays one frame per report through the uclamp.min logic of
+ * PowerHintSession::reportActualWorkDuration(). The frame runs faster as uclamp.min rises,
+ * duration = work / (1 + uclamp / 256), which is crude but monotonic like the real CPU.
+ */
+ReplayResult replay(WorkDurationController *controller, const std::vector<double> &work) {
+    int uclamp = kUclampMinHighLimit;
+    size_t misses = 0;
+    double uclampSum = 0;
+    for (double w : work) {
+        const int64_t duration = static_cast<int64_t>(w / (1.0 + uclamp / 256.0));
+        if (duration > kTarget60Hz) misses++;
+        uclampSum += uclamp;
+
+        const WorkDuration actual{0, duration};
+        const int64_t output = controller->update(&actual, 1, kTarget60Hz).output;
+        if (output != 0) {
+            int next = std::min(kUclampMinHighLimit, static_cast<int>(output));
+            next = std::max(kUclampMinLowLimit, next);
+            if (std::abs(uclamp - next) > kUclampMinGranularity) uclamp = next;
+        }
+    }
+    return ReplayResult{.missRate = static_cast<double>(misses) / work.size(),
+                        .avgUclamp = uclampSum / work.size()};
+}
+
+}  // namespace
+
+class ControllerReplayTest : public ::testing::TestWithParam<Load> {};
+
+// The predictive defaults must not trade deadline misses for the lower boost.
+TEST_P(ControllerReplayTest, PredictiveMissesNoMoreThanPid) {
+    const std::vector<double> work = makeTrace(GetParam());
+    PidController pid(makeGains());
+    PredictiveController predictive(makeGains(), kPredictiveGains);
+
+    const ReplayResult pidResult = replay(&pid, work);
+    const ReplayResult predictiveResult = replay(&predictive, work);
+    printf("%-12s pid: %5.2f%% missed, uclamp.min %5.1f; predictive: %5.2f%% missed, "
+           "uclamp.min %5.1f\n",
+           loadName(GetParam()), pidResult.missRate * 100, pidResult.avgUclamp,
+           predictiveResult.missRate * 100, predictiveResult.avgUclamp);
+
+    EXPECT_LE(predictiveResult.missRate, pidResult.missRate);
+}
+
+INSTANTIATE_TEST_SUITE_P(Loads, ControllerReplayTest,
+                         ::testing::Values(Load::kSlowWave, Load::kSteadyOver, Load::kStep,
+                                           Load::kSpiky));
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
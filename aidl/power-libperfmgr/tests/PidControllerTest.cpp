@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "PidController.h"
+#include "ReferencePid.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+namespace {
+
+std::vector<WorkDuration> makeBatch(std::initializer_list<int64_t> durationsNanos) {
+    std::vector<WorkDuration> batch;
+    int64_t timestamp = 0;
+    for (int64_t d : durationsNanos) {
+        WorkDuration w;
+        timestamp += d;
+        w.timeStampNanos = timestamp;
+        w.durationNanos = d;
+        batch.push_back(w);
+    }
+    return batch;
+}
+
+// Batches recorded from a 60 Hz game session: steady frames, a load spike, one-sample reports,
+// a long batch after a hitch, and a batch far over target (way-far warning path).
+const int64_t kTarget60Hz = 16666666;
+const std::vector<std::vector<WorkDuration>> kRecordedBatches = {
+        makeBatch({15210334, 16002117, 14877902}),
+        makeBatch({16904551}),
+        makeBatch({18233010, 21457992, 24901233, 19877451}),
+        makeBatch({12002345, 11876009}),
+        makeBatch({9873001, 10234567, 11002345, 9988776, 10456789, 9765432, 10111213, 9999999,
+                   10222333, 10333444, 9444555, 10555666}),
+        makeBatch({16666666}),
+        makeBatch({16566666, 16766666}),
+        makeBatch({45012345, 38001234, 17000001}),
+        makeBatch({400000000, 16000000}),
+        makeBatch({-1000000, 15000000, 16700000, 16600000, 16800000}),
+};
+
+void expectSame(const ControllerOutput &expected, const ControllerOutput &actual,
+                const char *what) {
+    EXPECT_EQ(expected.output, actual.output) << what;
+    EXPECT_EQ(expected.pOut, actual.pOut) << what;
+    EXPECT_EQ(expected.iOut, actual.iOut) << what;
+    EXPECT_EQ(expected.dOut, actual.dOut) << what;
+    EXPECT_EQ(expected.errSum, actual.errSum) << what;
+    EXPECT_EQ(expected.errAvg, actual.errAvg) << what;
+    EXPECT_EQ(expected.derivativeAvg, actual.derivativeAvg) << what;
+}
+
+}  // namespace
+
+// 0 means the whole batch, 20 is longer than every recorded batch.
+class PidControllerWindowTest
+    : public ::testing::TestWithParam<std::tuple<int64_t, int64_t, int64_t>> {};
+
+TEST_P(PidControllerWindowTest, RecordedBatchesMatchReference) {
+    const auto [pWindow, iWindow, dWindow] = GetParam();
+    const PidGains gains = makeGains(pWindow, iWindow, dWindow);
+    ReferencePid reference(gains);
+    PidController controller(gains);
+
+    // Replay twice so state carried over between reports is covered too.
+    for (int round = 0; round < 2; round++) {
+        for (const auto &batch : kRecordedBatches) {
+            expectSame(reference.update(batch, kTarget60Hz),
+                       controller.update(batch.data(), batch.size(), kTarget60Hz), "update");
+            ASSERT_EQ(reference.integral_error, controller.getState());
+        }
+        reference.reset();
+        controller.reset();
+        ASSERT_EQ(reference.integral_error, controller.getState());
+    }
+}
+
+TEST_P(PidControllerWindowTest, RandomBatchesMatchReference) {
+    const auto [pWindow, iWindow, dWindow] = GetParam();
+    const PidGains gains = makeGains(pWindow, iWindow, dWindow);
+    ReferencePid reference(gains);
+    PidController controller(gains);
+    std::mt19937_64 rng(pWindow * 100 + iWindow * 10 + dWindow);
+    const int64_t targets[] = {8333333, 11111111, kTarget60Hz, 33333333};
+    int64_t target = kTarget60Hz;
+
+    for (int n = 0; n < 5000; n++) {
+        if (rng() % 64 == 0) {
+            const int64_t next = targets[rng() % 4];
+            const double ratio = target / next;
+            reference.retarget(ratio);
+            controller.retarget(ratio);
+            target = next;
+        }
+        std::vector<WorkDuration> batch(1 + rng() % 24);
+        for (auto &w : batch) {
+            w.durationNanos = static_cast<int64_t>(target * (0.4 + (rng() % 1400) / 1000.0));
+            if (rng() % 40 == 0) {
+                w.durationNanos *= 4;
+            }
+        }
+        expectSame(reference.update(batch, target),
+                   controller.update(batch.data(), batch.size(), target), "random");
+        ASSERT_EQ(reference.integral_error, controller.getState());
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Windows, PidControllerWindowTest,
+                         ::testing::Combine(::testing::Values(0, 1, 3, 20),
+                                            ::testing::Values(0, 1, 3, 20),
+                                            ::testing::Values(0, 1, 3, 20)));
+
+TEST(PidControllerTest, IntegralIsClamped) {
+    const PidGains gains = makeGains(1, 0, 1);
+    PidController controller(gains);
+    const auto slow = makeBatch({100000000, 100000000, 100000000, 100000000});
+    const auto fast = makeBatch({1000000, 1000000, 1000000, 1000000});
+
+    for (int n = 0; n < 100; n++) {
+        controller.update(slow.data(), slow.size(), kTarget60Hz);
+    }
+    EXPECT_EQ(gains.iHighLimit, controller.getState());
+    for (int n = 0; n < 100; n++) {
+        controller.update(fast.data(), fast.size(), kTarget60Hz);
+    }
+    EXPECT_EQ(gains.iLowLimit, controller.getState());
+    controller.reset();
+    EXPECT_EQ(gains.iInit, controller.getState());
+}
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
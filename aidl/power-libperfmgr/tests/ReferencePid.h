@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <vector>
+
+#include "PidController.h"
+
+namespace aidl {
+namespace google {
+namespace hardware {
+namespace power {
+namespace impl {
+namespace pixel {
+
+// Default gains of PowerHintSession, with the windows overridden per test.
+inline PidGains makeGains(int64_t pWindow, int64_t iWindow, int64_t dWindow) {
+    const double i = 0.001;
+    return PidGains{
+            .pOver = 2.0,
+            .pUnder = 1.0,
+            .i = i,
+            .dOver = 500.0,
+            .dUnder = 0.0,
+            .iInit = static_cast<int64_t>(200 / i),
+            .iHighLimit = static_cast<int64_t>(512 / i),
+            .iLowLimit = static_cast<int64_t>(-30 / i),
+            .pWindow = pWindow,
+            .iWindow = iWindow,
+            .dWindow = dWindow,
+    };
+}
+
+/*
+ * Per-sample loop of PowerHintSession::reportActualWorkDuration() before PidController,
+ * kept verbatim as the golden reference of the tests and the baseline of the benchmark.
+ */
+class ReferencePid {
+  public:
+    explicit ReferencePid(const PidGains &gains) : g(gains) {}
+
+    ControllerOutput update(const std::vector<WorkDuration> &actualDurations,
+                            int64_t targetDurationNanos) {
+        int64_t length = actualDurations.size();
+        int64_t p_start = g.pWindow == 0 || g.pWindow > length ? 0 : length - g.pWindow;
+        int64_t i_start = g.iWindow == 0 || g.iWindow > length ? 0 : length - g.iWindow;
+        int64_t d_start = g.dWindow == 0 || g.dWindow > length ? 0 : length - g.dWindow;
+        int64_t dt = ns_to_100us(targetDurationNanos);
+        int64_t err_sum = 0;
+        int64_t derivative_sum = 0;
+        for (int64_t i = std::min({p_start, i_start, d_start}); i < length; i++) {
+            int64_t actualDurationNanos = actualDurations[i].durationNanos;
+            if (std::abs(actualDurationNanos) > targetDurationNanos * 20) {
+                ALOGW("The actual duration is way far from the target (%" PRId64 " >> %" PRId64
+                      ")",
+                      actualDurationNanos, targetDurationNanos);
+            }
+            int64_t error = ns_to_100us(actualDurationNanos - targetDurationNanos);
+            if (i >= d_start) {
+                derivative_sum += error - previous_error;
+            }
+            if (i >= p_start) {
+                err_sum += error;
+            }
+            if (i >= i_start) {
+                integral_error = integral_error + error * dt;
+                integral_error = std::min(g.iHighLimit, integral_error);
+                integral_error = std::max(g.iLowLimit, integral_error);
+            }
+            previous_error = error;
+        }
+        ControllerOutput out;
+        out.errSum = err_sum;
+        out.errAvg = err_sum / (length - p_start);
+        out.derivativeAvg = derivative_sum / dt / (length - d_start);
+        out.pOut = static_cast<int64_t>((err_sum > 0 ? g.pOver : g.pUnder) * err_sum /
+                                        (length - p_start));
+        out.iOut = static_cast<int64_t>(g.i * integral_error);
+        out.dOut = static_cast<int64_t>((derivative_sum > 0 ? g.dOver : g.dUnder) *
+                                        derivative_sum / dt / (length - d_start));
+        out.output = out.pOut + out.iOut + out.dOut;
+        return out;
+    }
+
+    void reset() { integral_error = std::max(g.iInit, integral_error); }
+    void retarget(double ratio) {
+        integral_error = std::max(g.iInit, static_cast<int64_t>(integral_error * ratio));
+    }
+
+    int64_t integral_error = 0;
+
+  private:
+    static int64_t ns_to_100us(int64_t ns) { return ns / 100000; }
+    const PidGains g;
+    int64_t previous_error = 0;
+};
+
+}  // namespace pixel
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace google
+}  // namespace aidl
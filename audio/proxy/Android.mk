@@ -18,7 +18,8 @@ SOC_BASE_PATH := $(TOP)/hardware/samsung_slsi/exynos
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-	audio_proxy.c
+	audio_proxy.c \
+	audio_resampler.c
 
 LOCAL_C_INCLUDES += \
 	$(SOC_BASE_PATH)/include/libaudio/audiohal \
@@ -63,6 +63,10 @@ audio_format_t supported_playback_audioformat[MAX_NUM_PLAYBACK_AF] = {AUDIO_FORM
 #define ABOX_DUMP          "/data/vendor/log/abox/"
 #define ABOX_DUMP_LIMIT    (10)
 
+#define CALLIOPE_COPY_CHUNK         (1024 * 1024)   // sendfile() request size
+#define CALLIOPE_COPY_BUFFERSIZE    (64 * 1024)     // read/write fallback buffer size
+#define CALLIOPE_DUMP_MODE          (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH)
+
 // ION Memory MMAP FD retreiving interface
 struct snd_pcm_mmap_fd {
     int32_t dir;
@@ -21,6 +21,23 @@
 
 #define BOARD_INFO_XML_PATH     "vendor/etc/audio_board_info.xml"
 
+/* Binary Cache of parsed Board Info, valid only for the same source file and the same layout */
+#define BOARD_INFO_CACHE_PATH       "/data/vendor/audio/audio_board_info.cache"
+#define BOARD_INFO_CACHE_MAGIC      0x49424150  // "PABI"
+#define BOARD_INFO_CACHE_VERSION    1
+
+struct board_info_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t mic_info_size;     // sizeof(struct audio_microphone_characteristic_t)
+    uint32_t num_mic;
+    int64_t  src_mtime_ns;
+    int64_t  src_size;
+    uint64_t src_ino;
+    uint64_t src_hash;          // FNV-1a of source XML
+    uint64_t payload_hash;      // FNV-1a of microphone array following this header
+};
+
 #define AUDIO_STRING_TO_ENUM(X) {#X, X}
 #define ARRAY_SIZE(x)           (sizeof((x))/sizeof((x)[0]) )
 
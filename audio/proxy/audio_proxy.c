@@ -33,13 +33,22 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <dlfcn.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <expat.h>
 
 #include <log/log.h>
 #include <cutils/str_parms.h>
 #include <cutils/properties.h>
+#include <system/thread_defs.h>
 
 #include <audio_utils/channels.h>
 #include <audio_utils/primitives.h>
@@ -47,6 +56,12 @@
 #include <hardware/audio.h>
 #include <sound/asound.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "audio_proxy.h"
 #include "audio_proxy_interface.h"
 #include "audio_tables.h"
@@ -79,6 +94,27 @@
 #define A2DPBYPRIMARY_DEFAULT   "no"
 #define A2DPBYPRIMARY_PROPERTY  "ro.vendor.config.a2dp_by_primary"
 
+#define CAPTURE_RING_DEFAULT    "no"
+#define CAPTURE_RING_PROPERTY   "ro.vendor.config.capture_ring"
+
+#define OFFLOAD_WRITER_DEFAULT      "no"
+#define OFFLOAD_WRITER_PROPERTY     "ro.vendor.config.offload_writer"
+
+#define CAPTURE_RESAMPLER_DEFAULT   "default"
+#define CAPTURE_RESAMPLER_PROPERTY  "ro.vendor.config.capture_resampler"
+
+#define POSITION_REFRESH_DEFAULT    "0"
+#define POSITION_REFRESH_PROPERTY   "ro.vendor.config.position_refresh_ms"
+
+#define POSITION_DRIFT_DEFAULT      "2000"
+#define POSITION_DRIFT_PROPERTY     "ro.vendor.config.position_drift_ppm"
+
+#define MMAP_POSITION_STALE_DEFAULT     "0"
+#define MMAP_POSITION_STALE_PROPERTY    "ro.vendor.config.mmap_position_stale_us"
+
+#define ADAPTIVE_PERIOD_DEFAULT     "no"
+#define ADAPTIVE_PERIOD_PROPERTY    "ro.vendor.config.adaptive_period"
+
 
 /******************************************************************************/
 /**                                                                          **/
@@ -92,6 +128,12 @@ static struct audio_proxy* getInstance(void)
 {
     if (instance == NULL) {
         instance = calloc(1, sizeof(struct audio_proxy));
+        if (instance) {
+            // Locks live as long as the instance, proxy_init() can be called again on it
+            pthread_mutex_init(&instance->init_lock, NULL);
+            atomic_init(&instance->init_pending, false);
+            pthread_mutex_init(&instance->route_lock, NULL);
+        }
         ALOGI("proxy-%s: created Audio Proxy Instance!", __func__);
     }
     return instance;
@@ -100,6 +142,8 @@ static struct audio_proxy* getInstance(void)
 static void destroyInstance(void)
 {
     if (instance) {
+        pthread_mutex_destroy(&instance->route_lock);
+        pthread_mutex_destroy(&instance->init_lock);
         free(instance);
         instance = NULL;
         ALOGI("proxy-%s: destroyed Audio Proxy Instance!", __func__);
@@ -196,12 +240,50 @@ bool is_needed_config(void *proxy, int config_type)
     return ret;
 }
 
+static inline uint64_t route_snapshot_pack(audio_usage ausage, device_type device,
+                                           modifier_type modifier, unsigned int generation)
+{
+    return ((uint64_t)(generation & 0xFFFF) << 48) | ((uint64_t)((unsigned int)modifier & 0xFFFF) << 32) |
+           ((uint64_t)((unsigned int)device & 0xFFFF) << 16) | (uint64_t)((unsigned int)ausage & 0xFFFF);
+}
+
+static struct route_state get_route_snapshot(struct audio_proxy *aproxy, bool playback)
+{
+    struct route_state state;
+    uint64_t packed;
+
+    packed = atomic_load_explicit(playback ? &aproxy->playback_route_snapshot :
+                                  &aproxy->capture_route_snapshot, memory_order_acquire);
+    state.ausage = (audio_usage)(packed & 0xFFFF);
+    state.device = (device_type)((packed >> 16) & 0xFFFF);
+    state.modifier = (modifier_type)((packed >> 32) & 0xFFFF);
+    state.generation = (unsigned int)(packed >> 48);
+
+    return state;
+}
+
+/* Called only by routing control after active_* fields are updated */
+static void publish_route_snapshot(struct audio_proxy *aproxy)
+{
+    aproxy->route_generation++;
+    atomic_store_explicit(&aproxy->playback_route_snapshot,
+                          route_snapshot_pack(aproxy->active_playback_ausage, aproxy->active_playback_device,
+                                              aproxy->active_playback_modifier, aproxy->route_generation),
+                          memory_order_release);
+    atomic_store_explicit(&aproxy->capture_route_snapshot,
+                          route_snapshot_pack(aproxy->active_capture_ausage, aproxy->active_capture_device,
+                                              aproxy->active_capture_modifier, aproxy->route_generation),
+                          memory_order_release);
+
+    return ;
+}
+
 bool is_active_usage_CPCall(void *proxy)
 {
     struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
+    audio_usage ausage = get_route_snapshot(aproxy, true).ausage;
 
-    if (aproxy->active_playback_ausage >= AUSAGE_CPCALL_MIN &&
-        aproxy->active_playback_ausage <= AUSAGE_CPCALL_MAX)
+    if (ausage >= AUSAGE_CPCALL_MIN && ausage <= AUSAGE_CPCALL_MAX)
         return true;
     else
         return false;
@@ -218,9 +300,9 @@ bool is_usage_CPCall(audio_usage ausage)
 bool is_active_usage_APCall(void *proxy)
 {
     struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
+    audio_usage ausage = get_route_snapshot(aproxy, true).ausage;
 
-    if (aproxy->active_playback_ausage >= AUSAGE_APCALL_MIN &&
-        aproxy->active_playback_ausage <= AUSAGE_APCALL_MAX)
+    if (ausage >= AUSAGE_APCALL_MIN && ausage <= AUSAGE_APCALL_MAX)
         return true;
     else
         return false;
@@ -274,11 +356,19 @@ int get_mmap_data_fd(void *proxy_stream, audio_usage_type usage_type,
     hwdev_node = ((usage_type ==  AUSAGE_PLAYBACK) ? MMAP_PLAYBACK_DEVICE :
                             MMAP_CAPTURE_DEVICE);
     snprintf(dev_name, sizeof(dev_name), "/dev/snd/hwC0D%d", hwdev_node);
-    hw_fd = open(dev_name, O_RDONLY);
-    if (hw_fd < 0) {
-        ALOGE("%s: hw %s node open failed", __func__, dev_name);
-        ret = -1;
-        goto err;
+
+    // hwdep node is kept by MMAP Position Service until stream is closed
+    if (apstream->mmap_pos.opened && apstream->mmap_pos.hw_fd >= 0) {
+        hw_fd = apstream->mmap_pos.hw_fd;
+    } else {
+        hw_fd = open(dev_name, O_RDONLY | O_CLOEXEC);
+        if (hw_fd < 0) {
+            ALOGE("%s: hw %s node open failed", __func__, dev_name);
+            ret = -1;
+            goto err;
+        }
+        if (apstream->mmap_pos.opened)
+            apstream->mmap_pos.hw_fd = hw_fd;
     }
 
     // get mmap fd for exclusive mode
@@ -292,7 +382,7 @@ int get_mmap_data_fd(void *proxy_stream, audio_usage_type usage_type,
     *size = mmapfd_info.size;
 
 err:
-    if (hw_fd >= 0)
+    if (hw_fd >= 0 && !(apstream->mmap_pos.opened && hw_fd == apstream->mmap_pos.hw_fd))
         close(hw_fd);
     return ret;
 }
@@ -303,7 +393,7 @@ err:
 /**                                                                          **/
 /******************************************************************************/
 
-static audio_format_t get_pcmformat_from_alsaformat(enum pcm_format pcmformat)
+static audio_format_t __unused get_pcmformat_from_alsaformat(enum pcm_format pcmformat)
 {
     audio_format_t format = AUDIO_FORMAT_PCM_16_BIT;
 
@@ -337,7 +427,6 @@ static int get_pcm_device_number(void *proxy, void *proxy_stream)
     struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
     int pcm_device_number = -1;
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
     if (apstream) {
         switch(apstream->stream_type) {
             case ASTREAM_PLAYBACK_PRIMARY:
@@ -398,7 +487,6 @@ static int get_pcm_device_number(void *proxy, void *proxy_stream)
         }
     } else {
     }
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
 
     return pcm_device_number;
 }
@@ -428,7 +516,7 @@ static void disable_out_loopback(void *proxy)
     return ;
 }
 
-static void enable_out_loopback(void *proxy)
+static void __unused enable_out_loopback(void *proxy)
 {
     struct audio_proxy *aproxy = proxy;
     struct pcm_config pcmconfig = pcm_config_out_loopback;
@@ -731,6 +819,215 @@ err_open:
     return ;
 }
 
+/*
+ * Mixer Control Cache
+ *
+ * Open addressing hash table from control name to control index of current mixer.
+ * It is built when mixer is opened and has to be accessed with mixer_update_lock.
+ * If the same name is used by several controls, the first one is cached as mixer_get_ctl_by_name().
+ */
+static uint32_t mixer_ctl_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;    // FNV-1a
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct mixer_ctl *find_mixer_ctl_cache(struct audio_proxy *aproxy, const char *name, uint32_t hash)
+{
+    unsigned int mask = aproxy->ctl_cache_size - 1;
+
+    for (unsigned int i = hash & mask; aproxy->ctl_cache[i].index != 0; i = (i + 1) & mask) {
+        if (aproxy->ctl_cache[i].hash == hash) {
+            struct mixer_ctl *ctl = mixer_get_ctl(aproxy->mixer, aproxy->ctl_cache[i].index - 1);
+            if (ctl && strcmp(mixer_ctl_get_name(ctl), name) == 0)
+                return ctl;
+        }
+    }
+    return NULL;
+}
+
+static void add_mixer_ctl_cache(struct audio_proxy *aproxy, unsigned int from, unsigned int to)
+{
+    unsigned int mask = aproxy->ctl_cache_size - 1;
+
+    for (unsigned int index = from; index < to; index++) {
+        struct mixer_ctl *ctl = mixer_get_ctl(aproxy->mixer, index);
+        const char *name;
+        uint32_t hash;
+        unsigned int i;
+
+        if (!ctl || !(name = mixer_ctl_get_name(ctl)))
+            continue;
+
+        hash = mixer_ctl_name_hash(name);
+        if (find_mixer_ctl_cache(aproxy, name, hash))
+            continue;
+
+        for (i = hash & mask; aproxy->ctl_cache[i].index != 0; i = (i + 1) & mask)
+            ;
+        aproxy->ctl_cache[i].hash = hash;
+        aproxy->ctl_cache[i].index = index + 1;
+    }
+    aproxy->ctl_cache_count = to;
+}
+
+static void destroy_mixer_ctl_cache(struct audio_proxy *aproxy)
+{
+    free(aproxy->ctl_cache);
+    aproxy->ctl_cache = NULL;
+    aproxy->ctl_cache_size = 0;
+    aproxy->ctl_cache_count = 0;
+}
+
+static void build_mixer_ctl_cache(struct audio_proxy *aproxy)
+{
+    unsigned int num_ctls, size = 1;
+
+    destroy_mixer_ctl_cache(aproxy);
+    if (!aproxy->mixer)
+        return ;
+
+    // Keeps load factor under 0.5
+    num_ctls = mixer_get_num_ctls(aproxy->mixer);
+    while (size < num_ctls * 2)
+        size <<= 1;
+
+    aproxy->ctl_cache = calloc(size, sizeof(struct mixer_ctl_cache_entry));
+    if (!aproxy->ctl_cache) {
+        ALOGE("proxy-%s: failed to allocate mixer control cache", __func__);
+        return ;
+    }
+    aproxy->ctl_cache_size = size;
+
+    add_mixer_ctl_cache(aproxy, 0, num_ctls);
+    ALOGI("proxy-%s: cached %u mixer controls", __func__, num_ctls);
+
+    return ;
+}
+
+/* Adds only new controls, or rebuilds if cache is too small for them */
+static void update_mixer_ctl_cache(struct audio_proxy *aproxy)
+{
+    unsigned int num_ctls;
+
+    if (!aproxy->mixer || !aproxy->ctl_cache) {
+        build_mixer_ctl_cache(aproxy);
+        return ;
+    }
+
+    num_ctls = mixer_get_num_ctls(aproxy->mixer);
+    if (num_ctls * 2 > aproxy->ctl_cache_size) {
+        build_mixer_ctl_cache(aproxy);
+    } else if (num_ctls > aproxy->ctl_cache_count) {
+        ALOGI("proxy-%s: cached %u added mixer controls", __func__, num_ctls - aproxy->ctl_cache_count);
+        add_mixer_ctl_cache(aproxy, aproxy->ctl_cache_count, num_ctls);
+    }
+
+    return ;
+}
+
+/*
+ * Parallel Initialization
+ *
+ * Loading SoundTrigger HAL library and opening Mixer don't depend on each other and on Board Info,
+ * so they run in their own threads while proxy_init parses Board Info. Callers which need their
+ * results join all of them at once by wait_init_tasks().
+ */
+static const char *init_task_table[INIT_TASK_CNT] = {
+    "sthal",
+    "mixer",
+    "board_info",
+};
+
+static inline int64_t init_boottime_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return audio_utils_ns_from_timespec(&ts);
+}
+
+static void start_init_task(struct audio_proxy *aproxy, init_task_type type, void *(*func)(void *))
+{
+    struct init_task *task = &aproxy->init_tasks[type];
+    bool created;
+
+    // Marked as pending before the thread runs, so dump never reads times it is writing
+    pthread_mutex_lock(&aproxy->init_lock);
+    task->pending = true;
+    created = (pthread_create(&task->thread, NULL, func, aproxy) == 0);
+    if (created)
+        atomic_store_explicit(&aproxy->init_pending, true, memory_order_release);
+    else
+        task->pending = false;
+    pthread_mutex_unlock(&aproxy->init_lock);
+
+    if (!created) {
+        ALOGE("proxy-%s: failed to create %s task, runs it directly", __func__, init_task_table[type]);
+        func(aproxy);
+    }
+
+    return ;
+}
+
+static void wait_init_tasks(struct audio_proxy *aproxy)
+{
+    int64_t start_ns;
+    int type;
+
+    if (!atomic_load_explicit(&aproxy->init_pending, memory_order_acquire))
+        return ;
+
+    pthread_mutex_lock(&aproxy->init_lock);
+    start_ns = init_boottime_ns();
+    for (type = 0; type < INIT_TASK_CNT; type++) {
+        if (aproxy->init_tasks[type].pending) {
+            pthread_join(aproxy->init_tasks[type].thread, NULL);
+            aproxy->init_tasks[type].pending = false;
+        }
+    }
+    aproxy->init_wait_ns += init_boottime_ns() - start_ns;
+    atomic_store_explicit(&aproxy->init_pending, false, memory_order_release);
+    pthread_mutex_unlock(&aproxy->init_lock);
+
+    return ;
+}
+
+static void *init_mixer_task(void *data)
+{
+    struct audio_proxy *aproxy = (struct audio_proxy *)data;
+    struct init_task *task = &aproxy->init_tasks[INIT_TASK_MIXER];
+
+    task->start_ns = init_boottime_ns();
+    aproxy->mixer = mixer_open(MIXER_CARD0);
+    build_mixer_ctl_cache(aproxy);
+    task->end_ns = init_boottime_ns();
+
+    return NULL;
+}
+
+static struct mixer_ctl *get_mixer_ctl(struct audio_proxy *aproxy, const char *name)
+{
+    struct mixer_ctl *ctl = NULL;
+
+    if (aproxy->ctl_cache)
+        ctl = find_mixer_ctl_cache(aproxy, name, mixer_ctl_name_hash(name));
+
+    if (ctl) {
+        atomic_fetch_add_explicit(&aproxy->ctl_cache_hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&aproxy->ctl_cache_misses, 1, memory_order_relaxed);
+        ctl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    }
+
+    return ctl;
+}
+
 // Specific Mixer Control Functions for Internal Loopback Handling
 void proxy_set_mixercontrol(struct audio_proxy *aproxy, erap_trigger type, int value)
 {
@@ -741,10 +1038,10 @@ void proxy_set_mixercontrol(struct audio_proxy *aproxy, erap_trigger type, int v
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
     if (type == MUTE_CONTROL) {
-        ctrl = mixer_get_ctl_by_name(aproxy->mixer, ABOX_MUTE_CONTROL_NAME);
+        ctrl = get_mixer_ctl(aproxy, ABOX_MUTE_CONTROL_NAME);
         snprintf(mixer_name, sizeof(mixer_name), ABOX_MUTE_CONTROL_NAME);
     } else if (type == TICKLE_CONTROL) {
-        ctrl = mixer_get_ctl_by_name(aproxy->mixer, ABOX_TICKLE_CONTROL_NAME);
+        ctrl = get_mixer_ctl(aproxy, ABOX_TICKLE_CONTROL_NAME);
         snprintf(mixer_name, sizeof(mixer_name), ABOX_TICKLE_CONTROL_NAME);
     }
 
@@ -788,7 +1085,7 @@ static void enable_internal_path(void *proxy, device_type target_device)
 
         // In cases of CP/AP Calland Loopback, ERAP Path is needed for SE
         // In case of Normal Media, ERAP Path is not needed
-        if (is_active_usage_CPCall(aproxy) || is_active_usage_APCall(aproxy))
+        if (is_usage_CPCall(aproxy->active_playback_ausage) || is_usage_APCall(aproxy->active_playback_ausage))
             enable_erap_in(aproxy);
         else if (is_usage_Loopback(aproxy->active_playback_ausage) && (target_device == DEVICE_EARPIECE))
             enable_erap_in(aproxy);
@@ -815,7 +1112,7 @@ static void disable_internal_path(void *proxy, device_type target_device)
         }
     } else if (target_device == DEVICE_HEADSET || target_device == DEVICE_HEADPHONE ||
                target_device == DEVICE_EARPIECE || target_device == DEVICE_CALL_FWD) {
-        if (is_active_usage_CPCall(aproxy) || is_active_usage_APCall(aproxy))
+        if (is_usage_CPCall(aproxy->active_playback_ausage) || is_usage_APCall(aproxy->active_playback_ausage))
             disable_erap_in(aproxy);
         else if (is_usage_Loopback(aproxy->active_playback_ausage) && (target_device == DEVICE_EARPIECE))
             disable_erap_in(aproxy);
@@ -1059,32 +1356,48 @@ struct mixer {
     unsigned int count;
 };
 
-static struct snd_ctl_event *mixer_read_event_sec(struct mixer *mixer, unsigned int mask)
+/*
+ * Waits one control event from mixer until timeout or stop request of Mixer Updater Thread.
+ * Returns 1 if event with mask is read, 0 if other event is read or timeout, and negative on error or stop.
+ */
+static int mixer_wait_event_sec(struct audio_proxy *aproxy, unsigned int mask, int timeout_ms,
+                                struct snd_ctl_event *ev)
 {
-    struct snd_ctl_event *ev;
+    struct pollfd pfd[2];
+    int ret;
 
-    if (!mixer)
-        return 0;
+    if (!aproxy->mixer)
+        return -ENODEV;
 
-    ev = calloc(1, sizeof(*ev));
-    if (!ev)
+    pfd[0].fd = aproxy->mixer->fd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = aproxy->mixer_update_stop_fd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+
+    ret = poll(pfd, 2, timeout_ms);
+    if (ret < 0)
+        return (errno == EINTR) ? 0 : -errno;
+    if (ret == 0)
         return 0;
 
-    while (read(mixer->fd, ev, sizeof(*ev)) > 0) {
-        if (ev->type != SNDRV_CTL_EVENT_ELEM)
-            continue;
+    if (pfd[1].revents)
+        return -ECANCELED;
+    if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        return -EIO;
 
-        if (!(ev->data.elem.mask & mask))
-            continue;
+    // Mixer is readable, so this read does not block
+    if (read(pfd[0].fd, ev, sizeof(*ev)) != sizeof(*ev))
+        return 0;
 
-        return ev;
-    }
+    if (ev->type != SNDRV_CTL_EVENT_ELEM || !(ev->data.elem.mask & mask))
+        return 0;
 
-    free(ev);
-    return 0;
+    return 1;
 }
 
-static int audio_route_missing_ctl(struct audio_route *ar) {
+static int audio_route_missing_ctl(struct audio_route *ar __unused) {
     return 0;
 }
 
@@ -1100,37 +1413,43 @@ static int audio_route_missing_ctl(struct audio_route *ar) {
 static void *mixer_update_loop(void *context)
 {
     struct audio_proxy *aproxy = (struct audio_proxy *)context;
-    struct snd_ctl_event *event = NULL;
+    struct snd_ctl_event event;
     struct timespec ts_start, ts_tick;
+    int remain_ms, ret;
 
     ALOGI("proxy-%s: started running Mixer Updater Thread", __func__);
 
     clock_gettime(CLOCK_MONOTONIC, &ts_start);
     do {
-        if (aproxy->mixer) {
-            ALOGD("proxy-%s: wait add event", __func__);
-            event = mixer_read_event_sec(aproxy->mixer, MIXER_EVENT_ADD);
-            if (!event) {
-                ALOGE("proxy-%s: returned as error or mixer close", __func__);
-                clock_gettime(CLOCK_MONOTONIC, &ts_tick);
-                if ((ts_tick.tv_sec - ts_start.tv_sec) > MIXER_UPDATE_TIMEOUT) {
-                    ALOGI("proxy-%s: Mixer Update Timeout, it will be destroyed", __func__);
-                    break;
-                }
-                continue;
-            }
-            ALOGD("proxy-%s: returned as add event", __func__);
-        } else
+        clock_gettime(CLOCK_MONOTONIC, &ts_tick);
+        remain_ms = MIXER_UPDATE_TIMEOUT * 1000 -
+                    (int)((ts_tick.tv_sec - ts_start.tv_sec) * 1000 +
+                          (ts_tick.tv_nsec - ts_start.tv_nsec) / 1000000);
+        if (remain_ms <= 0) {
+            ALOGI("proxy-%s: Mixer Update Timeout, it will be destroyed", __func__);
+            break;
+        }
+
+        ALOGD("proxy-%s: wait add event", __func__);
+        ret = mixer_wait_event_sec(aproxy, MIXER_EVENT_ADD, remain_ms, &event);
+        if (ret < 0) {
+            ALOGI("proxy-%s: returned as error(%d) or stop request", __func__, ret);
+            break;
+        } else if (ret == 0)
             continue;
+        ALOGD("proxy-%s: returned as add event", __func__);
 
         pthread_rwlock_wrlock(&aproxy->mixer_update_lock);
 
-        mixer_close(aproxy->mixer);
-        aproxy->mixer = mixer_open(MIXER_CARD0);
-        if (!aproxy->mixer)
-            ALOGE("proxy-%s: failed to re-open Mixer", __func__);
+        /*
+         * Resolves only added controls. tinyalsa reallocates its control array here, so any
+         * struct mixer_ctl pointer taken before is invalid; the control cache keeps indices only.
+         */
+        if (mixer_add_new_ctls(aproxy->mixer) < 0)
+            ALOGE("proxy-%s: failed to add new Mixer Controls", __func__);
+        update_mixer_ctl_cache(aproxy);
 
-        mixer_subscribe_events(aproxy->mixer, 1);
+        // audio_route has no way to resolve added controls only
         audio_route_free(aproxy->aroute);
         aproxy->aroute = audio_route_init(MIXER_CARD0, aproxy->xml_path);
         if (!aproxy->aroute)
@@ -1139,14 +1458,10 @@ static void *mixer_update_loop(void *context)
         ALOGI("proxy-%s: mixer and route are updated", __func__);
 
         pthread_rwlock_unlock(&aproxy->mixer_update_lock);
-        free(event);
     } while (aproxy->mixer && aproxy->aroute && audio_route_missing_ctl(aproxy->aroute));
 
     ALOGI("proxy-%s: all mixer controls are found", __func__);
 
-    if (aproxy->mixer)
-        mixer_subscribe_events(aproxy->mixer, 0);
-
     ALOGI("proxy-%s: stopped running Mixer Updater Thread", __func__);
     return NULL;
 }
@@ -1172,183 +1487,385 @@ static void make_gain(char *path_name, char *gain_name)
     return ;
 }
 
-static void add_dual_path(void *proxy, char *path_name)
+static void make_dual_path(char *path_name)
 {
-    struct audio_proxy *aproxy = proxy;
+    char tempStr[MAX_PATH_NAME_LEN] = {0};
+    char* szDump;
+    szDump = strstr(path_name, "speaker");
 
-    if (aproxy->support_dualspk) {
-        char tempStr[MAX_PATH_NAME_LEN] = {0};
-        char* szDump;
-        szDump = strstr(path_name, "speaker");
-
-        // do not add dual- path for loopback
-        if (strstr(path_name, "loopback")) {
-            return ;
-        }
+    // do not add dual- path for loopback
+    if (strstr(path_name, "loopback")) {
+        return ;
+    }
 
-        if (szDump != NULL) {
-            char tempRet[MAX_PATH_NAME_LEN] = {0};
-            strncpy(tempStr, path_name, szDump - path_name);
-            sprintf(tempRet, "%s%s%s", tempStr, "dual-", szDump);
-            strncpy(path_name, tempRet, MAX_PATH_NAME_LEN);
-        }
+    if (szDump != NULL) {
+        char tempRet[MAX_PATH_NAME_LEN] = {0};
+        strncpy(tempStr, path_name, szDump - path_name);
+        snprintf(tempRet, MAX_PATH_NAME_LEN, "%s%s%s", tempStr, "dual-", szDump);
+        strncpy(path_name, tempRet, MAX_PATH_NAME_LEN);
     }
 }
 
-/* Enable new Audio Path */
-static void set_route(void *proxy, audio_usage ausage, device_type device)
+static void add_dual_path(void *proxy, char *path_name)
 {
     struct audio_proxy *aproxy = proxy;
-    char path_name[MAX_PATH_NAME_LEN];
-    char gain_name[MAX_GAIN_PATH_NAME_LEN];
-
-    if (device == DEVICE_AUX_DIGITAL)
-        return ;
-
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    make_path(ausage, device, path_name);
-    add_dual_path(aproxy, path_name);
-    audio_route_apply_and_update_path(aproxy->aroute, path_name);
-    ALOGI("proxy-%s: routed to %s", __func__, path_name);
+    if (aproxy->support_dualspk)
+        make_dual_path(path_name);
+}
 
-    make_gain(path_name, gain_name);
-    audio_route_apply_and_update_path(aproxy->aroute, gain_name);
-    ALOGI("proxy-%s: set gain as %s", __func__, gain_name);
+/*
+ * Precompiled Route Table
+ *
+ * Path & Gain names for all (usage, device, dual speaker) combinations are built once
+ * at proxy_init_route(), so routing functions just index them instead of building strings.
+ * Each name is stored once in the pool as "gain-<path>", and path name points into it.
+ */
+#define ROUTE_USAGE_CNT     (sizeof(usage_path_table) / sizeof(usage_path_table[0]))
+#define ROUTE_DEVICE_CNT    (sizeof(device_table) / sizeof(device_table[0]))
+#define ROUTE_GAIN_PREFIX   "gain-"
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
+static size_t route_table_index(audio_usage ausage, device_type device, bool dual)
+{
+    return ((size_t)ausage * ROUTE_DEVICE_CNT + (size_t)device) * 2 + (dual ? 1 : 0);
+}
 
-    return ;
+static void destroy_route_table(struct audio_proxy *aproxy)
+{
+    free(aproxy->route_table);
+    aproxy->route_table = NULL;
+    free(aproxy->route_pool);
+    aproxy->route_pool = NULL;
 }
 
-/* reroute Audio Path */
-static void set_reroute(void *proxy, audio_usage old_ausage, device_type old_device,
-                                     audio_usage new_ausage, device_type new_device)
+/* Stores "gain-<path>" and points path name into it, unless gain name is truncated */
+static size_t add_route_name(char *pool, const char *path_name, struct route_name *route)
 {
-    struct audio_proxy *aproxy = proxy;
-    char path_name[MAX_PATH_NAME_LEN];
     char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    size_t gain_len, path_len = strlen(path_name);
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
+    make_gain((char *)path_name, gain_name);
+    gain_len = strlen(gain_name);
 
-    // 1. Unset Active Route
-    make_path(old_ausage, old_device, path_name);
-    add_dual_path(aproxy, path_name);
-    audio_route_reset_path(aproxy->aroute, path_name);
-    ALOGI("proxy-%s: unrouted %s", __func__, path_name);
+    if (gain_len == strlen(ROUTE_GAIN_PREFIX) + path_len) {
+        if (pool) {
+            memcpy(pool, gain_name, gain_len + 1);
+            route->gain = pool;
+            route->path = pool + strlen(ROUTE_GAIN_PREFIX);
+        }
+        return gain_len + 1;
+    }
 
-    make_gain(path_name, gain_name);
-    audio_route_reset_path(aproxy->aroute, gain_name);
-    ALOGI("proxy-%s: reset gain %s", __func__, gain_name);
+    if (pool) {
+        memcpy(pool, gain_name, gain_len + 1);
+        memcpy(pool + gain_len + 1, path_name, path_len + 1);
+        route->gain = pool;
+        route->path = pool + gain_len + 1;
+    }
+    return gain_len + 1 + path_len + 1;
+}
 
-    // 2. Set New Route
-    if (new_device != DEVICE_AUX_DIGITAL) {
-        make_path(new_ausage, new_device, path_name);
-        add_dual_path(aproxy, path_name);
-        audio_route_apply_and_update_path(aproxy->aroute, path_name);
-        ALOGI("proxy-%s: routed %s", __func__, path_name);
+static bool build_route_table(struct audio_proxy *aproxy)
+{
+    char path_name[MAX_PATH_NAME_LEN];
+    char dual_name[MAX_PATH_NAME_LEN];
+    size_t entries = ROUTE_USAGE_CNT * ROUTE_DEVICE_CNT * 2;
+    size_t pool_size = 0;
+    char *pool = NULL;
+
+    // 1st pass calculates the size of pool, 2nd pass fills pool and table
+    for (int pass = 0; pass < 2; pass++) {
+        size_t offset = 0;
+
+        if (pass == 1) {
+            aproxy->route_table = calloc(entries, sizeof(struct route_name));
+            aproxy->route_pool = malloc(pool_size);
+            if (!aproxy->route_table || !aproxy->route_pool) {
+                ALOGE("proxy-%s: failed to allocate route table, names will be built at routing", __func__);
+                destroy_route_table(aproxy);
+                return false;
+            }
+            pool = aproxy->route_pool;
+        }
 
-        make_gain(path_name, gain_name);
-        audio_route_apply_and_update_path(aproxy->aroute, gain_name);
-        ALOGI("proxy-%s: set gain as %s", __func__, gain_name);
-    }
+        for (size_t u = 0; u < ROUTE_USAGE_CNT; u++) {
+            for (size_t d = 0; d < ROUTE_DEVICE_CNT; d++) {
+                struct route_name *single = NULL, *dual = NULL;
+
+                if (pool) {
+                    single = &aproxy->route_table[route_table_index(u, d, false)];
+                    dual = &aproxy->route_table[route_table_index(u, d, true)];
+                }
 
-    // 3. Update Mixers
-    audio_route_update_mixer(aproxy->aroute);
+                make_path((audio_usage)u, (device_type)d, path_name);
+                offset += add_route_name(pool ? pool + offset : NULL, path_name, single);
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
+                strlcpy(dual_name, path_name, MAX_PATH_NAME_LEN);
+                make_dual_path(dual_name);
+                if (strcmp(dual_name, path_name) != 0)
+                    offset += add_route_name(pool ? pool + offset : NULL, dual_name, dual);
+                else if (pool)
+                    *dual = *single;
+            }
+        }
+        pool_size = offset;
+    }
 
-    return ;
+    ALOGI("proxy-%s: precompiled %zu routes with %zu bytes", __func__, entries, pool_size);
+    return true;
 }
 
-/* Disable Audio Path */
-static void reset_route(void *proxy, audio_usage ausage, device_type device)
+/* Returns Path & Gain names from route table, or builds them into given buffers */
+static struct route_name get_route_name(struct audio_proxy *aproxy, audio_usage ausage, device_type device,
+                                        char *path_name, char *gain_name)
 {
-    struct audio_proxy *aproxy = proxy;
-    char path_name[MAX_PATH_NAME_LEN];
-    char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    struct route_name route;
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
+    if (aproxy->route_table && (size_t)ausage < ROUTE_USAGE_CNT && (size_t)device < ROUTE_DEVICE_CNT)
+        return aproxy->route_table[route_table_index(ausage, device, aproxy->support_dualspk)];
 
     make_path(ausage, device, path_name);
     add_dual_path(aproxy, path_name);
-    audio_route_reset_and_update_path(aproxy->aroute, path_name);
-    ALOGI("proxy-%s: unrouted %s", __func__, path_name);
-
     make_gain(path_name, gain_name);
-    audio_route_reset_and_update_path(aproxy->aroute, gain_name);
-    ALOGI("proxy-%s: reset gain %s", __func__, gain_name);
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
+    route.path = path_name;
+    route.gain = gain_name;
+    return route;
+}
 
-    return ;
+/*
+ * Route Transaction
+ *
+ * Routing functions record path resets and applies into a transaction of their caller, and
+ * route_trans_commit() writes them to mixer in two passes under route_lock.
+ * 1. Resets tear old paths down, audio_route writes controls of each path in reverse order.
+ * 2. Applies set new paths up, audio_route writes changed controls of each path in forward order.
+ * When a path is reset and applied again in same transaction, only the apply is kept, so its
+ * controls are not written at all unless another reset has changed them.
+ */
+static void route_trans_begin(struct route_trans *trans)
+{
+    trans->count = 0;
 }
 
-/* Enable new Modifier */
-static void set_modifier(void *proxy, modifier_type modifier)
+/*
+ * Counts written mixer controls from value events of kernel. audio_route writes through its own
+ * mixer, but the events are delivered to all subscribed mixers including aproxy->mixer.
+ * Events belong to Mixer Updater Thread once it is started, so nothing is counted then.
+ */
+static unsigned int route_read_ctl_events(struct audio_proxy *aproxy)
 {
-    struct audio_proxy *aproxy = proxy;
+    struct snd_ctl_event events[16];
+    struct pollfd pfd;
+    unsigned int count = 0;
+    ssize_t bytes;
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
+    if (!aproxy->mixer || aproxy->mixer_update_running)
+        return 0;
 
-    audio_route_apply_and_update_path(aproxy->aroute, modifier_table[modifier]);
-    ALOGI("proxy-%s: enabled to %s", __func__, modifier_table[modifier]);
+    pfd.fd = aproxy->mixer->fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        bytes = read(pfd.fd, events, sizeof(events));
+        if (bytes < (ssize_t)sizeof(events[0]))
+            break;
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
+        for (size_t i = 0; i < (size_t)bytes / sizeof(events[0]); i++) {
+            if (events[i].type == SNDRV_CTL_EVENT_ELEM &&
+                events[i].data.elem.mask != MIXER_EVENT_REMOVE &&
+                (events[i].data.elem.mask & MIXER_EVENT_VALUE))
+                count++;
+        }
+    }
 
-    return ;
+    return count;
 }
 
-/* Update Modifier */
-static void update_modifier(void *proxy, modifier_type old_modifier, modifier_type new_modifier)
+static void route_trans_commit(struct audio_proxy *aproxy, struct route_trans *trans)
 {
-    struct audio_proxy *aproxy = proxy;
+    unsigned int ctls;
+
+    if (trans->count == 0)
+        return ;
 
+    pthread_mutex_lock(&aproxy->route_lock);
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    // 1. Unset Active Modifier
-    audio_route_reset_path(aproxy->aroute, modifier_table[old_modifier]);
-    ALOGI("proxy-%s: disabled %s", __func__, modifier_table[old_modifier]);
+    // Drops events of earlier control writes, which are not part of this route change
+    route_read_ctl_events(aproxy);
 
-    // 2. Set New Modifier
-    audio_route_apply_path(aproxy->aroute, modifier_table[new_modifier]);
-    ALOGI("proxy-%s: enabled %s", __func__, modifier_table[new_modifier]);
+    for (unsigned int i = 0; i < trans->count; i++) {
+        if (!trans->ops[i].apply)
+            audio_route_reset_and_update_path(aproxy->aroute, trans->ops[i].name);
+    }
+    for (unsigned int i = 0; i < trans->count; i++) {
+        if (trans->ops[i].apply)
+            audio_route_apply_and_update_path(aproxy->aroute, trans->ops[i].name);
+    }
 
-    // 3. Update Mixers
-    audio_route_update_mixer(aproxy->aroute);
+    ctls = route_read_ctl_events(aproxy);
 
     pthread_rwlock_unlock(&aproxy->mixer_update_lock);
 
+    aproxy->route_changes++;
+    aproxy->route_ctls_written += ctls;
+    aproxy->route_ctls_last = ctls;
+    ALOGD("proxy-%s: route change #%u wrote %u controls for %u paths", __func__,
+          aproxy->route_changes, ctls, trans->count);
+
+    pthread_mutex_unlock(&aproxy->route_lock);
+
+    trans->count = 0;
     return ;
 }
 
-/* Disable Modifier */
-static void reset_modifier(void *proxy, modifier_type modifier)
+static void route_trans_add(struct audio_proxy *aproxy, struct route_trans *trans,
+                            const char *name, bool apply)
 {
-    struct audio_proxy *aproxy = proxy;
+    unsigned int i;
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
+    // Last operation of a path wins
+    for (i = 0; i < trans->count; i++) {
+        if (strcmp(trans->ops[i].name, name) == 0) {
+            memmove(&trans->ops[i], &trans->ops[i + 1], (trans->count - i - 1) * sizeof(trans->ops[0]));
+            trans->count--;
+            break;
+        }
+    }
 
-    audio_route_reset_and_update_path(aproxy->aroute, modifier_table[modifier]);
-    ALOGI("proxy-%s: disabled %s", __func__, modifier_table[modifier]);
+    if (trans->count == ROUTE_TRANS_MAX_OPS) {
+        ALOGW("proxy-%s: route transaction is full, commits it early", __func__);
+        route_trans_commit(aproxy, trans);
+    }
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
+    strlcpy(trans->ops[trans->count].name, name, sizeof(trans->ops[0].name));
+    trans->ops[trans->count].apply = apply;
+    trans->count++;
 
     return ;
 }
 
-static void do_operations_by_playback_route_set(struct audio_proxy *aproxy,
-                                                audio_usage routed_ausage, device_type routed_device)
+/* Enable new Audio Path */
+static void set_route(void *proxy, struct route_trans *trans, audio_usage ausage, device_type device)
 {
-    /* Open/Close FM Radio PCM node based on Enable/disable */
-    if (routed_ausage != AUSAGE_FM_RADIO_CAPTURE || routed_ausage !=  AUSAGE_FM_RADIO_TUNER) {
-        fmradio_playback_stop(aproxy);
-        fmradio_capture_stop(aproxy);
-    }
+    struct audio_proxy *aproxy = proxy;
+    char path_name[MAX_PATH_NAME_LEN];
+    char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    struct route_name route;
+
+    if (device == DEVICE_AUX_DIGITAL)
+        return ;
+
+    route = get_route_name(aproxy, ausage, device, path_name, gain_name);
+    route_trans_add(aproxy, trans, route.path, true);
+    ALOGI("proxy-%s: routed to %s", __func__, route.path);
+
+    route_trans_add(aproxy, trans, route.gain, true);
+    ALOGI("proxy-%s: set gain as %s", __func__, route.gain);
+
+    return ;
+}
+
+/* reroute Audio Path */
+static void set_reroute(void *proxy, struct route_trans *trans,
+                        audio_usage old_ausage, device_type old_device,
+                        audio_usage new_ausage, device_type new_device)
+{
+    struct audio_proxy *aproxy = proxy;
+    char path_name[MAX_PATH_NAME_LEN];
+    char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    struct route_name route;
+
+    // 1. Unset Active Route
+    route = get_route_name(aproxy, old_ausage, old_device, path_name, gain_name);
+    route_trans_add(aproxy, trans, route.path, false);
+    ALOGI("proxy-%s: unrouted %s", __func__, route.path);
+
+    route_trans_add(aproxy, trans, route.gain, false);
+    ALOGI("proxy-%s: reset gain %s", __func__, route.gain);
+
+    // 2. Set New Route
+    if (new_device != DEVICE_AUX_DIGITAL) {
+        route = get_route_name(aproxy, new_ausage, new_device, path_name, gain_name);
+        route_trans_add(aproxy, trans, route.path, true);
+        ALOGI("proxy-%s: routed %s", __func__, route.path);
+
+        route_trans_add(aproxy, trans, route.gain, true);
+        ALOGI("proxy-%s: set gain as %s", __func__, route.gain);
+    }
+
+    return ;
+}
+
+/* Disable Audio Path */
+static void reset_route(void *proxy, struct route_trans *trans, audio_usage ausage, device_type device)
+{
+    struct audio_proxy *aproxy = proxy;
+    char path_name[MAX_PATH_NAME_LEN];
+    char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    struct route_name route;
+
+    route = get_route_name(aproxy, ausage, device, path_name, gain_name);
+    route_trans_add(aproxy, trans, route.path, false);
+    ALOGI("proxy-%s: unrouted %s", __func__, route.path);
+
+    route_trans_add(aproxy, trans, route.gain, false);
+    ALOGI("proxy-%s: reset gain %s", __func__, route.gain);
+
+    return ;
+}
+
+/* Enable new Modifier */
+static void set_modifier(void *proxy, struct route_trans *trans, modifier_type modifier)
+{
+    struct audio_proxy *aproxy = proxy;
+
+    route_trans_add(aproxy, trans, modifier_table[modifier], true);
+    ALOGI("proxy-%s: enabled to %s", __func__, modifier_table[modifier]);
+
+    return ;
+}
+
+/* Update Modifier */
+static void update_modifier(void *proxy, struct route_trans *trans,
+                            modifier_type old_modifier, modifier_type new_modifier)
+{
+    struct audio_proxy *aproxy = proxy;
+
+    // 1. Unset Active Modifier
+    route_trans_add(aproxy, trans, modifier_table[old_modifier], false);
+    ALOGI("proxy-%s: disabled %s", __func__, modifier_table[old_modifier]);
+
+    // 2. Set New Modifier
+    route_trans_add(aproxy, trans, modifier_table[new_modifier], true);
+    ALOGI("proxy-%s: enabled %s", __func__, modifier_table[new_modifier]);
+
+    return ;
+}
+
+/* Disable Modifier */
+static void reset_modifier(void *proxy, struct route_trans *trans, modifier_type modifier)
+{
+    struct audio_proxy *aproxy = proxy;
+
+    route_trans_add(aproxy, trans, modifier_table[modifier], false);
+    ALOGI("proxy-%s: disabled %s", __func__, modifier_table[modifier]);
+
+    return ;
+}
+
+static void do_operations_by_playback_route_set(struct audio_proxy *aproxy,
+                                                audio_usage routed_ausage, device_type routed_device)
+{
+    /* Open/Close FM Radio PCM node based on Enable/disable */
+    if (routed_ausage != AUSAGE_FM_RADIO_CAPTURE || routed_ausage !=  AUSAGE_FM_RADIO_TUNER) {
+        fmradio_playback_stop(aproxy);
+        fmradio_capture_stop(aproxy);
+    }
 
     /* Set Mute during APCall Path Change */
     if ((aproxy->active_playback_device != routed_device) &&
-        (is_active_usage_APCall(aproxy) || is_usage_APCall(routed_ausage)))
+        (is_usage_APCall(aproxy->active_playback_ausage) || is_usage_APCall(routed_ausage)))
         proxy_set_mixercontrol(aproxy, MUTE_CONTROL, ABOX_MUTE_CNT_FOR_PATH_CHANGE);
 
     return ;
@@ -1363,28 +1880,60 @@ static void do_operations_by_playback_route_reset(struct audio_proxy *aproxy __u
 /*
  * Dump functions
  */
-static void calliope_cleanup_old(const char *path, const char *prefix)
+/* Debug nodes to be dumped, and retention index for each of them */
+static const struct {
+    const char *prefix;
+    const char *file;
+} calliope_dump_nodes[] = {
+    { SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_GPR },
+    { CALLIOPE_DBG_PATH, CALLIOPE_LOG },
+    { SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_SRAM },
+    { SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_DRAM },
+    { SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_IVA },
+};
+#define CALLIOPE_DUMP_NODE_CNT  (sizeof(calliope_dump_nodes) / sizeof(calliope_dump_nodes[0]))
+
+// Only touched by Calliope Dump Worker, and only one worker runs at a time
+static struct calliope_dump_index calliope_dump_index[CALLIOPE_DUMP_NODE_CNT];
+static struct calliope_dump_stats calliope_dump_stats;
+
+static void calliope_remove_old(const char *path, const char *name)
+{
+    char *tgt;
+
+    if (asprintf(&tgt, "%s/%s", path, name) != -1) {
+        remove(tgt);
+        free(tgt);
+    }
+
+    return ;
+}
+
+/* Scan dump directory only once to seed index, then maintain it as files are added */
+static void calliope_load_index(struct calliope_dump_index *index, const char *path, const char *prefix)
 {
     struct dirent **namelist;
-    int n, match = 0;
+    int n, i;
 
     ALOGV("proxy-%s", __func__);
 
+    index->count = 0;
+    index->loaded = true;
+
     n = scandir(path, &namelist, NULL, alphasort);
     if (n > 0) {
-        /* interate in reverse order to get old file */
-        while (n--) {
-            if (strstr(namelist[n]->d_name, prefix) == namelist[n]->d_name) {
-                if (++match > ABOX_DUMP_LIMIT) {
-                    char *tgt;
-
-                    if (asprintf(&tgt, "%s/%s", path, namelist[n]->d_name) != -1) {
-                        remove(tgt);
-                        free(tgt);
-                    }
+        for (i = 0; i < n; i++) {
+            if (strstr(namelist[i]->d_name, prefix) == namelist[i]->d_name &&
+                strlen(namelist[i]->d_name) < CALLIOPE_DUMP_NAME_LEN) {
+                if (index->count == ABOX_DUMP_LIMIT) {
+                    calliope_remove_old(path, index->names[0]);
+                    memmove(index->names[0], index->names[1],
+                            (ABOX_DUMP_LIMIT - 1) * CALLIOPE_DUMP_NAME_LEN);
+                    index->count--;
                 }
+                strcpy(index->names[index->count++], namelist[i]->d_name);
             }
-            free(namelist[n]);
+            free(namelist[i]);
         }
         free(namelist);
     }
@@ -1392,12 +1941,62 @@ static void calliope_cleanup_old(const char *path, const char *prefix)
     return ;
 }
 
-static void __calliope_dump(int fd, const char *in_prefix, const char *in_file, const char *out_prefix, const char *out_suffix)
+static void calliope_add_index(struct calliope_dump_index *index, const char *path, const char *name)
+{
+    strlcpy(index->names[index->count++], name, CALLIOPE_DUMP_NAME_LEN);
+    if (index->count > ABOX_DUMP_LIMIT) {
+        calliope_remove_old(path, index->names[0]);
+        memmove(index->names[0], index->names[1], ABOX_DUMP_LIMIT * CALLIOPE_DUMP_NAME_LEN);
+        index->count--;
+    }
+
+    return ;
+}
+
+/*
+ * Copy debug node in kernel with sendfile() first.
+ * Some sysfs binary nodes cannot be spliced, so fall back to read/write with fixed buffer.
+ */
+static ssize_t calliope_copy(int fd_in, int fd_out, char *buf, bool *spliced)
+{
+    ssize_t n, total = 0;
+
+    while ((n = sendfile(fd_out, fd_in, NULL, CALLIOPE_COPY_CHUNK)) > 0)
+        total += n;
+
+    *spliced = true;
+    if (n == 0)
+        return total;
+    // A failure after partial copy leaves a truncated file, report it as an error
+    if (total > 0 || (errno != EINVAL && errno != ENOSYS))
+        return -errno;
+
+    *spliced = false;
+    while ((n = read(fd_in, buf, CALLIOPE_COPY_BUFFERSIZE)) > 0) {
+        ssize_t written = 0;
+
+        while (written < n) {
+            ssize_t ret = write(fd_out, buf + written, n - written);
+            if (ret < 0) {
+                ALOGE("proxy-%s: write error: %s", __func__, strerror(errno));
+                return -errno;
+            }
+            written += ret;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+static void __calliope_dump(int node, const char *in_prefix, const char *out_prefix,
+                            const char *out_suffix, char *buf)
 {
-    static const int buf_size = 4096;
-    char *buf, in_path[128], out_path[128];
-    int fd_in, fd_out, n;
-    mode_t mask;
+    const char *in_file = calliope_dump_nodes[node].file;
+    char in_path[128], out_path[128], out_name[CALLIOPE_DUMP_NAME_LEN];
+    int fd_in, fd_out;
+    ssize_t n;
+    bool spliced = false;
 
     ALOGV("proxy-%s", __func__);
 
@@ -1406,55 +2005,155 @@ static void __calliope_dump(int fd, const char *in_prefix, const char *in_file,
         return;
     }
 
-    if (snprintf(out_path, sizeof(out_path) - 1, "%s%s_%s.bin", out_prefix, in_file, out_suffix) < 0) {
+    if (snprintf(out_name, sizeof(out_name), "%s_%s.bin", in_file, out_suffix) < 0 ||
+        snprintf(out_path, sizeof(out_path) - 1, "%s%s", out_prefix, out_name) < 0) {
         ALOGE("proxy-%s: out path error: %s", __func__, strerror(errno));
         return;
     }
 
-    buf = malloc(buf_size);
-    if (!buf) {
-        ALOGE("proxy-%s: malloc failed: %s", __func__, strerror(errno));
-        return;
-    }
-
-    mask = umask(0);
-    ALOGV("umask = %o", mask);
+    if (!calliope_dump_index[node].loaded)
+        calliope_load_index(&calliope_dump_index[node], out_prefix, in_file);
 
     fd_in = open(in_path, O_RDONLY | O_NONBLOCK);
     if (fd_in < 0)
         ALOGE("proxy-%s: open error: %s, fd_in=%s", __func__, strerror(errno), in_path);
-    fd_out = open(out_path, O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    fd_out = open(out_path, O_CREAT | O_WRONLY, CALLIOPE_DUMP_MODE);
     if (fd_out < 0)
         ALOGE("proxy-%s: open error: %s, fd_out=%s", __func__, strerror(errno), out_path);
+    else if (fchmod(fd_out, CALLIOPE_DUMP_MODE) < 0)
+        ALOGW("proxy-%s: chmod error: %s, fd_out=%s", __func__, strerror(errno), out_path);
     if (fd_in >= 0 && fd_out >= 0) {
-        while((n = read(fd_in, buf, buf_size)) > 0) {
-            if (write(fd_out, buf, n) < 0) {
-                ALOGE("proxy-%s: write error: %s", __func__, strerror(errno));
-            }
-        }
-        n = snprintf(buf, buf_size, " %s_%s.bin <= %s\n", in_file, out_suffix, in_file);
-        write(fd, buf, n);
-        ALOGI("proxy-%s", buf);
+        n = calliope_copy(fd_in, fd_out, buf, &spliced);
+        if (n >= 0) {
+            atomic_fetch_add_explicit(spliced ? &calliope_dump_stats.bytes_spliced :
+                                      &calliope_dump_stats.bytes_copied,
+                                      (unsigned long long)n, memory_order_relaxed);
+            ALOGI("proxy-%s: %s <= %s (%zd bytes%s)", __func__, out_name, in_file, n,
+                  spliced ? ", spliced" : "");
+        } else
+            ALOGE("proxy-%s: copy error: %s, %s", __func__, strerror(-n), in_path);
+        calliope_add_index(&calliope_dump_index[node], out_prefix, out_name);
     }
 
-    calliope_cleanup_old(out_prefix, in_file);
-
     if (fd_in >= 0)
         close(fd_in);
     if (fd_out >= 0)
         close(fd_out);
 
-    mask = umask(mask);
-    free(buf);
+    return ;
+}
+
+/* Calliope Dump Worker, owns out_suffix */
+static void *calliope_dump_worker(void *data)
+{
+    char *out_suffix = (char *)data;
+    struct timespec start, end;
+    unsigned int node;
+    char *buf;
+
+    ALOGV("proxy-%s: started", __func__);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    buf = malloc(CALLIOPE_COPY_BUFFERSIZE);
+    if (buf) {
+        for (node = 0; node < CALLIOPE_DUMP_NODE_CNT; node++)
+            __calliope_dump(node, calliope_dump_nodes[node].prefix, ABOX_DUMP, out_suffix, buf);
+
+        free(buf);
+    } else
+        ALOGE("proxy-%s: malloc failed: %s", __func__, strerror(errno));
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    atomic_store_explicit(&calliope_dump_stats.last_msec,
+                          (unsigned int)((audio_utils_ns_from_timespec(&end) -
+                                          audio_utils_ns_from_timespec(&start)) / 1000000),
+                          memory_order_relaxed);
+    atomic_fetch_add_explicit(&calliope_dump_stats.snapshots, 1, memory_order_relaxed);
+    free(out_suffix);
+
+    ALOGV("proxy-%s: done", __func__);
+    atomic_store_explicit(&calliope_dump_stats.busy, false, memory_order_release);
+
+    return NULL;
+}
+
+static void dump_init_timeline(struct audio_proxy *aproxy, int fd)
+{
+    const size_t len = 256;
+    char buffer[len];
+    int64_t base_ns = aproxy->init_start_ns;
+    int type;
+
+    pthread_mutex_lock(&aproxy->init_lock);
+
+    snprintf(buffer, len, "\tInit started at %.3f sec since boot, returned after %.1f msec\n",
+             base_ns / 1000000000.0, (aproxy->init_end_ns - base_ns) / 1000000.0);
+    write(fd,buffer,strlen(buffer));
+    for (type = 0; type < INIT_TASK_CNT; type++) {
+        struct init_task *task = &aproxy->init_tasks[type];
+
+        // Times of a task thread are read only after it is joined
+        if (task->pending || task->end_ns == 0)
+            snprintf(buffer, len, "\tInit %s task: %s\n", init_task_table[type],
+                     task->pending ? "not joined" : "not run");
+        else
+            snprintf(buffer, len, "\tInit %s task: +%.1f ~ +%.1f msec (%.1f msec)\n", init_task_table[type],
+                     (task->start_ns - base_ns) / 1000000.0, (task->end_ns - base_ns) / 1000000.0,
+                     (task->end_ns - task->start_ns) / 1000000.0);
+        write(fd,buffer,strlen(buffer));
+    }
+    snprintf(buffer, len, "\tInit board info loaded from %s, %d microphones\n",
+             aproxy->board_info_source ? aproxy->board_info_source : "none", aproxy->num_mic);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\tInit join waited %.1f msec, route ready +%.1f msec, first stream +%.1f msec\n",
+             aproxy->init_wait_ns / 1000000.0,
+             aproxy->route_ready_ns ? (aproxy->route_ready_ns - base_ns) / 1000000.0 : 0.0,
+             aproxy->first_stream_ns ? (aproxy->first_stream_ns - base_ns) / 1000000.0 : 0.0);
+    write(fd,buffer,strlen(buffer));
+
+    pthread_mutex_unlock(&aproxy->init_lock);
+
+    return ;
+}
+
+static void dump_statistics(struct audio_proxy *aproxy, int fd)
+{
+    const size_t len = 256;
+    char buffer[len];
+
+    write(fd, "\n", strlen("\n"));
+    write(fd, "Audio Proxy statistics:\n", strlen("Audio Proxy statistics:\n"));
+
+    pthread_mutex_lock(&aproxy->route_lock);
+    snprintf(buffer, len, "\tRoute changes: %u, controls written: %u (last change %u)\n",
+             aproxy->route_changes, aproxy->route_ctls_written, aproxy->route_ctls_last);
+    pthread_mutex_unlock(&aproxy->route_lock);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\tRoute snapshot generation: %u\n", aproxy->route_generation);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\tMixer control cache: %u controls, %u hits, %u misses\n",
+             aproxy->ctl_cache_count,
+             atomic_load_explicit(&aproxy->ctl_cache_hits, memory_order_relaxed),
+             atomic_load_explicit(&aproxy->ctl_cache_misses, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
+
+    dump_init_timeline(aproxy, fd);
 
     return ;
 }
 
 static void calliope_ramdump(int fd)
 {
+    const size_t len = 256;
+    char buffer[len];
     char str_time[32];
+    char *out_suffix;
     time_t t;
     struct tm *lt;
+    pthread_attr_t attr;
+    pthread_t worker;
+    unsigned int node;
+    int ret;
 
     ALOGD("%s", __func__);
 
@@ -1471,11 +2170,43 @@ static void calliope_ramdump(int fd)
     write(fd, "\n", strlen("\n"));
     write(fd, "Calliope snapshot:\n", strlen("Calliope snapshot:\n"));
     ALOGI("Calliope snapshot:\n");
-    __calliope_dump(fd, SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_GPR, ABOX_DUMP, str_time);
-    __calliope_dump(fd, CALLIOPE_DBG_PATH, CALLIOPE_LOG, ABOX_DUMP, str_time);
-    __calliope_dump(fd, SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_SRAM, ABOX_DUMP, str_time);
-    __calliope_dump(fd, SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_DRAM, ABOX_DUMP, str_time);
-    __calliope_dump(fd, SYSFS_PREFIX ABOX_DEV ABOX_DEBUG, ABOX_IVA, ABOX_DUMP, str_time);
+
+    /* Previous snapshot is still being copied, don't queue another one behind it */
+    if (atomic_exchange_explicit(&calliope_dump_stats.busy, true, memory_order_acquire)) {
+        atomic_fetch_add_explicit(&calliope_dump_stats.skipped, 1, memory_order_relaxed);
+        write(fd, " skipped, previous snapshot in progress\n",
+              strlen(" skipped, previous snapshot in progress\n"));
+    } else {
+        ret = -ENOMEM;
+        out_suffix = strdup(str_time);
+        if (out_suffix) {
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            ret = pthread_create(&worker, &attr, calliope_dump_worker, out_suffix);
+            pthread_attr_destroy(&attr);
+            if (ret != 0)
+                free(out_suffix);
+        }
+
+        if (ret == 0) {
+            for (node = 0; node < CALLIOPE_DUMP_NODE_CNT; node++) {
+                snprintf(buffer, len, " %s_%s.bin <= %s\n", calliope_dump_nodes[node].file,
+                         str_time, calliope_dump_nodes[node].file);
+                write(fd,buffer,strlen(buffer));
+            }
+        } else {
+            ALOGE("%s: failed to start Calliope Dump Worker(%d)", __func__, ret);
+            atomic_store_explicit(&calliope_dump_stats.busy, false, memory_order_release);
+        }
+    }
+
+    snprintf(buffer, len, " snapshots %u (skipped %u), last took %u msec, %llu bytes spliced, %llu bytes copied\n",
+             atomic_load_explicit(&calliope_dump_stats.snapshots, memory_order_relaxed),
+             atomic_load_explicit(&calliope_dump_stats.skipped, memory_order_relaxed),
+             atomic_load_explicit(&calliope_dump_stats.last_msec, memory_order_relaxed),
+             atomic_load_explicit(&calliope_dump_stats.bytes_spliced, memory_order_relaxed),
+             atomic_load_explicit(&calliope_dump_stats.bytes_copied, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
     write(fd, "Calliope snapshot done\n", strlen("Calliope snapshot done\n"));
 
     return ;
@@ -1519,88 +2250,1151 @@ static int get_snd_codec_id(audio_format_t format)
     return id;
 }
 
-static void save_written_frames(struct audio_proxy_stream *apstream, int bytes)
+/*
+ * Stream Telemetry
+ *
+ * Latency and xrun counters have only one writer, the stream's own thread, so they are updated
+ * with relaxed load/store instead of read-modify-write, and dump can read them at any time
+ * without lock.
+ *
+ * Presentation position can be queried from several HAL threads at once, so position counters
+ * are updated with relaxed read-modify-write. Position state is also reset from stop/pause/close.
+ * It is atomic so nothing is torn; a reset or another query racing with a position record can
+ * overwrite last position, which costs at most one bogus jitter sample and is tolerated.
+ */
+static inline void telemetry_add(atomic_uint *counter, unsigned int value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+static inline void telemetry_max(atomic_uint *counter, unsigned int value)
+{
+    if (value > atomic_load_explicit(counter, memory_order_relaxed))
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+/* Same as above for counters with several writers */
+static inline void telemetry_max_shared(atomic_uint *counter, unsigned int value)
+{
+    unsigned int old = atomic_load_explicit(counter, memory_order_relaxed);
+
+    while (value > old &&
+           !atomic_compare_exchange_weak_explicit(counter, &old, value,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+static inline int64_t telemetry_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return audio_utils_ns_from_timespec(&ts);
+}
+
+static void record_latency_hist(atomic_uint *hist, atomic_uint *max_us, int64_t start_ns)
+{
+    int64_t elapsed_us = (telemetry_now_ns() - start_ns) / 1000;
+    unsigned int us = (elapsed_us <= 0) ? 0 :
+                      (elapsed_us > UINT_MAX) ? UINT_MAX : (unsigned int)elapsed_us;
+    unsigned int bucket = (us == 0) ? 0 : (unsigned int)(32 - __builtin_clz(us));
+
+    if (bucket >= LATENCY_HIST_BUCKETS)
+        bucket = LATENCY_HIST_BUCKETS - 1;
+
+    telemetry_add(&hist[bucket], 1);
+    telemetry_max(max_us, us);
+    return ;
+}
+
+static void telemetry_record_latency(struct stream_telemetry *telemetry, int64_t start_ns)
+{
+    record_latency_hist(telemetry->latency_hist, &telemetry->latency_max_us, start_ns);
+    return ;
+}
+
+static void telemetry_record_xrun(struct stream_telemetry *telemetry)
+{
+    telemetry_add(&telemetry->xruns, 1);
+    return ;
+}
+
+/* Position doesn't advance while stopped or paused, so restart jitter measurement from next one */
+static void telemetry_reset_position(struct stream_telemetry *telemetry)
+{
+    atomic_store_explicit(&telemetry->last_pos_ns, 0, memory_order_relaxed);
+    return ;
+}
+
+/* Jitter is the difference between advance of presented frames and advance of its timestamp */
+static void telemetry_record_position(struct stream_telemetry *telemetry, uint64_t frames,
+                                      const struct timespec *timestamp, unsigned int rate)
+{
+    int64_t time_ns = audio_utils_ns_from_timespec(timestamp);
+    uint64_t last_frames = atomic_load_explicit(&telemetry->last_pos_frames, memory_order_relaxed);
+    int64_t last_ns = atomic_load_explicit(&telemetry->last_pos_ns, memory_order_relaxed);
+
+    if (rate > 0 && last_ns > 0 && frames > last_frames && time_ns > last_ns) {
+        int64_t frames_us = (int64_t)(frames - last_frames) * 1000000 / rate;
+        int64_t time_us = (time_ns - last_ns) / 1000;
+        int64_t jitter_us = llabs(frames_us - time_us);
+        unsigned int jitter = (jitter_us > UINT_MAX) ? UINT_MAX : (unsigned int)jitter_us;
+
+        atomic_fetch_add_explicit(&telemetry->pos_samples, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&telemetry->pos_jitter_sum_us, jitter, memory_order_relaxed);
+        telemetry_max_shared(&telemetry->pos_jitter_max_us, jitter);
+    }
+
+    if (frames != last_frames) {
+        atomic_store_explicit(&telemetry->last_pos_frames, frames, memory_order_relaxed);
+        atomic_store_explicit(&telemetry->last_pos_ns, time_ns, memory_order_relaxed);
+    }
+    return ;
+}
+
+static void dump_latency_hist(atomic_uint *hist, const char *title, int fd)
+{
+    const size_t len = 256;
+    char buffer[len];
+    int i, offset;
+
+    offset = snprintf(buffer, len, "\t%s histogram(usec):", title);
+    for (i = 0; i < LATENCY_HIST_BUCKETS && offset < (int)len; i++) {
+        unsigned int count = atomic_load_explicit(&hist[i], memory_order_relaxed);
+        if (count > 0)
+            offset += snprintf(buffer + offset, len - offset, " <%u:%u", 1U << i, count);
+    }
+    if (offset < (int)len - 1)
+        offset += snprintf(buffer + offset, len - offset, "\n");
+    else
+        buffer[len - 2] = '\n';
+    write(fd,buffer,strlen(buffer));
+
+    return ;
+}
+
+static void dump_telemetry(struct stream_telemetry *telemetry, const char *dir, int fd)
+{
+    const size_t len = 256;
+    char buffer[len];
+    char title[32];
+    unsigned int samples;
+
+    snprintf(title, sizeof(title), "%s latency", dir);
+    dump_latency_hist(telemetry->latency_hist, title, fd);
+
+    snprintf(buffer, len, "\t%s latency max: %u usec\n", dir,
+             atomic_load_explicit(&telemetry->latency_max_us, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\t%s xruns: %u\n", dir,
+             atomic_load_explicit(&telemetry->xruns, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
+
+    samples = atomic_load_explicit(&telemetry->pos_samples, memory_order_relaxed);
+    if (samples > 0) {
+        snprintf(buffer, len, "\t%s position jitter: avg %llu usec, max %u usec (%u samples)\n", dir,
+                 atomic_load_explicit(&telemetry->pos_jitter_sum_us, memory_order_relaxed) / samples,
+                 atomic_load_explicit(&telemetry->pos_jitter_max_us, memory_order_relaxed), samples);
+        write(fd,buffer,strlen(buffer));
+    }
+
+    return ;
+}
+
+/*
+ * MMAP Position Service
+ *
+ * AAudio queries MMAP position at high rate. A position/timestamp pair stays valid after it was
+ * read, so it is served again until its timestamp is mmap_position_stale_us old. After that, status
+ * page is used if kernel has updated it recently enough, and hardware pointer is synced by ioctl
+ * only if not.
+ */
+static void mmap_position_open(struct audio_proxy_stream *apstream)
+{
+    struct mmap_position_service *service = &apstream->mmap_pos;
+    void *status;
+
+    service->opened = true;
+    service->hw_fd = -1;
+    service->valid = false;
+
+    status = mmap(NULL, sysconf(_SC_PAGE_SIZE), PROT_READ, MAP_SHARED,
+                  pcm_get_poll_fd(apstream->pcm), SNDRV_PCM_MMAP_OFFSET_STATUS);
+    if (status == MAP_FAILED) {
+        ALOGI("%s-%s: status page is not available, uses ioctl only", stream_table[apstream->stream_type],
+              __func__);
+        service->status = NULL;
+    } else
+        service->status = (const volatile struct snd_pcm_mmap_status *)status;
+
+    return ;
+}
+
+static void mmap_position_close(struct audio_proxy_stream *apstream)
+{
+    struct mmap_position_service *service = &apstream->mmap_pos;
+
+    if (!service->opened)
+        return ;
+
+    if (service->hw_fd >= 0)
+        close(service->hw_fd);
+    if (service->status != NULL)
+        munmap((void *)service->status, sysconf(_SC_PAGE_SIZE));
+
+    service->hw_fd = -1;
+    service->status = NULL;
+    service->valid = false;
+    service->opened = false;
+
+    return ;
+}
+
+/*
+ * Kernel updates status page without lock, so reads it until two reads are same.
+ * Pointer is not synced at stop, so status page is used only while stream is running.
+ */
+static bool mmap_position_read_status(struct mmap_position_service *service, unsigned int *frames,
+                                      int64_t *time_ns)
+{
+    const volatile struct snd_pcm_mmap_status *status = service->status;
+    struct timespec ts;
+    unsigned long hw_ptr;
+    int retry;
+
+    if (status->state != SNDRV_PCM_STATE_RUNNING)
+        return false;
+
+    for (retry = 0; retry < 3; retry++) {
+        hw_ptr = status->hw_ptr;
+        ts.tv_sec = status->tstamp.tv_sec;
+        ts.tv_nsec = status->tstamp.tv_nsec;
+        atomic_thread_fence(memory_order_acquire);
+        if (hw_ptr == status->hw_ptr && ts.tv_nsec == status->tstamp.tv_nsec) {
+            *frames = (unsigned int)hw_ptr;
+            *time_ns = audio_utils_ns_from_timespec(&ts);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int mmap_position_get(struct audio_proxy_stream *apstream, int32_t *frames, int64_t *time_ns)
+{
+    struct mmap_position_service *service = &apstream->mmap_pos;
+    int64_t stale_ns = (int64_t)getInstance()->mmap_position_stale_us * 1000;
+    int64_t now_ns = telemetry_now_ns();
+    unsigned int hw_ptr = 0;
+    int64_t hw_time_ns = 0;
+    struct timespec ts = { 0, 0 };
+    int ret;
+
+    telemetry_add(&service->queries, 1);
+
+    // Age of pair is from its DMA timestamp, as status page can be read long after kernel wrote it
+    if (service->valid && now_ns - service->time_ns < stale_ns) {
+        telemetry_add(&service->cached, 1);
+    } else {
+        if (service->status != NULL && stale_ns > 0 &&
+            mmap_position_read_status(service, &hw_ptr, &hw_time_ns) &&
+            (!service->valid || hw_time_ns > service->time_ns) && now_ns - hw_time_ns < stale_ns) {
+            telemetry_add(&service->status_reads, 1);
+        } else {
+            ret = pcm_mmap_get_hw_ptr(apstream->pcm, &hw_ptr, &ts);
+            record_latency_hist(service->latency_hist, &service->latency_max_us, now_ns);
+            if (ret != 0) {
+                telemetry_add(&service->errors, 1);
+                service->valid = false;
+                return ret;
+            }
+            hw_time_ns = audio_utils_ns_from_timespec(&ts);
+            telemetry_add(&service->hw_reads, 1);
+        }
+
+        service->frames = hw_ptr;
+        service->time_ns = hw_time_ns;
+        service->valid = true;
+    }
+
+    *frames = (int32_t)service->frames;
+    *time_ns = service->time_ns;
+
+    return 0;
+}
+
+static void dump_mmap_position(struct audio_proxy_stream *apstream, const char *dir, int fd)
+{
+    struct mmap_position_service *service = &apstream->mmap_pos;
+    const size_t len = 256;
+    char buffer[len];
+    char title[32];
+
+    snprintf(buffer, len, "\t%s mmap position: %u queries, %u cached, %u status page, %u ioctl, %u errors\n",
+             dir, atomic_load_explicit(&service->queries, memory_order_relaxed),
+             atomic_load_explicit(&service->cached, memory_order_relaxed),
+             atomic_load_explicit(&service->status_reads, memory_order_relaxed),
+             atomic_load_explicit(&service->hw_reads, memory_order_relaxed),
+             atomic_load_explicit(&service->errors, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
+
+    snprintf(title, sizeof(title), "%s mmap position ioctl", dir);
+    dump_latency_hist(service->latency_hist, title, fd);
+    snprintf(buffer, len, "\t%s mmap position ioctl max: %u usec\n", dir,
+             atomic_load_explicit(&service->latency_max_us, memory_order_relaxed));
+    write(fd,buffer,strlen(buffer));
+
+    return ;
+}
+
+/*
+ * Presentation Position Model
+ *
+ * Hardware timestamp is read at most once per refresh interval. Between them, presented frames
+ * are extrapolated from the line fitted to the last hardware timestamps by least squares.
+ */
+static void position_model_reset(struct position_model *model)
+{
+    model->count = 0;
+    model->next = 0;
+    model->valid = false;
+    model->refresh_ns = 0;
+    return ;
+}
+
+static double position_model_frames(struct position_model *model, int64_t time_ns)
+{
+    return model->base_frames + model->rate * (double)(time_ns - model->base_ns);
+}
+
+static void position_model_fit(struct position_model *model, unsigned int sample_rate,
+                               unsigned int drift_ppm)
+{
+    unsigned int oldest = (model->count < POSITION_MODEL_SAMPLES) ? 0 : model->next;
+    int64_t t0 = model->sample_ns[oldest];
+    uint64_t f0 = model->sample_frames[oldest];
+    double mean_t = 0, mean_f = 0, var = 0, cov = 0, nominal, bound, rate;
+    unsigned int i;
+
+    model->valid = false;
+    if (model->count < 2 || sample_rate == 0)
+        return ;
+
+    for (i = 0; i < model->count; i++) {
+        mean_t += (double)(model->sample_ns[i] - t0);
+        mean_f += (double)(model->sample_frames[i] - f0);
+    }
+    mean_t /= model->count;
+    mean_f /= model->count;
+
+    for (i = 0; i < model->count; i++) {
+        double dt = (double)(model->sample_ns[i] - t0) - mean_t;
+        double df = (double)(model->sample_frames[i] - f0) - mean_f;
+        var += dt * dt;
+        cov += dt * df;
+    }
+    if (var <= 0)
+        return ;
+
+    // Hardware pointer moves by DMA burst, so bound the fitted rate around nominal rate
+    nominal = (double)sample_rate / 1000000000.0;
+    bound = nominal * drift_ppm / 1000000.0;
+    rate = cov / var;
+    if (rate > nominal + bound)
+        rate = nominal + bound;
+    else if (rate < nominal - bound)
+        rate = nominal - bound;
+
+    model->rate = rate;
+    model->base_ns = t0 + (int64_t)mean_t;
+    model->base_frames = (double)f0 + mean_f;
+    model->valid = true;
+    return ;
+}
+
+/* Returns true if presented frames could be extrapolated without hardware timestamp */
+static bool position_model_predict(struct audio_proxy_stream *apstream, uint64_t *frames,
+                                   struct timespec *timestamp)
+{
+    struct audio_proxy *aproxy = getInstance();
+    struct position_model *model = &apstream->pos_model;
+    struct timespec now;
+    int64_t now_ns;
+    double predicted;
+
+    if (aproxy->position_refresh_ms == 0 || !model->valid)
+        return false;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ns = audio_utils_ns_from_timespec(&now);
+    if (now_ns - model->refresh_ns >= (int64_t)aproxy->position_refresh_ms * 1000000)
+        return false;
+
+    // Never beyond frames written so far, as hardware cannot play more, and never backward
+    predicted = position_model_frames(model, now_ns);
+    if (predicted > (double)apstream->frames)
+        predicted = (double)apstream->frames;
+    *frames = (predicted > (double)model->last_frames) ? (uint64_t)predicted : model->last_frames;
+
+    model->last_frames = *frames;
+    model->queries++;
+    *timestamp = now;
+    return true;
+}
+
+/* Feeds hardware timestamp and avail to the model, and keeps reported frames monotonic */
+static void position_model_update(struct audio_proxy_stream *apstream, uint64_t *frames,
+                                  const struct timespec *timestamp)
+{
+    struct audio_proxy *aproxy = getInstance();
+    struct position_model *model = &apstream->pos_model;
+    unsigned int sample_rate = apstream->pcmconfig.rate;
+    int64_t time_ns = audio_utils_ns_from_timespec(timestamp);
+    int64_t refresh_ns = (int64_t)aproxy->position_refresh_ms * 1000000;
+
+    if (aproxy->position_refresh_ms == 0 || sample_rate == 0)
+        return ;
+
+    if (model->valid) {
+        double error = position_model_frames(model, time_ns) - (double)*frames;
+        unsigned int error_us = (unsigned int)(fabs(error) * 1000000 / sample_rate);
+
+        model->errors++;
+        model->error_sum_us += error_us;
+        if (error_us > model->error_max_us)
+            model->error_max_us = error_us;
+
+        // Model doesn't fit anymore, such as after underrun, so restart from this timestamp
+        if (fabs(error) > (double)apstream->pcmconfig.period_size) {
+            position_model_reset(model);
+            model->resets++;
+        }
+    }
+
+    // Samples closer than refresh interval make the fitted rate noisy
+    if (model->count == 0 || time_ns - model->refresh_ns >= refresh_ns) {
+        model->sample_ns[model->next] = time_ns;
+        model->sample_frames[model->next] = *frames;
+        model->next = (model->next + 1) % POSITION_MODEL_SAMPLES;
+        if (model->count < POSITION_MODEL_SAMPLES)
+            model->count++;
+        model->refresh_ns = time_ns;
+        model->refreshes++;
+        position_model_fit(model, sample_rate, aproxy->position_drift_ppm);
+    }
+
+    if (*frames < model->last_frames)
+        *frames = model->last_frames;
+    model->last_frames = *frames;
+    model->queries++;
+    return ;
+}
+
+static void save_written_frames(struct audio_proxy_stream *apstream, int bytes)
+{
+    apstream->frames += bytes / (apstream->pcmconfig.channels *
+                audio_bytes_per_sample(audio_format_from_pcm_format(apstream->pcmconfig.format)));
+
+    ALOGVV("%s-%s: written = %u frames", stream_table[apstream->stream_type], __func__,
+                                         (unsigned int)apstream->frames);
+    return ;
+}
+
+/*
+ * Paces skipped writes with virtual clock instead of sleeping for each buffer duration.
+ * Deadline is computed from total skipped frames since anchor, so rounding and scheduling
+ * delay don't accumulate, and writer sleeps only once per write until absolute deadline.
+ */
+static void skip_pcm_processing(struct audio_proxy_stream *apstream, struct skip_clock *clock, int bytes)
+{
+    uint32_t rate = proxy_get_actual_sampling_rate(apstream);
+    unsigned int frames = 0;
+    int64_t now_ns, deadline_ns;
+    struct timespec ts;
+
+    frames = bytes / (apstream->pcmconfig.channels *
+             audio_bytes_per_sample(audio_format_from_pcm_format(apstream->pcmconfig.format)));
+    if (frames == 0 || rate == 0)
+        return ;
+
+    now_ns = telemetry_now_ns();
+    deadline_ns = clock->base_ns + (int64_t)(clock->base_frames / rate) * 1000000000LL +
+                  (int64_t)(clock->base_frames % rate) * 1000000000LL / rate;
+    if (clock->base_ns == 0 || now_ns - deadline_ns > (int64_t)SKIP_CLOCK_RESYNC_MS * 1000000LL) {
+        // First skip or writer was stopped, doesn't burst to catch up with old deadline
+        if (clock->base_ns != 0)
+            clock->resyncs++;
+        clock->base_ns = now_ns;
+        clock->base_frames = 0;
+    }
+
+    clock->base_frames += frames;
+    clock->frames += frames;
+    deadline_ns = clock->base_ns + (int64_t)(clock->base_frames / rate) * 1000000000LL +
+                  (int64_t)(clock->base_frames % rate) * 1000000000LL / rate;
+    if (deadline_ns <= now_ns) {
+        clock->late++;
+        return ;
+    }
+
+    ts.tv_sec = deadline_ns / 1000000000LL;
+    ts.tv_nsec = deadline_ns % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+    clock->sleeps++;
+
+    return ;
+}
+
+static bool check_skip_playback(struct audio_proxy_stream *apstream)
+{
+    struct audio_proxy *aproxy = getInstance();
+    bool skipping;
+
+    // Compress Offload has no PCM frame size, and AUX Digital Stream is the one to be played
+    if (apstream->stream_type == ASTREAM_PLAYBACK_AUX_DIGITAL ||
+        apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD)
+        return false;
+
+    skipping = (get_route_snapshot(aproxy, true).device == DEVICE_AUX_DIGITAL);
+    if (skipping != apstream->skip.skipping) {
+        apstream->skip.skipping = skipping;
+        if (skipping) {
+            apstream->skip.base_ns = 0;
+            apstream->skip.entries++;
+        }
+        ALOGI("%s-%s: %s skipping as AUX Digital is %s", stream_table[apstream->stream_type],
+              __func__, skipping ? "starts" : "stops", skipping ? "connected" : "disconnected");
+    }
+
+    return skipping;
+}
+
+/*
+ * Adaptive Period Policy
+ *
+ * Low Latency shrinks period count while whole session had no xrun and observed write cadence
+ * is covered by smaller buffer, and steps back when xrun appears. As stop threshold is boundary,
+ * underrun doesn't fail pcm_write(), so a write which comes after the buffer has drained since
+ * the previous one returned is counted as underrun as well. Deep Buffer uses larger period
+ * while screen is off to reduce wakeups. Decisions are applied only when PCM Device is reopened,
+ * and AudioFlinger keeps seeing base period size, so write size is not changed.
+ */
+static bool period_policy_active(struct audio_proxy_stream *apstream)
+{
+    return apstream->period_policy.base_size != 0 &&
+           apstream->period_policy.type == apstream->stream_type;
+}
+
+static void period_policy_init(struct audio_proxy *aproxy, struct audio_proxy_stream *apstream)
+{
+    struct period_policy *policy = &apstream->period_policy;
+
+    if (!aproxy->support_adaptive_period ||
+        (apstream->stream_type != ASTREAM_PLAYBACK_DEEP_BUFFER &&
+         apstream->stream_type != ASTREAM_PLAYBACK_LOW_LATENCY))
+        return ;
+
+    policy->type = apstream->stream_type;
+    policy->base_size = apstream->pcmconfig.period_size;
+    policy->base_count = apstream->pcmconfig.period_count;
+    policy->size = policy->base_size;
+    policy->count = policy->base_count;
+    policy->floor_count = PERIOD_POLICY_LOW_MIN_COUNT;
+    strlcpy(policy->last_decision, "none", sizeof(policy->last_decision));
+
+    return ;
+}
+
+static void period_policy_apply(struct audio_proxy_stream *apstream)
+{
+    struct period_policy *policy = &apstream->period_policy;
+    unsigned int size;
+
+    if (!period_policy_active(apstream))
+        return ;
+
+    if (apstream->stream_type == ASTREAM_PLAYBACK_DEEP_BUFFER) {
+        size = atomic_load_explicit(&getInstance()->screen_off, memory_order_relaxed) ?
+               policy->base_size * PERIOD_POLICY_DEEP_MAX_SCALE : policy->base_size;
+        if (size > policy->size) {
+            policy->grows++;
+            snprintf(policy->last_decision, sizeof(policy->last_decision),
+                     "screen off, period %u -> %u frames", policy->size, size);
+        } else if (size < policy->size) {
+            policy->restores++;
+            snprintf(policy->last_decision, sizeof(policy->last_decision),
+                     "screen on, period %u -> %u frames", policy->size, size);
+        }
+        policy->size = size;
+    }
+
+    apstream->pcmconfig.period_size = policy->size;
+    apstream->pcmconfig.period_count = policy->count;
+    apstream->pcmconfig.start_threshold = policy->size;
+
+    policy->writes = 0;
+    policy->last_write_ns = 0;
+    policy->last_return_ns = 0;
+    policy->max_gap_us = 0;
+    policy->underruns = 0;
+    policy->buffer_us = (unsigned int)((uint64_t)policy->size * policy->count * 1000000 /
+                                       apstream->pcmconfig.rate);
+    policy->xruns_at_open = atomic_load_explicit(&apstream->telemetry.xruns, memory_order_relaxed);
+
+    return ;
+}
+
+static void period_policy_record_write(struct audio_proxy_stream *apstream, int64_t start_ns,
+                                       int64_t return_ns)
+{
+    struct period_policy *policy = &apstream->period_policy;
+    int64_t gap_us;
+
+    if (!period_policy_active(apstream))
+        return ;
+
+    if (policy->last_write_ns != 0) {
+        gap_us = (start_ns - policy->last_write_ns) / 1000;
+        if (gap_us > (int64_t)policy->max_gap_us)
+            policy->max_gap_us = (gap_us > UINT_MAX) ? UINT_MAX : (unsigned int)gap_us;
+        // Buffer was full at most when previous write returned
+        if ((start_ns - policy->last_return_ns) / 1000 > (int64_t)policy->buffer_us)
+            policy->underruns++;
+    }
+    policy->last_write_ns = start_ns;
+    policy->last_return_ns = return_ns;
+    policy->writes++;
+
+    return ;
+}
+
+/* Called at standby, decides Low Latency period count for next open */
+static void period_policy_decide(struct audio_proxy_stream *apstream)
+{
+    struct period_policy *policy = &apstream->period_policy;
+    unsigned int xruns, period_us;
+
+    if (!period_policy_active(apstream) || apstream->stream_type != ASTREAM_PLAYBACK_LOW_LATENCY)
+        return ;
+
+    xruns = atomic_load_explicit(&apstream->telemetry.xruns, memory_order_relaxed) - policy->xruns_at_open +
+            policy->underruns;
+    period_us = (unsigned int)((uint64_t)policy->size * 1000000 / apstream->pcmconfig.rate);
+
+    if (xruns > 0) {
+        if (policy->count < policy->base_count) {
+            policy->floor_count = policy->count + 1;
+            policy->grows++;
+            snprintf(policy->last_decision, sizeof(policy->last_decision),
+                     "%u xruns, period count %u -> %u", xruns, policy->count, policy->count + 1);
+            policy->count++;
+        }
+    } else if (policy->writes >= PERIOD_POLICY_MIN_WRITES && policy->count > policy->floor_count) {
+        // One period is being consumed, the rest has to cover the longest gap between writes
+        if (policy->max_gap_us < (policy->count - 2) * period_us) {
+            policy->shrinks++;
+            snprintf(policy->last_decision, sizeof(policy->last_decision),
+                     "max gap %u usec, period count %u -> %u", policy->max_gap_us, policy->count,
+                     policy->count - 1);
+            policy->count--;
+        } else
+            snprintf(policy->last_decision, sizeof(policy->last_decision),
+                     "max gap %u usec, keeps period count %u", policy->max_gap_us, policy->count);
+    }
+
+    return ;
+}
+
+static void dump_period_policy(struct audio_proxy_stream *apstream, int fd)
+{
+    struct period_policy *policy = &apstream->period_policy;
+    const size_t len = 256;
+    char buffer[len];
+
+    if (!period_policy_active(apstream))
+        return ;
+
+    snprintf(buffer, len, "\toutput period policy: %u x %u frames (base %u x %u), %u shrinks, %u grows, %u restores\n",
+             policy->size, policy->count, policy->base_size, policy->base_count,
+             policy->shrinks, policy->grows, policy->restores);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\toutput period policy last decision: %s\n", policy->last_decision);
+    write(fd,buffer,strlen(buffer));
+
+    return ;
+}
+
+static void update_capture_pcmconfig(struct audio_proxy_stream *apstream)
+{
+    int i;
+
+    // Check Sampling Rate
+    for (i = 0; i < MAX_NUM_CAPTURE_SR; i++) {
+        if (apstream->requested_sample_rate == supported_capture_samplingrate[i]) {
+            if (apstream->requested_sample_rate != apstream->pcmconfig.rate) {
+                apstream->pcmconfig.rate = apstream->requested_sample_rate;
+                if (apstream->stream_type == ASTREAM_CAPTURE_PRIMARY)
+                    apstream->pcmconfig.period_size = (apstream->pcmconfig.rate * PREDEFINED_MEDIA_CAPTURE_DURATION) / 1000;
+                else if (apstream->stream_type == ASTREAM_CAPTURE_LOW_LATENCY)
+                    apstream->pcmconfig.period_size = (apstream->pcmconfig.rate * PREDEFINED_LOW_CAPTURE_DURATION) / 1000;
+
+                // WDMA in A-Box is 128-bit aligned, so period_size has to be multiple of 4 frames
+                apstream->pcmconfig.period_size &= 0xFFFFFFFC;
+                ALOGD("%s-%s: updates samplig rate to %u, period_size to %u", stream_table[apstream->stream_type],
+                                                           __func__, apstream->pcmconfig.rate,
+                                                           apstream->pcmconfig.period_size);
+            }
+            break;
+        }
+    }
+
+    if (i == MAX_NUM_CAPTURE_SR)
+        ALOGD("%s-%s: needs re-sampling to %u", stream_table[apstream->stream_type], __func__,
+                                                apstream->requested_sample_rate);
+
+    // Check Channel Mask
+    for (i = 0; i < MAX_NUM_CAPTURE_CM; i++) {
+        if (apstream->requested_channel_mask == supported_capture_channelmask[i]) {
+            if (audio_channel_count_from_in_mask(apstream->requested_channel_mask)
+                != apstream->pcmconfig.channels) {
+                apstream->pcmconfig.channels = audio_channel_count_from_in_mask(apstream->requested_channel_mask);
+                ALOGD("%s-%s: updates channel count to %u", stream_table[apstream->stream_type],
+                                                            __func__, apstream->pcmconfig.channels);
+            }
+            break;
+        }
+    }
+
+    if (i == MAX_NUM_CAPTURE_CM)
+        ALOGD("%s-%s: needs re-channeling to %u from %u", stream_table[apstream->stream_type], __func__,
+              audio_channel_count_from_in_mask(apstream->requested_channel_mask), apstream->pcmconfig.channels);
+
+    // Check PCM Format
+    for (i = 0; i < MAX_NUM_CAPTURE_PF; i++) {
+        if (apstream->requested_format == supported_capture_pcmformat[i]) {
+            if (pcm_format_from_audio_format(apstream->requested_format) != apstream->pcmconfig.format) {
+                apstream->pcmconfig.format = pcm_format_from_audio_format(apstream->requested_format);
+                ALOGD("%s-%s: updates PCM format to %d", stream_table[apstream->stream_type], __func__,
+                                                         apstream->pcmconfig.format);
+            }
+            break;
+        }
+    }
+
+    if (i == MAX_NUM_CAPTURE_PF)
+        ALOGD("%s-%s: needs re-formating to 0x%x", stream_table[apstream->stream_type], __func__,
+                                                   apstream->requested_format);
+
+    return ;
+}
+
+/*
+ * Capture Ring Buffer
+ *
+ * If enabled, dedicated PCM Reader Thread reads periods from PCM Device into fixed slots and
+ * Record Thread consumes them, so Record Thread does not block in pcm_read().
+ * This is Single Producer / Single Consumer, head and tail are never written by both threads.
+ */
+static inline void *capture_ring_slot(struct capture_ring *ring, unsigned int index)
+{
+    return (char *)ring->buf + (size_t)index * ring->slot_bytes;
+}
+
+static int capture_ring_alloc(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+    unsigned int slot_bytes = pcm_frames_to_bytes(apstream->pcm, apstream->pcmconfig.period_size);
+
+    if (ring->buf != NULL && ring->slot_bytes == slot_bytes)
+        return 0;
+
+    if (ring->buf != NULL) {
+        free(ring->buf);
+        ring->buf = NULL;
+    }
+
+    // Slots for periods + 1 spare slot for overrun + 1 silence slot for underrun
+    if (posix_memalign(&ring->buf, CACHE_LINE_SIZE,
+                       (size_t)slot_bytes * (CAPTURE_RING_PERIOD_COUNT + 2)) != 0) {
+        ring->buf = NULL;
+        ALOGE("%s-%s: failed to allocate capture ring", stream_table[apstream->stream_type], __func__);
+        return -ENOMEM;
+    }
+    memset(ring->buf, 0, (size_t)slot_bytes * (CAPTURE_RING_PERIOD_COUNT + 2));
+
+    ring->slot_bytes = slot_bytes;
+    ring->slot_count = CAPTURE_RING_PERIOD_COUNT;
+    ALOGI("%s-%s: alloc capture ring with %u slots of %u bytes", stream_table[apstream->stream_type],
+          __func__, ring->slot_count, ring->slot_bytes);
+
+    return 0;
+}
+
+static void capture_ring_free(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+
+    if (ring->buf) {
+        free(ring->buf);
+        ring->buf = NULL;
+    }
+    ring->slot_bytes = 0;
+    ring->slot_count = 0;
+}
+
+static void *capture_ring_loop(void *context)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)context;
+    struct capture_ring *ring = &apstream->ring;
+    void *spare = capture_ring_slot(ring, ring->slot_count);
+
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_URGENT_AUDIO);
+    ALOGI("%s-%s: started PCM Reader Thread", stream_table[apstream->stream_type], __func__);
+
+    while (atomic_load_explicit(&ring->running, memory_order_acquire)) {
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        bool full = (head - tail) >= ring->slot_count;
+        void *slot = full ? spare : capture_ring_slot(ring, head % ring->slot_count);
+        int ret;
+
+        ret = pcm_read(apstream->pcm, slot, ring->slot_bytes);
+        if (ret != 0) {
+            // pcm_stop() from capture_ring_stop() aborts the pending read, it is not an error
+            if (!atomic_load_explicit(&ring->running, memory_order_acquire))
+                break;
+            ALOGE("%s-%s: pcm_read error (%s)", stream_table[apstream->stream_type], __func__,
+                                                pcm_get_error(apstream->pcm));
+            atomic_store_explicit(&ring->status, ret, memory_order_release);
+            sem_post(&ring->filled);
+            break;
+        }
+
+        if (full) {
+            // Record Thread is too late, drop this period to keep PCM Device running
+            atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+            continue;
+        }
+
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        sem_post(&ring->filled);
+    }
+
+    ALOGI("%s-%s: stopped PCM Reader Thread", stream_table[apstream->stream_type], __func__);
+    return NULL;
+}
+
+static int capture_ring_start(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+    int ret;
+
+    if (ring->started)
+        return 0;
+
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->status, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->running, true, memory_order_release);
+    ring->holding = false;
+    sem_init(&ring->filled, 0, 0);
+
+    ret = pthread_create(&ring->thread, NULL, capture_ring_loop, apstream);
+    if (ret != 0) {
+        ALOGE("%s-%s: failed to create PCM Reader Thread", stream_table[apstream->stream_type], __func__);
+        atomic_store_explicit(&ring->running, false, memory_order_relaxed);
+        sem_destroy(&ring->filled);
+        return -ret;
+    }
+
+    ring->started = true;
+    return 0;
+}
+
+static void capture_ring_stop(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+
+    if (!ring->started)
+        return;
+
+    /*
+     * Stalled PCM Device can block pcm_read() until ALSA timeout,
+     * so stop PCM Device to make it return before joining PCM Reader Thread
+     */
+    atomic_store_explicit(&ring->running, false, memory_order_release);
+    if (apstream->pcm)
+        pcm_stop(apstream->pcm);
+    pthread_join(ring->thread, NULL);
+    sem_destroy(&ring->filled);
+
+    ring->started = false;
+    ring->holding = false;
+    apstream->read_buf_frames = 0;
+}
+
+static int capture_ring_acquire(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+    unsigned int wait_ms = CAPTURE_RING_WAIT_PERIODS * apstream->pcmconfig.period_size * 1000 /
+                           apstream->pcmconfig.rate;
+    struct timespec ts;
+    unsigned int tail;
+    int ret;
+
+    // PCM Reader Thread got error and exited, reports it until stream goes to standby
+    ret = atomic_load_explicit(&ring->status, memory_order_acquire);
+    if (ret != 0)
+        return ret;
+
+    // Deadline on monotonic clock, wall clock changes must not stretch or cut the wait
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += wait_ms / 1000;
+    ts.tv_nsec += (wait_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    do {
+        ret = sem_clockwait(&ring->filled, CLOCK_MONOTONIC, &ts);
+    } while (ret != 0 && errno == EINTR);
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (ret == 0 && atomic_load_explicit(&ring->head, memory_order_acquire) != tail) {
+        apstream->period_buf = (int16_t *)capture_ring_slot(ring, tail % ring->slot_count);
+        ring->holding = true;
+        return 0;
+    }
+
+    if (ret == 0) {
+        // Posted without period, PCM Reader Thread got error and exited
+        return atomic_load_explicit(&ring->status, memory_order_acquire);
+    }
+
+    // No period within timeout, gives silence to keep Record Thread in real time
+    atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+    apstream->period_buf = (int16_t *)capture_ring_slot(ring, ring->slot_count + 1);
+    ring->holding = false;
+    return 0;
+}
+
+static void capture_ring_release(struct audio_proxy_stream *apstream)
+{
+    struct capture_ring *ring = &apstream->ring;
+
+    if (ring->holding) {
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+        ring->holding = false;
+    }
+}
+
+/*
+ * Capture Kernels
+ *
+ * Channel processing on 16bit interleaved stereo PCM for Call Recording and Mono Conversion.
+ * SIMD kernels are selected at build time and give the same output as scalar kernels.
+ */
+struct capture_kernels {
+    const char *name;
+    void (*select_rx)(int16_t *buf, size_t frames);      // Left(Rx) to both channels
+    void (*select_tx)(int16_t *buf, size_t frames);      // Right(Tx) to both channels
+    void (*mix_rxtx)(int16_t *buf, size_t frames);       // Saturated Left + Right to both channels
+    void (*stereo_to_mono)(const int16_t *in, int16_t *out, size_t frames);
+};
+
+static void select_rx_c(int16_t *buf, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+        buf[2*i + 1] = buf[2*i];
+}
+
+static void select_tx_c(int16_t *buf, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+        buf[2*i] = buf[2*i + 1];
+}
+
+static void mix_rxtx_c(int16_t *buf, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        int16_t data_mono = clamp16((int32_t)buf[2*i] + (int32_t)buf[2*i + 1]);
+        buf[2*i]     = data_mono;
+        buf[2*i + 1] = data_mono;
+    }
+}
+
+// Same as stereo to mono conversion of adjust_channels()
+static void stereo_to_mono_c(const int16_t *in, int16_t *out, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+        out[i] = (int16_t)(((int32_t)in[2*i] + (int32_t)in[2*i + 1]) >> 1);
+}
+
+static const struct capture_kernels capture_kernels_c __unused = {
+    .name = "scalar",
+    .select_rx = select_rx_c,
+    .select_tx = select_tx_c,
+    .mix_rxtx = mix_rxtx_c,
+    .stereo_to_mono = stereo_to_mono_c,
+};
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static void select_rx_neon(int16_t *buf, size_t frames)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(buf + 2*i);
+        v.val[1] = v.val[0];
+        vst2q_s16(buf + 2*i, v);
+    }
+    select_rx_c(buf + 2*i, frames - i);
+}
+
+static void select_tx_neon(int16_t *buf, size_t frames)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(buf + 2*i);
+        v.val[0] = v.val[1];
+        vst2q_s16(buf + 2*i, v);
+    }
+    select_tx_c(buf + 2*i, frames - i);
+}
+
+static void mix_rxtx_neon(int16_t *buf, size_t frames)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(buf + 2*i);
+        v.val[0] = vqaddq_s16(v.val[0], v.val[1]);
+        v.val[1] = v.val[0];
+        vst2q_s16(buf + 2*i, v);
+    }
+    mix_rxtx_c(buf + 2*i, frames - i);
+}
+
+static void stereo_to_mono_neon(const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t i = 0;
+
+    // Halving add is (Left + Right) >> 1 without overflow
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(in + 2*i);
+        vst1q_s16(out + i, vhaddq_s16(v.val[0], v.val[1]));
+    }
+    stereo_to_mono_c(in + 2*i, out + i, frames - i);
+}
+
+static const struct capture_kernels capture_kernels_simd = {
+    .name = "neon",
+    .select_rx = select_rx_neon,
+    .select_tx = select_tx_neon,
+    .mix_rxtx = mix_rxtx_neon,
+    .stereo_to_mono = stereo_to_mono_neon,
+};
+#elif defined(__SSE2__)
+static void select_rx_sse2(int16_t *buf, size_t frames)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + 2*i));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 0, 0));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 2, 0, 0));
+        _mm_storeu_si128((__m128i *)(buf + 2*i), v);
+    }
+    select_rx_c(buf + 2*i, frames - i);
+}
+
+static void select_tx_sse2(int16_t *buf, size_t frames)
 {
-    apstream->frames += bytes / (apstream->pcmconfig.channels *
-                audio_bytes_per_sample(audio_format_from_pcm_format(apstream->pcmconfig.format)));
+    size_t i = 0;
 
-    ALOGVV("%s-%s: written = %u frames", stream_table[apstream->stream_type], __func__,
-                                         (unsigned int)apstream->frames);
-    return ;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + 2*i));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 1, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(3, 3, 1, 1));
+        _mm_storeu_si128((__m128i *)(buf + 2*i), v);
+    }
+    select_tx_c(buf + 2*i, frames - i);
 }
 
-static void skip_pcm_processing(struct audio_proxy_stream *apstream, int bytes)
+static void mix_rxtx_sse2(int16_t *buf, size_t frames)
 {
-    unsigned int frames = 0;
+    size_t i = 0;
 
-    frames = bytes / (apstream->pcmconfig.channels *
-             audio_bytes_per_sample(audio_format_from_pcm_format(apstream->pcmconfig.format)));
-    usleep(frames * 1000000 / proxy_get_actual_sampling_rate(apstream));
-    return ;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + 2*i));
+        __m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)),
+                                              _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *)(buf + 2*i), _mm_adds_epi16(v, swapped));
+    }
+    mix_rxtx_c(buf + 2*i, frames - i);
 }
 
-static void update_capture_pcmconfig(struct audio_proxy_stream *apstream)
+static inline __m128i stereo_to_mono_sse2_4frames(__m128i v)
 {
-    int i;
+    __m128i left = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    __m128i right = _mm_srai_epi32(v, 16);
+    return _mm_srai_epi32(_mm_add_epi32(left, right), 1);
+}
 
-    // Check Sampling Rate
-    for (i = 0; i < MAX_NUM_CAPTURE_SR; i++) {
-        if (apstream->requested_sample_rate == supported_capture_samplingrate[i]) {
-            if (apstream->requested_sample_rate != apstream->pcmconfig.rate) {
-                apstream->pcmconfig.rate = apstream->requested_sample_rate;
-                if (apstream->stream_type == ASTREAM_CAPTURE_PRIMARY)
-                    apstream->pcmconfig.period_size = (apstream->pcmconfig.rate * PREDEFINED_MEDIA_CAPTURE_DURATION) / 1000;
-                else if (apstream->stream_type == ASTREAM_CAPTURE_LOW_LATENCY)
-                    apstream->pcmconfig.period_size = (apstream->pcmconfig.rate * PREDEFINED_LOW_CAPTURE_DURATION) / 1000;
+static void stereo_to_mono_sse2(const int16_t *in, int16_t *out, size_t frames)
+{
+    size_t i = 0;
 
-                // WDMA in A-Box is 128-bit aligned, so period_size has to be multiple of 4 frames
-                apstream->pcmconfig.period_size &= 0xFFFFFFFC;
-                ALOGD("%s-%s: updates samplig rate to %u, period_size to %u", stream_table[apstream->stream_type],
-                                                           __func__, apstream->pcmconfig.rate,
-                                                           apstream->pcmconfig.period_size);
-            }
-            break;
-        }
+    for (; i + 8 <= frames; i += 8) {
+        __m128i lo = stereo_to_mono_sse2_4frames(_mm_loadu_si128((const __m128i *)(in + 2*i)));
+        __m128i hi = stereo_to_mono_sse2_4frames(_mm_loadu_si128((const __m128i *)(in + 2*i + 8)));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
     }
+    stereo_to_mono_c(in + 2*i, out + i, frames - i);
+}
 
-    if (i == MAX_NUM_CAPTURE_SR)
-        ALOGD("%s-%s: needs re-sampling to %u", stream_table[apstream->stream_type], __func__,
-                                                apstream->requested_sample_rate);
-
-    // Check Channel Mask
-    for (i = 0; i < MAX_NUM_CAPTURE_CM; i++) {
-        if (apstream->requested_channel_mask == supported_capture_channelmask[i]) {
-            if (audio_channel_count_from_in_mask(apstream->requested_channel_mask)
-                != apstream->pcmconfig.channels) {
-                apstream->pcmconfig.channels = audio_channel_count_from_in_mask(apstream->requested_channel_mask);
-                ALOGD("%s-%s: updates channel count to %u", stream_table[apstream->stream_type],
-                                                            __func__, apstream->pcmconfig.channels);
-            }
-            break;
-        }
-    }
+static const struct capture_kernels capture_kernels_simd = {
+    .name = "sse2",
+    .select_rx = select_rx_sse2,
+    .select_tx = select_tx_sse2,
+    .mix_rxtx = mix_rxtx_sse2,
+    .stereo_to_mono = stereo_to_mono_sse2,
+};
+#else
+#define capture_kernels_simd capture_kernels_c
+#endif
 
-    if (i == MAX_NUM_CAPTURE_CM)
-        ALOGD("%s-%s: needs re-channeling to %u from %u", stream_table[apstream->stream_type], __func__,
-              audio_channel_count_from_in_mask(apstream->requested_channel_mask), apstream->pcmconfig.channels);
+static const struct capture_kernels *capture_kernels = &capture_kernels_simd;
 
-    // Check PCM Format
-    for (i = 0; i < MAX_NUM_CAPTURE_PF; i++) {
-        if (apstream->requested_format == supported_capture_pcmformat[i]) {
-            if (pcm_format_from_audio_format(apstream->requested_format) != apstream->pcmconfig.format) {
-                apstream->pcmconfig.format = pcm_format_from_audio_format(apstream->requested_format);
-                ALOGD("%s-%s: updates PCM format to %d", stream_table[apstream->stream_type], __func__,
-                                                         apstream->pcmconfig.format);
-            }
-            break;
-        }
-    }
+static const char * const resampler_engine_table[RESAMPLER_ENGINE_CNT] = {
+    [RESAMPLER_ENGINE_DEFAULT]          = "default",
+    [RESAMPLER_ENGINE_POLYPHASE_LOW]    = "polyphase low",
+    [RESAMPLER_ENGINE_POLYPHASE_MEDIUM] = "polyphase medium",
+    [RESAMPLER_ENGINE_POLYPHASE_HIGH]   = "polyphase high",
+};
 
-    if (i == MAX_NUM_CAPTURE_PF)
-        ALOGD("%s-%s: needs re-formating to 0x%x", stream_table[apstream->stream_type], __func__,
-                                                   apstream->requested_format);
+static void process_call_record(struct audio_proxy_stream *apstream, int16_t *buf, size_t frames)
+{
+    /*
+     * [Call Recording Case]
+     * In case of Call Recording, A-Box sends stereo stream which uplink/downlink voice
+     * allocated in left/right to AudioHAL.
+     * AudioHAL has to select and mix uplink/downlink voice from left/right channel as usage.
+     */
 
-    return ;
+    // Channel Selection
+    // output : Stereo with Left/Right contains same selected channel PCM & Device SR
+    if (apstream->stream_usage == AUSAGE_INCALL_UPLINK)
+        capture_kernels->select_tx(buf, frames);        // Tx
+    else if (apstream->stream_usage == AUSAGE_INCALL_DOWNLINK)
+        capture_kernels->select_rx(buf, frames);        // Rx
+    else
+        capture_kernels->mix_rxtx(buf, frames);         // mix Rx/Tx
 }
 
 // For Resampler
@@ -1623,16 +3417,36 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
 
     if (apstream->pcm) {
         if (apstream->read_buf_frames == 0) {
-            unsigned int size_in_bytes = pcm_frames_to_bytes(apstream->pcm, apstream->pcmconfig.period_size);
-            if (apstream->actual_read_buf_size < size_in_bytes) {
-                apstream->actual_read_buf_size = size_in_bytes;
-                apstream->actual_read_buf = (int16_t *) realloc(apstream->actual_read_buf, size_in_bytes);
-                if (apstream->actual_read_buf != NULL)
-                    ALOGI("%s-%s: alloc actual read buffer with %u bytes",
-                           stream_table[apstream->stream_type], __func__, size_in_bytes);
-            }
+            if (apstream->ring.started) {
+                apstream->actual_read_status = capture_ring_acquire(apstream);
+                if (apstream->actual_read_status != 0) {
+                    buffer->raw = NULL;
+                    buffer->frame_count = 0;
+                    return apstream->actual_read_status;
+                }
+            } else {
+                unsigned int size_in_bytes = pcm_frames_to_bytes(apstream->pcm, apstream->pcmconfig.period_size);
+                if (apstream->actual_read_buf_size < size_in_bytes) {
+                    // Should be allocated at open, this is the fallback
+                    int16_t *buf = (int16_t *)realloc(apstream->actual_read_buf, size_in_bytes);
+                    apstream->data_path_allocs++;
+                    if (buf != NULL) {
+                        apstream->actual_read_buf = buf;
+                        apstream->actual_read_buf_size = size_in_bytes;
+                        ALOGW("%s-%s: realloc actual read buffer with %u bytes in Record Thread",
+                               stream_table[apstream->stream_type], __func__, size_in_bytes);
+                    }
+                }
+
+                if (apstream->actual_read_buf == NULL || apstream->actual_read_buf_size < size_in_bytes) {
+                    ALOGE("%s-%s: failed to reallocate actual_read_buf",
+                          stream_table[apstream->stream_type], __func__);
+                    buffer->raw = NULL;
+                    buffer->frame_count = 0;
+                    apstream->actual_read_status = -ENOMEM;
+                    return -ENOMEM;
+                }
 
-            if (apstream->actual_read_buf != NULL) {
                 apstream->actual_read_status = pcm_read(apstream->pcm, (void*)apstream->actual_read_buf, size_in_bytes);
                 if (apstream->actual_read_status != 0) {
                     ALOGE("%s-%s:  pcm_read error (%s)", stream_table[apstream->stream_type], __func__,
@@ -1641,48 +3455,19 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
                     buffer->frame_count = 0;
                     return apstream->actual_read_status;
                 }
+                apstream->period_buf = apstream->actual_read_buf;
+            }
 
-                if (apstream->stream_type == ASTREAM_CAPTURE_CALL) {
-                    /*
-                     * [Call Recording Case]
-                     * In case of Call Recording, A-Box sends stereo stream which uplink/downlink voice
-                     * allocated in left/right to AudioHAL.
-                     * AudioHAL has to select and mix uplink/downlink voice from left/right channel as usage.
-                     */
-                    int16_t data_mono;
-                    int16_t *vc_buf = (int16_t *)(apstream->actual_read_buf);
-
-                    // Channel Selection
-                    // output : Stereo with Left/Right contains same selected channel PCM & Device SR
-                    for (unsigned int i = 0; i < apstream->pcmconfig.period_size; i++){
-                        if (apstream->stream_usage == AUSAGE_INCALL_UPLINK)
-                            data_mono = (*(vc_buf + 2*i + 1)); // Tx
-                        else if (apstream->stream_usage == AUSAGE_INCALL_DOWNLINK){
-                            data_mono = (*(vc_buf + 2*i));     // Rx
-                        } else {
-                            data_mono = clamp16(((int32_t)*(vc_buf+2*i) + (int32_t)*(vc_buf+2*i+1))); // mix Rx/Tx
-                        }
-
-                        *(vc_buf + 2*i)     = data_mono;
-                        *(vc_buf + 2*i + 1) = data_mono;
-                    }
-                }
+            if (apstream->stream_type == ASTREAM_CAPTURE_CALL)
+                process_call_record(apstream, apstream->period_buf, apstream->pcmconfig.period_size);
 
-                apstream->read_buf_frames = apstream->pcmconfig.period_size;
-            } else {
-                ALOGE("%s-%s: failed to reallocate actual_read_buf",
-                      stream_table[apstream->stream_type], __func__);
-                buffer->raw = NULL;
-                buffer->frame_count = 0;
-                apstream->actual_read_status = -ENOMEM;
-                return -ENOMEM;
-            }
+            apstream->read_buf_frames = apstream->pcmconfig.period_size;
         }
 
         buffer->frame_count = (buffer->frame_count > apstream->read_buf_frames) ?
                                apstream->read_buf_frames : buffer->frame_count;
-        buffer->i16 = apstream->actual_read_buf + (apstream->pcmconfig.period_size - apstream->read_buf_frames) *
-                                                  apstream->pcmconfig.channels;
+        buffer->i16 = apstream->period_buf + (apstream->pcmconfig.period_size - apstream->read_buf_frames) *
+                                             apstream->pcmconfig.channels;
         return apstream->actual_read_status;
     } else {
         buffer->raw = NULL;
@@ -1704,6 +3489,8 @@ static void release_buffer(struct resampler_buffer_provider *buffer_provider,
                                              offsetof(struct audio_proxy_stream, buf_provider));
 
     apstream->read_buf_frames -= buffer->frame_count;
+    if (apstream->read_buf_frames == 0 && apstream->ring.started)
+        capture_ring_release(apstream);
 }
 
 static int read_frames(struct audio_proxy_stream *apstream, void *buffer, int frames)
@@ -1718,16 +3505,37 @@ static int read_frames(struct audio_proxy_stream *apstream, void *buffer, int fr
         if (apstream->resampler != NULL) {
             apstream->resampler->resample_from_provider(apstream->resampler,
             (int16_t *)((char *)buffer + pcm_frames_to_bytes(apstream->pcm, frames_wr)), &frames_rd);
+        } else if (apstream->pcm && !apstream->ring.started && apstream->read_buf_frames == 0 &&
+                   frames_rd >= apstream->pcmconfig.period_size) {
+            /*
+             * No cached frames and whole periods are requested,
+             * reads them directly into caller's buffer without intermediate copy.
+             */
+            void *dst = (char *)buffer + pcm_frames_to_bytes(apstream->pcm, frames_wr);
+
+            frames_rd -= frames_rd % apstream->pcmconfig.period_size;
+            apstream->actual_read_status = pcm_read(apstream->pcm, dst,
+                                                    pcm_frames_to_bytes(apstream->pcm, frames_rd));
+            if (apstream->actual_read_status != 0) {
+                ALOGE("%s-%s:  pcm_read error (%s)", stream_table[apstream->stream_type], __func__,
+                                                     pcm_get_error(apstream->pcm));
+            } else {
+                if (apstream->stream_type == ASTREAM_CAPTURE_CALL)
+                    process_call_record(apstream, (int16_t *)dst, frames_rd);
+                apstream->bytes_read_direct += pcm_frames_to_bytes(apstream->pcm, frames_rd);
+            }
         } else {
             struct resampler_buffer buf;
             buf.raw= NULL;
             buf.frame_count = frames_rd;
 
+            // Partial period is served from the remained frames of actual read buffer
             get_next_buffer(&apstream->buf_provider, &buf);
             if (buf.raw != NULL) {
                 memcpy((char *)buffer + pcm_frames_to_bytes(apstream->pcm, frames_wr),
                         buf.raw, pcm_frames_to_bytes(apstream->pcm, buf.frame_count));
                 frames_rd = buf.frame_count;
+                apstream->bytes_read_copied += pcm_frames_to_bytes(apstream->pcm, buf.frame_count);
             }
             release_buffer(&apstream->buf_provider, &buf);
         }
@@ -1757,9 +3565,18 @@ static int read_and_process_frames(struct audio_proxy_stream *apstream, void* bu
         int src_buffer_size = frames_num * num_device_channels * bytes_per_sample;
 
         if (apstream->proc_buf_size < src_buffer_size) {
+            // Should be allocated at open, this is the fallback
+            void *buf = realloc(apstream->proc_buf_out, src_buffer_size);
+            apstream->data_path_allocs++;
+            if (buf == NULL) {
+                ALOGE("%s-%s: failed to reallocate resampled read buffer with %d bytes",
+                      stream_table[apstream->stream_type], __func__, src_buffer_size);
+                apstream->actual_read_status = -ENOMEM;
+                return -ENOMEM;
+            }
+            apstream->proc_buf_out = buf;
             apstream->proc_buf_size = src_buffer_size;
-            apstream->proc_buf_out = realloc(apstream->proc_buf_out, src_buffer_size);
-            ALOGI("%s-%s: alloc resampled read buffer with %d bytes",
+            ALOGW("%s-%s: realloc resampled read buffer with %d bytes in Record Thread",
                       stream_table[apstream->stream_type], __func__, src_buffer_size);
         }
         proc_buf_out = apstream->proc_buf_out;
@@ -1775,11 +3592,15 @@ static int read_and_process_frames(struct audio_proxy_stream *apstream, void* bu
      */
     if (apstream->actual_read_status == 0) {
         if (apstream->need_monoconversion && (num_device_channels != num_req_channels)) {
-            size_t ret = adjust_channels(proc_buf_out, num_device_channels,
-                                         buffer, num_req_channels,
-                                         bytes_per_sample, (frames_wr * num_device_channels * bytes_per_sample));
-            if (ret != (frames_wr * num_req_channels * bytes_per_sample))
-                ALOGE("%s-%s: channel convert failed", stream_table[apstream->stream_type], __func__);
+            if (num_device_channels == 2 && num_req_channels == 1 && bytes_per_sample == sizeof(int16_t)) {
+                capture_kernels->stereo_to_mono((const int16_t *)proc_buf_out, (int16_t *)buffer, frames_wr);
+            } else {
+                size_t ret = adjust_channels(proc_buf_out, num_device_channels,
+                                             buffer, num_req_channels,
+                                             bytes_per_sample, (frames_wr * num_device_channels * bytes_per_sample));
+                if (ret != (frames_wr * num_req_channels * bytes_per_sample))
+                    ALOGE("%s-%s: channel convert failed", stream_table[apstream->stream_type], __func__);
+            }
         }
     } else {
         ALOGE("%s-%s: Read Fail = %d", stream_table[apstream->stream_type], __func__, frames_wr);
@@ -1788,6 +3609,92 @@ static int read_and_process_frames(struct audio_proxy_stream *apstream, void* bu
     return frames_wr;
 }
 
+/*
+ * Allocates read and channel conversion buffers before Record Thread reads,
+ * and keeps them across standby as long as PCM configuration doesn't grow.
+ */
+static int capture_buffers_alloc(struct audio_proxy_stream *apstream)
+{
+    unsigned int bytes_per_sample = (pcm_format_to_bits(apstream->pcmconfig.format) >> 3);
+    unsigned int read_bytes = pcm_frames_to_bytes(apstream->pcm, apstream->pcmconfig.period_size);
+    int num_device_channels = proxy_get_actual_channel_count(apstream);
+    int num_req_channels = audio_channel_count_from_in_mask(apstream->requested_channel_mask);
+    void *buf;
+
+    // Capture Ring Buffer has its own period slots
+    if (apstream->ring.buf == NULL && apstream->actual_read_buf_size < read_bytes) {
+        buf = realloc(apstream->actual_read_buf, read_bytes);
+        if (buf == NULL) {
+            ALOGE("%s-%s: failed to alloc actual read buffer with %u bytes",
+                  stream_table[apstream->stream_type], __func__, read_bytes);
+            return -ENOMEM;
+        }
+        apstream->actual_read_buf = (int16_t *)buf;
+        apstream->actual_read_buf_size = read_bytes;
+        ALOGI("%s-%s: alloc actual read buffer with %u bytes",
+              stream_table[apstream->stream_type], __func__, read_bytes);
+    }
+
+    if (apstream->need_monoconversion && (num_device_channels != num_req_channels)) {
+        // Record Thread doesn't request more than kernel buffer in requested sampling rate
+        uint64_t frames = (uint64_t)apstream->pcmconfig.period_size * apstream->pcmconfig.period_count;
+        int proc_bytes;
+
+        if (apstream->pcmconfig.rate > 0)
+            frames = frames * apstream->requested_sample_rate / apstream->pcmconfig.rate + 1;
+        proc_bytes = (int)(frames * num_device_channels * bytes_per_sample);
+
+        if (apstream->proc_buf_size < proc_bytes) {
+            buf = realloc(apstream->proc_buf_out, proc_bytes);
+            if (buf == NULL) {
+                ALOGE("%s-%s: failed to alloc resampled read buffer with %d bytes",
+                      stream_table[apstream->stream_type], __func__, proc_bytes);
+                return -ENOMEM;
+            }
+            apstream->proc_buf_out = buf;
+            apstream->proc_buf_size = proc_bytes;
+            ALOGI("%s-%s: alloc resampled read buffer with %d bytes",
+                  stream_table[apstream->stream_type], __func__, proc_bytes);
+        }
+    }
+
+    return 0;
+}
+
+/* Polyphase Resampler is used if configured, audio_utils Resampler is the fallback */
+static int create_capture_resampler(struct audio_proxy_stream *apstream)
+{
+    struct audio_proxy *aproxy = getInstance();
+    int ret;
+
+    if (aproxy->capture_resampler != RESAMPLER_ENGINE_DEFAULT) {
+        ret = create_polyphase_resampler(apstream->pcmconfig.rate, apstream->requested_sample_rate,
+                                         apstream->pcmconfig.channels, aproxy->capture_resampler,
+                                         &apstream->buf_provider, &apstream->resampler);
+        if (ret == 0) {
+            apstream->resampler_engine = aproxy->capture_resampler;
+            return 0;
+        }
+        ALOGW("%s-%s: failed to create polyphase resampler, use default one",
+              stream_table[apstream->stream_type], __func__);
+    }
+
+    apstream->resampler_engine = RESAMPLER_ENGINE_DEFAULT;
+    return create_resampler(apstream->pcmconfig.rate, apstream->requested_sample_rate,
+                            apstream->pcmconfig.channels, RESAMPLER_QUALITY_DEFAULT,
+                            &apstream->buf_provider, &apstream->resampler);
+}
+
+static void release_capture_resampler(struct audio_proxy_stream *apstream)
+{
+    if (apstream->resampler_engine == RESAMPLER_ENGINE_DEFAULT)
+        release_resampler(apstream->resampler);
+    else
+        release_polyphase_resampler(apstream->resampler);
+
+    return ;
+}
+
 static void check_conversion(struct audio_proxy_stream *apstream)
 {
     int request_cc = audio_channel_count_from_in_mask(apstream->requested_channel_mask);
@@ -1804,15 +3711,13 @@ static void check_conversion(struct audio_proxy_stream *apstream)
     if (apstream->requested_sample_rate != apstream->pcmconfig.rate) {
         // Only support Stereo Resampling
         if (apstream->resampler) {
-            release_resampler(apstream->resampler);
+            release_capture_resampler(apstream);
             apstream->resampler = NULL;
         }
 
         apstream->buf_provider.get_next_buffer = get_next_buffer;
         apstream->buf_provider.release_buffer = release_buffer;
-        int ret = create_resampler(apstream->pcmconfig.rate, apstream->requested_sample_rate,
-                                   apstream->pcmconfig.channels, RESAMPLER_QUALITY_DEFAULT,
-                                   &apstream->buf_provider, &apstream->resampler);
+        int ret = create_capture_resampler(apstream);
         if (ret !=0) {
             ALOGE("proxy-%s: failed to create resampler", __func__);
         } else {
@@ -1823,8 +3728,7 @@ static void check_conversion(struct audio_proxy_stream *apstream)
             ALOGD("%s-%s: needs re-sampling to %u Hz from %u Hz", stream_table[apstream->stream_type], __func__,
                   apstream->requested_sample_rate, apstream->pcmconfig.rate);
 
-            apstream->actual_read_buf = NULL;
-            apstream->actual_read_buf_size = 0;
+            // Read buffer is kept, and re-sized at open if period size is changed
             apstream->read_buf_frames = 0;
 
             apstream->resampler->reset(apstream->resampler);
@@ -1901,6 +3805,8 @@ uint32_t proxy_get_actual_period_size(void *proxy_stream)
     if (apstream) {
         if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD)
             actual_period_size = (uint32_t)apstream->comprconfig.fragment_size;
+        else if (period_policy_active(apstream))
+            actual_period_size = apstream->period_policy.base_size;  // write size is kept
         else
             actual_period_size = (uint32_t)apstream->pcmconfig.period_size;
     }
@@ -1938,6 +3844,305 @@ int32_t proxy_get_actual_format(void *proxy_stream)
     return actual_format;
 }
 
+/*
+ * Offload Writer
+ *
+ * Offload Thread of AudioHAL queues large buffers without waiting for Compress Device, and
+ * Offload Writer Thread writes them in whole fragments. Offload Thread is woken up only when
+ * a fragment of queue is free, instead of whenever Compress Device consumes a fragment.
+ */
+static void send_offload_metadata(struct audio_proxy_stream *apstream)
+{
+    if (apstream->ready_new_metadata) {
+        compress_set_gapless_metadata(apstream->compress, &apstream->offload_metadata);
+        ALOGI("%s-%s: sent gapless metadata(delay = %u, padding = %u) to Compress Device",
+               stream_table[apstream->stream_type], __func__,
+               apstream->offload_metadata.encoder_delay, apstream->offload_metadata.encoder_padding);
+        apstream->ready_new_metadata = 0;
+    }
+
+    return ;
+}
+
+static void *offload_writer_loop(void *context)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)context;
+    struct offload_writer *writer = &apstream->writer;
+    size_t fragment = apstream->comprconfig.fragment_size;
+
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
+    ALOGI("%s-%s: started Offload Writer Thread", stream_table[apstream->stream_type], __func__);
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->running) {
+        size_t pending = (size_t)(writer->head - writer->tail);
+        size_t offset = (size_t)(writer->tail % writer->size);
+        size_t chunk;
+        int wrote;
+
+        if (writer->status != 0 || pending == 0 || (pending < fragment && !writer->flush) ||
+            (writer->idle && writer->device_full)) {
+            if (pending == 0)
+                writer->flush = false;
+            pthread_cond_wait(&writer->data_cond, &writer->lock);
+            writer->writer_wakeups++;
+            continue;
+        }
+
+        // Whole fragments as many as possible in a write, partial one only when flushing
+        chunk = writer->flush ? pending : pending - pending % fragment;
+        if (chunk > writer->size - offset)
+            chunk = writer->size - offset;
+
+        writer->busy = true;
+        send_offload_metadata(apstream);
+        pthread_mutex_unlock(&writer->lock);
+
+        wrote = compress_write(apstream->compress, writer->buf + offset, chunk);
+        if (wrote == 0) {
+            // Compress Device is full, wait for a free fragment without holding the queue
+            compress_wait(apstream->compress, OFFLOAD_WRITER_WAIT_MS);
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        writer->busy = false;
+        writer->device_full = (wrote == 0);
+        if (wrote < 0) {
+            ALOGE("%s-%s: failed to write to Compress Device(%s)", stream_table[apstream->stream_type],
+                  __func__, compress_get_error(apstream->compress));
+            writer->status = wrote;
+        } else if (wrote > 0) {
+            writer->tail += wrote;
+            writer->writes++;
+            writer->bytes_written += wrote;
+        } else
+            writer->writer_wakeups++;
+
+        // Wake up Offload Thread only when enough space is free, not every fragment
+        if (wrote < 0 || writer->flush || writer->discarding ||
+            writer->size - (size_t)(writer->head - writer->tail) >= writer->size / OFFLOAD_WRITER_WAKEUP_RATIO)
+            pthread_cond_broadcast(&writer->space_cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    ALOGI("%s-%s: stopped Offload Writer Thread", stream_table[apstream->stream_type], __func__);
+    return NULL;
+}
+
+static int offload_writer_create(struct audio_proxy_stream *apstream)
+{
+    struct offload_writer *writer = &apstream->writer;
+    int ret;
+
+    writer->size = OFFLOAD_WRITER_QUEUE_SIZE - OFFLOAD_WRITER_QUEUE_SIZE % apstream->comprconfig.fragment_size;
+    writer->buf = (char *)malloc(writer->size);
+    if (writer->buf == NULL) {
+        ALOGE("%s-%s: failed to allocate Offload Writer Queue", stream_table[apstream->stream_type], __func__);
+        return -ENOMEM;
+    }
+
+    writer->head = writer->tail = 0;
+    writer->flush = false;
+    writer->busy = false;
+    writer->discarding = false;
+    writer->device_full = false;
+    writer->idle = true;
+    writer->status = 0;
+    writer->running = true;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->data_cond, NULL);
+    pthread_cond_init(&writer->space_cond, NULL);
+
+    // Offload Writer Thread can write before start, full Compress Device has to return 0 at once
+    compress_nonblock(apstream->compress, 1);
+
+    ret = pthread_create(&writer->thread, NULL, offload_writer_loop, apstream);
+    if (ret != 0) {
+        ALOGE("%s-%s: failed to create Offload Writer Thread(%d)", stream_table[apstream->stream_type],
+              __func__, ret);
+        pthread_cond_destroy(&writer->space_cond);
+        pthread_cond_destroy(&writer->data_cond);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer->buf);
+        writer->buf = NULL;
+        return -ret;
+    }
+
+    return 0;
+}
+
+static void offload_writer_destroy(struct audio_proxy_stream *apstream)
+{
+    struct offload_writer *writer = &apstream->writer;
+
+    if (writer->buf == NULL)
+        return ;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->running = false;
+    pthread_cond_broadcast(&writer->data_cond);
+    pthread_cond_broadcast(&writer->space_cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+    pthread_cond_destroy(&writer->space_cond);
+    pthread_cond_destroy(&writer->data_cond);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->buf);
+    writer->buf = NULL;
+
+    return ;
+}
+
+/* Queues as much as free space, waits for free space only in blocking mode */
+static int offload_writer_queue(struct audio_proxy_stream *apstream, const void *buffer, int bytes)
+{
+    struct offload_writer *writer = &apstream->writer;
+    size_t queued = 0, count, offset, part;
+    int ret;
+
+    pthread_mutex_lock(&writer->lock);
+    while (!apstream->nonblock_flag && writer->running && writer->status == 0 &&
+           writer->head - writer->tail == writer->size) {
+        pthread_cond_wait(&writer->space_cond, &writer->lock);
+        writer->hal_wakeups++;
+    }
+
+    if (writer->status != 0) {
+        ret = writer->status;
+        pthread_mutex_unlock(&writer->lock);
+        return ret;
+    }
+
+    count = writer->size - (size_t)(writer->head - writer->tail);
+    if (count > (size_t)bytes)
+        count = (size_t)bytes;
+
+    while (queued < count) {
+        offset = (size_t)((writer->head + queued) % writer->size);
+        part = writer->size - offset;
+        if (part > count - queued)
+            part = count - queued;
+        memcpy(writer->buf + offset, (const char *)buffer + queued, part);
+        queued += part;
+    }
+    writer->head += queued;
+
+    if (writer->head - writer->tail >= apstream->comprconfig.fragment_size)
+        pthread_cond_signal(&writer->data_cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    return (int)queued;
+}
+
+/* Waits until a part of queue is free, instead of a fragment of Compress Device */
+static int offload_writer_wait(struct audio_proxy_stream *apstream)
+{
+    struct offload_writer *writer = &apstream->writer;
+    int ret;
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->running && writer->status == 0 &&
+           writer->size - (size_t)(writer->head - writer->tail) < writer->size / OFFLOAD_WRITER_WAKEUP_RATIO) {
+        pthread_cond_wait(&writer->space_cond, &writer->lock);
+        writer->hal_wakeups++;
+    }
+    ret = writer->status;
+    pthread_mutex_unlock(&writer->lock);
+
+    return ret;
+}
+
+/*
+ * Writes all queued data to Compress Device.
+ * Before start, Compress Device can be full, so it is enough to fill it up.
+ */
+static int offload_writer_flush(struct audio_proxy_stream *apstream, bool until_empty)
+{
+    struct offload_writer *writer = &apstream->writer;
+    int ret;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->flush = true;
+    writer->device_full = false;
+    pthread_cond_signal(&writer->data_cond);
+    while (writer->running && writer->status == 0 && writer->head != writer->tail &&
+           (until_empty || !writer->device_full)) {
+        pthread_cond_wait(&writer->space_cond, &writer->lock);
+        writer->hal_wakeups++;
+    }
+    if (!until_empty)
+        writer->flush = false;
+    ret = writer->status;
+    pthread_mutex_unlock(&writer->lock);
+
+    return ret;
+}
+
+/* Discards queued data, Offload Writer Thread doesn't access Compress Device after this */
+static void offload_writer_discard(struct audio_proxy_stream *apstream)
+{
+    struct offload_writer *writer = &apstream->writer;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->discarding = true;
+    while (writer->busy)
+        pthread_cond_wait(&writer->space_cond, &writer->lock);
+    writer->discarding = false;
+    writer->head = writer->tail = 0;
+    writer->flush = false;
+    writer->device_full = false;
+    writer->idle = true;
+    writer->status = 0;
+    // Release HAL threads waiting for space, e.g. Offload Callback Thread in offload_writer_wait()
+    pthread_cond_broadcast(&writer->space_cond);
+    pthread_cond_broadcast(&writer->data_cond);
+    pthread_mutex_unlock(&writer->lock);
+
+    return ;
+}
+
+/* Offload Writer Thread sleeps instead of polling full Compress Device while it is not running */
+static void offload_writer_set_idle(struct audio_proxy_stream *apstream, bool idle)
+{
+    struct offload_writer *writer = &apstream->writer;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->idle = idle;
+    if (!idle) {
+        writer->device_full = false;
+        pthread_cond_signal(&writer->data_cond);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return ;
+}
+
+static void dump_offload_writer(struct audio_proxy_stream *apstream, int fd)
+{
+    struct offload_writer *writer = &apstream->writer;
+    int64_t elapsed_ms = (telemetry_now_ns() - writer->start_ns) / 1000000;
+    const size_t len = 256;
+    char buffer[len];
+
+    if (writer->start_ns == 0 || elapsed_ms <= 0)
+        return ;
+
+    snprintf(buffer, len, "\tOffload Writer: %s, queue %zu bytes\n",
+             (writer->buf != NULL) ? "enabled" : "disabled", writer->size);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\tOffload wakeups per minute: HAL %llu, writer %llu\n",
+             (unsigned long long)writer->hal_wakeups * 60000 / elapsed_ms,
+             (unsigned long long)writer->writer_wakeups * 60000 / elapsed_ms);
+    write(fd,buffer,strlen(buffer));
+    snprintf(buffer, len, "\tOffload bytes per write: %llu (%u writes)\n",
+             (writer->writes > 0) ? (unsigned long long)(writer->bytes_written / writer->writes) : 0ULL,
+             writer->writes);
+    write(fd,buffer,strlen(buffer));
+
+    return ;
+}
+
 void  proxy_offload_set_nonblock(void *proxy_stream)
 {
     struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
@@ -1957,24 +4162,39 @@ int proxy_offload_compress_func(void *proxy_stream, int func_type)
         if (apstream->compress) {
             switch (func_type) {
                 case COMPRESS_TYPE_WAIT:
-                    ret = compress_wait(apstream->compress, -1);
+                    if (apstream->writer.buf != NULL) {
+                        ret = offload_writer_wait(apstream);
+                    } else {
+                        ret = compress_wait(apstream->compress, -1);
+                        apstream->writer.hal_wakeups++;
+                    }
                     ALOGVV("%s-%s: returned from waiting", stream_table[apstream->stream_type], __func__);
                     break;
 
                 case COMPRESS_TYPE_NEXTTRACK:
+                    if (apstream->writer.buf != NULL)
+                        offload_writer_flush(apstream, true);
                     ret = compress_next_track(apstream->compress);
                     ALOGI("%s-%s: set next track", stream_table[apstream->stream_type], __func__);
                     break;
 
                 case COMPRESS_TYPE_PARTIALDRAIN:
+                    if (apstream->writer.buf != NULL)
+                        offload_writer_flush(apstream, true);
                     ret = compress_partial_drain(apstream->compress);
                     ALOGI("%s-%s: drained this track partially", stream_table[apstream->stream_type], __func__);
 
                     /* Resend the metadata for next iteration */
+                    if (apstream->writer.buf != NULL)
+                        pthread_mutex_lock(&apstream->writer.lock);
                     apstream->ready_new_metadata = 1;
+                    if (apstream->writer.buf != NULL)
+                        pthread_mutex_unlock(&apstream->writer.lock);
                     break;
 
                 case COMPRESS_TYPE_DRAIN:
+                    if (apstream->writer.buf != NULL)
+                        offload_writer_flush(apstream, true);
                     ret = compress_drain(apstream->compress);
                     ALOGI("%s-%s: drained this track", stream_table[apstream->stream_type], __func__);
                     break;
@@ -1997,8 +4217,11 @@ int proxy_offload_pause(void *proxy_stream)
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
         if (apstream->compress) {
             ret = compress_pause(apstream->compress);
+            if (ret == 0 && apstream->writer.buf != NULL)
+                offload_writer_set_idle(apstream, true);
             ALOGV("%s-%s: paused compress offload!", stream_table[apstream->stream_type], __func__);
         }
+        telemetry_reset_position(&apstream->telemetry);
     }
 
     return ret;
@@ -2012,6 +4235,8 @@ int proxy_offload_resume(void *proxy_stream)
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
         if (apstream->compress) {
             ret = compress_resume(apstream->compress);
+            if (ret == 0 && apstream->writer.buf != NULL)
+                offload_writer_set_idle(apstream, false);
             ALOGV("%s-%s: resumed compress offload!", stream_table[apstream->stream_type], __func__);
         }
     }
@@ -2028,6 +4253,10 @@ void *proxy_create_playback_stream(void *proxy, int type, void *config, char *ad
 
     struct audio_proxy_stream *apstream;
 
+    wait_init_tasks(aproxy);
+    if (aproxy->first_stream_ns == 0)
+        aproxy->first_stream_ns = init_boottime_ns();
+
     apstream = (struct audio_proxy_stream *)calloc(1, sizeof(struct audio_proxy_stream));
     if (!apstream) {
         ALOGE("proxy-%s: failed to allocate memory for Proxy Stream", __func__);
@@ -2148,6 +4377,8 @@ void *proxy_create_playback_stream(void *proxy, int type, void *config, char *ad
     apstream->pcm = NULL;
     apstream->compress = NULL;
 
+    period_policy_init(aproxy, apstream);
+
     ALOGI("proxy-%s: opened Proxy Stream(%s)", __func__, stream_table[apstream->stream_type]);
     return (void *)apstream;
 
@@ -2186,17 +4417,22 @@ int proxy_close_playback_stream(void *proxy_stream)
     /* Close Noamrl PCM Device */
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
         if (apstream->compress) {
+            offload_writer_destroy(apstream);
             compress_close(apstream->compress);
             apstream->compress = NULL;
         }
         ALOGI("%s-%s: closed Compress Device", stream_table[apstream->stream_type], __func__);
     } else {
+        mmap_position_close(apstream);
         if (apstream->pcm) {
+            period_policy_decide(apstream);
             ret = pcm_close(apstream->pcm);
             apstream->pcm = NULL;
         }
         ALOGI("%s-%s: closed PCM Device", stream_table[apstream->stream_type], __func__);
     }
+    telemetry_reset_position(&apstream->telemetry);
+    position_model_reset(&apstream->pos_model);
 
     return ret;
 }
@@ -2236,6 +4472,12 @@ int proxy_open_playback_stream(void *proxy_stream, int32_t min_size_frames, void
                   apstream->comprconfig.codec->sample_rate, apstream->comprconfig.codec->format);
 
             apstream->pcm = NULL;
+
+            // Offload Writer Thread is optional, writes go to Compress Device directly without it
+            if (aproxy->support_offload_writer)
+                offload_writer_create(apstream);
+            if (apstream->writer.start_ns == 0)
+                apstream->writer.start_ns = telemetry_now_ns();
         }
     } else {
         if (apstream->pcm == NULL) {
@@ -2243,9 +4485,12 @@ int proxy_open_playback_stream(void *proxy_stream, int32_t min_size_frames, void
                 flags = PCM_OUT | PCM_MMAP | PCM_NOIRQ | PCM_MONOTONIC;
 
                 adjust_mmap_period_count(apstream, &apstream->pcmconfig, min_size_frames);
-            } else
+            } else {
                 flags = PCM_OUT | PCM_MONOTONIC;
 
+                period_policy_apply(apstream);
+            }
+
             apstream->pcm = pcm_open(sound_card, sound_device, flags, &apstream->pcmconfig);
             if (apstream->pcm && !pcm_is_ready(apstream->pcm)) {
                 /* pcm_open does always return pcm structure, not NULL */
@@ -2276,6 +4521,8 @@ int proxy_open_playback_stream(void *proxy_stream, int32_t min_size_frames, void
                     buf_size = pcm_frames_to_bytes(apstream->pcm, info->buffer_size_frames);
                     info->burst_size_frames = apstream->pcmconfig.period_size;
 
+                    mmap_position_open(apstream);
+
                     // get mmap buffer fd
                     ret = get_mmap_data_fd(proxy_stream, AUSAGE_PLAYBACK,
                                                             &info->shared_memory_fd, &mmap_size);
@@ -2317,7 +4564,7 @@ int proxy_open_playback_stream(void *proxy_stream, int32_t min_size_frames, void
     }
 
     if(aproxy->support_dualspk) {
-        if (aproxy->active_playback_device == DEVICE_EARPIECE)
+        if (get_route_snapshot(aproxy, true).device == DEVICE_EARPIECE)
             proxy_set_mixer_value_int(aproxy, SPK_AMPL_POWER_NAME, true);
         else
             proxy_set_mixer_value_int(aproxy, SPK_AMPL_POWER_NAME, aproxy->spk_ampL_powerOn);
@@ -2339,7 +4586,12 @@ int proxy_start_playback_stream(void *proxy_stream)
 
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
         if (apstream->compress) {
-            if (apstream->nonblock_flag) {
+            if (apstream->writer.buf != NULL) {
+                // Nonblock mode is set at creation, Offload Writer Thread waits with timeout by itself
+                compress_nonblock(apstream->compress, 1);
+                offload_writer_flush(apstream, false);
+                ALOGV("%s-%s: set Nonblock mode for Offload Writer!", stream_table[apstream->stream_type], __func__);
+            } else if (apstream->nonblock_flag) {
                 compress_nonblock(apstream->compress, apstream->nonblock_flag);
                 ALOGV("%s-%s: set Nonblock mode!", stream_table[apstream->stream_type], __func__);
             } else {
@@ -2348,6 +4600,8 @@ int proxy_start_playback_stream(void *proxy_stream)
             }
 
             ret = compress_start(apstream->compress);
+            if (ret == 0 && apstream->writer.buf != NULL)
+                offload_writer_set_idle(apstream, false);
             if (ret == 0)
                 ALOGI("%s-%s: started Compress Device", stream_table[apstream->stream_type], __func__);
             else
@@ -2374,33 +4628,40 @@ int proxy_write_playback_buffer(void *proxy_stream, void* buffer, int bytes)
 {
     struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
     int ret = 0, wrote = 0;
+    int64_t start_ns;
 
     /* Skip other sounds except AUX Digital Stream when AUX_DIGITAL is connected */
-    if (apstream->stream_type != ASTREAM_PLAYBACK_AUX_DIGITAL &&
-        getInstance()->active_playback_device == DEVICE_AUX_DIGITAL) {
-        skip_pcm_processing(apstream, wrote);
+    if (check_skip_playback(apstream)) {
         wrote = bytes;
+        skip_pcm_processing(apstream, &apstream->skip, wrote);
         save_written_frames(apstream, wrote);
         return wrote;
-     }
+    }
 
+    start_ns = telemetry_now_ns();
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
-        if (apstream->compress) {
-            if (apstream->ready_new_metadata) {
-                compress_set_gapless_metadata(apstream->compress, &apstream->offload_metadata);
-                ALOGI("%s-%s: sent gapless metadata(delay = %u, padding = %u) to Compress Device",
-                       stream_table[apstream->stream_type], __func__,
-                       apstream->offload_metadata.encoder_delay, apstream->offload_metadata.encoder_padding);
-                apstream->ready_new_metadata = 0;
-        }
+        if (apstream->compress && apstream->writer.buf != NULL) {
+            wrote = offload_writer_queue(apstream, buffer, bytes);
+            ALOGVV("%s-%s: queued Request(%u bytes) to Offload Writer, and Accepted (%d bytes)",
+                    stream_table[apstream->stream_type], __func__, (unsigned int)bytes, wrote);
+            telemetry_record_latency(&apstream->telemetry, start_ns);
+        } else if (apstream->compress) {
+            send_offload_metadata(apstream);
 
             wrote = compress_write(apstream->compress, buffer, bytes);
+            if (wrote > 0) {
+                apstream->writer.writes++;
+                apstream->writer.bytes_written += wrote;
+            }
             ALOGVV("%s-%s: wrote Request(%u bytes) to Compress Device, and Accepted (%u bytes)",
                     stream_table[apstream->stream_type], __func__, (unsigned int)bytes, wrote);
+            telemetry_record_latency(&apstream->telemetry, start_ns);
         }
     } else {
         if (apstream->pcm) {
             ret = pcm_write(apstream->pcm, (void *)buffer, (unsigned int)bytes);
+            telemetry_record_latency(&apstream->telemetry, start_ns);
+            period_policy_record_write(apstream, start_ns, telemetry_now_ns());
             if (ret == 0) {
                 ALOGVV("%s-%s: writed %u bytes to PCM Device", stream_table[apstream->stream_type],
                                                                __func__, (unsigned int)bytes);
@@ -2408,7 +4669,10 @@ int proxy_write_playback_buffer(void *proxy_stream, void* buffer, int bytes)
             } else {
                 ALOGE("%s-%s: failed to write to PCM Device with %s",
                       stream_table[apstream->stream_type], __func__, pcm_get_error(apstream->pcm));
-                skip_pcm_processing(apstream, wrote);
+                telemetry_record_xrun(&apstream->telemetry);
+                apstream->xrun.base_ns = 0;
+                apstream->xrun.entries++;
+                skip_pcm_processing(apstream, &apstream->xrun, bytes);
             }
             wrote = bytes;
             save_written_frames(apstream, wrote);
@@ -2425,6 +4689,9 @@ int proxy_stop_playback_stream(void *proxy_stream)
 
     if (apstream->stream_type == ASTREAM_PLAYBACK_COMPR_OFFLOAD) {
         if (apstream->compress) {
+            if (apstream->writer.buf != NULL)
+                offload_writer_discard(apstream);
+
             ret = compress_stop(apstream->compress);
             if (ret == 0)
                 ALOGI("%s-%s: stopped Compress Device", stream_table[apstream->stream_type], __func__);
@@ -2436,6 +4703,7 @@ int proxy_stop_playback_stream(void *proxy_stream)
         }
     } else if (apstream->stream_type == ASTREAM_PLAYBACK_MMAP) {
         if (apstream->pcm) {
+            apstream->mmap_pos.valid = false;
             ret = pcm_stop(apstream->pcm);
             if (ret == 0)
                 ALOGI("%s-%s: stop MMAP Device", stream_table[apstream->stream_type], __func__);
@@ -2444,6 +4712,8 @@ int proxy_stop_playback_stream(void *proxy_stream)
                                                __func__, pcm_get_error(apstream->pcm));
         }
     }
+    telemetry_reset_position(&apstream->telemetry);
+    position_model_reset(&apstream->pos_model);
 
     return ret;
 }
@@ -2511,10 +4781,16 @@ int proxy_get_presen_position(void *proxy_stream, uint64_t *frames, struct times
 
                     *frames = (uint64_t)hw_frames;
                     clock_gettime(CLOCK_MONOTONIC, timestamp);
+                    telemetry_record_position(&apstream->telemetry, *frames, timestamp, sample_rate);
                 }
             }
         } else {
-            if (apstream->pcm) {
+            if (apstream->pcm && apstream->stream_type != ASTREAM_PLAYBACK_MMAP &&
+                position_model_predict(apstream, frames, timestamp)) {
+                telemetry_record_position(&apstream->telemetry, *frames, timestamp,
+                                          apstream->pcmconfig.rate);
+                ret = 0;
+            } else if (apstream->pcm) {
                 ret = pcm_get_htimestamp(apstream->pcm, &avail, timestamp);
                 if (ret == 0) {
                     // Total Frame Count in kernel Buffer
@@ -2524,9 +4800,13 @@ int proxy_get_presen_position(void *proxy_stream, uint64_t *frames, struct times
                     // Real frames which played out to device
                     int64_t signed_frames = apstream->frames - kernel_buffer_size + avail;
 
-                    if (signed_frames >= 0)
+                    if (signed_frames >= 0) {
                         *frames = (uint64_t)signed_frames;
-                    else
+                        if (apstream->stream_type != ASTREAM_PLAYBACK_MMAP)
+                            position_model_update(apstream, frames, timestamp);
+                        telemetry_record_position(&apstream->telemetry, *frames, timestamp,
+                                                  apstream->pcmconfig.rate);
+                    } else
                         ret = -ENODATA;
                 } else
                         ret = -ENODATA;
@@ -2556,8 +4836,7 @@ int proxy_getparam_playback_stream(void *proxy_stream, void *query_params, void
         char formats_list[256];
 
         memset(formats_list, 0, 256);
-        strncpy(formats_list, stream_format_table[apstream->stream_type],
-                       strlen(stream_format_table[apstream->stream_type]));
+        strlcpy(formats_list, stream_format_table[apstream->stream_type], sizeof(formats_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_FORMATS, formats_list);
     }
 
@@ -2566,8 +4845,7 @@ int proxy_getparam_playback_stream(void *proxy_stream, void *query_params, void
         char channels_list[256];
 
         memset(channels_list, 0, 256);
-        strncpy(channels_list, stream_channel_table[apstream->stream_type],
-                        strlen(stream_channel_table[apstream->stream_type]));
+        strlcpy(channels_list, stream_channel_table[apstream->stream_type], sizeof(channels_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_CHANNELS, channels_list);
     }
 
@@ -2576,8 +4854,7 @@ int proxy_getparam_playback_stream(void *proxy_stream, void *query_params, void
         char rates_list[256];
 
         memset(rates_list, 0, 256);
-        strncpy(rates_list, stream_rate_table[apstream->stream_type],
-                     strlen(stream_rate_table[apstream->stream_type]));
+        strlcpy(rates_list, stream_rate_table[apstream->stream_type], sizeof(rates_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_SAMPLING_RATES, rates_list);
     }
 
@@ -2616,8 +4893,12 @@ int proxy_setparam_playback_stream(void *proxy_stream, void *parameters)
         }
 
         if (need_to_set_metadata) {
+            if (apstream->writer.buf != NULL)
+                pthread_mutex_lock(&apstream->writer.lock);
             apstream->offload_metadata = tmp_mdata;
             apstream->ready_new_metadata = 1;
+            if (apstream->writer.buf != NULL)
+                pthread_mutex_unlock(&apstream->writer.lock);
         }
     }
 
@@ -2703,8 +4984,44 @@ void proxy_dump_playback_stream(void *proxy_stream, int fd)
         write(fd,buffer,strlen(buffer));
         snprintf(buffer, len, "\tOffload Fragments: %d\n",apstream->comprconfig.fragments);
         write(fd,buffer,strlen(buffer));
+
+        dump_offload_writer(apstream, fd);
+    }
+
+    if (apstream->pos_model.errors > 0) {
+        struct position_model *model = &apstream->pos_model;
+
+        snprintf(buffer, len, "\toutput position model: %u queries, %u hardware timestamps, %u resets\n",
+                 model->queries, model->refreshes, model->resets);
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\toutput position model error: avg %llu usec, max %u usec, rate %.2f Hz\n",
+                 (unsigned long long)(model->error_sum_us / model->errors), model->error_max_us,
+                 model->valid ? model->rate * 1000000000.0 : 0.0);
+        write(fd,buffer,strlen(buffer));
+    }
+
+    dump_period_policy(apstream, fd);
+
+    if (apstream->skip.entries > 0 || apstream->skip.frames > 0) {
+        snprintf(buffer, len, "\toutput skipped: %llu frames in %u periods of AUX Digital, %u resyncs\n",
+                 (unsigned long long)apstream->skip.frames, apstream->skip.entries, apstream->skip.resyncs);
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\toutput skip clock: %u sleeps, %u late writes\n",
+                 apstream->skip.sleeps, apstream->skip.late);
+        write(fd,buffer,strlen(buffer));
+    }
+
+    if (apstream->xrun.entries > 0) {
+        snprintf(buffer, len, "\toutput xrun recovery: %llu frames paced after %u failed writes, %u sleeps\n",
+                 (unsigned long long)apstream->xrun.frames, apstream->xrun.entries, apstream->xrun.sleeps);
+        write(fd,buffer,strlen(buffer));
     }
 
+    if (apstream->stream_type == ASTREAM_PLAYBACK_MMAP)
+        dump_mmap_position(apstream, "output", fd);
+
+    dump_telemetry(&apstream->telemetry, "output", fd);
+
     return ;
 }
 
@@ -2718,6 +5035,10 @@ void *proxy_create_capture_stream(void *proxy, int type, int usage, void *config
 
     struct audio_proxy_stream *apstream;
 
+    wait_init_tasks(aproxy);
+    if (aproxy->first_stream_ns == 0)
+        aproxy->first_stream_ns = init_boottime_ns();
+
     apstream = (struct audio_proxy_stream *)calloc(1, sizeof(struct audio_proxy_stream));
     if (!apstream) {
         ALOGE("proxy-%s: failed to allocate memory for Proxy Stream", __func__);
@@ -2743,6 +5064,7 @@ void *proxy_create_capture_stream(void *proxy, int type, int usage, void *config
     apstream->proc_buf_size = 0;
 
     apstream->resampler = NULL;
+    apstream->resampler_engine = RESAMPLER_ENGINE_DEFAULT;
 
     apstream->need_update_pcm_config = false;
     apstream->skip_ch_convert = false;
@@ -2853,7 +5175,7 @@ void proxy_destroy_capture_stream(void *proxy_stream)
     if (apstream) {
         if (apstream->resampler) {
             ALOGV("%s-%s: released resampler", stream_table[apstream->stream_type], __func__);
-            release_resampler(apstream->resampler);
+            release_capture_resampler(apstream);
         }
 
         if (apstream->actual_read_buf)
@@ -2862,6 +5184,8 @@ void proxy_destroy_capture_stream(void *proxy_stream)
         if (apstream->proc_buf_out)
             free(apstream->proc_buf_out);
 
+        capture_ring_free(apstream);
+
         free(apstream);
     }
 
@@ -2871,10 +5195,11 @@ void proxy_destroy_capture_stream(void *proxy_stream)
 int proxy_close_capture_stream(void *proxy_stream)
 {
     struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
-    struct audio_proxy *aproxy = getInstance();
     int ret = 0;
 
 #ifdef SUPPORT_STHAL_INTERFACE
+    struct audio_proxy *aproxy = getInstance();
+
     /* Handle HOTWORD soure separately */
     if (apstream->stream_type == ASTREAM_CAPTURE_HOTWORD) {
         if (aproxy->sound_trigger_close_for_streaming) {
@@ -2904,6 +5229,9 @@ int proxy_close_capture_stream(void *proxy_stream)
 
     /* Close Normal PCM Device */
     if (apstream->pcm) {
+        capture_ring_stop(apstream);
+        mmap_position_close(apstream);
+
         ret = pcm_close(apstream->pcm);
         apstream->pcm = NULL;
 
@@ -3008,6 +5336,8 @@ int proxy_open_capture_stream(void *proxy_stream, int32_t min_size_frames, void
                 buf_size = pcm_frames_to_bytes(apstream->pcm, info->buffer_size_frames);
                 info->burst_size_frames = apstream->pcmconfig.period_size;
 
+                mmap_position_open(apstream);
+
                 // get mmap buffer fd
                 ret = get_mmap_data_fd(proxy_stream, AUSAGE_CAPTURE,
                                                         &info->shared_memory_fd, &mmap_size);
@@ -3044,6 +5374,13 @@ int proxy_open_capture_stream(void *proxy_stream, int32_t min_size_frames, void
                 goto err_open;
             }
         }
+
+        // Capture Ring Buffer is allocated here, PCM Reader Thread starts with first read
+        if (aproxy->support_capture_ring && apstream->stream_type != ASTREAM_CAPTURE_MMAP)
+            capture_ring_alloc(apstream);
+
+        if (apstream->stream_type != ASTREAM_CAPTURE_MMAP && capture_buffers_alloc(apstream) != 0)
+            goto err_open;
     } else
         ALOGW("%s-%s: PCM Device is already opened!", stream_table[apstream->stream_type], __func__);
 
@@ -3135,7 +5472,15 @@ int proxy_read_capture_buffer(void *proxy_stream, void *buffer, int bytes)
             ALOGVV("%s-%s: Mute data PCM Device(%d)", stream_table[apstream->stream_type], __func__,
                 apstream->sound_device);
         } else {
+            int64_t start_ns = telemetry_now_ns();
+
+            if (apstream->ring.buf != NULL && !apstream->ring.started && apstream->pcm)
+                capture_ring_start(apstream);
+
             frames_actual = read_and_process_frames(apstream, buffer, frames_request);
+            telemetry_record_latency(&apstream->telemetry, start_ns);
+            if (frames_actual < 0)
+                telemetry_record_xrun(&apstream->telemetry);
             ALOGVV("%s-%s: requested read frames = %d vs. actual processed read frames = %d",
                    stream_table[apstream->stream_type], __func__, frames_request, frames_actual);
         }
@@ -3164,6 +5509,9 @@ int proxy_stop_capture_stream(void *proxy_stream)
 #endif
 
     if (apstream->pcm) {
+        capture_ring_stop(apstream);
+        apstream->mmap_pos.valid = false;
+
         ret = pcm_stop(apstream->pcm);
         if (ret == 0)
             ALOGI("%s-%s: stopped PCM Device", stream_table[apstream->stream_type], __func__);
@@ -3230,7 +5578,7 @@ int proxy_reconfig_capture_usage(void *proxy_stream, int type, int usage)
             /* Release already running resampler for reconfiguration purpose */
             if (apstream->resampler) {
                 ALOGI("%s-%s: released resampler", stream_table[apstream->stream_type], __func__);
-                release_resampler(apstream->resampler);
+                release_capture_resampler(apstream);
                 apstream->resampler = NULL;
             }
 
@@ -3246,7 +5594,7 @@ int proxy_reconfig_capture_usage(void *proxy_stream, int type, int usage)
             /* Release already running resampler for reconfiguration purpose */
              if (apstream->resampler) {
                  ALOGI("%s-%s: released resampler", stream_table[apstream->stream_type], __func__);
-                 release_resampler(apstream->resampler);
+                 release_capture_resampler(apstream);
                  apstream->resampler = NULL;
              }
 
@@ -3306,7 +5654,7 @@ int proxy_get_active_microphones(void *proxy_stream, void *array, int *count)
             apstream->stream_type == ASTREAM_CAPTURE_PRIMARY ||
             apstream->stream_type == ASTREAM_CAPTURE_LOW_LATENCY ||
             apstream->stream_type == ASTREAM_CAPTURE_MMAP) {
-            device_type active_device = aproxy->active_capture_device;
+            device_type active_device = get_route_snapshot(aproxy, false).device;
             if (active_device == DEVICE_NONE) {
                 ALOGE("%s-%s: There are no active MIC", stream_table[apstream->stream_type], __func__);
                 ret = -ENOSYS;
@@ -3372,8 +5720,7 @@ int proxy_getparam_capture_stream(void *proxy_stream, void *query_params, void *
         char formats_list[256];
 
         memset(formats_list, 0, 256);
-        strncpy(formats_list, stream_format_table[apstream->stream_type],
-                       strlen(stream_format_table[apstream->stream_type]));
+        strlcpy(formats_list, stream_format_table[apstream->stream_type], sizeof(formats_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_FORMATS, formats_list);
     }
 
@@ -3382,8 +5729,7 @@ int proxy_getparam_capture_stream(void *proxy_stream, void *query_params, void *
         char channels_list[256];
 
         memset(channels_list, 0, 256);
-        strncpy(channels_list, stream_channel_table[apstream->stream_type],
-                        strlen(stream_channel_table[apstream->stream_type]));
+        strlcpy(channels_list, stream_channel_table[apstream->stream_type], sizeof(channels_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_CHANNELS, channels_list);
     }
 
@@ -3392,17 +5738,15 @@ int proxy_getparam_capture_stream(void *proxy_stream, void *query_params, void *
         char rates_list[256];
 
         memset(rates_list, 0, 256);
-        strncpy(rates_list, stream_rate_table[apstream->stream_type],
-                     strlen(stream_rate_table[apstream->stream_type]));
+        strlcpy(rates_list, stream_rate_table[apstream->stream_type], sizeof(rates_list));
         str_parms_add_str(reply, AUDIO_PARAMETER_STREAM_SUP_SAMPLING_RATES, rates_list);
     }
 
     return 0;
 }
 
-int proxy_setparam_capture_stream(void *proxy_stream, void *parameters)
+int proxy_setparam_capture_stream(void *proxy_stream __unused, void *parameters __unused)
 {
-    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
     int ret = 0;
 
     return ret;
@@ -3422,8 +5766,42 @@ void proxy_dump_capture_stream(void *proxy_stream, int fd)
         write(fd,buffer,strlen(buffer));
         snprintf(buffer, len, "\tinput pcm config format: %d\n",apstream->pcmconfig.format);
         write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\tinput channel kernels: %s\n", capture_kernels->name);
+        write(fd,buffer,strlen(buffer));
+        if (apstream->resampler != NULL) {
+            snprintf(buffer, len, "\tinput resampler: %s, delay %d nsec\n",
+                     resampler_engine_table[apstream->resampler_engine],
+                     apstream->resampler->delay_ns(apstream->resampler));
+            write(fd,buffer,strlen(buffer));
+        }
+        snprintf(buffer, len, "\tinput bytes read directly: %llu\n",
+                 (unsigned long long)apstream->bytes_read_direct);
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\tinput bytes copied: %llu\n",
+                 (unsigned long long)apstream->bytes_read_copied);
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\tinput buffers: read %zu bytes, conversion %d bytes, %u data path allocs\n",
+                 apstream->actual_read_buf_size, apstream->proc_buf_size, apstream->data_path_allocs);
+        write(fd,buffer,strlen(buffer));
+    }
+
+    if (apstream->ring.buf != NULL) {
+        snprintf(buffer, len, "\tinput capture ring slots: %u x %u bytes\n",
+                 apstream->ring.slot_count, apstream->ring.slot_bytes);
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\tinput capture ring overruns: %u\n",
+                 atomic_load_explicit(&apstream->ring.overruns, memory_order_relaxed));
+        write(fd,buffer,strlen(buffer));
+        snprintf(buffer, len, "\tinput capture ring underruns: %u\n",
+                 atomic_load_explicit(&apstream->ring.underruns, memory_order_relaxed));
+        write(fd,buffer,strlen(buffer));
     }
 
+    if (apstream->stream_type == ASTREAM_CAPTURE_MMAP)
+        dump_mmap_position(apstream, "input", fd);
+
+    dump_telemetry(&apstream->telemetry, "input", fd);
+
     return ;
 }
 
@@ -3449,11 +5827,7 @@ int proxy_get_mmap_position(void *proxy_stream, void *pos)
 
     if ((apstream->stream_type == ASTREAM_PLAYBACK_MMAP || apstream->stream_type == ASTREAM_CAPTURE_MMAP)&&
          apstream->pcm) {
-        struct timespec ts = { 0, 0 };
-
-        ret = pcm_mmap_get_hw_ptr(apstream->pcm, (unsigned int *)&position->position_frames, &ts);
-        if (ret == 0)
-            position->time_nanoseconds = audio_utils_ns_from_timespec(&ts);
+        ret = mmap_position_get(apstream, &position->position_frames, &position->time_nanoseconds);
     }
 
     return ret;
@@ -3476,7 +5850,12 @@ bool proxy_init_route(void *proxy, char *path)
     bool ret = false;
 
     if (aproxy) {
-        aproxy->mixer = mixer_open(MIXER_CARD0);
+        // Mixer is opened by init task at first, and has to be reopened after proxy_deinit_route
+        wait_init_tasks(aproxy);
+        if (!aproxy->mixer) {
+            aproxy->mixer = mixer_open(MIXER_CARD0);
+            build_mixer_ctl_cache(aproxy);
+        }
         proxy_set_mixercontrol(aproxy, TICKLE_CONTROL, ABOX_TICKLE_ON);
         if (aproxy->mixer) {
             // In order to get add event, subscription has to be here!
@@ -3488,10 +5867,13 @@ bool proxy_init_route(void *proxy, char *path)
                 mixer_subscribe_events(aproxy->mixer, 0);
                 mixer_close(aproxy->mixer);
                 aproxy->mixer = NULL;
+                destroy_mixer_ctl_cache(aproxy);
             } else {
                 aproxy->aroute = ar;
                 aproxy->xml_path = strdup(path);    // Save Mixer Paths XML File path
 
+                build_route_table(aproxy);
+
                 aproxy->active_playback_ausage   = AUSAGE_NONE;
                 aproxy->active_playback_device   = DEVICE_NONE;
                 aproxy->active_playback_modifier = MODIFIER_NONE;
@@ -3499,18 +5881,28 @@ bool proxy_init_route(void *proxy, char *path)
                 aproxy->active_capture_ausage   = AUSAGE_NONE;
                 aproxy->active_capture_device   = DEVICE_NONE;
                 aproxy->active_capture_modifier = MODIFIER_NONE;
+                publish_route_snapshot(aproxy);
 
                 ALOGI("proxy-%s: opened Mixer & initialized audio route", __func__);
                 ret = true;
+                aproxy->route_ready_ns = init_boottime_ns();
 
                 /* Create Mixer Control Update Thread */
                 pthread_rwlock_init(&aproxy->mixer_update_lock, NULL);
 
                 if (audio_route_missing_ctl(ar)) {
-                    pthread_create(&aproxy->mixer_update_thread, NULL, mixer_update_loop, aproxy);
-                    ALOGI("proxy-%s: missing control found, update thread is created", __func__);
-                } else
-                    mixer_subscribe_events(aproxy->mixer, 0);
+                    aproxy->mixer_update_stop_fd = eventfd(0, EFD_CLOEXEC);
+                    if (aproxy->mixer_update_stop_fd >= 0 &&
+                        pthread_create(&aproxy->mixer_update_thread, NULL, mixer_update_loop, aproxy) == 0) {
+                        aproxy->mixer_update_running = true;
+                        ALOGI("proxy-%s: missing control found, update thread is created", __func__);
+                    } else {
+                        ALOGE("proxy-%s: failed to create update thread", __func__);
+                        if (aproxy->mixer_update_stop_fd >= 0)
+                            close(aproxy->mixer_update_stop_fd);
+                    }
+                }
+                // Mixer stays subscribed, route changes count written controls from value events
             }
         } else
             ALOGE("proxy-%s: failed to open Mixer", __func__);
@@ -3524,6 +5916,14 @@ void proxy_deinit_route(void *proxy)
     struct audio_proxy *aproxy = proxy;
 
     if (aproxy) {
+        // Wakes up and waits Mixer Updater Thread
+        if (aproxy->mixer_update_running) {
+            eventfd_write(aproxy->mixer_update_stop_fd, 1);
+            pthread_join(aproxy->mixer_update_thread, NULL);
+            close(aproxy->mixer_update_stop_fd);
+            aproxy->mixer_update_running = false;
+        }
+
         pthread_rwlock_wrlock(&aproxy->mixer_update_lock);
 
         if (aproxy->aroute) {
@@ -3534,28 +5934,22 @@ void proxy_deinit_route(void *proxy)
             mixer_close(aproxy->mixer);
             aproxy->mixer = NULL;
         }
+        destroy_mixer_ctl_cache(aproxy);
 
         pthread_rwlock_unlock(&aproxy->mixer_update_lock);
         pthread_rwlock_destroy(&aproxy->mixer_update_lock);
         free(aproxy->xml_path);
+
+        destroy_route_table(aproxy);
     }
     ALOGI("proxy-%s: closed Mixer & deinitialized audio route", __func__);
 
     return ;
 }
 
-bool proxy_update_route(void *proxy, int ausage, int device)
+bool proxy_update_route(void *proxy __unused, int ausage __unused, int device __unused)
 {
-    struct audio_proxy *aproxy = proxy;
-    audio_usage routed_ausage = (audio_usage)ausage;
-    device_type routed_device = (device_type)device;
-
     // Temp
-    if (aproxy != NULL) {
-        routed_ausage = AUSAGE_NONE;
-        routed_device = DEVICE_NONE;
-    }
-
     return true;
 }
 
@@ -3568,18 +5962,23 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
 
     modifier_type routed_modifier = (modifier_type)modifier;
 
+    struct route_trans trans;
+
     if (set) {
         if (routed_device < DEVICE_MAIN_MIC) {
             /* Do Specific Operation based on Audio Path */
             do_operations_by_playback_route_set(aproxy, routed_ausage, routed_device);
 
+            // Route and Modifier changes are written to mixer at once
+            route_trans_begin(&trans);
+
             if (aproxy->active_playback_ausage != AUSAGE_NONE &&
                 aproxy->active_playback_device != DEVICE_NONE) {
                 disable_internal_path(aproxy, aproxy->active_playback_device);
-                set_reroute(aproxy, aproxy->active_playback_ausage, aproxy->active_playback_device,
-                                    routed_ausage, routed_device);
+                set_reroute(aproxy, &trans, aproxy->active_playback_ausage, aproxy->active_playback_device,
+                            routed_ausage, routed_device);
             } else
-                set_route(aproxy, routed_ausage, routed_device);
+                set_route(aproxy, &trans, routed_ausage, routed_device);
 
             aproxy->active_playback_ausage = routed_ausage;
             aproxy->active_playback_device = routed_device;
@@ -3587,14 +5986,16 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
             // Audio Path Modifier for Playback Path
             if (routed_modifier < MODIFIER_BT_SCO_TX_NB) {
                 if (aproxy->active_playback_modifier == MODIFIER_NONE)
-                    set_modifier(aproxy, routed_modifier);
+                    set_modifier(aproxy, &trans, routed_modifier);
                 else
-                    update_modifier(aproxy, aproxy->active_playback_modifier, routed_modifier);
+                    update_modifier(aproxy, &trans, aproxy->active_playback_modifier, routed_modifier);
             } else if (routed_modifier == MODIFIER_NONE && aproxy->active_playback_modifier != MODIFIER_NONE)
-                reset_modifier(aproxy, aproxy->active_playback_modifier);
+                reset_modifier(aproxy, &trans, aproxy->active_playback_modifier);
 
             aproxy->active_playback_modifier = routed_modifier;
 
+            route_trans_commit(aproxy, &trans);
+
             // Set Loopback for Playback Path
             enable_internal_path(aproxy, routed_device);
 
@@ -3603,17 +6004,20 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
                 proxy_start_fm_radio(aproxy);
             }
         } else {
+            // Route and Modifier changes are written to mixer at once
+            route_trans_begin(&trans);
+
             // Audio Path Routing for Capture Path
             if (aproxy->active_capture_ausage != AUSAGE_NONE &&
                 aproxy->active_capture_device != DEVICE_NONE) {
                 disable_internal_path(aproxy, aproxy->active_capture_device);
-                set_reroute(aproxy, aproxy->active_capture_ausage, aproxy->active_capture_device,
-                                    routed_ausage, routed_device);
+                set_reroute(aproxy, &trans, aproxy->active_capture_ausage, aproxy->active_capture_device,
+                            routed_ausage, routed_device);
             } else {
                 // In case of capture routing setup, it needs A-Box early-wakeup
                 proxy_set_mixercontrol(aproxy, TICKLE_CONTROL, ABOX_TICKLE_ON);
 
-                set_route(aproxy, routed_ausage, routed_device);
+                set_route(aproxy, &trans, routed_ausage, routed_device);
             }
 
             aproxy->active_capture_ausage = routed_ausage;
@@ -3622,14 +6026,16 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
             // Audio Path Modifier for Capture Path
             if (routed_modifier >= MODIFIER_BT_SCO_TX_NB && routed_modifier < MODIFIER_NONE) {
                 if (aproxy->active_capture_modifier == MODIFIER_NONE)
-                    set_modifier(aproxy, routed_modifier);
+                    set_modifier(aproxy, &trans, routed_modifier);
                 else
-                    update_modifier(aproxy, aproxy->active_capture_modifier, routed_modifier);
+                    update_modifier(aproxy, &trans, aproxy->active_capture_modifier, routed_modifier);
             } else if (routed_modifier == MODIFIER_NONE && aproxy->active_capture_modifier != MODIFIER_NONE)
-                reset_modifier(aproxy, aproxy->active_capture_modifier);
+                reset_modifier(aproxy, &trans, aproxy->active_capture_modifier);
 
             aproxy->active_capture_modifier = routed_modifier;
 
+            route_trans_commit(aproxy, &trans);
+
             // Set Loopback for Capture Path
             enable_internal_path(aproxy, routed_device);
         }
@@ -3641,9 +6047,12 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
         // Reset Loopback
         disable_internal_path(aproxy, routed_device);
 
+        // Route and Modifier changes are written to mixer at once
+        route_trans_begin(&trans);
+
         // Audio Path Modifier
         if (routed_modifier != MODIFIER_NONE) {
-            reset_modifier(aproxy, routed_modifier);
+            reset_modifier(aproxy, &trans, routed_modifier);
 
             if (routed_modifier < MODIFIER_BT_SCO_TX_NB)
                 aproxy->active_playback_modifier = MODIFIER_NONE;
@@ -3655,7 +6064,9 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
         }
 
         // Audio Path Routing
-        reset_route(aproxy, routed_ausage, routed_device);
+        reset_route(aproxy, &trans, routed_ausage, routed_device);
+
+        route_trans_commit(aproxy, &trans);
 
         if (routed_device < DEVICE_MAIN_MIC) {
             aproxy->active_playback_ausage = AUSAGE_NONE;
@@ -3666,6 +6077,9 @@ bool proxy_set_route(void *proxy, int ausage, int device, int modifier, bool set
         }
     }
 
+    // Stream Threads see this route change at once
+    publish_route_snapshot(aproxy);
+
     return true;
 }
 
@@ -3738,7 +6152,7 @@ int proxy_get_mixer_value_int(void *proxy, const char *name)
 
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    ctrl = get_mixer_ctl(aproxy, name);
     if (ctrl) {
         ret = mixer_ctl_get_value(ctrl, 0);
     } else {
@@ -3761,7 +6175,7 @@ int proxy_get_mixer_value_array(void *proxy, const char *name, void *value, int
 
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    ctrl = get_mixer_ctl(aproxy, name);
     if (ctrl) {
         ret = mixer_ctl_get_array(ctrl, value, count);
     } else {
@@ -3784,7 +6198,7 @@ void proxy_set_mixer_value_int(void *proxy, const char *name, int value)
 
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    ctrl = get_mixer_ctl(aproxy, name);
     if (ctrl) {
         ret = mixer_ctl_set_value(ctrl, 0, val);
         if (ret != 0)
@@ -3809,7 +6223,7 @@ void proxy_set_mixer_value_string(void *proxy, const char *name, const char *val
 
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    ctrl = get_mixer_ctl(aproxy, name);
     if (ctrl) {
         ret = mixer_ctl_set_enum_by_string(ctrl, value);
         if (ret != 0)
@@ -3834,7 +6248,7 @@ void proxy_set_mixer_value_array(void *proxy, const char *name, const void *valu
 
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, name);
+    ctrl = get_mixer_ctl(aproxy, name);
     if (ctrl) {
         ret = mixer_ctl_set_array(ctrl, value, count);
         if (ret != 0)
@@ -3860,7 +6274,7 @@ void proxy_set_audiomode(void *proxy, int audiomode)
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
     /* Set Audio Mode to Kernel */
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, ABOX_AUDIOMODE_CONTROL_NAME);
+    ctrl = get_mixer_ctl(aproxy, ABOX_AUDIOMODE_CONTROL_NAME);
     if (ctrl) {
         ret = mixer_ctl_set_value(ctrl, 0,val);
         if (ret != 0)
@@ -3887,7 +6301,7 @@ void proxy_set_volume(void *proxy, int volume_type, float left, float right)
         val[0] = (int)(left * COMPRESS_PLAYBACK_VOLUME_MAX);
         val[1] = (int)(right * COMPRESS_PLAYBACK_VOLUME_MAX);
 
-        ctrl = mixer_get_ctl_by_name(aproxy->mixer, OFFLOAD_VOLUME_CONTROL_NAME);
+        ctrl = get_mixer_ctl(aproxy, OFFLOAD_VOLUME_CONTROL_NAME);
     }
 
     if (ctrl) {
@@ -3910,9 +6324,9 @@ void proxy_set_volume(void *proxy, int volume_type, float left, float right)
 void proxy_clear_apcall_txse(void)
 {
     struct audio_proxy *aproxy = getInstance();
-    char basic_path_name[MAX_PATH_NAME_LEN];
+    struct route_trans trans;
     char path_name[MAX_PATH_NAME_LEN];
-    audio_usage ausage = aproxy->active_capture_ausage;
+    audio_usage ausage = get_route_snapshot(aproxy, false).ausage;
 
     memset(path_name, 0, MAX_PATH_NAME_LEN);
 
@@ -3921,22 +6335,20 @@ void proxy_clear_apcall_txse(void)
         return;
     }
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
-
-    audio_route_reset_and_update_path(aproxy->aroute, path_name);
+    route_trans_begin(&trans);
+    route_trans_add(aproxy, &trans, path_name, false);
+    route_trans_commit(aproxy, &trans);
     ALOGI("proxy-%s: %s is disabled", __func__, path_name);
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
-
     return ;
 }
 
 void proxy_set_apcall_txse(void)
 {
     struct audio_proxy *aproxy = getInstance();
-    char basic_path_name[MAX_PATH_NAME_LEN];
+    struct route_trans trans;
     char path_name[MAX_PATH_NAME_LEN];
-    audio_usage ausage = aproxy->active_capture_ausage;
+    audio_usage ausage = get_route_snapshot(aproxy, false).ausage;
 
     memset(path_name, 0, MAX_PATH_NAME_LEN);
 
@@ -3945,13 +6357,11 @@ void proxy_set_apcall_txse(void)
         return;
     }
 
-    pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
-
-    audio_route_apply_and_update_path(aproxy->aroute, path_name);
+    route_trans_begin(&trans);
+    route_trans_add(aproxy, &trans, path_name, true);
+    route_trans_commit(aproxy, &trans);
     ALOGI("proxy-%s: %s is enabled", __func__, path_name);
 
-    pthread_rwlock_unlock(&aproxy->mixer_update_lock);
-
     return ;
 }
 
@@ -3964,7 +6374,7 @@ void proxy_set_upscale(void *proxy, int sampling_rate, int pcm_format)
     pthread_rwlock_rdlock(&aproxy->mixer_update_lock);
 
     /* Set Compress Offload Upscaling Info to Kernel */
-    ctrl = mixer_get_ctl_by_name(aproxy->mixer, OFFLOAD_UPSCALE_CONTROL_NAME);
+    ctrl = get_mixer_ctl(aproxy, OFFLOAD_UPSCALE_CONTROL_NAME);
     if (ctrl) {
         if (sampling_rate == 48000 && (audio_format_t)pcm_format == AUDIO_FORMAT_PCM_SUB_16_BIT)
             val = (int)UPSCALE_48K_16B;
@@ -4024,6 +6434,8 @@ void proxy_call_status(void *proxy, int status)
 {
     struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
 
+    wait_init_tasks(aproxy);
+
     /* status : TRUE means call starting
         FALSE means call stopped
     */
@@ -4049,10 +6461,20 @@ int proxy_set_parameters(void *proxy, void *parameters)
 {
     struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
     struct str_parms *parms = (struct str_parms *)parameters;
+    char value[32];
     int val;
     int ret = 0;     // for parameter handling
     int status = 0;  // for return value
 
+    wait_init_tasks(aproxy);
+
+    ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_SCREEN_STATE, value, sizeof(value));
+    if (ret >= 0) {
+        atomic_store_explicit(&aproxy->screen_off, strcmp(value, AUDIO_PARAMETER_VALUE_OFF) == 0,
+                              memory_order_relaxed);
+        ALOGV("proxy-%s: Screen State is %s", __func__, value);
+    }
+
     ret = str_parms_get_int(parms, AUDIO_PARAMETER_DEVICE_CONNECT, &val);
     if (ret >= 0) {
         if ((audio_devices_t)val == AUDIO_DEVICE_IN_WIRED_HEADSET) {
@@ -4124,7 +6546,7 @@ int proxy_get_microphones(void *proxy, void *array, int *count)
     return ret;
 }
 
-void proxy_update_uhqa_playback_stream(void *proxy_stream, int hq_mode)
+void proxy_update_uhqa_playback_stream(void *proxy_stream __unused, int hq_mode __unused)
 {
 #if 0
     struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
@@ -4246,6 +6668,7 @@ int proxy_fw_dump(int fd)
 {
     ALOGV("proxy-%s: enter with file descriptor(%d)", __func__, fd);
 
+    dump_statistics(getInstance(), fd);
     calliope_ramdump(fd);
 
     ALOGV("proxy-%s: exit with file descriptor(%d)", __func__, fd);
@@ -4341,6 +6764,65 @@ static void check_configurations(struct audio_proxy *aproxy)
         ALOGI("proxy-%s: The BT A2DP Device is supported by BT A2DP AudioHAL", __func__);
     }
 
+    // Capture Ring Buffer
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(CAPTURE_RING_PROPERTY, property, CAPTURE_RING_DEFAULT);
+    if (strcmp(property, "yes") == 0) {
+        aproxy->support_capture_ring = true;
+        ALOGI("proxy-%s: The Capture Ring Buffer is enabled", __func__);
+    } else
+        aproxy->support_capture_ring = false;
+
+    // Offload Writer
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(OFFLOAD_WRITER_PROPERTY, property, OFFLOAD_WRITER_DEFAULT);
+    if (strcmp(property, "yes") == 0) {
+        aproxy->support_offload_writer = true;
+        ALOGI("proxy-%s: The Offload Writer is enabled", __func__);
+    } else
+        aproxy->support_offload_writer = false;
+
+    // Capture Resampler
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(CAPTURE_RESAMPLER_PROPERTY, property, CAPTURE_RESAMPLER_DEFAULT);
+    if (strcmp(property, "low") == 0)
+        aproxy->capture_resampler = RESAMPLER_ENGINE_POLYPHASE_LOW;
+    else if (strcmp(property, "medium") == 0)
+        aproxy->capture_resampler = RESAMPLER_ENGINE_POLYPHASE_MEDIUM;
+    else if (strcmp(property, "high") == 0)
+        aproxy->capture_resampler = RESAMPLER_ENGINE_POLYPHASE_HIGH;
+    else
+        aproxy->capture_resampler = RESAMPLER_ENGINE_DEFAULT;
+    if (aproxy->capture_resampler != RESAMPLER_ENGINE_DEFAULT)
+        ALOGI("proxy-%s: The Polyphase Resampler(%s quality) is used for Capture", __func__, property);
+
+    // Presentation Position Model
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(POSITION_REFRESH_PROPERTY, property, POSITION_REFRESH_DEFAULT);
+    aproxy->position_refresh_ms = (unsigned int)atoi(property);
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(POSITION_DRIFT_PROPERTY, property, POSITION_DRIFT_DEFAULT);
+    aproxy->position_drift_ppm = (unsigned int)atoi(property);
+    if (aproxy->position_refresh_ms > 0)
+        ALOGI("proxy-%s: The Presentation Position Model is enabled(refresh %u ms, drift %u ppm)",
+              __func__, aproxy->position_refresh_ms, aproxy->position_drift_ppm);
+
+    // MMAP Position Service
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(MMAP_POSITION_STALE_PROPERTY, property, MMAP_POSITION_STALE_DEFAULT);
+    aproxy->mmap_position_stale_us = (unsigned int)atoi(property);
+    if (aproxy->mmap_position_stale_us > 0)
+        ALOGI("proxy-%s: The MMAP Position is cached for %u usec", __func__, aproxy->mmap_position_stale_us);
+
+    // Adaptive Period
+    memset(property, 0, PROPERTY_VALUE_MAX);
+    property_get(ADAPTIVE_PERIOD_PROPERTY, property, ADAPTIVE_PERIOD_DEFAULT);
+    if (strcmp(property, "yes") == 0) {
+        aproxy->support_adaptive_period = true;
+        ALOGI("proxy-%s: The Adaptive Period is enabled for Deep Buffer and Low Latency", __func__);
+    } else
+        aproxy->support_adaptive_period = false;
+
     return ;
 }
 
@@ -4449,128 +6931,186 @@ static void set_microphone_info(struct audio_microphone_characteristic_t *microp
         microphone->channel_mapping[array_cnt] = AUDIO_MICROPHONE_CHANNEL_MAPPING_UNUSED;
 }
 
-static void end_tag(void *data, const XML_Char *tag_name)
+static void end_tag(void *data __unused, const XML_Char *tag_name)
 {
     if (strcmp(tag_name, "microphone_characteristis") == 0)
         set_info = INFO_NONE;
 }
 
-static void start_tag(void *data, const XML_Char *tag_name, const XML_Char **attr)
+static void start_tag(void *data __unused, const XML_Char *tag_name, const XML_Char **attr)
 {
     struct audio_proxy *aproxy = getInstance();
-    const XML_Char *attr_name  = NULL;
-    const XML_Char *attr_value = NULL;
 
     if (strcmp(tag_name, "microphone_characteristics") == 0) {
         set_info = MICROPHONE_CHARACTERISTIC;
     } else if (strcmp(tag_name, "microphone") == 0) {
         if (set_info != MICROPHONE_CHARACTERISTIC)
             ALOGE("proxy-%s microphone tag should be supported with microphone_characteristics tag", __func__);
+        if (aproxy->num_mic >= AUDIO_MICROPHONE_MAX_COUNT) {
+            ALOGE("proxy-%s more than %d microphones", __func__, AUDIO_MICROPHONE_MAX_COUNT);
+            return ;
+        }
         set_microphone_info(&aproxy->mic_info[aproxy->num_mic++], attr);
     }
 }
 
-void proxy_set_board_info(void *proxy)
+static uint64_t board_info_hash(const void *data, size_t size)
 {
-    struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
-    XML_Parser parser = 0;
-    FILE *file = NULL;
-    char info_file_name[MAX_MIXER_NAME_LEN] = {0};
-    void *buf = NULL;
-    uint32_t buf_size = 1024;
-    int32_t bytes_read = 0;
-
-    strlcpy(info_file_name, BOARD_INFO_XML_PATH, MAX_MIXER_NAME_LEN);
-
-    file = fopen(info_file_name, "r");
-    if (file == NULL)
-        ALOGE("proxy-%s: open error: %s, file=%s", __func__, strerror(errno), info_file_name);
-    else
-        ALOGI("proxy-%s: Board info file name is %s", __func__, info_file_name);
-
-    parser = XML_ParserCreate(NULL);
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
 
-    XML_SetElementHandler(parser, start_tag, end_tag);
+    while (size--) {
+        hash ^= *p++;
+        hash *= 0x100000001b3ULL;
+    }
 
-    while (1) {
-        buf = XML_GetBuffer(parser, buf_size);
-        if (buf == NULL) {
-            ALOGE("proxy-%s fail to get buffer", __func__);
-            break;
-        }
+    return hash;
+}
 
-        bytes_read = fread(buf, 1, buf_size, file);
-        if (bytes_read < 0) {
-            ALOGE("proxy-%s fail to read from file", __func__);
-            break;
-        }
+static bool load_board_info_cache(struct audio_proxy *aproxy, const struct board_info_cache_header *key)
+{
+    const struct board_info_cache_header *header;
+    struct stat st;
+    void *buf;
+    size_t payload;
+    bool ret = false;
+    int fd;
 
-        XML_ParseBuffer(parser, bytes_read, bytes_read == 0);
+    fd = open(BOARD_INFO_CACHE_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
 
-        if (bytes_read == 0)
-            break;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*header)) {
+        close(fd);
+        return false;
     }
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+        return false;
 
-    XML_ParserFree(parser);
-    fclose(file);
+    header = (const struct board_info_cache_header *)buf;
+    payload = (size_t)header->num_mic * sizeof(struct audio_microphone_characteristic_t);
+    if (header->magic == key->magic && header->version == key->version &&
+        header->mic_info_size == key->mic_info_size && header->src_mtime_ns == key->src_mtime_ns &&
+        header->src_size == key->src_size && header->src_ino == key->src_ino &&
+        header->src_hash == key->src_hash && header->num_mic <= AUDIO_MICROPHONE_MAX_COUNT &&
+        (size_t)st.st_size == sizeof(*header) + payload &&
+        board_info_hash(header + 1, payload) == header->payload_hash) {
+        memcpy(aproxy->mic_info, header + 1, payload);
+        aproxy->num_mic = (int)header->num_mic;
+        ret = true;
+    } else
+        ALOGI("proxy-%s: %s is stale", __func__, BOARD_INFO_CACHE_PATH);
 
-    check_configurations(aproxy);
+    munmap(buf, st.st_size);
+    return ret;
 }
 
-bool proxy_is_initialized(void)
+/* Writes to temporary file and renames it, so that reader never sees partial cache */
+static void save_board_info_cache(struct audio_proxy *aproxy, struct board_info_cache_header *key)
 {
-    if (instance)
-        return true;
-    else
-        return false;
-}
+    const char *tmp_path = BOARD_INFO_CACHE_PATH ".tmp";
+    size_t payload;
+    bool ok = false;
+    int fd;
 
-void * proxy_init(void)
-{
-    struct audio_proxy *aproxy;
-#ifdef SUPPORT_STHAL_INTERFACE
-    char sound_trigger_hal_path[100] = {0, };
-#endif
-    /* Creates the structure for audio_proxy. */
-    aproxy = getInstance();
-    if (!aproxy) {
-        ALOGE("proxy-%s: failed to create for audio_proxy", __func__);
-        return NULL;
+    key->num_mic = (uint32_t)aproxy->num_mic;
+    payload = (size_t)key->num_mic * sizeof(struct audio_microphone_characteristic_t);
+    key->payload_hash = board_info_hash(aproxy->mic_info, payload);
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        ALOGW("proxy-%s: cannot create %s: %s", __func__, tmp_path, strerror(errno));
+        return ;
     }
 
-    aproxy->primary_out = NULL;
+    if (write(fd, key, sizeof(*key)) == (ssize_t)sizeof(*key) &&
+        (payload == 0 || write(fd, aproxy->mic_info, payload) == (ssize_t)payload) &&
+        fsync(fd) == 0)
+        ok = true;
+    close(fd);
 
-    // In case of Output Loopback Support, initializes Out Loopback Stream
-    aproxy->support_out_loopback = true;
-    aproxy->out_loopback = NULL;
-    aproxy->erap_in = NULL;
+    if (ok && rename(tmp_path, BOARD_INFO_CACHE_PATH) == 0) {
+        ALOGI("proxy-%s: saved %u microphones to %s", __func__, key->num_mic, BOARD_INFO_CACHE_PATH);
+    } else {
+        ALOGE("proxy-%s: failed to save %s: %s", __func__, BOARD_INFO_CACHE_PATH, strerror(errno));
+        unlink(tmp_path);
+    }
 
-    // In case of External Speaker AMP Support, initializes Reference & Playback Stream
-    aproxy->support_spkamp = true;
-    aproxy->spkamp_reference = NULL;
-    aproxy->spkamp_playback = NULL;
+    return ;
+}
 
-    // In case of External BT-SCO Support, initializes Playback Stream
-    aproxy->support_btsco = true;
-    aproxy->btsco_playback = NULL;
+void proxy_set_board_info(void *proxy)
+{
+    struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
+    struct board_info_cache_header key;
+    XML_Parser parser = 0;
+    struct stat st;
+    void *buf = MAP_FAILED;
+    int fd;
 
-    // Voice Call PCM Devices
-    aproxy->call_rx = NULL;
-    aproxy->call_tx = NULL;
+    aproxy->board_info_source = "none";
+    // Parser appends microphones, so that board info can be loaded again
+    aproxy->num_mic = 0;
 
-    // FM Radio PCM Devices
-    aproxy->fm_playback = NULL;
-    aproxy->fm_capture  = NULL;
+    // Whole file is mapped and parsed at once
+    fd = open(BOARD_INFO_XML_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("proxy-%s: open error: %s, file=%s", __func__, strerror(errno), BOARD_INFO_XML_PATH);
+    } else {
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+            ALOGE("proxy-%s: invalid file: %s, file=%s", __func__, strerror(errno), BOARD_INFO_XML_PATH);
+        else if ((buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+            ALOGE("proxy-%s: mmap error: %s, file=%s", __func__, strerror(errno), BOARD_INFO_XML_PATH);
+        else
+            ALOGI("proxy-%s: Board info file name is %s", __func__, BOARD_INFO_XML_PATH);
+        close(fd);
+    }
+
+    if (buf != MAP_FAILED) {
+        // Cache is keyed on source file identity and contents
+        memset(&key, 0, sizeof(key));
+        key.magic = BOARD_INFO_CACHE_MAGIC;
+        key.version = BOARD_INFO_CACHE_VERSION;
+        key.mic_info_size = sizeof(struct audio_microphone_characteristic_t);
+        key.src_mtime_ns = audio_utils_ns_from_timespec(&st.st_mtim);
+        key.src_size = st.st_size;
+        key.src_ino = st.st_ino;
+        key.src_hash = board_info_hash(buf, st.st_size);
+
+        if (load_board_info_cache(aproxy, &key)) {
+            aproxy->board_info_source = "cache";
+        } else {
+            parser = XML_ParserCreate(NULL);
+            if (parser) {
+                XML_SetElementHandler(parser, start_tag, end_tag);
+                if (XML_Parse(parser, (const char *)buf, (int)st.st_size, 1) == XML_STATUS_ERROR) {
+                    ALOGE("proxy-%s: parse error: %s at line %d", __func__,
+                          XML_ErrorString(XML_GetErrorCode(parser)), (int)XML_GetCurrentLineNumber(parser));
+                } else {
+                    aproxy->board_info_source = "xml";
+                    save_board_info_cache(aproxy, &key);
+                }
+                XML_ParserFree(parser);
+            } else
+                ALOGE("proxy-%s fail to create parser", __func__);
+        }
 
-    // Call State
-    aproxy->call_state = false;
+        munmap(buf, st.st_size);
+    }
 
-    /* Audio Mode */
-    aproxy->audio_mode = AUDIO_MODE_NORMAL;
+    check_configurations(aproxy);
+}
 
-    //ST HAL interface initialization
 #ifdef SUPPORT_STHAL_INTERFACE
-    aproxy->sthal_state = 0;
+static void *init_sthal_task(void *data)
+{
+    struct audio_proxy *aproxy = (struct audio_proxy *)data;
+    struct init_task *task = &aproxy->init_tasks[INIT_TASK_STHAL];
+    char sound_trigger_hal_path[100] = {0, };
+
+    task->start_ns = init_boottime_ns();
 
     snprintf(sound_trigger_hal_path, sizeof(sound_trigger_hal_path),
              SOUND_TRIGGER_HAL_LIBRARY_PATH, XSTR(TARGET_SOC_NAME));
@@ -4624,6 +7164,71 @@ void * proxy_init(void)
             aproxy->sound_trigger_voicecall_status = 0;
         }
     }
+
+    task->end_ns = init_boottime_ns();
+
+    return NULL;
+}
+#endif
+
+bool proxy_is_initialized(void)
+{
+    if (instance)
+        return true;
+    else
+        return false;
+}
+
+void * proxy_init(void)
+{
+    struct audio_proxy *aproxy;
+
+    /* Creates the structure for audio_proxy. */
+    aproxy = getInstance();
+    if (!aproxy) {
+        ALOGE("proxy-%s: failed to create for audio_proxy", __func__);
+        return NULL;
+    }
+
+    aproxy->init_start_ns = init_boottime_ns();
+
+    // Mixer is opened in background, proxy_init_route joins it
+    start_init_task(aproxy, INIT_TASK_MIXER, init_mixer_task);
+
+    aproxy->primary_out = NULL;
+
+    // In case of Output Loopback Support, initializes Out Loopback Stream
+    aproxy->support_out_loopback = true;
+    aproxy->out_loopback = NULL;
+    aproxy->erap_in = NULL;
+
+    // In case of External Speaker AMP Support, initializes Reference & Playback Stream
+    aproxy->support_spkamp = true;
+    aproxy->spkamp_reference = NULL;
+    aproxy->spkamp_playback = NULL;
+
+    // In case of External BT-SCO Support, initializes Playback Stream
+    aproxy->support_btsco = true;
+    aproxy->btsco_playback = NULL;
+
+    // Voice Call PCM Devices
+    aproxy->call_rx = NULL;
+    aproxy->call_tx = NULL;
+
+    // FM Radio PCM Devices
+    aproxy->fm_playback = NULL;
+    aproxy->fm_capture  = NULL;
+
+    // Call State
+    aproxy->call_state = false;
+
+    /* Audio Mode */
+    aproxy->audio_mode = AUDIO_MODE_NORMAL;
+
+    //ST HAL interface initialization
+#ifdef SUPPORT_STHAL_INTERFACE
+    aproxy->sthal_state = 0;
+    start_init_task(aproxy, INIT_TASK_STHAL, init_sthal_task);
 #endif
 
     /* offload effect */
@@ -4634,8 +7239,11 @@ void * proxy_init(void)
     // Force dual speaker
     aproxy->support_dualspk = true;
 
+    aproxy->init_tasks[INIT_TASK_BOARD_INFO].start_ns = init_boottime_ns();
     proxy_set_board_info(aproxy);
+    aproxy->init_tasks[INIT_TASK_BOARD_INFO].end_ns = init_boottime_ns();
 
+    aproxy->init_end_ns = init_boottime_ns();
     ALOGI("proxy-%s: opened & initialized Audio Proxy", __func__);
     return (void *)aproxy;
 }
@@ -4645,6 +7253,8 @@ void proxy_deinit(void *proxy)
     struct audio_proxy *aproxy = (struct audio_proxy *)proxy;
 
     if (aproxy) {
+        wait_init_tasks(aproxy);
+
         destroyInstance();
         ALOGI("proxy-%s: destroyed for audio_proxy", __func__);
     }
@@ -22,6 +22,9 @@
 #include <hardware/audio.h>
 #include <hardware/audio_alsaops.h>
 
+#include <semaphore.h>
+#include <stdatomic.h>
+
 #include <audio_utils/resampler.h>
 
 #include "alsa_device_profile.h"
@@ -38,6 +41,277 @@
 #include "audio_abox.h"
 #include "audio_streamconfig.h"
 #include "audio_board_info.h"
+#include "audio_resampler.h"
+
+#define CACHE_LINE_SIZE         64
+
+// Definition for Capture Ring Buffer
+#define CAPTURE_RING_PERIOD_COUNT   4
+#define CAPTURE_RING_WAIT_PERIODS   2  // Underrun if no period is filled within 2 periods
+
+/* Capture Ring Buffer between PCM Reader Thread and Record Thread */
+struct capture_ring
+{
+    // Period slots, spare slot for overrun and silence slot for underrun
+    void         *buf;
+    unsigned int  slot_bytes;
+    unsigned int  slot_count;
+
+    // head is only written by PCM Reader Thread, tail is only written by Record Thread
+    atomic_uint   head;
+    char          pad_head[CACHE_LINE_SIZE - sizeof(atomic_uint)];
+    atomic_uint   tail;
+    char          pad_tail[CACHE_LINE_SIZE - sizeof(atomic_uint)];
+    atomic_int    status;
+
+    sem_t         filled;
+    pthread_t     thread;
+    atomic_bool   running;
+    bool          started;
+    bool          holding;  // Record Thread is consuming a slot, not silence
+
+    atomic_uint   overruns;
+    atomic_uint   underruns;
+};
+
+// Definition for Stream Telemetry
+#define LATENCY_HIST_BUCKETS    20  // bucket n counts durations in [2^(n-1), 2^n) usec
+
+/* Per-Stream Telemetry, latency and xrun fields have a single writer, position fields several (see audio_proxy.c) */
+struct stream_telemetry
+{
+    atomic_uint   latency_hist[LATENCY_HIST_BUCKETS];
+    atomic_uint   latency_max_us;
+    atomic_uint   xruns;        // pcm_write/pcm_read failures
+
+    // Presentation Position Jitter
+    atomic_ullong last_pos_frames;
+    atomic_llong  last_pos_ns;     // 0 after reset, also cleared from stop/pause/close
+    atomic_uint   pos_samples;
+    atomic_uint   pos_jitter_max_us;
+    atomic_ullong pos_jitter_sum_us;
+};
+
+/* MMAP Position Service, keeps hwdep node and PCM status page while MMAP stream is opened */
+struct mmap_position_service
+{
+    bool          opened;
+    int           hw_fd;        // hwdep node for MMAP data fd
+    const volatile struct snd_pcm_mmap_status *status;  // read-only PCM status page, or NULL
+
+    // Cached Position, served again within staleness bound
+    bool          valid;
+    unsigned int  frames;
+    int64_t       time_ns;      // DMA timestamp of frames
+
+    // Statistics
+    atomic_uint   queries;
+    atomic_uint   cached;       // served from cache
+    atomic_uint   status_reads; // served from status page without ioctl
+    atomic_uint   hw_reads;     // served by hardware pointer sync ioctl
+    atomic_uint   errors;
+    atomic_uint   latency_hist[LATENCY_HIST_BUCKETS];   // latency of hardware pointer sync
+    atomic_uint   latency_max_us;
+};
+
+// Definition for Offload Writer
+#define OFFLOAD_WRITER_QUEUE_SIZE   (256 * 1024)
+#define OFFLOAD_WRITER_WAIT_MS      20  // Compress Device wait timeout to check requests
+#define OFFLOAD_WRITER_WAKEUP_RATIO 2   // Offload Thread wakes up when 1/2 of queue is free
+
+/* Queue between Offload Thread of AudioHAL and Offload Writer Thread */
+struct offload_writer
+{
+    char           *buf;
+    size_t          size;
+    uint64_t        head;           // total bytes queued by Offload Thread
+    uint64_t        tail;           // total bytes written to Compress Device
+
+    pthread_mutex_t lock;
+    pthread_cond_t  data_cond;      // Offload Writer Thread waits for data or requests
+    pthread_cond_t  space_cond;     // Offload Thread waits for free space or flush
+    pthread_t       thread;
+    bool            running;
+    bool            flush;          // write partial fragment too, until queue is empty
+    bool            busy;           // Offload Writer Thread is accessing Compress Device
+    bool            discarding;     // Offload Thread waits for busy to be cleared
+    bool            device_full;
+    bool            idle;           // Compress Device is not running, don't wait for it when full
+    int             status;         // error from Compress Device
+
+    // Statistics, also counted without Offload Writer Thread
+    int64_t         start_ns;
+    unsigned int    writer_wakeups;
+    unsigned int    hal_wakeups;
+    unsigned int    writes;
+    uint64_t        bytes_written;
+};
+
+// Definition for Parallel Initialization
+typedef enum {
+    INIT_TASK_STHAL     = 0,    // loads SoundTrigger HAL library
+    INIT_TASK_MIXER,            // opens Mixer and builds Mixer Control Cache
+    INIT_TASK_BOARD_INFO,       // parses Board Info XML and checks configurations in caller
+    INIT_TASK_CNT,
+} init_task_type;
+
+struct init_task
+{
+    pthread_t thread;
+    bool      pending;      // thread is created but not joined yet, under init_lock
+    int64_t   start_ns;     // CLOCK_BOOTTIME
+    int64_t   end_ns;
+};
+
+// Definition for Adaptive Period Policy
+#define PERIOD_POLICY_MIN_WRITES        500 // session has to be long enough to judge cadence
+#define PERIOD_POLICY_LOW_MIN_COUNT     2
+#define PERIOD_POLICY_DEEP_MAX_SCALE    4   // Deep Buffer period grows up to 4 times while screen is off
+
+/* Period Size/Count decided at standby, and applied when PCM Device is opened again */
+struct period_policy
+{
+    audio_stream_type type;         // policy is initialized for this stream type
+    unsigned int base_size;         // from predefined PCM configuration
+    unsigned int base_count;
+    unsigned int size;              // applied at next open
+    unsigned int count;
+    unsigned int floor_count;       // Low Latency doesn't go below count which got xrun
+
+    // Observed from open to standby
+    unsigned int writes;
+    int64_t      last_write_ns;
+    int64_t      last_return_ns;
+    unsigned int max_gap_us;
+    unsigned int xruns_at_open;
+    unsigned int underruns;         // writes which came after the whole buffer drained
+    unsigned int buffer_us;
+
+    // Decisions
+    unsigned int shrinks;
+    unsigned int grows;
+    unsigned int restores;
+    char         last_decision[80];
+};
+
+// Definition for Skip Clock
+#define SKIP_CLOCK_RESYNC_MS    100 // re-anchors virtual clock if writer was late more than this
+
+/*
+ * Virtual Clock to pace writes which don't reach PCM Device, either skipped while AUX Digital
+ * owns the playback path or failed by xrun
+ */
+struct skip_clock
+{
+    bool          skipping;     // stream's view of routing at last write, AUX Digital clock only
+    int64_t       base_ns;      // CLOCK_MONOTONIC time of virtual clock anchor
+    uint64_t      base_frames;  // frames skipped since anchor
+
+    // Statistics
+    uint64_t      frames;       // total skipped frames
+    unsigned int  entries;      // AUX Digital periods, or failed writes
+    unsigned int  resyncs;
+    unsigned int  sleeps;
+    unsigned int  late;         // deadline was already passed, returned without sleep
+};
+
+// Definition for Presentation Position Model
+#define POSITION_MODEL_SAMPLES  8
+
+/* Linear Model of Presentation Position fitted from hardware timestamps */
+struct position_model
+{
+    int64_t      sample_ns[POSITION_MODEL_SAMPLES];
+    uint64_t     sample_frames[POSITION_MODEL_SAMPLES];
+    unsigned int count;
+    unsigned int next;
+
+    // frames = base_frames + rate * (time - base_ns)
+    bool         valid;
+    int64_t      base_ns;
+    double       base_frames;
+    double       rate;          // frames per nsec
+
+    int64_t      refresh_ns;    // time of last hardware timestamp
+    uint64_t     last_frames;   // last reported frames to keep them monotonic
+
+    // Accuracy against hardware timestamp
+    unsigned int queries;
+    unsigned int refreshes;
+    unsigned int resets;
+    unsigned int errors;        // number of measured errors
+    unsigned int error_max_us;
+    uint64_t     error_sum_us;
+};
+
+// Definition for Calliope Dump
+#define CALLIOPE_DUMP_NAME_LEN  64
+
+/* Retention Index of Calliope Dump files per debug node, oldest first */
+struct calliope_dump_index
+{
+    bool         loaded;
+    unsigned int count;
+    char         names[ABOX_DUMP_LIMIT + 1][CALLIOPE_DUMP_NAME_LEN];
+};
+
+/* Calliope Dump Statistics */
+struct calliope_dump_stats
+{
+    atomic_bool   busy;         // Calliope Dump Worker is running
+    atomic_uint   snapshots;
+    atomic_uint   skipped;      // requested while previous snapshot was in progress
+    atomic_ullong bytes_spliced;
+    atomic_ullong bytes_copied;
+    atomic_uint   last_msec;
+};
+
+/* Mixer Control Cache Entry */
+struct mixer_ctl_cache_entry
+{
+    uint32_t hash;
+    uint32_t index;     // control index + 1, 0 means empty
+};
+
+/* Precompiled Route Names */
+struct route_name
+{
+    const char *path;
+    const char *gain;
+};
+
+/*
+ * Route Transaction, owned by one routing call on its stack
+ *
+ * Path resets and applies are only recorded here, and written to mixer by route_trans_commit().
+ */
+#define ROUTE_TRANS_MAX_OPS 8
+
+struct route_trans_op
+{
+    char name[MAX_GAIN_PATH_NAME_LEN];
+    bool apply;
+};
+
+struct route_trans
+{
+    unsigned int count;
+    struct route_trans_op ops[ROUTE_TRANS_MAX_OPS];
+};
+
+/*
+ * Route State seen by Stream Threads without lock
+ *
+ * active_* fields of audio_proxy belong to routing control, and this copy is published as one
+ * 64-bit word after each route change, so readers always get usage/device/modifier of same route.
+ */
+struct route_state
+{
+    audio_usage   ausage;
+    device_type   device;
+    modifier_type modifier;
+    unsigned int  generation;   // increased at each publish, lower 16 bits
+};
 
 /* Data Structure for Audio Proxy */
 struct audio_proxy_stream
@@ -60,6 +334,9 @@ struct audio_proxy_stream
     int ready_new_metadata;
     struct compr_gapless_mdata offload_metadata;
 
+    // Optional Offload Writer
+    struct offload_writer writer;
+
     // Common
     unsigned int            requested_sample_rate;
     audio_channel_mask_t    requested_channel_mask;
@@ -82,9 +359,38 @@ struct audio_proxy_stream
     void *   proc_buf_out;
     int      proc_buf_size;
 
+    unsigned int data_path_allocs;  // buffer allocations in Record Thread, should be 0
+
+    int16_t* period_buf;    // Period which is being consumed now
+
+    uint64_t bytes_read_direct; // read into caller's buffer without copy
+    uint64_t bytes_read_copied; // copied from actual_read_buf or capture ring
+
+    // Optional Capture Ring Buffer
+    struct capture_ring ring;
+
+    // Write/Read Latency, XRun and Position Jitter
+    struct stream_telemetry telemetry;
+
+    // Presentation Position Model for PCM Playback
+    struct position_model pos_model;
+
+    // Position Service for MMAP Playback/Capture
+    struct mmap_position_service mmap_pos;
+
+    // Skipped Playback while AUX Digital is connected
+    struct skip_clock skip;
+
+    // Failed PCM writes, paced as played to keep writer in real time during xrun recovery
+    struct skip_clock xrun;
+
+    // Adaptive Period Size/Count for Deep Buffer and Low Latency Playback
+    struct period_policy period_policy;
+
     // Resampler
     struct resampler_itfe *             resampler;
     struct resampler_buffer_provider    buf_provider;
+    resampler_engine                    resampler_engine;   // to release resampler properly
 
 
 #ifdef SUPPORT_STHAL_INTERFACE
@@ -106,14 +412,40 @@ struct audio_proxy
     struct audio_route *aroute;
     char *xml_path;
 
+    // Precompiled Route Table indexed by usage, device and dual speaker
+    struct route_name *route_table;
+    char *route_pool;
+
+    // Mixer Control Cache
+    struct mixer_ctl_cache_entry *ctl_cache;
+    unsigned int ctl_cache_size;
+    unsigned int ctl_cache_count;
+    atomic_uint  ctl_cache_hits;
+    atomic_uint  ctl_cache_misses;
+
     // Mixer Update Thread
     pthread_rwlock_t mixer_update_lock;
     pthread_t        mixer_update_thread;
+    int              mixer_update_stop_fd;  // eventfd to stop Mixer Updater Thread
+    bool             mixer_update_running;
+
+    // Serializes route transaction commits, and protects Route Statistics
+    pthread_mutex_t route_lock;
+
+    // Route Statistics
+    unsigned int route_changes;
+    unsigned int route_ctls_written;        // mixer controls written by all route changes
+    unsigned int route_ctls_last;           // mixer controls written by last route change
 
     audio_usage   active_playback_ausage;
     device_type   active_playback_device;
     modifier_type active_playback_modifier;
 
+    // Route Snapshots for Stream Threads, published by proxy_set_route (see route_snapshot_pack)
+    atomic_ullong playback_route_snapshot;
+    atomic_ullong capture_route_snapshot;
+    unsigned int  route_generation;
+
     audio_usage   active_capture_ausage;
     device_type   active_capture_device;
     modifier_type active_capture_modifier;
@@ -129,6 +461,7 @@ struct audio_proxy
     /* BuiltIn MIC Characteristics Map */
     int num_mic;
     struct audio_microphone_characteristic_t mic_info[AUDIO_MICROPHONE_MAX_COUNT];
+    const char *board_info_source;  // where mic_info was loaded from
 
     // PCM Devices for Audio Path(Loopback / ERAP)
     bool support_out_loopback;
@@ -158,6 +491,26 @@ struct audio_proxy
     /* USB Configuration */
     bool usb_by_primary;
 
+    /* Capture Ring Buffer Configuration */
+    bool support_capture_ring;
+
+    /* Offload Writer Configuration */
+    bool support_offload_writer;
+
+    /* Capture Resampler Configuration */
+    resampler_engine capture_resampler;
+
+    /* Presentation Position Model Configuration */
+    unsigned int position_refresh_ms;   // 0 means every query reads hardware timestamp
+    unsigned int position_drift_ppm;    // allowed drift of fitted rate from nominal rate
+
+    /* MMAP Position Service Configuration */
+    unsigned int mmap_position_stale_us;    // 0 means every query reads hardware pointer
+
+    /* Adaptive Period Configuration */
+    bool support_adaptive_period;
+    atomic_bool screen_off;     // from screen_state parameter
+
     /* PCM Devices for Voice Call */
     struct pcm *call_rx;    // CP to Output Devices
     struct pcm *call_tx;    // Input Devices to CP
@@ -190,6 +543,16 @@ struct audio_proxy
 
     bool support_dualspk;  //Dual Speaker
     bool spk_ampL_powerOn; //Dual Speaker
+
+    // Parallel Initialization, all timestamps are CLOCK_BOOTTIME
+    struct init_task init_tasks[INIT_TASK_CNT];
+    pthread_mutex_t  init_lock;         // serializes joins from different HAL threads
+    atomic_bool      init_pending;      // some init tasks are not joined yet
+    int64_t          init_start_ns;
+    int64_t          init_end_ns;       // proxy_init returned
+    int64_t          init_wait_ns;      // time callers were blocked to join init tasks
+    int64_t          route_ready_ns;    // proxy_init_route completed
+    int64_t          first_stream_ns;   // first stream was created
 };
 
 
@@ -0,0 +1,576 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "audio_hw_resampler"
+//#define LOG_NDEBUG 0
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <log/log.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "audio_resampler.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define POLYPHASE_TABLE_CNT     8       // Shared coefficient tables
+#define POLYPHASE_TAP_ALIGN     8       // SIMD kernels process 8 taps at once
+#define POLYPHASE_MIN_COEF_SHIFT    15  // Q15 coefficients, when larger ones don't fit
+#define POLYPHASE_MAX_COEF_SHIFT    18
+
+/* Filter Design Parameters per Quality */
+static const struct {
+    unsigned int taps;      // taps per phase, when not decimating
+    double       beta;      // Kaiser window parameter
+} polyphase_quality_table[RESAMPLER_ENGINE_CNT] = {
+    [RESAMPLER_ENGINE_POLYPHASE_LOW]    = { 16, 5.0 },
+    [RESAMPLER_ENGINE_POLYPHASE_MEDIUM] = { 32, 7.0 },
+    [RESAMPLER_ENGINE_POLYPHASE_HIGH]   = { 64, 9.0 },
+};
+
+/* Coefficient Table, reversed per phase to be multiplied with oldest-first history */
+struct polyphase_table
+{
+    uint32_t          up;       // interpolation factor L = number of phases
+    uint32_t          down;     // decimation factor M
+    resampler_engine  engine;
+    unsigned int      taps;
+    unsigned int      shift;    // fraction bits of coefficients
+    unsigned int      refcount;
+    int16_t          *coefs;    // up * taps
+};
+
+struct polyphase_resampler
+{
+    struct resampler_itfe itfe;     // must be the first member
+
+    struct resampler_buffer_provider *provider;
+    struct polyphase_table *table;
+
+    uint32_t     in_sample_rate;
+    uint32_t     channels;
+
+    // Planar history per channel, each written twice to read taps contiguously
+    int16_t     *history;
+    unsigned int write;
+    unsigned int phase;
+    unsigned int needed;            // input frames needed before next output
+};
+
+static struct polyphase_table polyphase_tables[POLYPHASE_TABLE_CNT];
+static pthread_mutex_t polyphase_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * Dot product of coefficients and samples, taps is multiple of POLYPHASE_TAP_ALIGN.
+ * Partial sums are split in 4 lanes of 32 bits before being added as 64 bits, NEON lane
+ * takes taps i % 4 and SSE2 lane takes taps (i % 8) / 2. Filter design keeps them in range.
+ */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline int64_t polyphase_dot(const int16_t *coef, const int16_t *x, unsigned int taps)
+{
+    int32x4_t acc = vdupq_n_s32(0);
+    int64x2_t sum;
+    unsigned int i;
+
+    for (i = 0; i < taps; i += 8) {
+        int16x8_t c = vld1q_s16(coef + i);
+        int16x8_t v = vld1q_s16(x + i);
+        acc = vmlal_s16(acc, vget_low_s16(c), vget_low_s16(v));
+        acc = vmlal_s16(acc, vget_high_s16(c), vget_high_s16(v));
+    }
+
+    sum = vpaddlq_s32(acc);
+    return vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+}
+
+const char *polyphase_kernel_name(void)
+{
+    return "neon";
+}
+#elif defined(__SSE2__)
+static inline int64_t polyphase_dot(const int16_t *coef, const int16_t *x, unsigned int taps)
+{
+    __m128i acc = _mm_setzero_si128();
+    int32_t lanes[4];
+    unsigned int i;
+
+    for (i = 0; i < taps; i += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(coef + i));
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(c, v));
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+const char *polyphase_kernel_name(void)
+{
+    return "sse2";
+}
+#else
+static inline int64_t polyphase_dot(const int16_t *coef, const int16_t *x, unsigned int taps)
+{
+    int64_t sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < taps; i++)
+        sum += (int32_t)coef[i] * x[i];
+
+    return sum;
+}
+
+const char *polyphase_kernel_name(void)
+{
+    return "c";
+}
+#endif
+
+
+/*
+ * Filter Design
+ */
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0, half = x / 2.0;
+    int k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (half / k) * (half / k);
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+static unsigned int polyphase_taps(uint32_t up, uint32_t down, resampler_engine engine)
+{
+    unsigned int taps = polyphase_quality_table[engine].taps;
+
+    // Longer filter keeps transition band relative to output rate when decimating
+    if (down > up)
+        taps = (unsigned int)(((uint64_t)taps * down + up - 1) / up);
+
+    taps = (taps + POLYPHASE_TAP_ALIGN - 1) & ~(POLYPHASE_TAP_ALIGN - 1);
+    return (taps > POLYPHASE_MAX_TAPS) ? POLYPHASE_MAX_TAPS : taps;
+}
+
+/* Whether 32 bit lanes of SIMD kernels can hold any partial sum of given phase */
+static bool polyphase_lanes_fit(const int16_t *coef, unsigned int taps)
+{
+    uint32_t neon[4] = { 0 }, sse2[4] = { 0 };
+    unsigned int i, lane;
+
+    for (i = 0; i < taps; i++) {
+        uint32_t weight = (uint32_t)abs(coef[i]);
+        neon[i % 4] += weight;
+        sse2[(i % 8) / 2] += weight;
+    }
+
+    // Samples are at most 2^15 in magnitude
+    for (lane = 0; lane < 4; lane++) {
+        if (neon[lane] > (uint32_t)INT32_MAX >> 15 || sse2[lane] > (uint32_t)INT32_MAX >> 15)
+            return false;
+    }
+
+    return true;
+}
+
+/* Quantizes coefficients of all phases, returns false if any of them or any lane overflows */
+static bool polyphase_quantize(struct polyphase_table *table, const double *proto, unsigned int shift)
+{
+    unsigned int up = table->up, taps = table->taps;
+    unsigned int p, k;
+    bool fit = true;
+
+    // Phase p uses proto[k * up + p], newest sample is multiplied with k = 0
+    for (p = 0; p < up; p++) {
+        int16_t *coef = table->coefs + p * taps;
+        double sum = 0;
+
+        for (k = 0; k < taps; k++)
+            sum += proto[k * up + p];
+
+        for (k = 0; k < taps; k++) {
+            double c = (sum != 0) ? proto[k * up + p] / sum : 0;
+            long q = lround(c * (1 << shift));
+            if (q > INT16_MAX) {
+                q = INT16_MAX;
+                fit = false;
+            } else if (q < INT16_MIN) {
+                q = INT16_MIN;
+                fit = false;
+            }
+            coef[taps - 1 - k] = (int16_t)q;
+        }
+
+        if (!polyphase_lanes_fit(coef, taps))
+            fit = false;
+    }
+
+    table->shift = shift;
+    return fit;
+}
+
+/*
+ * Kaiser windowed sinc low pass filter at up * input rate, cut off at Nyquist of lower rate
+ * minus half of transition band. Each phase is normalized to unity DC gain.
+ *
+ * Coefficients get as many fraction bits as they can hold. Decimating filters have small
+ * coefficients, whose quantization would limit stopband attenuation in Q15.
+ */
+static int polyphase_design(struct polyphase_table *table)
+{
+    unsigned int up = table->up, taps = table->taps;
+    unsigned int length = up * taps;
+    double beta = polyphase_quality_table[table->engine].beta;
+    double attenuation = beta / 0.1102 + 8.7;
+    double base_taps = polyphase_quality_table[table->engine].taps;
+    double transition = (attenuation - 7.95) / (14.36 * base_taps);
+    double cutoff = (0.5 - transition / 2) / ((up > table->down) ? up : table->down);
+    double center = (length - 1) / 2.0, i0_beta = bessel_i0(beta);
+    double *proto;
+    unsigned int shift, k;
+
+    proto = (double *)malloc(length * sizeof(double));
+    if (proto == NULL)
+        return -ENOMEM;
+
+    table->coefs = (int16_t *)calloc(length, sizeof(int16_t));
+    if (table->coefs == NULL) {
+        free(proto);
+        return -ENOMEM;
+    }
+
+    for (k = 0; k < length; k++) {
+        double t = k - center;
+        double r = t / (center + 0.5);
+        double sinc = (t == 0) ? 1.0 : sin(2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+        double window = bessel_i0(beta * sqrt(fmax(0.0, 1.0 - r * r))) / i0_beta;
+        proto[k] = 2 * cutoff * sinc * window;
+    }
+
+    for (shift = POLYPHASE_MAX_COEF_SHIFT; shift > POLYPHASE_MIN_COEF_SHIFT; shift--) {
+        if (polyphase_quantize(table, proto, shift))
+            break;
+    }
+    if (shift == POLYPHASE_MIN_COEF_SHIFT)
+        polyphase_quantize(table, proto, shift);
+
+    free(proto);
+    return 0;
+}
+
+static struct polyphase_table *get_polyphase_table(uint32_t up, uint32_t down, resampler_engine engine)
+{
+    struct polyphase_table *table = NULL;
+    int i;
+
+    pthread_mutex_lock(&polyphase_table_lock);
+
+    for (i = 0; i < POLYPHASE_TABLE_CNT; i++) {
+        struct polyphase_table *entry = &polyphase_tables[i];
+        if (entry->refcount > 0 && entry->up == up && entry->down == down && entry->engine == engine) {
+            table = entry;
+            break;
+        }
+    }
+
+    if (table == NULL) {
+        for (i = 0; i < POLYPHASE_TABLE_CNT; i++) {
+            if (polyphase_tables[i].refcount == 0) {
+                table = &polyphase_tables[i];
+                break;
+            }
+        }
+
+        if (table != NULL) {
+            free(table->coefs);
+            table->coefs = NULL;
+            table->up = up;
+            table->down = down;
+            table->engine = engine;
+            table->taps = polyphase_taps(up, down, engine);
+            if (polyphase_design(table) != 0) {
+                ALOGE("resampler-%s: failed to design %u/%u filter", __func__, up, down);
+                table = NULL;
+            } else
+                ALOGI("resampler-%s: designed %u/%u filter with %u phases x %u taps in Q%u",
+                      __func__, up, down, up, table->taps, table->shift);
+        } else
+            ALOGE("resampler-%s: no free coefficient table", __func__);
+    }
+
+    if (table != NULL)
+        table->refcount++;
+
+    pthread_mutex_unlock(&polyphase_table_lock);
+
+    return table;
+}
+
+static void put_polyphase_table(struct polyphase_table *table)
+{
+    // Coefficients are kept to be reused for the same ratio, until the entry is recycled
+    pthread_mutex_lock(&polyphase_table_lock);
+    table->refcount--;
+    pthread_mutex_unlock(&polyphase_table_lock);
+
+    return ;
+}
+
+
+/*
+ * Resampling
+ */
+static inline void polyphase_push(struct polyphase_resampler *rsmp, const int16_t *frame)
+{
+    unsigned int taps = rsmp->table->taps;
+    unsigned int ch;
+
+    for (ch = 0; ch < rsmp->channels; ch++) {
+        int16_t *history = rsmp->history + ch * taps * 2;
+        history[rsmp->write] = frame[ch];
+        history[rsmp->write + taps] = frame[ch];
+    }
+
+    if (++rsmp->write == taps)
+        rsmp->write = 0;
+    return ;
+}
+
+static inline void polyphase_output(struct polyphase_resampler *rsmp, int16_t *frame)
+{
+    unsigned int taps = rsmp->table->taps, shift = rsmp->table->shift;
+    const int16_t *coef = rsmp->table->coefs + rsmp->phase * taps;
+    unsigned int ch;
+
+    for (ch = 0; ch < rsmp->channels; ch++) {
+        const int16_t *history = rsmp->history + ch * taps * 2 + rsmp->write;
+        int64_t sum = polyphase_dot(coef, history, taps) + (1 << (shift - 1));
+
+        sum >>= shift;
+        frame[ch] = (sum > INT16_MAX) ? INT16_MAX : (sum < INT16_MIN) ? INT16_MIN : (int16_t)sum;
+    }
+
+    rsmp->phase += rsmp->table->down;
+    rsmp->needed = rsmp->phase / rsmp->table->up;
+    rsmp->phase -= rsmp->needed * rsmp->table->up;
+    return ;
+}
+
+// Input frames to be consumed for next out_frames output frames
+static size_t polyphase_input_frames(struct polyphase_resampler *rsmp, size_t out_frames)
+{
+    if (out_frames == 0)
+        return 0;
+
+    return rsmp->needed + (size_t)(((uint64_t)(out_frames - 1) * rsmp->table->down + rsmp->phase) /
+                                   rsmp->table->up);
+}
+
+static void polyphase_reset(struct resampler_itfe *resampler)
+{
+    struct polyphase_resampler *rsmp = (struct polyphase_resampler *)resampler;
+
+    memset(rsmp->history, 0, rsmp->channels * rsmp->table->taps * 2 * sizeof(int16_t));
+    rsmp->write = 0;
+    rsmp->phase = 0;
+    rsmp->needed = 1;
+    return ;
+}
+
+static int polyphase_resample_from_provider(struct resampler_itfe *resampler,
+                                            int16_t *out, size_t *outFrameCount)
+{
+    struct polyphase_resampler *rsmp = (struct polyphase_resampler *)resampler;
+    size_t requested, produced = 0;
+
+    if (rsmp == NULL || out == NULL || outFrameCount == NULL)
+        return -EINVAL;
+    if (rsmp->provider == NULL) {
+        *outFrameCount = 0;
+        return -ENOSYS;
+    }
+
+    requested = *outFrameCount;
+    while (produced < requested) {
+        struct resampler_buffer buf;
+        size_t consumed = 0;
+
+        buf.raw = NULL;
+        buf.frame_count = polyphase_input_frames(rsmp, requested - produced);
+        rsmp->provider->get_next_buffer(rsmp->provider, &buf);
+        if (buf.raw == NULL || buf.frame_count == 0)
+            break;
+
+        while (produced < requested) {
+            while (rsmp->needed > 0 && consumed < buf.frame_count) {
+                polyphase_push(rsmp, buf.i16 + consumed * rsmp->channels);
+                consumed++;
+                rsmp->needed--;
+            }
+            if (rsmp->needed > 0)
+                break;
+
+            polyphase_output(rsmp, out + produced * rsmp->channels);
+            produced++;
+        }
+
+        buf.frame_count = consumed;
+        rsmp->provider->release_buffer(rsmp->provider, &buf);
+    }
+
+    *outFrameCount = produced;
+    return 0;
+}
+
+static int polyphase_resample_from_input(struct resampler_itfe *resampler, int16_t *in,
+                                         size_t *inFrameCount, int16_t *out, size_t *outFrameCount)
+{
+    struct polyphase_resampler *rsmp = (struct polyphase_resampler *)resampler;
+    size_t consumed = 0, produced = 0;
+
+    if (rsmp == NULL || in == NULL || inFrameCount == NULL || out == NULL || outFrameCount == NULL)
+        return -EINVAL;
+    if (rsmp->provider != NULL) {
+        *inFrameCount = 0;
+        *outFrameCount = 0;
+        return -ENOSYS;
+    }
+
+    while (produced < *outFrameCount) {
+        while (rsmp->needed > 0 && consumed < *inFrameCount) {
+            polyphase_push(rsmp, in + consumed * rsmp->channels);
+            consumed++;
+            rsmp->needed--;
+        }
+        if (rsmp->needed > 0)
+            break;
+
+        polyphase_output(rsmp, out + produced * rsmp->channels);
+        produced++;
+    }
+
+    *inFrameCount = consumed;
+    *outFrameCount = produced;
+    return 0;
+}
+
+static int32_t polyphase_delay_ns(struct resampler_itfe *resampler)
+{
+    struct polyphase_resampler *rsmp = (struct polyphase_resampler *)resampler;
+
+    // Half of filter length in input frames
+    return (int32_t)((int64_t)rsmp->table->taps * 1000000000 / (2 * rsmp->in_sample_rate));
+}
+
+int create_polyphase_resampler(uint32_t in_sample_rate, uint32_t out_sample_rate, uint32_t channels,
+                               resampler_engine engine, struct resampler_buffer_provider *provider,
+                               struct resampler_itfe **resampler)
+{
+    struct polyphase_resampler *rsmp;
+    uint32_t divisor, up, down;
+
+    if (resampler == NULL)
+        return -EINVAL;
+    *resampler = NULL;
+
+    if (in_sample_rate == 0 || out_sample_rate == 0 || channels == 0 ||
+        channels > POLYPHASE_MAX_CHANNELS || engine <= RESAMPLER_ENGINE_DEFAULT ||
+        engine >= RESAMPLER_ENGINE_CNT)
+        return -EINVAL;
+
+    divisor = gcd(in_sample_rate, out_sample_rate);
+    up = out_sample_rate / divisor;
+    down = in_sample_rate / divisor;
+    if (up > POLYPHASE_MAX_PHASES) {
+        ALOGW("resampler-%s: %u Hz to %u Hz needs too many phases(%u)",
+              __func__, in_sample_rate, out_sample_rate, up);
+        return -EINVAL;
+    }
+
+    rsmp = (struct polyphase_resampler *)calloc(1, sizeof(struct polyphase_resampler));
+    if (rsmp == NULL)
+        return -ENOMEM;
+
+    rsmp->table = get_polyphase_table(up, down, engine);
+    if (rsmp->table == NULL) {
+        free(rsmp);
+        return -ENOMEM;
+    }
+
+    rsmp->history = (int16_t *)malloc(channels * rsmp->table->taps * 2 * sizeof(int16_t));
+    if (rsmp->history == NULL) {
+        put_polyphase_table(rsmp->table);
+        free(rsmp);
+        return -ENOMEM;
+    }
+
+    rsmp->itfe.reset = polyphase_reset;
+    rsmp->itfe.resample_from_provider = polyphase_resample_from_provider;
+    rsmp->itfe.resample_from_input = polyphase_resample_from_input;
+    rsmp->itfe.delay_ns = polyphase_delay_ns;
+
+    rsmp->provider = provider;
+    rsmp->in_sample_rate = in_sample_rate;
+    rsmp->channels = channels;
+    polyphase_reset(&rsmp->itfe);
+
+    *resampler = &rsmp->itfe;
+    return 0;
+}
+
+void release_polyphase_resampler(struct resampler_itfe *resampler)
+{
+    struct polyphase_resampler *rsmp = (struct polyphase_resampler *)resampler;
+
+    if (rsmp == NULL)
+        return ;
+
+    put_polyphase_table(rsmp->table);
+    free(rsmp->history);
+    free(rsmp);
+
+    return ;
+}
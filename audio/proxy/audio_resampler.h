@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EXYNOS_AUDIOPROXY_RESAMPLER_H__
+#define __EXYNOS_AUDIOPROXY_RESAMPLER_H__
+
+#include <audio_utils/resampler.h>
+
+
+/* Resampler Engines for Capture Stream */
+typedef enum {
+    RESAMPLER_ENGINE_DEFAULT          = 0,   // audio_utils resampler
+    RESAMPLER_ENGINE_POLYPHASE_LOW,          // 16 taps per phase
+    RESAMPLER_ENGINE_POLYPHASE_MEDIUM,       // 32 taps per phase
+    RESAMPLER_ENGINE_POLYPHASE_HIGH,         // 64 taps per phase
+    RESAMPLER_ENGINE_CNT,
+} resampler_engine;
+
+// Taps per phase are scaled up by decimation ratio to keep transition band in output rate
+#define POLYPHASE_MAX_PHASES    1024
+#define POLYPHASE_MAX_TAPS      512
+#define POLYPHASE_MAX_CHANNELS  8
+
+/*
+ * Polyphase FIR Resampler
+ *
+ * Implements resampler_itfe of audio_utils, so it can be used with the same buffer provider.
+ * Coefficient tables are computed once per rate ratio and quality, and shared between streams.
+ * Returns -EINVAL if rate ratio cannot be reduced to POLYPHASE_MAX_PHASES phases.
+ */
+int create_polyphase_resampler(uint32_t in_sample_rate, uint32_t out_sample_rate, uint32_t channels,
+                               resampler_engine engine, struct resampler_buffer_provider *provider,
+                               struct resampler_itfe **resampler);
+void release_polyphase_resampler(struct resampler_itfe *resampler);
+
+const char *polyphase_kernel_name(void);
+
+#endif  // __EXYNOS_AUDIOPROXY_RESAMPLER_H__
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+/*
+ * Heap of the whole test binary goes through these, so allocations of Audio Proxy and fake
+ * backend in any thread are counted while counting is on. Host builds use glibc, which keeps
+ * its own entry points under __libc_ names.
+ */
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace {
+
+std::atomic<bool> gCounting{false};
+std::atomic<unsigned int> gAllocs{0};
+std::atomic<unsigned int> gFrees{0};
+
+}  // namespace
+
+extern "C" void *malloc(size_t size) {
+    if (gCounting.load(std::memory_order_relaxed))
+        gAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    if (gCounting.load(std::memory_order_relaxed))
+        gAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    if (gCounting.load(std::memory_order_relaxed))
+        gAllocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void *ptr) {
+    if (ptr && gCounting.load(std::memory_order_relaxed))
+        gFrees.fetch_add(1, std::memory_order_relaxed);
+    __libc_free(ptr);
+}
+
+namespace {
+
+constexpr int kPeriods = 100;                // 2 sec of 20 msec periods
+
+struct StreamConfig {
+    unsigned int rate;
+    audio_channel_mask_t mask;
+    unsigned int channels;
+    bool ring;
+};
+
+/*
+ * Capture Streams on fake PCM Device, which skips time instead of blocking. Stream buffers
+ * are allocated at open, so reads from the first one after start touch no heap.
+ */
+class CaptureAllocationTest : public ::testing::TestWithParam<StreamConfig> {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        test_set_capture_ring(GetParam().ring);
+
+        config.sample_rate = GetParam().rate;
+        config.channel_mask = GetParam().mask;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_capture_stream(test_proxy(), ASTREAM_CAPTURE_PRIMARY,
+                                              AUSAGE_RECORDING, &config, NULL);
+        ASSERT_NE(nullptr, mStream);
+        ASSERT_EQ(0, proxy_open_capture_stream(mStream, 0, NULL));
+        ASSERT_EQ(0, proxy_start_capture_stream(mStream));
+        mBuffer.resize(GetParam().rate / 50 * GetParam().channels);
+    }
+
+    void TearDown() override {
+        gCounting = false;
+        if (mStream) {
+            proxy_stop_capture_stream(mStream);
+            proxy_close_capture_stream(mStream);
+            proxy_destroy_capture_stream(mStream);
+        }
+        test_set_capture_ring(false);
+    }
+
+    void read() {
+        const int bytes = static_cast<int>(mBuffer.size() * sizeof(int16_t));
+
+        ASSERT_EQ(bytes, proxy_read_capture_buffer(mStream, mBuffer.data(), bytes));
+    }
+
+    std::string dump() {
+        int fds[2];
+        char text[4096];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        proxy_dump_capture_stream(mStream, fds[1]);
+        close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    void *mStream = nullptr;
+    std::vector<int16_t> mBuffer;
+};
+
+TEST_P(CaptureAllocationTest, NoHeapActivityAfterStart) {
+    gAllocs = 0;
+    gFrees = 0;
+    gCounting = true;
+    for (int i = 0; i < kPeriods; i++)
+        read();
+    gCounting = false;
+
+    EXPECT_EQ(0u, gAllocs.load());
+    EXPECT_EQ(0u, gFrees.load());
+    EXPECT_NE(std::string::npos, dump().find(", 0 data path allocs"));
+}
+
+TEST_P(CaptureAllocationTest, NoHeapActivityAfterStandby) {
+    read();
+    // Standby and restart, as Audio HAL does, keep the buffers allocated at first open
+    ASSERT_EQ(0, proxy_stop_capture_stream(mStream));
+    proxy_close_capture_stream(mStream);
+    ASSERT_EQ(0, proxy_open_capture_stream(mStream, 0, NULL));
+    ASSERT_EQ(0, proxy_start_capture_stream(mStream));
+
+    gAllocs = 0;
+    gFrees = 0;
+    gCounting = true;
+    for (int i = 0; i < kPeriods; i++)
+        read();
+    gCounting = false;
+
+    EXPECT_EQ(0u, gAllocs.load());
+    EXPECT_EQ(0u, gFrees.load());
+}
+
+// Without conversion, with resampling and channel conversion, and through Capture Ring Buffer
+INSTANTIATE_TEST_SUITE_P(Configs, CaptureAllocationTest,
+                         ::testing::Values(StreamConfig{48000, AUDIO_CHANNEL_IN_STEREO, 2, false},
+                                           StreamConfig{16000, AUDIO_CHANNEL_IN_MONO, 1, false},
+                                           StreamConfig{48000, AUDIO_CHANNEL_IN_STEREO, 2, true}));
+
+}  // namespace
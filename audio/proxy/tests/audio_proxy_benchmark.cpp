@@ -0,0 +1,834 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Audio Proxy Benchmark
+ *
+ * Runs hot paths of Audio Proxy against the fake backend. Per iteration counts of the fake
+ * backend are reported as counters of each benchmark.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+extern "C" {
+#include "audio_resampler.h"
+}
+
+namespace {
+
+constexpr unsigned int kBufferMsec = 20;     // Record/Playback Thread buffer duration
+constexpr unsigned int kMixerCtls = 1000;    // Controls of synthetic A-Box mixer
+
+// Counts of the fake backend while the benchmark loop runs
+class BackendCounters {
+  public:
+    BackendCounters() { fake_backend_get_stats(&mBefore); }
+
+    void report(benchmark::State &state) {
+        struct fake_backend_stats after;
+
+        fake_backend_get_stats(&after);
+        add(state, "pcm_opens", mBefore.pcm_opens, after.pcm_opens);
+        add(state, "pcm_frames_read", mBefore.pcm_frames_read, after.pcm_frames_read);
+        add(state, "pcm_frames_written", mBefore.pcm_frames_written, after.pcm_frames_written);
+        add(state, "virtual_ns", mBefore.virtual_ns, after.virtual_ns);
+        add(state, "xruns", mBefore.xruns, after.xruns);
+        add(state, "ctl_lookups", mBefore.ctl_lookups, after.ctl_lookups);
+        add(state, "ctl_writes", mBefore.ctl_writes, after.ctl_writes);
+        add(state, "route_paths", mBefore.route_paths, after.route_paths);
+        add(state, "route_updates", mBefore.route_updates, after.route_updates);
+    }
+
+  private:
+    static void add(benchmark::State &state, const char *name, uint64_t before, uint64_t after) {
+        if (after != before)
+            state.counters[name] = benchmark::Counter(static_cast<double>(after - before),
+                                                      benchmark::Counter::kAvgIterations);
+    }
+
+    struct fake_backend_stats mBefore;
+};
+
+void *proxyOrSkip(benchmark::State &state) {
+    void *proxy = test_proxy();
+
+    if (!proxy)
+        state.SkipWithError("cannot initialize Audio Proxy with fake backend");
+    return proxy;
+}
+
+/*
+ * Capture: resampling, mono conversion and call record channel selection
+ */
+void BM_Capture(benchmark::State &state, int type, int usage, unsigned int rate,
+                audio_channel_mask_t mask) {
+    struct audio_config config = {};
+    void *proxy = proxyOrSkip(state);
+
+    if (!proxy)
+        return;
+
+    config.sample_rate = rate;
+    config.channel_mask = mask;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+
+    const int bytes = static_cast<int>(rate * kBufferMsec / 1000 *
+                                       audio_channel_count_from_in_mask(mask) * sizeof(int16_t));
+    std::vector<char> buffer(bytes);
+    void *stream = proxy_create_capture_stream(proxy, type, usage, &config, NULL);
+    if (!stream) {
+        state.SkipWithError("cannot create capture stream");
+        return;
+    }
+
+    // First read starts PCM Device, and PCM Reader Thread if Capture Ring Buffer is enabled
+    if (proxy_open_capture_stream(stream, 0, NULL) != 0 || proxy_start_capture_stream(stream) != 0 ||
+        proxy_read_capture_buffer(stream, buffer.data(), bytes) != bytes) {
+        state.SkipWithError("cannot start capture stream");
+    } else {
+        /*
+         * Host libaudioutils has no resampler, tests/host_resampler.c serves the default
+         * engine with medium quality polyphase. These runs don't measure the device one.
+         */
+        const char *engine = test_capture_resampler(stream);
+        if (engine)
+            state.SetLabel(strcmp(engine, "default") == 0
+                                   ? "resampler: polyphase medium (host stand-in of default)"
+                                   : std::string("resampler: ") + engine);
+
+        BackendCounters counters;
+        for (auto _ : state)
+            benchmark::DoNotOptimize(proxy_read_capture_buffer(stream, buffer.data(), bytes));
+        counters.report(state);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+    }
+
+    proxy_stop_capture_stream(stream);
+    proxy_close_capture_stream(stream);
+    proxy_destroy_capture_stream(stream);
+}
+
+// A-Box records 48KHz Stereo, other configurations are converted in Audio Proxy
+BENCHMARK_CAPTURE(BM_Capture, primary/48000_stereo, ASTREAM_CAPTURE_PRIMARY, AUSAGE_RECORDING,
+                  48000, AUDIO_CHANNEL_IN_STEREO);
+BENCHMARK_CAPTURE(BM_Capture, primary/16000_mono, ASTREAM_CAPTURE_PRIMARY, AUSAGE_RECORDING,
+                  16000, AUDIO_CHANNEL_IN_MONO);
+BENCHMARK_CAPTURE(BM_Capture, primary/44100_mono, ASTREAM_CAPTURE_PRIMARY, AUSAGE_RECORDING,
+                  44100, AUDIO_CHANNEL_IN_MONO);
+
+// Call Record has uplink/downlink in left/right, usages other than uplink/downlink mix both
+BENCHMARK_CAPTURE(BM_Capture, call_record/uplink_32000_stereo, ASTREAM_CAPTURE_CALL,
+                  AUSAGE_INCALL_UPLINK, 32000, AUDIO_CHANNEL_IN_STEREO);
+BENCHMARK_CAPTURE(BM_Capture, call_record/downlink_32000_stereo, ASTREAM_CAPTURE_CALL,
+                  AUSAGE_INCALL_DOWNLINK, 32000, AUDIO_CHANNEL_IN_STEREO);
+BENCHMARK_CAPTURE(BM_Capture, call_record/mix_32000_stereo, ASTREAM_CAPTURE_CALL, AUSAGE_NONE,
+                  32000, AUDIO_CHANNEL_IN_STEREO);
+BENCHMARK_CAPTURE(BM_Capture, call_record/uplink_16000_mono, ASTREAM_CAPTURE_CALL,
+                  AUSAGE_INCALL_UPLINK, 16000, AUDIO_CHANNEL_IN_MONO);
+
+/*
+ * Capture Kernels: channel processing of one period on Record Thread, time per frame
+ */
+void BM_CaptureKernel(benchmark::State &state, enum test_capture_kernel kernel, bool simd) {
+    // In place kernels would see their own output, so each iteration takes a fresh period of
+    // the pool, and the pool is refilled out of timing once in a while
+    constexpr size_t kPoolPeriods = 64;
+    const size_t frames = static_cast<size_t>(state.range(0));
+    std::vector<int16_t> input(frames * 2 * kPoolPeriods), pool(input.size()), out(frames);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+    size_t next = kPoolPeriods;
+
+    for (auto &s : input)
+        s = static_cast<int16_t>(sample(rng));
+
+    for (auto _ : state) {
+        if (next == kPoolPeriods) {
+            state.PauseTiming();
+            memcpy(pool.data(), input.data(), input.size() * sizeof(int16_t));
+            next = 0;
+            state.ResumeTiming();
+        }
+        test_run_capture_kernel(simd, kernel, &pool[frames * 2 * next++], out.data(), frames);
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(test_capture_kernels_name(simd));
+    state.counters["frame_time"] = benchmark::Counter(
+            static_cast<double>(frames),
+            benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// Period sizes from 5 msec at 48KHz up to 4096 frames
+#define KERNEL_PERIODS Arg(240)->Arg(480)->Arg(960)->Arg(1920)->Arg(4096)
+
+BENCHMARK_CAPTURE(BM_CaptureKernel, select_rx/scalar, TEST_KERNEL_SELECT_RX, false)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, select_rx/simd, TEST_KERNEL_SELECT_RX, true)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, select_tx/scalar, TEST_KERNEL_SELECT_TX, false)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, select_tx/simd, TEST_KERNEL_SELECT_TX, true)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, mix_rxtx/scalar, TEST_KERNEL_MIX_RXTX, false)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, mix_rxtx/simd, TEST_KERNEL_MIX_RXTX, true)->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, stereo_to_mono/scalar, TEST_KERNEL_STEREO_TO_MONO, false)
+        ->KERNEL_PERIODS;
+BENCHMARK_CAPTURE(BM_CaptureKernel, stereo_to_mono/simd, TEST_KERNEL_STEREO_TO_MONO, true)
+        ->KERNEL_PERIODS;
+
+/*
+ * Polyphase Resampler offline: one iteration converts one period of 48KHz capture, time per
+ * input frame. Label shows dot product kernel selected at build.
+ */
+void BM_Resampler(benchmark::State &state, unsigned int out_rate, unsigned int channels,
+                  resampler_engine engine) {
+    constexpr unsigned int kInRate = 48000;
+    const size_t in_frames = kInRate * kBufferMsec / 1000;
+    std::vector<int16_t> in(in_frames * channels), out((out_rate * kBufferMsec / 1000 + 1) * channels);
+    struct resampler_itfe *resampler = nullptr;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> sample(INT16_MIN / 2, INT16_MAX / 2);
+
+    for (auto &s : in)
+        s = static_cast<int16_t>(sample(rng));
+    if (create_polyphase_resampler(kInRate, out_rate, channels, engine, nullptr, &resampler) != 0) {
+        state.SkipWithError("cannot create resampler");
+        return;
+    }
+
+    for (auto _ : state) {
+        size_t in_count = in_frames, out_count = out.size() / channels;
+
+        resampler->resample_from_input(resampler, in.data(), &in_count, out.data(), &out_count);
+        benchmark::DoNotOptimize(out.data());
+    }
+    release_polyphase_resampler(resampler);
+
+    state.SetLabel(polyphase_kernel_name());
+    state.counters["frame_time"] = benchmark::Counter(
+            static_cast<double>(in_frames),
+            benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// VoIP and CD rates from A-Box capture, with each quality tier for 16KHz mono
+BENCHMARK_CAPTURE(BM_Resampler, 16000_mono/high, 16000, 1, RESAMPLER_ENGINE_POLYPHASE_HIGH);
+BENCHMARK_CAPTURE(BM_Resampler, 16000_mono/medium, 16000, 1, RESAMPLER_ENGINE_POLYPHASE_MEDIUM);
+BENCHMARK_CAPTURE(BM_Resampler, 16000_mono/low, 16000, 1, RESAMPLER_ENGINE_POLYPHASE_LOW);
+BENCHMARK_CAPTURE(BM_Resampler, 8000_mono/high, 8000, 1, RESAMPLER_ENGINE_POLYPHASE_HIGH);
+BENCHMARK_CAPTURE(BM_Resampler, 44100_stereo/high, 44100, 2, RESAMPLER_ENGINE_POLYPHASE_HIGH);
+BENCHMARK_CAPTURE(BM_Resampler, 44100_stereo/medium, 44100, 2, RESAMPLER_ENGINE_POLYPHASE_MEDIUM);
+
+/*
+ * Route: one iteration switches route to the other device
+ */
+void BM_Route(benchmark::State &state, int usage, int device0, int device1) {
+    const int device[2] = {device0, device1};
+    void *proxy = proxyOrSkip(state);
+    int routed = 0;
+
+    if (!proxy)
+        return;
+    if (!proxy_set_route(proxy, usage, device[0], MODIFIER_NONE, true)) {
+        state.SkipWithError("cannot set route");
+        return;
+    }
+
+    BackendCounters counters;
+    for (auto _ : state) {
+        routed ^= 1;
+        proxy_set_route(proxy, usage, device[routed], MODIFIER_NONE, true);
+    }
+    counters.report(state);
+
+    proxy_set_route(proxy, usage, device[routed], MODIFIER_NONE, false);
+}
+
+// Speaker opens and closes Speaker AMP streams in addition to path changes
+BENCHMARK_CAPTURE(BM_Route, playback/speaker_headphone, AUSAGE_MEDIA, DEVICE_SPEAKER,
+                  DEVICE_HEADPHONE);
+BENCHMARK_CAPTURE(BM_Route, playback/headset_headphone, AUSAGE_MEDIA, DEVICE_HEADSET,
+                  DEVICE_HEADPHONE);
+BENCHMARK_CAPTURE(BM_Route, capture/main_mic_sub_mic, AUSAGE_RECORDING, DEVICE_MAIN_MIC,
+                  DEVICE_SUB_MIC);
+
+/*
+ * Route Table: one iteration moves route to next (usage, device) pair, going through all of
+ * them, with names from precompiled route table or built at routing as before it existed
+ */
+std::vector<std::pair<audio_usage, device_type>> routePairs() {
+    std::vector<std::pair<audio_usage, device_type>> pairs;
+
+    for (unsigned int u = 0; u < test_route_usages(); u++)
+        for (unsigned int d = 0; d < test_route_devices(); d++)
+            pairs.emplace_back(static_cast<audio_usage>(u), static_cast<device_type>(d));
+    return pairs;
+}
+
+void BM_RouteName(benchmark::State &state, bool precompiled) {
+    const auto pairs = routePairs();
+    size_t next = 0;
+
+    if (!proxyOrSkip(state))
+        return;
+    test_set_route_table(precompiled);
+
+    for (auto _ : state) {
+        const char *gain;
+        const char *path = test_route_name(pairs[next].first, pairs[next].second, &gain);
+
+        benchmark::DoNotOptimize(path);
+        benchmark::DoNotOptimize(gain);
+        next = (next + 1) % pairs.size();
+    }
+    state.SetLabel(std::to_string(pairs.size()) + " usage x device pairs");
+
+    test_set_route_table(true);
+}
+
+void BM_RouteSwitch(benchmark::State &state, bool precompiled) {
+    const auto pairs = routePairs();
+    size_t current = 0;
+
+    if (!proxyOrSkip(state))
+        return;
+    test_set_route_table(precompiled);
+
+    BackendCounters counters;
+    for (auto _ : state) {
+        size_t next = (current + 1) % pairs.size();
+
+        test_reroute(pairs[current].first, pairs[current].second,
+                     pairs[next].first, pairs[next].second);
+        current = next;
+    }
+    counters.report(state);
+    state.SetLabel(std::to_string(pairs.size()) + " usage x device pairs");
+
+    test_set_route_table(true);
+}
+
+BENCHMARK_CAPTURE(BM_RouteName, precompiled, true);
+BENCHMARK_CAPTURE(BM_RouteName, built, false);
+BENCHMARK_CAPTURE(BM_RouteSwitch, precompiled, true);
+BENCHMARK_CAPTURE(BM_RouteSwitch, built, false);
+
+/*
+ * Mixer: access by control name, as Audio HAL does for its own controls, through the control
+ * cache or by linear search of mixer_get_ctl_by_name(). Argument is index of the control.
+ */
+void BM_Mixer(benchmark::State &state, bool set, bool cached) {
+    void *proxy = proxyOrSkip(state);
+
+    if (!proxy)
+        return;
+    test_set_mixer_ctl_cache(cached);
+
+    const std::string name = fake_backend_ctl_name(static_cast<unsigned int>(state.range(0)));
+    unsigned int hits, misses;
+    int value = 0;
+
+    test_mixer_ctl_cache_stats(&hits, &misses);
+    BackendCounters counters;
+    for (auto _ : state) {
+        if (set) {
+            proxy_set_mixer_value_int(proxy, name.c_str(), value);
+            value ^= 1;
+        } else {
+            benchmark::DoNotOptimize(proxy_get_mixer_value_int(proxy, name.c_str()));
+        }
+    }
+    counters.report(state);
+
+    unsigned int hits_after, misses_after;
+    test_mixer_ctl_cache_stats(&hits_after, &misses_after);
+    state.counters["cache_hits"] = benchmark::Counter(hits_after - hits,
+                                                      benchmark::Counter::kAvgIterations);
+    state.counters["cache_misses"] = benchmark::Counter(misses_after - misses,
+                                                        benchmark::Counter::kAvgIterations);
+    state.SetLabel(std::to_string(fake_backend_num_ctls()) + " controls");
+
+    test_set_mixer_ctl_cache(true);
+}
+
+// First, middle and last of the synthetic mixer, last one is the worst case of linear search
+#define MIXER_CTLS Arg(0)->Arg(kMixerCtls / 2)->Arg(kMixerCtls - 1)
+
+BENCHMARK_CAPTURE(BM_Mixer, get/cached, false, true)->MIXER_CTLS;
+BENCHMARK_CAPTURE(BM_Mixer, get/linear, false, false)->MIXER_CTLS;
+BENCHMARK_CAPTURE(BM_Mixer, set/cached, true, true)->MIXER_CTLS;
+BENCHMARK_CAPTURE(BM_Mixer, set/linear, true, false)->MIXER_CTLS;
+
+/*
+ * Presentation Position: queries from a running Primary Playback Stream
+ */
+void BM_Position(benchmark::State &state, bool write) {
+    struct audio_config config = {};
+    void *proxy = proxyOrSkip(state);
+
+    if (!proxy)
+        return;
+
+    config.sample_rate = 48000;
+    config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+
+    const int bytes = static_cast<int>(config.sample_rate * kBufferMsec / 1000 *
+                                       audio_channel_count_from_out_mask(config.channel_mask) *
+                                       sizeof(int16_t));
+    std::vector<char> buffer(bytes);
+    void *stream = proxy_create_playback_stream(proxy, ASTREAM_PLAYBACK_PRIMARY, &config, NULL);
+    if (!stream) {
+        state.SkipWithError("cannot create playback stream");
+        return;
+    }
+
+    bool started = proxy_open_playback_stream(stream, 0, NULL) == 0 &&
+                   proxy_start_playback_stream(stream) == 0;
+    // Fills kernel buffer, so PCM Device is running and has hardware timestamp
+    for (int i = 0; started && i < 8; i++)
+        started = proxy_write_playback_buffer(stream, buffer.data(), bytes) == bytes;
+
+    if (!started) {
+        state.SkipWithError("cannot start playback stream");
+    } else {
+        struct timespec timestamp;
+        uint64_t frames;
+
+        BackendCounters counters;
+        for (auto _ : state) {
+            if (write)
+                proxy_write_playback_buffer(stream, buffer.data(), bytes);
+            benchmark::DoNotOptimize(proxy_get_presen_position(stream, &frames, &timestamp));
+        }
+        counters.report(state);
+    }
+
+    proxy_stop_playback_stream(stream);
+    proxy_close_playback_stream(stream);
+    proxy_destroy_playback_stream(stream);
+}
+
+BENCHMARK_CAPTURE(BM_Position, primary/query, false);
+BENCHMARK_CAPTURE(BM_Position, primary/write_query, true);
+
+/*
+ * Contention: each thread writes to its own Primary Playback Stream while routing control
+ * toggles media route between headset and headphone as fast as it can. Writers read the route
+ * snapshot and take no routing lock, so their write cost should not depend on toggling.
+ */
+std::atomic<bool> gToggleStop;
+std::atomic<uint64_t> gToggles;
+
+void toggleRoutes(void *proxy) {
+    int routed = 0;
+
+    while (!gToggleStop.load(std::memory_order_relaxed)) {
+        routed ^= 1;
+        proxy_set_route(proxy, AUSAGE_MEDIA, routed ? DEVICE_HEADPHONE : DEVICE_HEADSET,
+                        MODIFIER_NONE, true);
+        gToggles.fetch_add(1, std::memory_order_relaxed);
+    }
+    proxy_set_route(proxy, AUSAGE_MEDIA, routed ? DEVICE_HEADPHONE : DEVICE_HEADSET, MODIFIER_NONE,
+                    false);
+}
+
+void BM_PlaybackContention(benchmark::State &state, bool toggle) {
+    struct audio_config config = {};
+    void *proxy = proxyOrSkip(state);
+    std::thread toggler;
+
+    if (!proxy)
+        return;
+
+    config.sample_rate = 48000;
+    config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+
+    const int bytes = static_cast<int>(config.sample_rate * kBufferMsec / 1000 *
+                                       audio_channel_count_from_out_mask(config.channel_mask) *
+                                       sizeof(int16_t));
+    std::vector<char> buffer(bytes);
+    void *stream = proxy_create_playback_stream(proxy, ASTREAM_PLAYBACK_PRIMARY, &config, NULL);
+    if (!stream) {
+        state.SkipWithError("cannot create playback stream");
+        return;
+    }
+    bool started = proxy_open_playback_stream(stream, 0, NULL) == 0 &&
+                   proxy_start_playback_stream(stream) == 0 &&
+                   proxy_write_playback_buffer(stream, buffer.data(), bytes) == bytes;
+
+    if (state.thread_index() == 0 && toggle) {
+        gToggleStop = false;
+        gToggles = 0;
+        toggler = std::thread(toggleRoutes, proxy);
+    }
+
+    if (!started) {
+        state.SkipWithError("cannot start playback stream");
+    } else {
+        std::chrono::nanoseconds max_write(0);
+
+        for (auto _ : state) {
+            auto start = std::chrono::steady_clock::now();
+
+            benchmark::DoNotOptimize(proxy_write_playback_buffer(stream, buffer.data(), bytes));
+            max_write = std::max(max_write, std::chrono::steady_clock::now() - start);
+        }
+        state.counters["write_max_us"] = benchmark::Counter(
+                std::chrono::duration<double, std::micro>(max_write).count(),
+                benchmark::Counter::kAvgThreads);
+    }
+
+    if (toggler.joinable()) {
+        gToggleStop = true;
+        toggler.join();
+        state.counters["route_switches"] = benchmark::Counter(static_cast<double>(gToggles),
+                                                              benchmark::Counter::kIsRate);
+    }
+    proxy_stop_playback_stream(stream);
+    proxy_close_playback_stream(stream);
+    proxy_destroy_playback_stream(stream);
+}
+
+BENCHMARK_CAPTURE(BM_PlaybackContention, quiet, false)->Threads(1)->Threads(4)->UseRealTime();
+BENCHMARK_CAPTURE(BM_PlaybackContention, toggling, true)->Threads(1)->Threads(4)->UseRealTime();
+
+}  // namespace
+
+/*
+ * Telemetry: what each write/read and each presentation position query adds, budget is ~50 ns.
+ * Clock is one CLOCK_MONOTONIC read, latency record is two of them plus histogram update.
+ */
+void BM_TelemetryClock(benchmark::State &state) {
+    for (auto _ : state)
+        benchmark::DoNotOptimize(test_telemetry_now_ns());
+}
+
+void BM_TelemetryLatency(benchmark::State &state) {
+    void *telemetry = test_telemetry_create();
+
+    for (auto _ : state) {
+        int64_t start_ns = test_telemetry_now_ns();
+
+        test_telemetry_record_latency(telemetry, start_ns);
+    }
+    test_telemetry_destroy(telemetry);
+}
+
+// Shared by all threads of the benchmark, as HAL threads query position of one stream
+void *gPositionTelemetry;
+
+void BM_TelemetryPosition(benchmark::State &state) {
+    struct timespec timestamp;
+    uint64_t frames = 0;
+
+    if (state.thread_index() == 0)
+        gPositionTelemetry = test_telemetry_create();
+
+    clock_gettime(CLOCK_MONOTONIC, &timestamp);
+    for (auto _ : state) {
+        // 1 msec and 48 frames apart, with 1 usec of jitter every other query
+        frames += 48;
+        timestamp.tv_nsec += 1000000 + (frames & 48 ? 1000 : -1000);
+        if (timestamp.tv_nsec >= 1000000000) {
+            timestamp.tv_nsec -= 1000000000;
+            timestamp.tv_sec++;
+        }
+        test_telemetry_record_position(gPositionTelemetry, frames, &timestamp, 48000);
+    }
+
+    if (state.thread_index() == 0) {
+        test_telemetry_destroy(gPositionTelemetry);
+        gPositionTelemetry = nullptr;
+    }
+}
+
+BENCHMARK(BM_TelemetryClock);
+BENCHMARK(BM_TelemetryLatency);
+BENCHMARK(BM_TelemetryPosition)->Threads(1)->Threads(4);
+
+/*
+ * Calliope Dump: debug nodes on a tmpfs stand-in for debugfs and sysfs of A-Box
+ */
+class CalliopeDir {
+  public:
+    CalliopeDir() {
+        char path[] = "/dev/shm/abox_bench.XXXXXX";
+        char fallback[] = "/tmp/abox_bench.XXXXXX";
+
+        if (mkdtemp(path))
+            mRoot = path;
+        else if (mkdtemp(fallback))
+            mRoot = fallback;
+        else
+            return;
+        mIn = mRoot + "/debug/";
+        mOut = mRoot + "/dump/";
+        mkdir(mIn.c_str(), 0755);
+        mkdir(mOut.c_str(), 0755);
+    }
+
+    ~CalliopeDir() {
+        if (!mRoot.empty())
+            nftw(mRoot.c_str(), remove, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    bool ok() const { return !mRoot.empty(); }
+
+    unsigned int dumps() const {
+        unsigned int count = 0;
+        DIR *d = opendir(mOut.c_str());
+
+        if (d) {
+            for (struct dirent *entry; (entry = readdir(d));)
+                count += entry->d_name[0] != '.';
+            closedir(d);
+        }
+        return count;
+    }
+    const std::string &in() const { return mIn; }
+    const std::string &out() const { return mOut; }
+
+    // Debug node filled with a pattern, as it would be with firmware state
+    bool fill(const std::string &path, size_t size) const {
+        std::vector<char> block(64 * 1024);
+        int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+
+        if (fd < 0)
+            return false;
+        for (size_t i = 0; i < block.size(); i++)
+            block[i] = static_cast<char>(i * 131);
+        for (size_t done = 0; done < size;) {
+            size_t n = std::min(block.size(), size - done);
+            if (write(fd, block.data(), n) != static_cast<ssize_t>(n)) {
+                close(fd);
+                return false;
+            }
+            done += n;
+        }
+        close(fd);
+        return true;
+    }
+
+  private:
+    static int remove(const char *path, const struct stat *, int, struct FTW *) {
+        return ::remove(path);
+    }
+
+    std::string mRoot, mIn, mOut;
+};
+
+// Sizes of debug nodes, close to what a device of this A-Box generation dumps
+size_t calliopeNodeSize(const std::string &file) {
+    if (file == "calliope_dram")
+        return 16 << 20;
+    if (file == "calliope_iva")
+        return 8 << 20;
+    if (file == "calliope_sram")
+        return 3 << 19;
+    if (file == "gpr")
+        return 4 << 10;
+    return 2 << 20;                          // log
+}
+
+/* One iteration is a snapshot of all nodes, with retention removing the oldest files */
+void BM_CalliopeSnapshot(benchmark::State &state) {
+    CalliopeDir dir;
+    size_t bytes = 0;
+    uint64_t spliced, copied;
+
+    if (!dir.ok()) {
+        state.SkipWithError("cannot create tmpfs stand-in");
+        return;
+    }
+    for (unsigned int node = 0; node < test_calliope_nodes(); node++) {
+        const std::string file = test_calliope_node_file(node);
+
+        if (!dir.fill(dir.in() + file, calliopeNodeSize(file))) {
+            state.SkipWithError("cannot fill debug node");
+            return;
+        }
+        bytes += calliopeNodeSize(file);
+    }
+
+    test_calliope_bytes(&spliced, &copied);
+    unsigned int snapshot = 0;
+    for (auto _ : state)
+        test_calliope_snapshot(dir.in().c_str(), dir.out().c_str(),
+                               std::to_string(snapshot++).c_str());
+
+    uint64_t spliced_after, copied_after;
+    test_calliope_bytes(&spliced_after, &copied_after);
+    state.counters["bytes_spliced"] = benchmark::Counter(spliced_after - spliced,
+                                                         benchmark::Counter::kAvgIterations);
+    state.counters["bytes_copied"] = benchmark::Counter(copied_after - copied,
+                                                        benchmark::Counter::kAvgIterations);
+    state.counters["dump_files"] = dir.dumps();   // ABOX_DUMP_LIMIT of each node at most
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+BENCHMARK(BM_CalliopeSnapshot)->Unit(benchmark::kMillisecond);
+
+/*
+ * One iteration copies one node to a new file, with sendfile() of the snapshot or with the
+ * 4KB read/write loop it replaced
+ */
+ssize_t copyReadWrite4k(int fd_in, int fd_out) {
+    char buf[4096];
+    ssize_t n, total = 0;
+
+    while ((n = read(fd_in, buf, sizeof(buf))) > 0) {
+        if (write(fd_out, buf, n) != n)
+            return -1;
+        total += n;
+    }
+    return n < 0 ? -1 : total;
+}
+
+void BM_CalliopeCopy(benchmark::State &state, bool sendfile) {
+    CalliopeDir dir;
+    const size_t size = static_cast<size_t>(state.range(0));
+    const std::string in = dir.in() + "node", out = dir.out() + "node.bin";
+
+    if (!dir.ok() || !dir.fill(in, size)) {
+        state.SkipWithError("cannot create tmpfs stand-in");
+        return;
+    }
+
+    for (auto _ : state) {
+        int fd_in = open(in.c_str(), O_RDONLY | O_CLOEXEC);
+        int fd_out = open(out.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+        bool spliced = false;
+        ssize_t copied = sendfile ? test_calliope_copy(fd_in, fd_out, &spliced)
+                                  : copyReadWrite4k(fd_in, fd_out);
+
+        close(fd_in);
+        close(fd_out);
+        if (copied != static_cast<ssize_t>(size)) {
+            state.SkipWithError("copy failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+
+#define CALLIOPE_NODE_SIZES Arg(64 << 10)->Arg(1 << 20)->Arg(16 << 20)
+
+BENCHMARK_CAPTURE(BM_CalliopeCopy, sendfile, true)->CALLIOPE_NODE_SIZES;
+BENCHMARK_CAPTURE(BM_CalliopeCopy, readwrite_4k, false)->CALLIOPE_NODE_SIZES;
+
+/*
+ * Board info at proxy_init(): cold parses sample XML and writes the binary cache, as the first
+ * boot after an update does, warm maps the cache written by the boot before.
+ */
+constexpr unsigned int kBoardMics = 4;
+constexpr unsigned int kBoardResponses = 32;  // points of each frequency response
+
+bool writeBoardInfo(const char *path) {
+    std::string xml = "<audio_board_info>\n<microphone_characteristics>\n";
+    std::string frequencies, responses;
+
+    for (unsigned int i = 0; i < kBoardResponses; i++) {
+        frequencies += std::to_string(100 + i * 250) + (i + 1 < kBoardResponses ? " " : "");
+        responses += std::to_string(-0.25 * (i % 5)) + (i + 1 < kBoardResponses ? " " : "");
+    }
+    for (unsigned int mic = 0; mic < kBoardMics; mic++) {
+        xml += "<microphone device_id=\"builtin_mic_" + std::to_string(mic) + "\"";
+        xml += " id=\"" + std::to_string(mic) + "\"";
+        xml += std::string(" device=\"") +
+               (mic < 2 ? "AUDIO_DEVICE_IN_BUILTIN_MIC" : "AUDIO_DEVICE_IN_BACK_MIC") + "\"";
+        xml += " address=\"bottom\" location=\"AUDIO_MICROPHONE_LOCATION_MAINBODY\"";
+        xml += " group=\"0\" index_in_the_group=\"" + std::to_string(mic) + "\"";
+        xml += " sensitivity=\"-37.0\" max_spl=\"132.5\" min_spl=\"28.5\"";
+        xml += " directionality=\"AUDIO_MICROPHONE_DIRECTIONALITY_OMNI\"";
+        xml += " num_frequency_responses=\"" + std::to_string(kBoardResponses) + "\"";
+        xml += " frequencies=\"" + frequencies + "\" responses=\"" + responses + "\"";
+        xml += " geometric_location=\"0.0" + std::to_string(mic) + " 0.150 0.004\"";
+        xml += " orientation=\"0.0 0.0 1.0\"/>\n";
+    }
+    xml += "</microphone_characteristics>\n</audio_board_info>\n";
+
+    int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = write(fd, xml.data(), xml.size()) == static_cast<ssize_t>(xml.size());
+    close(fd);
+    return ok;
+}
+
+void BM_BoardInfo(benchmark::State &state, bool warm) {
+    const std::string expected = warm ? "cache" : "xml";
+    unsigned int num_mic = 0;
+
+    if (!test_proxy() || !writeBoardInfo(TEST_BOARD_INFO_XML_PATH)) {
+        state.SkipWithError("cannot write sample board info");
+        return;
+    }
+    unlink(TEST_BOARD_INFO_CACHE_PATH);
+    if (warm)
+        test_load_board_info(&num_mic);
+
+    for (auto _ : state) {
+        if (!warm) {
+            state.PauseTiming();
+            unlink(TEST_BOARD_INFO_CACHE_PATH);
+            state.ResumeTiming();
+        }
+        const char *source = test_load_board_info(&num_mic);
+
+        if (!source || expected != source || num_mic != kBoardMics) {
+            state.SkipWithError("board info is not loaded as expected");
+            break;
+        }
+    }
+    state.counters["mics"] = num_mic;
+
+    // Leaves nothing which proxy_init() of later runs would pick up
+    unlink(TEST_BOARD_INFO_CACHE_PATH);
+    unlink(TEST_BOARD_INFO_XML_PATH);
+}
+
+BENCHMARK_CAPTURE(BM_BoardInfo, cold, false)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_BoardInfo, warm, true)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char **argv) {
+    // Before Audio Proxy opens any mixer
+    fake_backend_set_num_ctls(kMixerCtls);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "proxy_test_hooks.h"
+
+namespace {
+
+class CaptureKernelsTest
+    : public ::testing::TestWithParam<std::tuple<enum test_capture_kernel, size_t>> {};
+
+// SIMD kernels selected at build give the same output as scalar ones, including the tails
+TEST_P(CaptureKernelsTest, SimdMatchesScalar) {
+    const enum test_capture_kernel kernel = std::get<0>(GetParam());
+    const size_t frames = std::get<1>(GetParam());
+    std::vector<int16_t> scalar(frames * 2), simd, scalar_out(frames), simd_out(frames);
+    std::mt19937 rng(frames);
+    std::uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+
+    for (auto &s : scalar)
+        s = static_cast<int16_t>(sample(rng));
+    // Saturation at both ends
+    if (frames > 2) {
+        scalar[0] = scalar[1] = INT16_MAX;
+        scalar[2] = scalar[3] = INT16_MIN;
+    }
+    simd = scalar;
+
+    test_run_capture_kernel(false, kernel, scalar.data(), scalar_out.data(), frames);
+    test_run_capture_kernel(true, kernel, simd.data(), simd_out.data(), frames);
+
+    EXPECT_EQ(scalar, simd) << test_capture_kernels_name(true);
+    EXPECT_EQ(scalar_out, simd_out) << test_capture_kernels_name(true);
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, CaptureKernelsTest,
+                         ::testing::Combine(::testing::Values(TEST_KERNEL_SELECT_RX,
+                                                              TEST_KERNEL_SELECT_TX,
+                                                              TEST_KERNEL_MIX_RXTX,
+                                                              TEST_KERNEL_STEREO_TO_MONO),
+                                            ::testing::Values(1, 7, 240, 961, 4096)));
+
+}  // namespace
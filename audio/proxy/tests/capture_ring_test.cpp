@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kRate = 48000;
+constexpr unsigned int kChannels = 2;
+constexpr int kFrames = 960;                 // 20 msec, one period of Primary Capture
+constexpr int kBytes = kFrames * kChannels * sizeof(int16_t);
+
+/*
+ * Primary Capture Stream at 48KHz stereo, which needs no conversion, on fake PCM Device
+ * running in real time. Fake capture data has ramps of 131 per frame on left channel.
+ */
+class CaptureRingTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        test_set_capture_ring(true);
+        fake_backend_set_realtime(true);
+
+        config.sample_rate = kRate;
+        config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_capture_stream(test_proxy(), ASTREAM_CAPTURE_PRIMARY,
+                                              AUSAGE_RECORDING, &config, NULL);
+        ASSERT_NE(nullptr, mStream);
+        ASSERT_EQ(0, proxy_open_capture_stream(mStream, 0, NULL));
+        ASSERT_EQ(0, proxy_start_capture_stream(mStream));
+    }
+
+    void TearDown() override {
+        if (mStream) {
+            proxy_stop_capture_stream(mStream);
+            proxy_close_capture_stream(mStream);
+            proxy_destroy_capture_stream(mStream);
+        }
+        fake_backend_set_capture_stall(false);
+        fake_backend_set_realtime(false);
+        test_set_capture_ring(false);
+    }
+
+    std::vector<int16_t> read() {
+        std::vector<int16_t> buffer(kFrames * kChannels);
+        EXPECT_EQ(kBytes, proxy_read_capture_buffer(mStream, buffer.data(), kBytes));
+        return buffer;
+    }
+
+    std::string dump() {
+        int fds[2];
+        char text[4096];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        proxy_dump_capture_stream(mStream, fds[1]);
+        close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    void *mStream = nullptr;
+};
+
+// Number of frames whose left sample doesn't follow the previous one
+int countDiscontinuities(const std::vector<int16_t> &samples, int16_t *last) {
+    int breaks = 0;
+
+    for (size_t i = 0; i < samples.size(); i += kChannels) {
+        if (static_cast<int16_t>(samples[i] - *last) != 131)
+            breaks++;
+        *last = samples[i];
+    }
+    return breaks;
+}
+
+TEST_F(CaptureRingTest, DeliversEveryFrameInOrder) {
+    std::vector<int16_t> first = read();
+    int16_t last = first[first.size() - kChannels];
+
+    EXPECT_TRUE(test_capture_ring_started(mStream));
+
+    int breaks = 0;
+    for (int i = 0; i < 50; i++)            // 1 sec
+        breaks += countDiscontinuities(read(), &last);
+
+    EXPECT_EQ(0, breaks);
+    EXPECT_EQ(0u, test_capture_ring_overruns(mStream));
+    EXPECT_EQ(0u, test_capture_ring_underruns(mStream));
+}
+
+TEST_F(CaptureRingTest, LateReaderCountsOverruns) {
+    read();
+    // Ring holds 4 periods, PCM Reader Thread drops the ones after it is full
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    read();
+
+    EXPECT_GT(test_capture_ring_overruns(mStream), 0u);
+    EXPECT_EQ(0u, test_capture_ring_underruns(mStream));
+    EXPECT_NE(std::string::npos, dump().find("input capture ring overruns: "));
+}
+
+TEST_F(CaptureRingTest, StalledDeviceGivesSilenceInTime) {
+    read();
+    fake_backend_set_capture_stall(true);
+    // Drains the periods filled before the stall
+    for (int i = 0; i < 5; i++)
+        read();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int16_t> silence = read();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(std::vector<int16_t>(silence.size(), 0), silence);
+    EXPECT_GT(test_capture_ring_underruns(mStream), 0u);
+    // Record Thread waits 2 periods at most, plus scheduling slack
+    EXPECT_LT(elapsed, std::chrono::milliseconds(200));
+    EXPECT_NE(std::string::npos, dump().find("input capture ring underruns: "));
+    // TearDown() stops the stream while PCM Reader Thread is still blocked in pcm_read()
+}
+
+}  // namespace
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kChannels = 2;
+constexpr int kPeriod = 960;                 // 20 msec, one period of Primary Capture
+constexpr int kFrameBytes = kChannels * sizeof(int16_t);
+
+/*
+ * Primary Capture Stream at 48KHz stereo without Capture Ring Buffer, which needs no
+ * conversion, on fake PCM Device running in real time. Fake capture data has ramps of
+ * 131 per frame on left channel, so any lost or repeated frame breaks the ramp.
+ */
+class DirectReadTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_realtime(true);
+
+        config.sample_rate = 48000;
+        config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_capture_stream(test_proxy(), ASTREAM_CAPTURE_PRIMARY,
+                                              AUSAGE_RECORDING, &config, NULL);
+        ASSERT_NE(nullptr, mStream);
+        ASSERT_EQ(0, proxy_open_capture_stream(mStream, 0, NULL));
+        ASSERT_EQ(0, proxy_start_capture_stream(mStream));
+        ASSERT_EQ(nullptr, test_capture_resampler(mStream));
+    }
+
+    void TearDown() override {
+        if (mStream) {
+            proxy_stop_capture_stream(mStream);
+            proxy_close_capture_stream(mStream);
+            proxy_destroy_capture_stream(mStream);
+        }
+        fake_backend_set_realtime(false);
+    }
+
+    // Reads given frames and checks that left ramp continues from the previous read
+    void read(int frames) {
+        std::vector<int16_t> buffer(frames * kChannels);
+
+        ASSERT_EQ(frames * kFrameBytes,
+                  proxy_read_capture_buffer(mStream, buffer.data(), frames * kFrameBytes));
+        for (size_t i = 0; i < buffer.size(); i += kChannels) {
+            if (mStarted) {
+                EXPECT_EQ(131, static_cast<int16_t>(buffer[i] - mLast)) << "frame " << i / kChannels;
+            }
+            mLast = buffer[i];
+            mStarted = true;
+        }
+    }
+
+    void expectBytes(uint64_t direct, uint64_t copied) {
+        uint64_t actual_direct, actual_copied;
+
+        test_capture_read_bytes(mStream, &actual_direct, &actual_copied);
+        EXPECT_EQ(direct, actual_direct);
+        EXPECT_EQ(copied, actual_copied);
+    }
+
+    void *mStream = nullptr;
+    int16_t mLast = 0;
+    bool mStarted = false;
+};
+
+TEST_F(DirectReadTest, WholePeriodsSkipTheCopy) {
+    struct fake_backend_stats before, after;
+
+    fake_backend_get_stats(&before);
+    read(kPeriod);
+    read(3 * kPeriod);
+    fake_backend_get_stats(&after);
+
+    expectBytes(4 * kPeriod * kFrameBytes, 0);
+    // Every frame handed to caller was read from the device once
+    EXPECT_EQ(4u * kPeriod, after.pcm_frames_read - before.pcm_frames_read);
+}
+
+TEST_F(DirectReadTest, PartialPeriodsAreCopiedFromRemainder) {
+    read(kPeriod / 2);                       // reads one period, half of it remains
+    read(kPeriod / 2);                       // remainder only
+    expectBytes(0, kPeriod * kFrameBytes);
+
+    read(kPeriod + 100);                     // whole period directly, then 100 frames copied
+    expectBytes(kPeriod * kFrameBytes, (kPeriod + 100) * kFrameBytes);
+
+    read(kPeriod);                           // 860 cached frames, then 100 of a new period
+    expectBytes(kPeriod * kFrameBytes, (2 * kPeriod + 100) * kFrameBytes);
+
+    read(kPeriod - 100);                     // drains remainder
+    read(2 * kPeriod);                       // back on the direct path
+    expectBytes(3 * kPeriod * kFrameBytes, 3 * kPeriod * kFrameBytes);
+}
+
+TEST_F(DirectReadTest, DumpShowsCounters) {
+    int fds[2];
+    char text[4096];
+    ssize_t size;
+
+    read(kPeriod);
+    read(kPeriod / 2);
+    ASSERT_EQ(0, pipe(fds));
+    proxy_dump_capture_stream(mStream, fds[1]);
+    close(fds[1]);
+    size = ::read(fds[0], text, sizeof(text) - 1);
+    close(fds[0]);
+    ASSERT_GT(size, 0);
+
+    std::string dump(text, size);
+    EXPECT_NE(std::string::npos,
+              dump.find("input bytes read directly: " + std::to_string(kPeriod * kFrameBytes)));
+    EXPECT_NE(std::string::npos,
+              dump.find("input bytes copied: " + std::to_string(kPeriod / 2 * kFrameBytes)));
+}
+
+}  // namespace
@@ -0,0 +1,1603 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "audio_proxy_fake"
+//#define LOG_NDEBUG 0
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#include <log/log.h>
+
+#include <tinyalsa/asoundlib.h>
+#include <tinycompress/tinycompress.h>
+#include <compress_params.h>
+#include <sound/asound.h>
+
+#include "audio_mixer.h"
+#include "fake_backend.h"
+
+#define FAKE_MAX_CARDS      4
+#define FAKE_CTL_VALUES     2
+#define FAKE_LATE_CTLS      64      // controls which can be added after card is created
+#define FAKE_PATH_CTLS      6
+#define FAKE_PATH_NAME_LEN  128
+#define FAKE_MMAP_PCMS      4       // opened MMAP PCM Devices with status page
+#define FAKE_FNV_OFFSET     14695981039346656037ULL
+#define FAKE_FNV_PRIME      1099511628211ULL
+
+static atomic_uint_fast64_t stat_pcm_opens;
+static atomic_uint_fast64_t stat_pcm_frames_read;
+static atomic_uint_fast64_t stat_pcm_frames_written;
+static atomic_uint_fast64_t stat_compr_bytes_written;
+static atomic_uint_fast64_t stat_virtual_ns;
+static atomic_uint_fast64_t stat_xruns;
+static atomic_uint_fast64_t stat_ctl_lookups;
+static atomic_uint_fast64_t stat_ctl_writes;
+static atomic_uint_fast64_t stat_route_paths;
+static atomic_uint_fast64_t stat_route_updates;
+
+static atomic_uint_fast64_t stat_timestamps;
+static atomic_uint_fast64_t stat_compr_writes;
+static atomic_uint_fast64_t stat_sleeps;
+static atomic_uint_fast64_t stat_hw_syncs;
+static atomic_uint_fast64_t stat_compr_checksum = FAKE_FNV_OFFSET;
+
+static atomic_bool fake_realtime;
+static atomic_bool fake_capture_stalled;
+static atomic_bool fake_virtual_clock;
+static atomic_int_fast64_t fake_virtual_ns;
+static atomic_int fake_drift_ppm;
+static atomic_uint fake_granularity;
+
+static inline void stat_add(atomic_uint_fast64_t *stat, uint64_t value)
+{
+    atomic_fetch_add_explicit(stat, value, memory_order_relaxed);
+}
+
+static inline int64_t fake_real_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int64_t fake_now_ns(void)
+{
+    if (atomic_load_explicit(&fake_virtual_clock, memory_order_acquire))
+        return atomic_load_explicit(&fake_virtual_ns, memory_order_acquire);
+    return fake_real_ns();
+}
+
+static inline void fake_timespec(int64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+/*
+ * Virtual Clock
+ *
+ * CLOCK_MONOTONIC of fake devices and of Audio Proxy built by test hooks. It starts from real
+ * time when enabled, and moves only when tests advance it or a blocked device waits for frames.
+ */
+void fake_backend_set_virtual_clock(bool enable)
+{
+    if (enable)
+        atomic_store_explicit(&fake_virtual_ns, fake_real_ns(), memory_order_release);
+    atomic_store_explicit(&fake_virtual_clock, enable, memory_order_release);
+}
+
+void fake_backend_advance_clock(int64_t ns)
+{
+    atomic_fetch_add_explicit(&fake_virtual_ns, ns, memory_order_acq_rel);
+}
+
+int fake_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+    if (clock == CLOCK_MONOTONIC && atomic_load_explicit(&fake_virtual_clock, memory_order_acquire)) {
+        fake_timespec(fake_now_ns(), ts);
+        return 0;
+    }
+    return clock_gettime(clock, ts);
+}
+
+/* Sleeps on virtual clock move it to the wakeup time at once, never backward */
+int fake_clock_nanosleep(clockid_t clock, int flags, const struct timespec *request,
+                         struct timespec *remain)
+{
+    int64_t now_ns, wakeup_ns;
+
+    if (clock != CLOCK_MONOTONIC || !atomic_load_explicit(&fake_virtual_clock, memory_order_acquire))
+        return clock_nanosleep(clock, flags, request, remain);
+
+    wakeup_ns = (int64_t)request->tv_sec * 1000000000LL + request->tv_nsec;
+    now_ns = atomic_load_explicit(&fake_virtual_ns, memory_order_acquire);
+    if (!(flags & TIMER_ABSTIME))
+        wakeup_ns += now_ns;
+    while (now_ns < wakeup_ns &&
+           !atomic_compare_exchange_weak_explicit(&fake_virtual_ns, &now_ns, wakeup_ns,
+                                                  memory_order_acq_rel, memory_order_acquire))
+        ;
+    stat_add(&stat_sleeps, 1);
+    return 0;
+}
+
+void fake_backend_set_clock_drift(int ppm)
+{
+    atomic_store_explicit(&fake_drift_ppm, ppm, memory_order_relaxed);
+}
+
+void fake_backend_set_pointer_granularity(unsigned int units)
+{
+    atomic_store_explicit(&fake_granularity, units, memory_order_relaxed);
+}
+
+
+/*
+ * Device Clock
+ *
+ * Positions are in frames for PCM Device and in bytes for Compress Device.
+ * Hardware position runs at rate from base_ns while device is running, off by the clock drift,
+ * and moves in steps of pointer granularity.
+ */
+struct fake_device {
+    pthread_mutex_t lock;
+    unsigned int rate;          // units per second
+    uint64_t size;              // ring size in units
+    uint64_t appl;              // application position
+    uint64_t hw;                // hardware position
+    uint64_t hw_base;           // hardware position at base_ns
+    int64_t base_ns;
+    bool running;
+    bool capture;
+    bool free_running;          // MMAP NOIRQ device doesn't stop at xrun
+    void (*produce)(void *owner, uint64_t from, uint64_t to);
+    void *owner;
+};
+
+static void device_init(struct fake_device *dev, unsigned int rate, uint64_t size, bool capture)
+{
+    pthread_mutex_init(&dev->lock, NULL);
+    dev->rate = rate ? rate : 48000;
+    dev->size = size ? size : 1;
+    dev->capture = capture;
+}
+
+static void device_start(struct fake_device *dev, int64_t now_ns)
+{
+    dev->hw_base = dev->hw;
+    dev->base_ns = now_ns;
+    dev->running = true;
+}
+
+/* Units the device clock moves in given nsec of CLOCK_MONOTONIC */
+static uint64_t device_units(struct fake_device *dev, int64_t ns)
+{
+    int ppm = atomic_load_explicit(&fake_drift_ppm, memory_order_relaxed);
+
+    if (ppm == 0)
+        return (uint64_t)ns * dev->rate / 1000000000ULL;
+    return (uint64_t)((double)ns * dev->rate * (1000000.0 + ppm) / 1e15);
+}
+
+/* Nsec of CLOCK_MONOTONIC the device clock takes to move given units, rounded up */
+static int64_t device_ns(struct fake_device *dev, uint64_t units)
+{
+    int ppm = atomic_load_explicit(&fake_drift_ppm, memory_order_relaxed);
+
+    return (int64_t)ceil((double)units * 1e15 / ((double)dev->rate * (1000000.0 + ppm)));
+}
+
+/* Moves hardware position to now_ns, capture device produces the frames passed by */
+static void device_update(struct fake_device *dev, int64_t now_ns)
+{
+    unsigned int granularity;
+    uint64_t hw, from;
+
+    if (!dev->running || now_ns <= dev->base_ns)
+        return ;
+
+    if (dev->capture && atomic_load_explicit(&fake_capture_stalled, memory_order_relaxed)) {
+        // Stalled device keeps its position, and restarts from here
+        dev->hw_base = dev->hw;
+        dev->base_ns = now_ns;
+        return ;
+    }
+
+    hw = dev->hw_base + device_units(dev, now_ns - dev->base_ns);
+    granularity = atomic_load_explicit(&fake_granularity, memory_order_relaxed);
+    if (granularity > 1)
+        hw -= hw % granularity;
+    if (hw <= dev->hw)
+        return ;
+
+    if (dev->capture) {
+        from = (hw - dev->hw > dev->size) ? hw - dev->size : dev->hw;
+        if (dev->produce)
+            dev->produce(dev->owner, from, hw);
+        if (hw - dev->appl > dev->size && !dev->free_running) {
+            // Overrun, the oldest frames are lost
+            dev->appl = hw - dev->size;
+            stat_add(&stat_xruns, 1);
+        }
+    } else if (hw > dev->appl && !dev->free_running) {
+        // Underrun, hardware waits for next write from here
+        hw = dev->appl;
+        dev->hw_base = hw;
+        dev->base_ns = now_ns;
+        stat_add(&stat_xruns, 1);
+    }
+    dev->hw = hw;
+}
+
+/*
+ * Instead of sleeping, moves device clock forward by given units.
+ * With virtual clock, moves the clock itself until hardware position gets there.
+ */
+static void device_skip(struct fake_device *dev, uint64_t units)
+{
+    uint64_t hw = dev->hw + units;
+
+    if (atomic_load_explicit(&fake_virtual_clock, memory_order_acquire)) {
+        while (dev->running && dev->hw < hw) {
+            int64_t ns = device_ns(dev, hw - dev->hw);
+
+            fake_backend_advance_clock(ns > 0 ? ns : 1);
+            device_update(dev, fake_now_ns());
+            stat_add(&stat_virtual_ns, (uint64_t)ns);
+        }
+        if (dev->hw >= hw)
+            return ;
+    }
+
+    if (dev->capture && dev->produce)
+        dev->produce(dev->owner, (units > dev->size) ? hw - dev->size : dev->hw, hw);
+    dev->hw_base += units;
+    dev->hw = hw;
+    stat_add(&stat_virtual_ns, units * 1000000000ULL / dev->rate);
+}
+
+static inline uint64_t device_avail(struct fake_device *dev)
+{
+    return dev->capture ? dev->hw - dev->appl : dev->size - (dev->appl - dev->hw);
+}
+
+
+/*
+ * PCM Device
+ */
+struct pcm {
+    struct fake_device dev;
+    pthread_cond_t wake;        // signaled by pcm_stop() to abort blocked read or write
+    unsigned int stops;
+    struct pcm_config config;
+    unsigned int flags;
+    unsigned int frame_bytes;
+    unsigned int start_threshold;
+    char *ring;
+    int poll_fd;
+    volatile struct snd_pcm_mmap_status *status;    // MMAP PCM Device only, in poll_fd
+    const char *error;
+};
+
+static pthread_mutex_t fake_mmap_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pcm *fake_mmap_pcms[FAKE_MMAP_PCMS];
+
+unsigned int pcm_format_to_bits(enum pcm_format format)
+{
+    switch (format) {
+        case PCM_FORMAT_S32_LE:
+        case PCM_FORMAT_S24_LE:
+            return 32;
+        case PCM_FORMAT_S24_3LE:
+            return 24;
+        case PCM_FORMAT_S8:
+            return 8;
+        default:
+        case PCM_FORMAT_S16_LE:
+            return 16;
+    }
+}
+
+unsigned int pcm_frames_to_bytes(struct pcm *pcm, unsigned int frames)
+{
+    return frames * pcm->frame_bytes;
+}
+
+/* Left and right channels carry different ramps, so channel selection is visible */
+static void pcm_produce(void *owner, uint64_t from, uint64_t to)
+{
+    struct pcm *pcm = (struct pcm *)owner;
+    unsigned int channels = pcm->config.channels;
+
+    for (uint64_t frame = from; frame < to; frame++) {
+        char *dst = pcm->ring + (frame % pcm->dev.size) * pcm->frame_bytes;
+
+        if (pcm->frame_bytes == channels * sizeof(int16_t)) {
+            int16_t *sample = (int16_t *)dst;
+            for (unsigned int ch = 0; ch < channels; ch++)
+                sample[ch] = (int16_t)(frame * (ch + 1) * 131);
+        } else
+            memset(dst, (int)(frame & 0xFF), pcm->frame_bytes);
+    }
+}
+
+/*
+ * Status page of MMAP PCM Device, in a shared memory region standing in for PCM fd.
+ * It is mapped at the same offset as kernel maps it, so Audio Proxy maps it from poll fd as is.
+ */
+static void pcm_status_open(struct pcm *pcm)
+{
+    long page = sysconf(_SC_PAGE_SIZE);
+    void *status;
+    int fd;
+
+    fd = memfd_create("fake_pcm_status", MFD_CLOEXEC);
+    if (fd < 0)
+        return ;
+    if (ftruncate(fd, SNDRV_PCM_MMAP_OFFSET_STATUS + page) != 0 ||
+        (status = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       SNDRV_PCM_MMAP_OFFSET_STATUS)) == MAP_FAILED) {
+        close(fd);
+        return ;
+    }
+    pcm->poll_fd = fd;
+    pcm->status = (volatile struct snd_pcm_mmap_status *)status;
+    pcm->status->state = SNDRV_PCM_STATE_PREPARED;
+
+    pthread_mutex_lock(&fake_mmap_lock);
+    for (int i = 0; i < FAKE_MMAP_PCMS; i++) {
+        if (!fake_mmap_pcms[i]) {
+            fake_mmap_pcms[i] = pcm;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&fake_mmap_lock);
+}
+
+static void pcm_status_close(struct pcm *pcm)
+{
+    if (!pcm->status)
+        return ;
+
+    pthread_mutex_lock(&fake_mmap_lock);
+    for (int i = 0; i < FAKE_MMAP_PCMS; i++) {
+        if (fake_mmap_pcms[i] == pcm)
+            fake_mmap_pcms[i] = NULL;
+    }
+    pthread_mutex_unlock(&fake_mmap_lock);
+    munmap((void *)pcm->status, sysconf(_SC_PAGE_SIZE));
+    pcm->status = NULL;
+}
+
+/* Kernel writes status page without lock, pointer first, with device lock held */
+static void pcm_status_update(struct pcm *pcm, int64_t now_ns)
+{
+    if (!pcm->status)
+        return ;
+
+    pcm->status->state = pcm->dev.running ? SNDRV_PCM_STATE_RUNNING : SNDRV_PCM_STATE_SETUP;
+    pcm->status->hw_ptr = (snd_pcm_uframes_t)pcm->dev.hw;
+    pcm->status->tstamp.tv_sec = now_ns / 1000000000LL;
+    pcm->status->tstamp.tv_nsec = now_ns % 1000000000LL;
+}
+
+void fake_backend_update_status(void)
+{
+    int64_t now_ns = fake_now_ns();
+
+    pthread_mutex_lock(&fake_mmap_lock);
+    for (int i = 0; i < FAKE_MMAP_PCMS; i++) {
+        struct pcm *pcm = fake_mmap_pcms[i];
+
+        if (!pcm)
+            continue;
+        pthread_mutex_lock(&pcm->dev.lock);
+        if (pcm->dev.running) {
+            device_update(&pcm->dev, now_ns);
+            pcm_status_update(pcm, now_ns);
+        }
+        pthread_mutex_unlock(&pcm->dev.lock);
+    }
+    pthread_mutex_unlock(&fake_mmap_lock);
+}
+
+/* Copies between ring and buffer from given position, wrapping around the end of ring */
+static void pcm_ring_copy(struct pcm *pcm, uint64_t pos, void *buf, unsigned int frames, bool to_ring)
+{
+    while (frames > 0) {
+        unsigned int offset = (unsigned int)(pos % pcm->dev.size);
+        unsigned int chunk = (unsigned int)pcm->dev.size - offset;
+        char *ring = pcm->ring + offset * pcm->frame_bytes;
+
+        if (chunk > frames)
+            chunk = frames;
+        if (to_ring)
+            memcpy(ring, buf, chunk * pcm->frame_bytes);
+        else
+            memcpy(buf, ring, chunk * pcm->frame_bytes);
+
+        buf = (char *)buf + chunk * pcm->frame_bytes;
+        pos += chunk;
+        frames -= chunk;
+    }
+}
+
+struct pcm *pcm_open(unsigned int card, unsigned int device, unsigned int flags,
+                     struct pcm_config *config)
+{
+    struct pcm *pcm;
+
+    pcm = (struct pcm *)calloc(1, sizeof(struct pcm));
+    if (!pcm)
+        return NULL;
+
+    pcm->poll_fd = -1;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pcm->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (!config) {
+        pcm->error = "no pcm config";
+        return pcm;
+    }
+
+    pcm->config = *config;
+    if (pcm->config.period_size == 0)
+        pcm->config.period_size = 1024;
+    if (pcm->config.period_count == 0)
+        pcm->config.period_count = 4;
+    pcm->flags = flags;
+    pcm->frame_bytes = pcm->config.channels * (pcm_format_to_bits(pcm->config.format) >> 3);
+    pcm->start_threshold = pcm->config.start_threshold ? pcm->config.start_threshold
+                                                       : pcm->config.period_size;
+
+    device_init(&pcm->dev, pcm->config.rate,
+                (uint64_t)pcm->config.period_size * pcm->config.period_count, (flags & PCM_IN) != 0);
+    pcm->dev.free_running = (flags & PCM_NOIRQ) != 0;
+    pcm->dev.produce = pcm_produce;
+    pcm->dev.owner = pcm;
+
+    pcm->ring = (char *)calloc(pcm->dev.size, pcm->frame_bytes ? pcm->frame_bytes : 1);
+    if (!pcm->ring) {
+        pcm->error = "cannot allocate ring";
+        return pcm;
+    }
+    if (flags & PCM_MMAP)
+        pcm_status_open(pcm);
+
+    stat_add(&stat_pcm_opens, 1);
+    ALOGV("%s: card %u device %u %s rate %u channels %u period %u x %u", __func__, card, device,
+          (flags & PCM_IN) ? "capture" : "playback", pcm->config.rate, pcm->config.channels,
+          pcm->config.period_size, pcm->config.period_count);
+    return pcm;
+}
+
+int pcm_close(struct pcm *pcm)
+{
+    if (!pcm)
+        return -EINVAL;
+
+    pcm_status_close(pcm);
+    if (pcm->poll_fd >= 0)
+        close(pcm->poll_fd);
+    pthread_cond_destroy(&pcm->wake);
+    pthread_mutex_destroy(&pcm->dev.lock);
+    free(pcm->ring);
+    free(pcm);
+    return 0;
+}
+
+int pcm_is_ready(struct pcm *pcm)
+{
+    return pcm && pcm->ring != NULL;
+}
+
+const char *pcm_get_error(struct pcm *pcm)
+{
+    return (pcm && pcm->error) ? pcm->error : "";
+}
+
+unsigned int pcm_get_buffer_size(struct pcm *pcm)
+{
+    return (unsigned int)pcm->dev.size;
+}
+
+int pcm_get_poll_fd(struct pcm *pcm)
+{
+    if (pcm->poll_fd < 0)
+        pcm->poll_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return pcm->poll_fd;
+}
+
+int pcm_start(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -EBADFD;
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    if (!pcm->dev.running)
+        device_start(&pcm->dev, fake_now_ns());
+    pthread_mutex_unlock(&pcm->dev.lock);
+    return 0;
+}
+
+/* Pending frames are dropped as SNDRV_PCM_IOCTL_DROP does */
+int pcm_stop(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -EBADFD;
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    device_update(&pcm->dev, fake_now_ns());
+    pcm->dev.running = false;
+    pcm->dev.appl = pcm->dev.hw;
+    pcm->stops++;
+    if (pcm->status)
+        pcm->status->state = SNDRV_PCM_STATE_SETUP;
+    pthread_cond_broadcast(&pcm->wake);
+    pthread_mutex_unlock(&pcm->dev.lock);
+    return 0;
+}
+
+/*
+ * Waits in real time until given frames are available, with device lock held.
+ * A stalled device is polled, and pcm_stop() from other thread aborts the wait as kernel does.
+ */
+static int pcm_wait_avail(struct pcm *pcm, uint64_t frames)
+{
+    unsigned int stops = pcm->stops;
+
+    for (;;) {
+        int64_t now_ns = fake_now_ns();
+        int64_t wait_ns;
+        struct timespec ts;
+        uint64_t avail;
+
+        device_update(&pcm->dev, now_ns);
+        avail = device_avail(&pcm->dev);
+        if (avail >= frames)
+            return 0;
+        if (pcm->stops != stops) {
+            pcm->error = "stopped while waiting";
+            return -EBADFD;
+        }
+
+        wait_ns = (int64_t)((frames - avail) * 1000000000ULL / pcm->dev.rate) + 1;
+        if (wait_ns > 5000000LL)
+            wait_ns = 5000000LL;
+        fake_timespec(now_ns + wait_ns, &ts);
+        pthread_cond_timedwait(&pcm->wake, &pcm->dev.lock, &ts);
+    }
+}
+
+static inline bool pcm_blocks(struct pcm *pcm)
+{
+    return atomic_load_explicit(&fake_realtime, memory_order_relaxed) ||
+           (pcm->dev.capture && atomic_load_explicit(&fake_capture_stalled, memory_order_relaxed));
+}
+
+int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    unsigned int frames;
+    int64_t now_ns;
+
+    if (!pcm_is_ready(pcm) || !(pcm->flags & PCM_IN)) {
+        if (pcm)
+            pcm->error = "not a capture device";
+        return -EINVAL;
+    }
+
+    frames = count / pcm->frame_bytes;
+    now_ns = fake_now_ns();
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    if (!pcm->dev.running)
+        device_start(&pcm->dev, now_ns);
+    device_update(&pcm->dev, now_ns);
+    while (frames > 0) {
+        unsigned int chunk = frames;
+        uint64_t avail;
+
+        if (chunk > pcm->dev.size)
+            chunk = (unsigned int)pcm->dev.size;
+        avail = device_avail(&pcm->dev);
+        if (avail < chunk) {
+            if (!pcm_blocks(pcm)) {
+                device_skip(&pcm->dev, chunk - avail);
+            } else if (pcm_wait_avail(pcm, chunk) != 0) {
+                pthread_mutex_unlock(&pcm->dev.lock);
+                return -EBADFD;
+            }
+        }
+
+        pcm_ring_copy(pcm, pcm->dev.appl, data, chunk, false);
+        pcm->dev.appl += chunk;
+        data = (char *)data + chunk * pcm->frame_bytes;
+        frames -= chunk;
+    }
+    pthread_mutex_unlock(&pcm->dev.lock);
+
+    stat_add(&stat_pcm_frames_read, count / pcm->frame_bytes);
+    return 0;
+}
+
+int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    unsigned int frames;
+    int64_t now_ns;
+
+    if (!pcm_is_ready(pcm) || (pcm->flags & PCM_IN)) {
+        if (pcm)
+            pcm->error = "not a playback device";
+        return -EINVAL;
+    }
+
+    frames = count / pcm->frame_bytes;
+    now_ns = fake_now_ns();
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    device_update(&pcm->dev, now_ns);
+    while (frames > 0) {
+        unsigned int chunk = frames;
+        uint64_t avail;
+
+        if (chunk > pcm->dev.size)
+            chunk = (unsigned int)pcm->dev.size;
+        avail = device_avail(&pcm->dev);
+        if (avail < chunk) {
+            // Full ring starts the device as start threshold cannot be above buffer size
+            if (!pcm->dev.running)
+                device_start(&pcm->dev, fake_now_ns());
+            if (!pcm_blocks(pcm)) {
+                device_skip(&pcm->dev, chunk - avail);
+            } else if (pcm_wait_avail(pcm, chunk) != 0) {
+                pthread_mutex_unlock(&pcm->dev.lock);
+                return -EBADFD;
+            }
+        }
+
+        pcm_ring_copy(pcm, pcm->dev.appl, (void *)data, chunk, true);
+        pcm->dev.appl += chunk;
+        data = (const char *)data + chunk * pcm->frame_bytes;
+        frames -= chunk;
+
+        if (!pcm->dev.running && pcm->dev.appl - pcm->dev.hw >= pcm->start_threshold)
+            device_start(&pcm->dev, now_ns);
+    }
+    pthread_mutex_unlock(&pcm->dev.lock);
+
+    stat_add(&stat_pcm_frames_written, count / pcm->frame_bytes);
+    return 0;
+}
+
+int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail, struct timespec *tstamp)
+{
+    int64_t now_ns = fake_now_ns();
+    int ret = 0;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    stat_add(&stat_timestamps, 1);
+    pthread_mutex_lock(&pcm->dev.lock);
+    if (pcm->dev.running) {
+        device_update(&pcm->dev, now_ns);
+        *avail = (unsigned int)device_avail(&pcm->dev);
+        fake_timespec(now_ns, tstamp);
+    } else
+        ret = -1;
+    pthread_mutex_unlock(&pcm->dev.lock);
+
+    return ret;
+}
+
+int pcm_mmap_begin(struct pcm *pcm, void **areas, unsigned int *offset, unsigned int *frames)
+{
+    uint64_t avail;
+
+    if (!pcm_is_ready(pcm) || !(pcm->flags & PCM_MMAP))
+        return -EINVAL;
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    device_update(&pcm->dev, fake_now_ns());
+    avail = device_avail(&pcm->dev);
+    *areas = pcm->ring;
+    *offset = (unsigned int)(pcm->dev.appl % pcm->dev.size);
+    if (avail > pcm->dev.size - *offset)
+        avail = pcm->dev.size - *offset;
+    if (avail > *frames && *frames != 0)
+        avail = *frames;
+    *frames = (unsigned int)avail;
+    pthread_mutex_unlock(&pcm->dev.lock);
+
+    return 0;
+}
+
+int pcm_mmap_commit(struct pcm *pcm, unsigned int offset, unsigned int frames)
+{
+    if (!pcm_is_ready(pcm) || !(pcm->flags & PCM_MMAP) || offset != pcm->dev.appl % pcm->dev.size)
+        return -EINVAL;
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    pcm->dev.appl += frames;
+    pthread_mutex_unlock(&pcm->dev.lock);
+
+    return (int)frames;
+}
+
+int pcm_mmap_get_hw_ptr(struct pcm *pcm, unsigned int *hw_ptr, struct timespec *tstamp)
+{
+    int64_t now_ns = fake_now_ns();
+
+    if (!pcm_is_ready(pcm) || !hw_ptr || !tstamp)
+        return -EINVAL;
+
+    pthread_mutex_lock(&pcm->dev.lock);
+    device_update(&pcm->dev, now_ns);
+    *hw_ptr = (unsigned int)pcm->dev.hw;
+    fake_timespec(now_ns, tstamp);
+    pcm_status_update(pcm, now_ns);
+    pthread_mutex_unlock(&pcm->dev.lock);
+    stat_add(&stat_hw_syncs, 1);
+
+    return 0;
+}
+
+
+/*
+ * Mixer
+ *
+ * struct mixer starts with the same layout as tinyalsa, as Audio Proxy polls its fd directly.
+ * Control values live in the card, so route and proxy mixers see the same values.
+ * The fd is a pipe, and a value change of a control sends SNDRV_CTL_EVENT_ELEM to every
+ * subscribed mixer of the card as kernel does. Controls added later, as by a late codec probe,
+ * send add events the same way and show up in a mixer after mixer_add_new_ctls().
+ */
+struct fake_card {
+    unsigned int num_ctls;
+    unsigned int max_ctls;      // allocated, so added controls don't move values of opened mixers
+    char (*names)[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+    int (*values)[FAKE_CTL_VALUES];
+    struct mixer *mixers;       // opened mixers
+};
+
+struct mixer {
+    int fd;
+    struct snd_ctl_card_info card_info;
+    struct snd_ctl_elem_info *elem_info;
+    struct mixer_ctl *ctl;
+    unsigned int count;
+
+    // Fake only
+    struct fake_card *fcard;
+    struct mixer *next;
+    int event_fd;               // write end of fd
+    bool subscribed;
+};
+
+struct mixer_ctl {
+    struct mixer *mixer;
+    struct snd_ctl_elem_info *info;
+    int *values;
+};
+
+static struct fake_card fake_cards[FAKE_MAX_CARDS];
+static unsigned int fake_num_ctls = FAKE_BACKEND_DEFAULT_CTLS;
+static pthread_mutex_t fake_card_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Controls looked up by name in Audio Proxy, they come last as worst case of linear search
+static const char * const fake_named_ctls[] = {
+    ABOX_MUTE_CONTROL_NAME,
+    ABOX_TICKLE_CONTROL_NAME,
+    ABOX_AUDIOMODE_CONTROL_NAME,
+    OFFLOAD_VOLUME_CONTROL_NAME,
+    OFFLOAD_UPSCALE_CONTROL_NAME,
+    SPK_AMPL_POWER_NAME,
+    MIXER_CTL_ABOX_MMAP_OUT_VOLUME_CONTROL,
+};
+#define FAKE_NAMED_CTLS (sizeof(fake_named_ctls) / sizeof(fake_named_ctls[0]))
+
+static const char * const fake_ctl_blocks[] = {
+    "ABOX", "SPK", "MIC", "DMIC", "RCV", "HP", "BT", "VTS", "USB", "ADC", "DAC", "AIF",
+};
+static const char * const fake_ctl_units[] = {
+    "SPUS IN", "SPUM ASRC", "RDMA", "WDMA", "UAIF", "DSIF", "SIFS", "NSRC", "MIXP", "ERAP",
+};
+static const char * const fake_ctl_kinds[] = {
+    "Volume", "Switch", "Mux", "Gain", "Rate",
+};
+#define FAKE_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static struct fake_card *fake_get_card(unsigned int card)
+{
+    struct fake_card *fcard;
+    unsigned int generated;
+
+    if (card >= FAKE_MAX_CARDS)
+        return NULL;
+
+    pthread_mutex_lock(&fake_card_lock);
+    fcard = &fake_cards[card];
+    if (fcard->names == NULL) {
+        fcard->num_ctls = fake_num_ctls > FAKE_NAMED_CTLS ? fake_num_ctls : FAKE_NAMED_CTLS;
+        fcard->max_ctls = fcard->num_ctls + FAKE_LATE_CTLS;
+        fcard->names = calloc(fcard->max_ctls, sizeof(*fcard->names));
+        fcard->values = calloc(fcard->max_ctls, sizeof(*fcard->values));
+        if (!fcard->names || !fcard->values) {
+            free(fcard->names);
+            free(fcard->values);
+            fcard->names = NULL;
+            fcard->values = NULL;
+            fcard = NULL;
+        } else {
+            generated = fcard->num_ctls - FAKE_NAMED_CTLS;
+            for (unsigned int i = 0; i < generated; i++) {
+                unsigned int b = FAKE_ARRAY_SIZE(fake_ctl_blocks), u = FAKE_ARRAY_SIZE(fake_ctl_units);
+                snprintf(fcard->names[i], sizeof(fcard->names[i]), "%s %s%u %s",
+                         fake_ctl_blocks[i % b], fake_ctl_units[(i / b) % u], i / (b * u),
+                         fake_ctl_kinds[i % FAKE_ARRAY_SIZE(fake_ctl_kinds)]);
+            }
+            for (unsigned int i = 0; i < FAKE_NAMED_CTLS; i++)
+                snprintf(fcard->names[generated + i], sizeof(fcard->names[0]), "%s", fake_named_ctls[i]);
+        }
+    }
+    pthread_mutex_unlock(&fake_card_lock);
+
+    return fcard;
+}
+
+void fake_backend_set_num_ctls(unsigned int num_ctls)
+{
+    pthread_mutex_lock(&fake_card_lock);
+    fake_num_ctls = num_ctls ? num_ctls : FAKE_BACKEND_DEFAULT_CTLS;
+    for (unsigned int card = 0; card < FAKE_MAX_CARDS; card++) {
+        free(fake_cards[card].names);
+        free(fake_cards[card].values);
+        memset(&fake_cards[card], 0, sizeof(fake_cards[card]));
+    }
+    pthread_mutex_unlock(&fake_card_lock);
+}
+
+const char *fake_backend_ctl_name(unsigned int index)
+{
+    struct fake_card *fcard = fake_get_card(0);
+
+    return (fcard && index < fcard->num_ctls) ? fcard->names[index] : NULL;
+}
+
+unsigned int fake_backend_num_ctls(void)
+{
+    struct fake_card *fcard = fake_get_card(0);
+
+    return fcard ? fcard->num_ctls : 0;
+}
+
+/* Fills controls of mixer from given index up to its count */
+static void fake_init_ctls(struct mixer *mixer, struct fake_card *fcard, unsigned int from)
+{
+    for (unsigned int i = from; i < mixer->count; i++) {
+        struct snd_ctl_elem_info *info = &mixer->elem_info[i];
+
+        info->id.numid = i + 1;
+        info->id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+        snprintf((char *)info->id.name, sizeof(info->id.name), "%s", fcard->names[i]);
+        info->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+        info->count = FAKE_CTL_VALUES;
+    }
+    // elem_info may have moved, so all controls point to it again
+    for (unsigned int i = 0; i < mixer->count; i++) {
+        mixer->ctl[i].mixer = mixer;
+        mixer->ctl[i].info = &mixer->elem_info[i];
+        mixer->ctl[i].values = fcard->values[i];
+    }
+}
+
+struct mixer *mixer_open(unsigned int card)
+{
+    struct fake_card *fcard = fake_get_card(card);
+    struct mixer *mixer;
+    int fds[2];
+
+    if (!fcard)
+        return NULL;
+
+    mixer = (struct mixer *)calloc(1, sizeof(struct mixer));
+    if (!mixer)
+        return NULL;
+
+    mixer->count = fcard->num_ctls;
+    mixer->elem_info = calloc(mixer->count, sizeof(struct snd_ctl_elem_info));
+    mixer->ctl = calloc(mixer->count, sizeof(struct mixer_ctl));
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0) {
+        mixer->fd = fds[0];
+        mixer->event_fd = fds[1];
+    } else {
+        mixer->fd = -1;
+        mixer->event_fd = -1;
+    }
+    if (!mixer->elem_info || !mixer->ctl || mixer->fd < 0) {
+        mixer_close(mixer);
+        return NULL;
+    }
+
+    snprintf((char *)mixer->card_info.id, sizeof(mixer->card_info.id), "fake%u", card);
+    fake_init_ctls(mixer, fcard, 0);
+
+    pthread_mutex_lock(&fake_card_lock);
+    mixer->fcard = fcard;
+    mixer->next = fcard->mixers;
+    fcard->mixers = mixer;
+    pthread_mutex_unlock(&fake_card_lock);
+
+    return mixer;
+}
+
+void mixer_close(struct mixer *mixer)
+{
+    if (!mixer)
+        return ;
+
+    if (mixer->fcard) {
+        pthread_mutex_lock(&fake_card_lock);
+        for (struct mixer **link = &mixer->fcard->mixers; *link; link = &(*link)->next) {
+            if (*link == mixer) {
+                *link = mixer->next;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&fake_card_lock);
+    }
+
+    if (mixer->fd >= 0)
+        close(mixer->fd);
+    if (mixer->event_fd >= 0)
+        close(mixer->event_fd);
+    free(mixer->ctl);
+    free(mixer->elem_info);
+    free(mixer);
+}
+
+int mixer_subscribe_events(struct mixer *mixer, int subscribe)
+{
+    if (!mixer)
+        return -EINVAL;
+
+    pthread_mutex_lock(&fake_card_lock);
+    mixer->subscribed = subscribe != 0;
+    pthread_mutex_unlock(&fake_card_lock);
+    return 0;
+}
+
+/* Sends event of the control with given mask to subscribed mixers of the card, a full pipe drops it */
+static void fake_notify(struct fake_card *fcard, unsigned int index, unsigned int mask)
+{
+    struct snd_ctl_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = SNDRV_CTL_EVENT_ELEM;
+    event.data.elem.mask = mask;
+    event.data.elem.id.numid = index + 1;
+    event.data.elem.id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+    snprintf((char *)event.data.elem.id.name, sizeof(event.data.elem.id.name), "%s", fcard->names[index]);
+
+    for (struct mixer *mixer = fcard->mixers; mixer; mixer = mixer->next) {
+        if (mixer->subscribed && write(mixer->event_fd, &event, sizeof(event)) != sizeof(event))
+            ALOGV("%s: event queue of mixer is full", __func__);
+    }
+}
+
+/* Sends value event of the control to subscribed mixers */
+static void fake_notify_value(struct mixer_ctl *ctl)
+{
+    pthread_mutex_lock(&fake_card_lock);
+    fake_notify(ctl->mixer->fcard, ctl->info->id.numid - 1, SNDRV_CTL_EVENT_MASK_VALUE);
+    pthread_mutex_unlock(&fake_card_lock);
+}
+
+unsigned int fake_backend_add_ctls(unsigned int count)
+{
+    struct fake_card *fcard = fake_get_card(0);
+    unsigned int added = 0;
+
+    if (!fcard)
+        return 0;
+
+    pthread_mutex_lock(&fake_card_lock);
+    while (added < count && fcard->num_ctls < fcard->max_ctls) {
+        unsigned int index = fcard->num_ctls++;
+
+        snprintf(fcard->names[index], sizeof(fcard->names[index]), "LATE CODEC%u Switch",
+                 index - (fcard->max_ctls - FAKE_LATE_CTLS));
+        fake_notify(fcard, index, SNDRV_CTL_EVENT_MASK_ADD);
+        added++;
+    }
+    pthread_mutex_unlock(&fake_card_lock);
+
+    return added;
+}
+
+/* Resolves controls added to card since open, tinyalsa reallocates its arrays here too */
+int mixer_add_new_ctls(struct mixer *mixer)
+{
+    struct snd_ctl_elem_info *elem_info;
+    struct mixer_ctl *ctl;
+    unsigned int count, from;
+
+    if (!mixer)
+        return -EINVAL;
+
+    pthread_mutex_lock(&fake_card_lock);
+    count = mixer->fcard ? mixer->fcard->num_ctls : mixer->count;
+    pthread_mutex_unlock(&fake_card_lock);
+    if (count <= mixer->count)
+        return 0;
+
+    elem_info = realloc(mixer->elem_info, count * sizeof(*elem_info));
+    if (!elem_info)
+        return -ENOMEM;
+    mixer->elem_info = elem_info;
+    ctl = realloc(mixer->ctl, count * sizeof(*ctl));
+    if (!ctl) {
+        fake_init_ctls(mixer, mixer->fcard, mixer->count);
+        return -ENOMEM;
+    }
+    mixer->ctl = ctl;
+
+    memset(&elem_info[mixer->count], 0, (count - mixer->count) * sizeof(*elem_info));
+    from = mixer->count;
+    mixer->count = count;
+    fake_init_ctls(mixer, mixer->fcard, from);
+    return 0;
+}
+
+unsigned int mixer_get_num_ctls(struct mixer *mixer)
+{
+    return mixer ? mixer->count : 0;
+}
+
+struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
+{
+    if (mixer && id < mixer->count)
+        return &mixer->ctl[id];
+    return NULL;
+}
+
+/* Linear search as tinyalsa */
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    stat_add(&stat_ctl_lookups, 1);
+    if (!mixer || !name)
+        return NULL;
+
+    for (unsigned int i = 0; i < mixer->count; i++)
+        if (strcmp(name, (const char *)mixer->elem_info[i].id.name) == 0)
+            return &mixer->ctl[i];
+    return NULL;
+}
+
+const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
+{
+    return ctl ? (const char *)ctl->info->id.name : NULL;
+}
+
+int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    if (!ctl || id >= FAKE_CTL_VALUES)
+        return -EINVAL;
+    return ctl->values[id];
+}
+
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
+{
+    if (!ctl || id >= FAKE_CTL_VALUES)
+        return -EINVAL;
+
+    stat_add(&stat_ctl_writes, 1);
+    if (ctl->values[id] != value) {
+        ctl->values[id] = value;
+        fake_notify_value(ctl);
+    }
+    return 0;
+}
+
+int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
+{
+    if (!ctl || !array || count > FAKE_CTL_VALUES)
+        return -EINVAL;
+
+    memcpy(array, ctl->values, count * sizeof(int));
+    return 0;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
+{
+    if (!ctl || !array || count > FAKE_CTL_VALUES)
+        return -EINVAL;
+
+    stat_add(&stat_ctl_writes, 1);
+    if (memcmp(ctl->values, array, count * sizeof(int)) != 0) {
+        memcpy(ctl->values, array, count * sizeof(int));
+        fake_notify_value(ctl);
+    }
+    return 0;
+}
+
+/* Fake controls have no enum items, any string is accepted as the first one */
+int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
+{
+    if (!ctl || !string)
+        return -EINVAL;
+
+    stat_add(&stat_ctl_writes, 1);
+    if (ctl->values[0] != 0) {
+        ctl->values[0] = 0;
+        fake_notify_value(ctl);
+    }
+    return 0;
+}
+
+
+/*
+ * Audio Route
+ *
+ * Paths are kept in a list and searched by name as audio_route does, and a path is added
+ * at its first use instead of being parsed from XML. update_mixer compares all controls,
+ * and writes only changed ones. *_and_update_path write only changed controls of the path,
+ * in forward order for apply and in reverse order for reset.
+ */
+struct fake_route_path {
+    char name[FAKE_PATH_NAME_LEN];
+    unsigned int ctls[FAKE_PATH_CTLS];
+    int value;
+};
+
+struct audio_route {
+    struct mixer *mixer;
+    unsigned int num_ctls;
+    int *target;                // value to be written at next update
+    int *current;               // value written at last update
+    struct fake_route_path *paths;
+    unsigned int num_paths;
+    unsigned int max_paths;
+};
+
+static uint32_t fake_path_hash(const char *name)
+{
+    uint32_t hash = 5381;
+
+    while (*name)
+        hash = hash * 33 + (uint8_t)*name++;
+    return hash;
+}
+
+static struct fake_route_path *fake_route_get_path(struct audio_route *ar, const char *name)
+{
+    struct fake_route_path *path;
+    uint32_t hash;
+
+    for (unsigned int i = 0; i < ar->num_paths; i++)
+        if (strcmp(ar->paths[i].name, name) == 0)
+            return &ar->paths[i];
+
+    if (ar->num_paths == ar->max_paths) {
+        unsigned int max_paths = ar->max_paths ? ar->max_paths * 2 : 64;
+        struct fake_route_path *paths = realloc(ar->paths, max_paths * sizeof(*paths));
+        if (!paths)
+            return NULL;
+        ar->paths = paths;
+        ar->max_paths = max_paths;
+    }
+
+    path = &ar->paths[ar->num_paths++];
+    snprintf(path->name, sizeof(path->name), "%s", name);
+    hash = fake_path_hash(name);
+    for (unsigned int i = 0; i < FAKE_PATH_CTLS; i++) {
+        path->ctls[i] = hash % ar->num_ctls;
+        hash = hash * 2654435761u + i + 1;
+    }
+    path->value = (int)(fake_path_hash(name) % 100) + 1;
+
+    return path;
+}
+
+struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
+{
+    struct audio_route *ar;
+
+    ar = (struct audio_route *)calloc(1, sizeof(struct audio_route));
+    if (!ar)
+        return NULL;
+
+    ar->mixer = mixer_open(card);
+    if (!ar->mixer) {
+        ALOGE("%s: cannot open fake mixer of card %u", __func__, card);
+        free(ar);
+        return NULL;
+    }
+
+    ar->num_ctls = mixer_get_num_ctls(ar->mixer);
+    ar->target = calloc(ar->num_ctls, sizeof(int));
+    ar->current = calloc(ar->num_ctls, sizeof(int));
+    if (!ar->target || !ar->current) {
+        audio_route_free(ar);
+        return NULL;
+    }
+
+    ALOGV("%s: fake audio route for %s", __func__, xml_path ? xml_path : "(null)");
+    return ar;
+}
+
+void audio_route_free(struct audio_route *ar)
+{
+    if (!ar)
+        return ;
+
+    mixer_close(ar->mixer);
+    free(ar->target);
+    free(ar->current);
+    free(ar->paths);
+    free(ar);
+}
+
+int audio_route_apply_path(struct audio_route *ar, const char *name)
+{
+    struct fake_route_path *path;
+
+    if (!ar || !name || !(path = fake_route_get_path(ar, name)))
+        return -1;
+
+    for (unsigned int i = 0; i < FAKE_PATH_CTLS; i++)
+        ar->target[path->ctls[i]] = path->value;
+    stat_add(&stat_route_paths, 1);
+    return 0;
+}
+
+int audio_route_reset_path(struct audio_route *ar, const char *name)
+{
+    struct fake_route_path *path;
+
+    if (!ar || !name || !(path = fake_route_get_path(ar, name)))
+        return -1;
+
+    for (unsigned int i = 0; i < FAKE_PATH_CTLS; i++)
+        ar->target[path->ctls[i]] = 0;
+    stat_add(&stat_route_paths, 1);
+    return 0;
+}
+
+int audio_route_update_mixer(struct audio_route *ar)
+{
+    if (!ar)
+        return -1;
+
+    for (unsigned int i = 0; i < ar->num_ctls; i++) {
+        if (ar->target[i] != ar->current[i]) {
+            mixer_ctl_set_value(mixer_get_ctl(ar->mixer, i), 0, ar->target[i]);
+            ar->current[i] = ar->target[i];
+        }
+    }
+    stat_add(&stat_route_updates, 1);
+    return 0;
+}
+
+static int fake_route_update_path(struct audio_route *ar, const char *name, bool reverse)
+{
+    struct fake_route_path *path = fake_route_get_path(ar, name);
+
+    if (!path)
+        return -1;
+
+    for (unsigned int n = 0; n < FAKE_PATH_CTLS; n++) {
+        unsigned int i = path->ctls[reverse ? FAKE_PATH_CTLS - 1 - n : n];
+
+        if (ar->target[i] != ar->current[i]) {
+            mixer_ctl_set_value(mixer_get_ctl(ar->mixer, i), 0, ar->target[i]);
+            ar->current[i] = ar->target[i];
+        }
+    }
+    stat_add(&stat_route_updates, 1);
+    return 0;
+}
+
+int audio_route_apply_and_update_path(struct audio_route *ar, const char *name)
+{
+    if (audio_route_apply_path(ar, name) < 0)
+        return -1;
+    return fake_route_update_path(ar, name, false);
+}
+
+int audio_route_reset_and_update_path(struct audio_route *ar, const char *name)
+{
+    if (audio_route_reset_path(ar, name) < 0)
+        return -1;
+    return fake_route_update_path(ar, name, true);
+}
+
+
+/*
+ * Compress Device
+ *
+ * Decoded rate is taken as 16bit stereo PCM of codec sample rate.
+ */
+#define FAKE_COMPR_FRAME_BYTES  4
+
+struct compress {
+    struct fake_device dev;
+    struct compr_config config;
+    unsigned int sample_rate;
+    bool ready;
+    bool paused;
+    int nonblock;
+    struct compr_gapless_mdata gapless;
+    const char *error;
+};
+
+struct compress *compress_open(unsigned int card, unsigned int device, unsigned int flags,
+                               struct compr_config *config)
+{
+    struct compress *compress;
+
+    compress = (struct compress *)calloc(1, sizeof(struct compress));
+    if (!compress)
+        return NULL;
+
+    if (!config || config->fragment_size == 0 || config->fragments == 0) {
+        compress->error = "invalid compress config";
+        return compress;
+    }
+
+    compress->config = *config;
+    compress->sample_rate = (config->codec && config->codec->sample_rate) ? config->codec->sample_rate : 48000;
+    device_init(&compress->dev, compress->sample_rate * FAKE_COMPR_FRAME_BYTES,
+                (uint64_t)config->fragment_size * config->fragments, false);
+    compress->ready = true;
+
+    ALOGV("%s: card %u device %u flags %#x fragment %u x %u", __func__, card, device, flags,
+          config->fragment_size, config->fragments);
+    return compress;
+}
+
+void compress_close(struct compress *compress)
+{
+    if (!compress)
+        return ;
+
+    if (compress->ready)
+        pthread_mutex_destroy(&compress->dev.lock);
+    free(compress);
+}
+
+bool is_compress_ready(struct compress *compress)
+{
+    return compress && compress->ready;
+}
+
+const char *compress_get_error(struct compress *compress)
+{
+    return (compress && compress->error) ? compress->error : "";
+}
+
+void compress_nonblock(struct compress *compress, int nonblock)
+{
+    if (compress)
+        compress->nonblock = nonblock;
+}
+
+/* Data is not kept, only the ring position moves and accepted bytes are hashed */
+int compress_write(struct compress *compress, const void *buf, unsigned int size)
+{
+    const uint8_t *bytes = (const uint8_t *)buf;
+    uint64_t avail, hash;
+    unsigned int written, i;
+
+    if (!is_compress_ready(compress) || !buf)
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    avail = device_avail(&compress->dev);
+    if (avail < size && !compress->nonblock) {
+        // Blocking write waits until whole buffer fits, or ring is empty for the bigger one
+        uint64_t needed = (size > compress->dev.size ? compress->dev.size : size) - avail;
+        if (compress->dev.running && !compress->paused)
+            device_skip(&compress->dev, needed);
+        avail = device_avail(&compress->dev);
+    }
+    written = (unsigned int)(avail < size ? avail : size);
+    compress->dev.appl += written;
+
+    // Running FNV-1a of all accepted bytes, so only one Compress Device is written at a time
+    hash = atomic_load_explicit(&stat_compr_checksum, memory_order_relaxed);
+    for (i = 0; i < written; i++)
+        hash = (hash ^ bytes[i]) * FAKE_FNV_PRIME;
+    atomic_store_explicit(&stat_compr_checksum, hash, memory_order_relaxed);
+    pthread_mutex_unlock(&compress->dev.lock);
+
+    stat_add(&stat_compr_bytes_written, written);
+    if (written > 0)
+        stat_add(&stat_compr_writes, 1);
+    return (int)written;
+}
+
+/* Never sleeps, the device clock moves forward by up to one fragment, or timeout_ms if shorter */
+int compress_wait(struct compress *compress, int timeout_ms)
+{
+    int ret = 0;
+
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    if (device_avail(&compress->dev) < compress->config.fragment_size) {
+        uint64_t needed = compress->config.fragment_size - device_avail(&compress->dev);
+
+        if (compress->dev.running && !compress->paused) {
+            if (timeout_ms >= 0 && needed > (uint64_t)timeout_ms * compress->dev.rate / 1000)
+                needed = (uint64_t)timeout_ms * compress->dev.rate / 1000;
+            device_skip(&compress->dev, needed);
+        }
+        if (device_avail(&compress->dev) < compress->config.fragment_size) {
+            compress->error = "poll timed out";
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&compress->dev.lock);
+
+    return ret;
+}
+
+int compress_start(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_start(&compress->dev, fake_now_ns());
+    compress->paused = false;
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+int compress_stop(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    compress->dev.running = false;
+    compress->dev.appl = compress->dev.hw;
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+int compress_pause(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    compress->dev.running = false;
+    compress->paused = true;
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+int compress_resume(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    if (compress->paused)
+        device_start(&compress->dev, fake_now_ns());
+    compress->paused = false;
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+/* Plays out all queued data at once */
+int compress_drain(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    if (compress->dev.running && compress->dev.appl > compress->dev.hw)
+        device_skip(&compress->dev, compress->dev.appl - compress->dev.hw);
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+int compress_partial_drain(struct compress *compress)
+{
+    return compress_drain(compress);
+}
+
+int compress_next_track(struct compress *compress)
+{
+    return is_compress_ready(compress) ? 0 : -1;
+}
+
+int compress_set_gapless_metadata(struct compress *compress, struct compr_gapless_mdata *mdata)
+{
+    if (!is_compress_ready(compress) || !mdata)
+        return -1;
+
+    compress->gapless = *mdata;
+    return 0;
+}
+
+int compress_get_tstamp(struct compress *compress, unsigned long *samples, unsigned int *sampling_rate)
+{
+    if (!is_compress_ready(compress))
+        return -1;
+
+    pthread_mutex_lock(&compress->dev.lock);
+    device_update(&compress->dev, fake_now_ns());
+    *samples = (unsigned long)(compress->dev.hw / FAKE_COMPR_FRAME_BYTES);
+    *sampling_rate = compress->sample_rate;
+    pthread_mutex_unlock(&compress->dev.lock);
+    return 0;
+}
+
+
+void fake_backend_set_realtime(bool realtime)
+{
+    atomic_store_explicit(&fake_realtime, realtime, memory_order_relaxed);
+}
+
+void fake_backend_set_capture_stall(bool stall)
+{
+    atomic_store_explicit(&fake_capture_stalled, stall, memory_order_relaxed);
+}
+
+void fake_backend_get_stats(struct fake_backend_stats *stats)
+{
+    stats->pcm_opens = atomic_load_explicit(&stat_pcm_opens, memory_order_relaxed);
+    stats->pcm_frames_read = atomic_load_explicit(&stat_pcm_frames_read, memory_order_relaxed);
+    stats->pcm_frames_written = atomic_load_explicit(&stat_pcm_frames_written, memory_order_relaxed);
+    stats->compr_bytes_written = atomic_load_explicit(&stat_compr_bytes_written, memory_order_relaxed);
+    stats->virtual_ns = atomic_load_explicit(&stat_virtual_ns, memory_order_relaxed);
+    stats->xruns = atomic_load_explicit(&stat_xruns, memory_order_relaxed);
+    stats->ctl_lookups = atomic_load_explicit(&stat_ctl_lookups, memory_order_relaxed);
+    stats->ctl_writes = atomic_load_explicit(&stat_ctl_writes, memory_order_relaxed);
+    stats->route_paths = atomic_load_explicit(&stat_route_paths, memory_order_relaxed);
+    stats->route_updates = atomic_load_explicit(&stat_route_updates, memory_order_relaxed);
+    stats->timestamps = atomic_load_explicit(&stat_timestamps, memory_order_relaxed);
+    stats->compr_writes = atomic_load_explicit(&stat_compr_writes, memory_order_relaxed);
+    stats->sleeps = atomic_load_explicit(&stat_sleeps, memory_order_relaxed);
+    stats->hw_syncs = atomic_load_explicit(&stat_hw_syncs, memory_order_relaxed);
+    stats->compr_checksum = atomic_load_explicit(&stat_compr_checksum, memory_order_relaxed);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EXYNOS_AUDIOPROXY_FAKE_BACKEND_H__
+#define __EXYNOS_AUDIOPROXY_FAKE_BACKEND_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fake tinyalsa, tinycompress and audio_route for running Audio Proxy on host
+ *
+ * PCM and Compress Devices are in-memory rings. Their hardware position is derived from
+ * CLOCK_MONOTONIC and the configured rate, as Audio Proxy reads that clock by itself.
+ * A read or write which would block on real device moves the device clock forward instead
+ * of sleeping, and the skipped time is counted as virtual time, unless real time is set.
+ *
+ * Each card has one set of mixer controls, shared by all mixers opened on it.
+ * Audio routes create a path at its first use, and set a few controls chosen by its name.
+ */
+
+#define FAKE_BACKEND_DEFAULT_CTLS   1200
+
+struct fake_backend_stats {
+    uint64_t pcm_opens;
+    uint64_t pcm_frames_read;
+    uint64_t pcm_frames_written;
+    uint64_t compr_bytes_written;
+    uint64_t virtual_ns;            // device time moved forward instead of blocking
+    uint64_t xruns;
+    uint64_t ctl_lookups;           // mixer_get_ctl_by_name() calls
+    uint64_t ctl_writes;
+    uint64_t route_paths;           // applied or reset paths
+    uint64_t route_updates;
+    uint64_t timestamps;            // pcm_get_htimestamp() calls
+    uint64_t compr_writes;          // compress_write() calls which accepted data
+    uint64_t compr_checksum;        // FNV-1a of all bytes accepted by compress_write()
+    uint64_t sleeps;                // fake_clock_nanosleep() calls on virtual clock
+    uint64_t hw_syncs;              // pcm_mmap_get_hw_ptr() calls
+};
+
+/* Number of controls of each card, 0 means default. Has to be called while no mixer is opened */
+void fake_backend_set_num_ctls(unsigned int num_ctls);
+
+/* Name of card 0 control, or NULL if index is out of range */
+const char *fake_backend_ctl_name(unsigned int index);
+unsigned int fake_backend_num_ctls(void);
+
+/*
+ * Adds controls to card 0 as a late probed codec does, up to 64 after card is created, and sends
+ * their add events to subscribed mixers. Returns number of added controls.
+ */
+unsigned int fake_backend_add_ctls(unsigned int count);
+
+/* PCM Devices block in real time as kernel does, instead of moving their clock forward */
+void fake_backend_set_realtime(bool realtime);
+
+/* Capture PCM Devices produce no frames while stalled, blocked reads wait for pcm_stop() */
+void fake_backend_set_capture_stall(bool stall);
+
+/*
+ * Virtual CLOCK_MONOTONIC of fake devices, also seen by Audio Proxy through fake_clock_gettime()
+ * and fake_clock_nanosleep().
+ * It starts from real time and moves only by advance, or when a device not blocking in real time
+ * needs frames. Blocking waits of real time devices don't move it, so don't mix both.
+ */
+void fake_backend_set_virtual_clock(bool enable);
+void fake_backend_advance_clock(int64_t ns);
+int fake_clock_gettime(clockid_t clock, struct timespec *ts);
+int fake_clock_nanosleep(clockid_t clock, int flags, const struct timespec *request,
+                         struct timespec *remain);
+
+/* Device clocks run faster than CLOCK_MONOTONIC by ppm, and hardware pointers move in DMA bursts */
+void fake_backend_set_clock_drift(int ppm);
+void fake_backend_set_pointer_granularity(unsigned int units);
+
+/*
+ * MMAP PCM Devices have a status page in a shared memory region, mapped from their poll fd at
+ * SNDRV_PCM_MMAP_OFFSET_STATUS as kernel maps it from PCM fd. Hardware pointer sync updates it,
+ * and so does this call for all running ones, as a period interrupt or DSP position update would.
+ */
+void fake_backend_update_status(void);
+
+void fake_backend_get_stats(struct fake_backend_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __EXYNOS_AUDIOPROXY_FAKE_BACKEND_H__
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "audio_proxy_fake"
+
+#include <log/log.h>
+
+#include "audio_resampler.h"
+
+/*
+ * Host build of libaudioutils has no resampler, so default engine of Capture Stream is
+ * served by medium quality Polyphase Resampler on host.
+ */
+int create_resampler(uint32_t inSampleRate, uint32_t outSampleRate, uint32_t channelCount,
+                     uint32_t quality, struct resampler_buffer_provider *provider,
+                     struct resampler_itfe **rs)
+{
+    ALOGV("%s: polyphase resampler for quality %u", __func__, quality);
+    return create_polyphase_resampler(inSampleRate, outSampleRate, channelCount,
+                                      RESAMPLER_ENGINE_POLYPHASE_MEDIUM, provider, rs);
+}
+
+void release_resampler(struct resampler_itfe *resampler)
+{
+    release_polyphase_resampler(resampler);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+/*
+ * Mixer Updater Thread on the fake mixer, whose fd is a pipe. Added controls of fake card send
+ * SNDRV_CTL_EVENT_ELEM add events through it as a late probed codec does.
+ */
+class MixerUpdateTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_NE(nullptr, test_proxy());
+        ASSERT_TRUE(test_start_mixer_update());
+    }
+
+    void TearDown() override { test_stop_mixer_update(); }
+};
+
+double cpuMsec() {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+TEST_F(MixerUpdateTest, AddEventMakesControlAvailable) {
+    auto start = steady_clock::now();
+    ASSERT_EQ(1u, fake_backend_add_ctls(1));
+    const std::string name = fake_backend_ctl_name(fake_backend_num_ctls() - 1);
+
+    // Control can be used as soon as Mixer Updater Thread releases mixer_update_lock
+    while (proxy_get_mixer_value_int(test_proxy(), name.c_str()) < 0) {
+        ASSERT_LT(steady_clock::now() - start, milliseconds(1000)) << name << " is not found";
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    auto available = steady_clock::now() - start;
+
+    // Thread ends after the update, as audio_route misses no control any more
+    test_join_mixer_update();
+    auto finished = steady_clock::now() - start;
+
+    unsigned int hits, misses, hits_after, misses_after;
+    test_mixer_ctl_cache_stats(&hits, &misses);
+    EXPECT_EQ(0, proxy_get_mixer_value_int(test_proxy(), name.c_str()));
+    test_mixer_ctl_cache_stats(&hits_after, &misses_after);
+    EXPECT_EQ(hits + 1, hits_after) << "added control is not in control cache";
+    EXPECT_EQ(misses, misses_after);
+
+    EXPECT_LT(available, milliseconds(100));
+    std::cout << "control available in "
+              << std::chrono::duration<double, std::micro>(available).count() << " usec, route in "
+              << std::chrono::duration<double, std::micro>(finished).count() << " usec"
+              << std::endl;
+}
+
+TEST_F(MixerUpdateTest, IdleThreadSleepsAndStopsPromptly) {
+    std::this_thread::sleep_for(milliseconds(10));
+
+    // Waits in poll() without an event, instead of spinning on read() errors
+    double cpu = cpuMsec();
+    std::this_thread::sleep_for(milliseconds(200));
+    EXPECT_LT(cpuMsec() - cpu, 20.0);
+
+    auto start = steady_clock::now();
+    test_stop_mixer_update();
+    EXPECT_LT(steady_clock::now() - start, milliseconds(50));
+}
+
+}  // namespace
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <hardware/audio.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kRate = 48000;
+constexpr int32_t kMinSizeFrames = 480;
+constexpr int64_t kQueryNs = 250000;         // AAudio EXCLUSIVE client polling at 4 KHz
+constexpr int kQueries = 4000;               // 1 sec
+constexpr int kQueriesPerUpdate = 4;         // device updates status page every msec
+
+/*
+ * MMAP Playback or Capture Stream, by the parameter, on fake PCM Device whose status page is
+ * a shared memory region. Both run on the virtual clock, which only the test moves.
+ */
+class MmapPositionTest : public ::testing::TestWithParam<bool> {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+        struct audio_mmap_buffer_info info = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_virtual_clock(true);
+
+        config.sample_rate = kRate;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        if (capture()) {
+            config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+            mStream = proxy_create_capture_stream(test_proxy(), ASTREAM_CAPTURE_MMAP,
+                                                  AUSAGE_RECORDING, &config, NULL);
+            ASSERT_NE(nullptr, mStream);
+            ASSERT_EQ(0, proxy_open_capture_stream(mStream, kMinSizeFrames, &info));
+            ASSERT_EQ(0, proxy_start_capture_stream(mStream));
+        } else {
+            config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+            mStream = proxy_create_playback_stream(test_proxy(), ASTREAM_PLAYBACK_MMAP, &config,
+                                                   NULL);
+            ASSERT_NE(nullptr, mStream);
+            ASSERT_EQ(0, proxy_open_playback_stream(mStream, kMinSizeFrames, &info));
+            ASSERT_EQ(0, proxy_start_playback_stream(mStream));
+        }
+        ASSERT_GT(info.buffer_size_frames, 0);
+
+        struct test_mmap_position_stats stats;
+        test_mmap_position_stats(mStream, &stats);
+        ASSERT_TRUE(stats.status_mapped);
+    }
+
+    void TearDown() override {
+        if (mStream && capture()) {
+            proxy_stop_capture_stream(mStream);
+            proxy_close_capture_stream(mStream);
+            proxy_destroy_capture_stream(mStream);
+        } else if (mStream) {
+            proxy_stop_playback_stream(mStream);
+            proxy_close_playback_stream(mStream);
+            proxy_destroy_playback_stream(mStream);
+        }
+        test_set_mmap_position_stale(0);
+        fake_backend_set_virtual_clock(false);
+    }
+
+    bool capture() const { return GetParam(); }
+
+    uint64_t hwSyncs() {
+        struct fake_backend_stats stats;
+
+        fake_backend_get_stats(&stats);
+        return stats.hw_syncs;
+    }
+
+    int64_t nowNs() {
+        struct timespec ts;
+
+        fake_clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    /*
+     * Queries position and checks that it is not older than the bound, moves forward, and is the
+     * pair device had at that time: fake hardware pointer is exactly rate times time since start.
+     */
+    void query(int64_t stale_ns) {
+        struct audio_mmap_position position = {};
+
+        ASSERT_EQ(0, proxy_get_mmap_position(mStream, &position));
+        int64_t now_ns = nowNs();
+        EXPECT_LE(position.time_nanoseconds, now_ns);
+        if (stale_ns > 0) {
+            EXPECT_LT(now_ns - position.time_nanoseconds, stale_ns);
+        }
+        if (mQueries > 0) {
+            EXPECT_GE(position.time_nanoseconds, mLast.time_nanoseconds);
+            EXPECT_GE(position.position_frames, mLast.position_frames);
+
+            int64_t expected = mFirst.position_frames +
+                               (position.time_nanoseconds - mFirst.time_nanoseconds) * kRate /
+                               1000000000LL;
+            EXPECT_LE(std::llabs(position.position_frames - expected), 1)
+                    << "at " << position.time_nanoseconds;
+        } else
+            mFirst = position;
+        mLast = position;
+        mQueries++;
+    }
+
+    std::string dump() {
+        int fds[2];
+        char text[8192];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        if (capture())
+            proxy_dump_capture_stream(mStream, fds[1]);
+        else
+            proxy_dump_playback_stream(mStream, fds[1]);
+        close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    void *mStream = nullptr;
+    struct audio_mmap_position mFirst = {}, mLast = {};
+    int mQueries = 0;
+};
+
+// Without the bound, as before the service, each query syncs hardware pointer
+TEST_P(MmapPositionTest, DefaultBoundSyncsEveryQuery) {
+    uint64_t syncs = hwSyncs();
+
+    for (int i = 0; i < kQueries; i++) {
+        fake_backend_advance_clock(kQueryNs);
+        query(0);
+    }
+
+    struct test_mmap_position_stats stats;
+    test_mmap_position_stats(mStream, &stats);
+    EXPECT_EQ(static_cast<unsigned int>(kQueries), stats.queries);
+    EXPECT_EQ(stats.queries, stats.hw_reads);
+    EXPECT_EQ(0u, stats.cached);
+    EXPECT_EQ(0u, stats.status_reads);
+    EXPECT_EQ(static_cast<uint64_t>(kQueries), hwSyncs() - syncs);
+}
+
+// Device doesn't update status page by itself, so the cached pair saves all but one of 4 ioctls
+TEST_P(MmapPositionTest, CachesWithinBound) {
+    const unsigned int stale_us = 1000;
+    uint64_t syncs = hwSyncs();
+
+    test_set_mmap_position_stale(stale_us);
+    for (int i = 0; i < kQueries; i++) {
+        fake_backend_advance_clock(kQueryNs);
+        query(stale_us * 1000LL);
+    }
+
+    struct test_mmap_position_stats stats;
+    test_mmap_position_stats(mStream, &stats);
+    EXPECT_EQ(static_cast<unsigned int>(kQueries), stats.queries);
+    EXPECT_EQ(0u, stats.status_reads);
+    EXPECT_LE(stats.hw_reads, kQueries / 4 + 1u);
+    EXPECT_EQ(stats.queries, stats.cached + stats.hw_reads);
+    EXPECT_EQ(stats.hw_reads, hwSyncs() - syncs);
+    EXPECT_EQ(0u, stats.errors);
+}
+
+// Device updates status page every msec, so no query needs an ioctl
+TEST_P(MmapPositionTest, ServesStatusPageWithoutIoctl) {
+    const unsigned int stale_us = 2000;
+    uint64_t syncs = hwSyncs();
+
+    test_set_mmap_position_stale(stale_us);
+    for (int i = 0; i < kQueries; i++) {
+        fake_backend_advance_clock(kQueryNs);
+        if (i % kQueriesPerUpdate == 0)
+            fake_backend_update_status();
+        query(stale_us * 1000LL);
+    }
+
+    struct test_mmap_position_stats stats;
+    test_mmap_position_stats(mStream, &stats);
+    EXPECT_EQ(0u, stats.hw_reads);
+    EXPECT_EQ(0u, hwSyncs() - syncs);
+    EXPECT_GE(stats.status_reads, kQueries / 8u);
+    EXPECT_EQ(stats.queries, stats.cached + stats.status_reads);
+    EXPECT_NE(std::string::npos,
+              dump().find("mmap position: " + std::to_string(kQueries) + " queries"));
+}
+
+// Status page which device stopped updating gets older than the bound, and ioctls take over
+TEST_P(MmapPositionTest, StaleStatusPageFallsBackToIoctl) {
+    const unsigned int stale_us = 2000;
+
+    test_set_mmap_position_stale(stale_us);
+    for (int i = 0; i < kQueries; i++) {
+        fake_backend_advance_clock(kQueryNs);
+        if (i < kQueries / 2 && i % kQueriesPerUpdate == 0)
+            fake_backend_update_status();
+        query(stale_us * 1000LL);
+    }
+
+    struct test_mmap_position_stats stats;
+    test_mmap_position_stats(mStream, &stats);
+    EXPECT_GT(stats.status_reads, 0u);
+    EXPECT_GE(stats.hw_reads, kQueries / 2 / 8u);
+    EXPECT_LE(stats.hw_reads, kQueries / 2 / 8u + 1);
+}
+
+// Stop drops the cached pair and status page, so the next query syncs the stopped device
+TEST_P(MmapPositionTest, StopInvalidatesCache) {
+    struct audio_mmap_position position = {};
+
+    test_set_mmap_position_stale(1000);
+    fake_backend_advance_clock(kQueryNs);
+    fake_backend_update_status();
+    query(0);
+
+    if (capture()) {
+        ASSERT_EQ(0, proxy_stop_capture_stream(mStream));
+    } else {
+        ASSERT_EQ(0, proxy_stop_playback_stream(mStream));
+    }
+    fake_backend_advance_clock(kQueryNs);
+    ASSERT_EQ(0, proxy_get_mmap_position(mStream, &position));
+
+    struct test_mmap_position_stats stats;
+    test_mmap_position_stats(mStream, &stats);
+    EXPECT_EQ(0u, stats.cached);
+    EXPECT_EQ(1u, stats.status_reads);
+    EXPECT_EQ(1u, stats.hw_reads);
+    EXPECT_EQ(nowNs(), position.time_nanoseconds);
+    // Stopped at the time of the first query
+    EXPECT_EQ(mFirst.position_frames, position.position_frames);
+}
+
+INSTANTIATE_TEST_SUITE_P(Streams, MmapPositionTest, ::testing::Values(false, true),
+                         [](const ::testing::TestParamInfo<bool> &info) {
+                             return info.param ? "capture" : "playback";
+                         });
+
+}  // namespace
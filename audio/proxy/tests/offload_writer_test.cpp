@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+#include "audio_offload.h"
+
+namespace {
+
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+constexpr size_t kHalBuffer = 32 * 1024;     // AudioFlinger Offload Thread buffer
+constexpr unsigned int kFragment = 4096;     // fragment size of Compress Offload
+constexpr int64_t kPlayNs = 60000000000LL;   // one minute of decoded audio
+
+uint64_t fnv(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * kFnvPrime;
+    return hash;
+}
+
+int64_t nowNs() {
+    struct timespec ts;
+
+    fake_clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+struct Playback {
+    uint64_t accepted = 0;          // bytes Audio Proxy accepted from Offload Thread
+    uint64_t device_bytes = 0;      // bytes Compress Device accepted
+    uint64_t device_writes = 0;
+    uint64_t checksum = 0;          // expected FNV-1a of device data
+    uint64_t device_checksum = 0;
+    unsigned int hal_calls = 0;     // writes and waits of Offload Thread
+    int64_t elapsed_ns = 0;
+    std::string dump;
+};
+
+/*
+ * MP3 Compress Offload Stream in nonblocking mode on fake Compress Device, which consumes
+ * decoded rate of 48KHz stereo 16bit from 5 fragments of 4KB, a whole fragment at a time as
+ * DSP does. Fake devices run on the virtual clock, so waits move time instead of sleeping.
+ */
+class OffloadWriterTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_virtual_clock(true);
+        fake_backend_set_pointer_granularity(kFragment);
+
+        mData.resize(kHalBuffer * 7 + 123);  // doesn't line up with fragments nor HAL buffers
+        for (size_t i = 0; i < mData.size(); i++)
+            mData[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+    }
+
+    void TearDown() override {
+        test_set_offload_writer(false);
+        fake_backend_set_pointer_granularity(0);
+        fake_backend_set_virtual_clock(false);
+    }
+
+    void *open(bool writer) {
+        struct audio_config config = {};
+
+        test_set_offload_writer(writer);
+        config.sample_rate = 48000;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_MP3;
+        config.offload_info.format = AUDIO_FORMAT_MP3;
+        config.offload_info.bit_rate = 128000;
+
+        void *stream = proxy_create_playback_stream(test_proxy(), ASTREAM_PLAYBACK_COMPR_OFFLOAD,
+                                                    &config, NULL);
+        EXPECT_NE(nullptr, stream);
+        if (stream == nullptr)
+            return nullptr;
+        proxy_offload_set_nonblock(stream);
+        EXPECT_EQ(0, proxy_open_playback_stream(stream, 0, NULL));
+        return stream;
+    }
+
+    void close(void *stream) {
+        proxy_stop_playback_stream(stream);
+        proxy_close_playback_stream(stream);
+        proxy_destroy_playback_stream(stream);
+    }
+
+    /*
+     * Offload Thread writes a buffer, and waits for Compress Device only when the write was
+     * short, as AudioFlinger does in nonblocking mode. Stream starts after its first write.
+     */
+    Playback play(void *stream, int64_t play_ns) {
+        struct fake_backend_stats before, after;
+        Playback result;
+        size_t offset = 0;
+        int64_t start_ns = nowNs();
+        bool started = false;
+
+        fake_backend_get_stats(&before);
+        result.checksum = before.compr_checksum;
+
+        while (nowNs() - start_ns < play_ns) {
+            size_t size = std::min(kHalBuffer, mData.size() - offset);
+            int wrote = proxy_write_playback_buffer(stream, &mData[offset], static_cast<int>(size));
+
+            result.hal_calls++;
+            if (wrote < 0) {
+                ADD_FAILURE() << "write failed with " << wrote;
+                break;
+            }
+            result.checksum = fnv(result.checksum, &mData[offset], wrote);
+            result.accepted += wrote;
+            offset = (offset + wrote) % mData.size();
+
+            if (!started) {
+                EXPECT_EQ(0, proxy_start_playback_stream(stream));
+                started = true;
+            }
+            if (static_cast<size_t>(wrote) < size) {
+                EXPECT_EQ(0, proxy_offload_compress_func(stream, COMPRESS_TYPE_WAIT));
+                result.hal_calls++;
+            }
+        }
+        // End of track, everything accepted has to reach Compress Device before drain returns
+        EXPECT_EQ(0, proxy_offload_compress_func(stream, COMPRESS_TYPE_DRAIN));
+
+        fake_backend_get_stats(&after);
+        result.elapsed_ns = nowNs() - start_ns;
+        result.device_bytes = after.compr_bytes_written - before.compr_bytes_written;
+        result.device_writes = after.compr_writes - before.compr_writes;
+        result.device_checksum = after.compr_checksum;
+        result.dump = dump(stream);
+        return result;
+    }
+
+    std::string dump(void *stream) {
+        int fds[2];
+        char text[8192];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        proxy_dump_playback_stream(stream, fds[1]);
+        ::close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        ::close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    std::vector<uint8_t> mData;
+};
+
+TEST_F(OffloadWriterTest, DirectWritesAreByteExact) {
+    void *stream = open(false);
+    ASSERT_NE(nullptr, stream);
+    Playback direct = play(stream, kPlayNs);
+    close(stream);
+
+    EXPECT_EQ(direct.accepted, direct.device_bytes);
+    EXPECT_EQ(direct.checksum, direct.device_checksum);
+    EXPECT_NE(std::string::npos, direct.dump.find("Offload Writer: disabled"));
+}
+
+TEST_F(OffloadWriterTest, WriterIsByteExactWithFewerWakeups) {
+    void *stream = open(false);
+    ASSERT_NE(nullptr, stream);
+    Playback direct = play(stream, kPlayNs);
+    close(stream);
+
+    stream = open(true);
+    ASSERT_NE(nullptr, stream);
+    Playback writer = play(stream, kPlayNs);
+    close(stream);
+
+    std::cout << "direct: " << direct.hal_calls << " HAL calls, "
+              << direct.device_bytes / std::max<uint64_t>(direct.device_writes, 1)
+              << " bytes per device write" << std::endl;
+    std::cout << "writer: " << writer.hal_calls << " HAL calls, "
+              << writer.device_bytes / std::max<uint64_t>(writer.device_writes, 1)
+              << " bytes per device write" << std::endl;
+
+    EXPECT_EQ(writer.accepted, writer.device_bytes);
+    EXPECT_EQ(writer.checksum, writer.device_checksum);
+
+    // Offload Thread wakes up when half of 256KB queue is free, not for every 4KB fragment
+    EXPECT_LT(writer.hal_calls * 4, direct.hal_calls);
+    // Writer Thread writes whole fragments only, except for the tail at drain
+    EXPECT_GE(writer.device_bytes / writer.device_writes, kFragment);
+    EXPECT_NE(std::string::npos, writer.dump.find("Offload Writer: enabled"));
+    EXPECT_NE(std::string::npos, writer.dump.find("Offload wakeups per minute: HAL "));
+    EXPECT_NE(std::string::npos, writer.dump.find("Offload bytes per write: "));
+}
+
+TEST_F(OffloadWriterTest, StopDiscardsQueue) {
+    void *stream = open(true);
+    ASSERT_NE(nullptr, stream);
+
+    // Before start, 20KB fills Compress Device and the rest stays in the queue
+    int wrote = proxy_write_playback_buffer(stream, mData.data(), static_cast<int>(kHalBuffer * 2));
+    EXPECT_EQ(static_cast<int>(kHalBuffer * 2), wrote);
+    EXPECT_EQ(0, proxy_stop_playback_stream(stream));
+
+    // Restarted stream takes a full queue again
+    wrote = proxy_write_playback_buffer(stream, mData.data(), static_cast<int>(mData.size()));
+    EXPECT_EQ(static_cast<int>(mData.size()), wrote);
+    close(stream);
+}
+
+}  // namespace
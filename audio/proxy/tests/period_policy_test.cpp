@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cutils/str_parms.h>
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kRate = 48000;
+constexpr unsigned int kChannels = 2;
+
+/*
+ * Write trace of a mixer thread: time it spends out of each write, mixing and waiting to be
+ * scheduled, in usec. A blocking write returns once its period fits, so the kernel buffer is full
+ * whenever the thread leaves a write, and a trace entry longer than the buffer underruns it.
+ */
+struct TraceShape {
+    unsigned int writes;
+    unsigned int idle_min_us;
+    unsigned int idle_max_us;
+    unsigned int stall_every;       // every Nth write comes after a stall, 0 for none
+    unsigned int stall_us;
+};
+
+std::vector<unsigned int> makeTrace(const TraceShape &shape, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<unsigned int> idle(shape.idle_min_us, shape.idle_max_us);
+    std::vector<unsigned int> trace(shape.writes);
+
+    for (unsigned int i = 0; i < shape.writes; i++)
+        trace[i] = (shape.stall_every && i % shape.stall_every == shape.stall_every - 1)
+                           ? shape.stall_us
+                           : idle(rng);
+    return trace;
+}
+
+// Low Latency writes 2 msec periods into 4 of them at most
+constexpr TraceShape kSteady = {2000, 100, 600, 0, 0};       // light mixing
+constexpr TraceShape kBusy = {2000, 100, 600, 250, 3000};    // 3 msec preemptions
+constexpr TraceShape kStalls = {2000, 100, 600, 400, 7000};  // 7 msec stalls, as at CPU hotplug
+
+// Deep Buffer writes 20 msec periods
+constexpr TraceShape kDeep = {600, 500, 3000, 0, 0};
+
+/*
+ * Playback Stream with Adaptive Period Policy on fake PCM Device and the virtual clock. Each
+ * session opens the stream, replays a write trace and goes to standby, where the policy decides.
+ */
+class PeriodPolicyTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_virtual_clock(true);
+        test_set_adaptive_period(true);
+    }
+
+    void TearDown() override {
+        if (mStream)
+            proxy_destroy_playback_stream(mStream);
+        setScreen(true);
+        test_set_adaptive_period(false);
+        fake_backend_set_virtual_clock(false);
+    }
+
+    void create(int type) {
+        struct audio_config config = {};
+
+        config.sample_rate = kRate;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_playback_stream(test_proxy(), type, &config, NULL);
+        ASSERT_NE(nullptr, mStream);
+    }
+
+    void setScreen(bool on) {
+        struct str_parms *parms = str_parms_create_str(on ? "screen_state=on" : "screen_state=off");
+
+        proxy_set_parameters(test_proxy(), parms);
+        str_parms_destroy(parms);
+    }
+
+    uint64_t deviceXruns() {
+        struct fake_backend_stats stats;
+
+        fake_backend_get_stats(&stats);
+        return stats.xruns;
+    }
+
+    // Replays trace from open to standby, returns underruns of the device
+    uint64_t runSession(const std::vector<unsigned int> &trace) {
+        const unsigned int period = proxy_get_actual_period_size(mStream);
+        std::vector<int16_t> buffer(period * kChannels);
+        uint64_t xruns;
+
+        EXPECT_EQ(0, proxy_open_playback_stream(mStream, 0, NULL));
+        EXPECT_EQ(0, proxy_start_playback_stream(mStream));
+        xruns = deviceXruns();
+        for (unsigned int idle_us : trace) {
+            fake_backend_advance_clock(idle_us * 1000LL);
+            EXPECT_EQ(static_cast<int>(buffer.size() * sizeof(int16_t)),
+                      proxy_write_playback_buffer(mStream, buffer.data(),
+                                                  buffer.size() * sizeof(int16_t)));
+        }
+        xruns = deviceXruns() - xruns;
+        mDump = dump();
+        proxy_stop_playback_stream(mStream);
+        proxy_close_playback_stream(mStream);
+        return xruns;
+    }
+
+    struct test_period_policy policy() {
+        struct test_period_policy policy;
+
+        test_period_policy(mStream, &policy);
+        return policy;
+    }
+
+    std::string dump() {
+        int fds[2];
+        char text[8192];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        proxy_dump_playback_stream(mStream, fds[1]);
+        close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    void *mStream = nullptr;
+    std::string mDump;               // taken before standby of the last session
+};
+
+// Steady mixing needs 3 periods. Stalls underrun them once, and the count steps back for good.
+TEST_F(PeriodPolicyTest, LowLatencyShrinksAndStepsBackAtUnderrun) {
+    create(ASTREAM_PLAYBACK_LOW_LATENCY);
+    ASSERT_EQ(4u, policy().base_count);
+
+    EXPECT_EQ(0u, runSession(makeTrace(kSteady, 1)));
+    EXPECT_EQ(3u, policy().count);
+    EXPECT_EQ(1u, policy().shrinks);
+
+    EXPECT_EQ(0u, runSession(makeTrace(kBusy, 2)));
+    EXPECT_EQ(3u, policy().count);
+    EXPECT_NE(std::string::npos, mDump.find("output period policy: 96 x 3 frames (base 96 x 4)"));
+
+    EXPECT_GT(runSession(makeTrace(kStalls, 3)), 0u);
+    EXPECT_EQ(4u, policy().count);
+    EXPECT_EQ(1u, policy().grows);
+
+    for (unsigned int seed = 4; seed < 7; seed++)
+        EXPECT_EQ(0u, runSession(makeTrace(kSteady, seed)));
+    EXPECT_EQ(4u, policy().count);
+    EXPECT_EQ(1u, policy().shrinks);
+    EXPECT_EQ(96u, policy().size);
+}
+
+// Stalls from the start keep the whole buffer, which covers them without underrun
+TEST_F(PeriodPolicyTest, LowLatencyKeepsDepthForStalls) {
+    create(ASTREAM_PLAYBACK_LOW_LATENCY);
+
+    for (unsigned int seed = 1; seed < 4; seed++)
+        EXPECT_EQ(0u, runSession(makeTrace(kStalls, seed)));
+    EXPECT_EQ(4u, policy().count);
+    EXPECT_EQ(0u, policy().shrinks);
+    EXPECT_EQ(0u, policy().grows);
+}
+
+// Deep Buffer period grows 4 times at the first standby with screen off, and comes back with it
+TEST_F(PeriodPolicyTest, DeepBufferGrowsWhileScreenOff) {
+    create(ASTREAM_PLAYBACK_DEEP_BUFFER);
+    const unsigned int base = policy().base_size;
+
+    EXPECT_EQ(0u, runSession(makeTrace(kDeep, 1)));
+    EXPECT_EQ(base, policy().size);
+
+    setScreen(false);
+    EXPECT_EQ(0u, runSession(makeTrace(kDeep, 2)));
+    EXPECT_EQ(base * 4, policy().size);
+    EXPECT_EQ(1u, policy().grows);
+    // AudioFlinger keeps writing the base period
+    EXPECT_EQ(base, proxy_get_actual_period_size(mStream));
+    EXPECT_NE(std::string::npos, mDump.find("screen off, period"));
+
+    setScreen(true);
+    EXPECT_EQ(0u, runSession(makeTrace(kDeep, 3)));
+    EXPECT_EQ(base, policy().size);
+    EXPECT_EQ(1u, policy().restores);
+}
+
+}  // namespace
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kRate = 48000;
+constexpr unsigned int kChannels = 2;
+constexpr unsigned int kRefreshMs = 20;
+constexpr unsigned int kDriftBoundPpm = 2000;
+constexpr unsigned int kGranularity = 48;    // hardware pointer moves by 1 msec DMA bursts
+constexpr int64_t kStepNs = 1000000;         // AAudio and A/V sync query every msec
+
+/*
+ * Primary Playback Stream on fake PCM Device, whose clock drifts from CLOCK_MONOTONIC by the
+ * parameter in ppm. Both run on the virtual clock, so minutes of playback take a few seconds.
+ */
+class PositionModelTest : public ::testing::TestWithParam<int> {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_virtual_clock(true);
+        fake_backend_set_clock_drift(GetParam());
+        fake_backend_set_pointer_granularity(kGranularity);
+        test_set_position_model(kRefreshMs, kDriftBoundPpm);
+
+        config.sample_rate = kRate;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_playback_stream(test_proxy(), ASTREAM_PLAYBACK_PRIMARY, &config,
+                                               NULL);
+        ASSERT_NE(nullptr, mStream);
+        ASSERT_EQ(0, proxy_open_playback_stream(mStream, 0, NULL));
+        ASSERT_EQ(0, proxy_start_playback_stream(mStream));
+        mPeriod = proxy_get_actual_period_size(mStream);
+        mSilence.resize(mPeriod * kChannels);
+
+        // Fills kernel buffer, so the device starts
+        for (unsigned int i = 0; i < proxy_get_actual_period_count(mStream); i++)
+            write();
+    }
+
+    void TearDown() override {
+        if (mStream) {
+            proxy_stop_playback_stream(mStream);
+            proxy_close_playback_stream(mStream);
+            proxy_destroy_playback_stream(mStream);
+        }
+        test_set_position_model(0, kDriftBoundPpm);
+        fake_backend_set_pointer_granularity(0);
+        fake_backend_set_clock_drift(0);
+        fake_backend_set_virtual_clock(false);
+    }
+
+    void write() {
+        const int bytes = static_cast<int>(mSilence.size() * sizeof(int16_t));
+
+        ASSERT_EQ(bytes, proxy_write_playback_buffer(mStream, mSilence.data(), bytes));
+    }
+
+    uint64_t timestamps() {
+        struct fake_backend_stats stats;
+
+        fake_backend_get_stats(&stats);
+        return stats.timestamps;
+    }
+
+    /*
+     * Plays for given msec with a query every msec, and writes a period whenever the kernel
+     * buffer has room, as Playback Thread does. Returns the largest difference of reported
+     * frames from the hardware timestamp at the same time.
+     */
+    int64_t play(unsigned int msec, bool write_periods = true) {
+        int64_t max_error = 0;
+
+        for (unsigned int ms = 0; ms < msec; ms++) {
+            uint64_t frames = 0, raw = 0;
+            unsigned int avail = 0;
+            struct timespec timestamp;
+
+            fake_backend_advance_clock(kStepNs);
+
+            uint64_t before = timestamps();
+            EXPECT_EQ(0, proxy_get_presen_position(mStream, &frames, &timestamp));
+            mIoctls += timestamps() - before;
+            mQueries++;
+
+            EXPECT_GE(frames, mLastFrames) << "position went backward at " << ms << " msec";
+            mLastFrames = frames;
+
+            if (test_raw_position(mStream, &raw, &avail)) {
+                int64_t error = std::llabs(static_cast<int64_t>(frames - raw));
+                if (error > max_error)
+                    max_error = error;
+            }
+            while (write_periods && avail >= mPeriod) {
+                write();
+                avail -= mPeriod;
+            }
+        }
+        return max_error;
+    }
+
+    std::string dump() {
+        int fds[2];
+        char text[8192];
+        ssize_t size;
+
+        if (pipe(fds) != 0)
+            return "";
+        proxy_dump_playback_stream(mStream, fds[1]);
+        close(fds[1]);
+        size = ::read(fds[0], text, sizeof(text) - 1);
+        close(fds[0]);
+        return std::string(text, size > 0 ? size : 0);
+    }
+
+    void *mStream = nullptr;
+    unsigned int mPeriod = 0;
+    std::vector<int16_t> mSilence;
+    uint64_t mLastFrames = 0;
+    uint64_t mQueries = 0;
+    uint64_t mIoctls = 0;
+};
+
+TEST_P(PositionModelTest, TracksDriftingClockWithFewTimestamps) {
+    // One minute of playback
+    int64_t max_error = play(60000);
+    struct test_position_stats stats;
+
+    test_position_stats(mStream, &stats);
+    std::cout << "drift " << GetParam() << " ppm: max error " << max_error << " frames, "
+              << mIoctls << " hardware timestamps for " << mQueries << " queries, "
+              << stats.resets << " resets, fitted " << stats.rate << " Hz, model max error "
+              << stats.error_max_us << " usec" << std::endl;
+
+    // Hardware pointer itself is off by up to a DMA burst, so allow two of them
+    EXPECT_LE(max_error, 2 * static_cast<int64_t>(kGranularity));
+    EXPECT_EQ(0u, stats.resets);
+    // Fitted rate stays within drift bound, even if device clock drifts further
+    EXPECT_NEAR(kRate, stats.rate, kRate * kDriftBoundPpm / 1000000.0 + 0.01);
+    // One per refresh interval, plus the ones before the model has two samples to fit
+    EXPECT_LE(mIoctls, mQueries / kRefreshMs + kRefreshMs);
+    EXPECT_LT(stats.error_max_us, 2 * kGranularity * 1000000 / kRate);
+
+    std::string text = dump();
+    EXPECT_NE(std::string::npos, text.find("output position model: "));
+    EXPECT_NE(std::string::npos, text.find("output position model error: "));
+}
+
+TEST_P(PositionModelTest, RestartsAfterUnderrun) {
+    play(1000);
+    // Playback Thread is late by 10 periods, hardware stops at the end of written frames
+    play(10 * mPeriod * 1000 / kRate, false);
+    int64_t max_error = play(1000);
+    struct test_position_stats stats;
+
+    test_position_stats(mStream, &stats);
+    EXPECT_GE(stats.resets, 1u);
+    EXPECT_LE(max_error, static_cast<int64_t>(mPeriod));
+    // Once restarted, the model follows the hardware again
+    EXPECT_LE(play(1000), 2 * static_cast<int64_t>(kGranularity));
+}
+
+// Within drift bound, and beyond it where fitted rate is clamped
+INSTANTIATE_TEST_SUITE_P(Drift, PositionModelTest, ::testing::Values(-1000, 0, 300, 1000, 5000));
+
+}  // namespace
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * System headers of audio_proxy.c come first. Host C libraries name some struct fields
+ * __unused, so the bionic attribute can be defined only after they are included.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+
+#ifndef __unused
+#define __unused __attribute__((__unused__))
+#endif
+
+/* Audio Proxy reads and sleeps on CLOCK_MONOTONIC of fake backend, which can be virtual */
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+#define clock_gettime fake_clock_gettime
+#define clock_nanosleep fake_clock_nanosleep
+
+/* Board info is read from and cached in host temporary files, see proxy_test_hooks.h */
+#include <system/audio.h>
+#include "audio_board_info.h"
+#undef BOARD_INFO_XML_PATH
+#undef BOARD_INFO_CACHE_PATH
+#define BOARD_INFO_XML_PATH TEST_BOARD_INFO_XML_PATH
+#define BOARD_INFO_CACHE_PATH TEST_BOARD_INFO_CACHE_PATH
+
+#include "../audio_proxy.c"
+
+static char test_mixer_paths[] = "/vendor/etc/mixer_paths.xml";   // not parsed by fake audio_route
+static void *test_proxy_instance;
+static pthread_once_t test_proxy_once = PTHREAD_ONCE_INIT;
+
+static void test_proxy_create(void)
+{
+    void *proxy = proxy_init();
+
+    if (proxy && !proxy_init_route(proxy, test_mixer_paths)) {
+        ALOGE("%s: cannot initialize routes on fake backend", __func__);
+        proxy_deinit(proxy);
+        proxy = NULL;
+    }
+    test_proxy_instance = proxy;
+}
+
+void *test_proxy(void)
+{
+    pthread_once(&test_proxy_once, test_proxy_create);
+    return test_proxy_instance;
+}
+
+void test_set_capture_ring(bool enable)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (aproxy)
+        aproxy->support_capture_ring = enable;
+}
+
+bool test_capture_ring_started(void *proxy_stream)
+{
+    return ((struct audio_proxy_stream *)proxy_stream)->ring.started;
+}
+
+unsigned int test_capture_ring_overruns(void *proxy_stream)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+
+    return atomic_load_explicit(&apstream->ring.overruns, memory_order_relaxed);
+}
+
+unsigned int test_capture_ring_underruns(void *proxy_stream)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+
+    return atomic_load_explicit(&apstream->ring.underruns, memory_order_relaxed);
+}
+
+void test_capture_read_bytes(void *proxy_stream, uint64_t *direct, uint64_t *copied)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+
+    *direct = apstream->bytes_read_direct;
+    *copied = apstream->bytes_read_copied;
+}
+
+void test_set_route_table(bool enable)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (!aproxy)
+        return;
+    destroy_route_table(aproxy);
+    if (enable)
+        build_route_table(aproxy);
+}
+
+unsigned int test_route_usages(void)
+{
+    return ROUTE_USAGE_CNT;
+}
+
+unsigned int test_route_devices(void)
+{
+    return ROUTE_DEVICE_CNT;
+}
+
+const char *test_route_name(audio_usage ausage, device_type device, const char **gain)
+{
+    static char path_name[MAX_PATH_NAME_LEN];
+    static char gain_name[MAX_GAIN_PATH_NAME_LEN];
+    struct route_name route = get_route_name(test_proxy(), ausage, device, path_name, gain_name);
+
+    *gain = route.gain;
+    return route.path;
+}
+
+void test_reroute(audio_usage old_ausage, device_type old_device,
+                  audio_usage new_ausage, device_type new_device)
+{
+    struct audio_proxy *aproxy = test_proxy();
+    struct route_trans trans;
+
+    route_trans_begin(&trans);
+    set_reroute(aproxy, &trans, old_ausage, old_device, new_ausage, new_device);
+    route_trans_commit(aproxy, &trans);
+}
+
+void test_set_mixer_ctl_cache(bool enable)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (!aproxy)
+        return;
+    if (enable)
+        build_mixer_ctl_cache(aproxy);
+    else
+        destroy_mixer_ctl_cache(aproxy);
+}
+
+void test_mixer_ctl_cache_stats(unsigned int *hits, unsigned int *misses)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    *hits = atomic_load_explicit(&aproxy->ctl_cache_hits, memory_order_relaxed);
+    *misses = atomic_load_explicit(&aproxy->ctl_cache_misses, memory_order_relaxed);
+}
+
+bool test_start_mixer_update(void)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    struct snd_ctl_event event;
+
+    if (!aproxy || aproxy->mixer_update_running)
+        return false;
+
+    /*
+     * Drops value events left by earlier route changes. The thread leaves at its first event
+     * which is not an add event, as audio_route_missing_ctl() of this tree reports nothing missing.
+     */
+    while (read(aproxy->mixer->fd, &event, sizeof(event)) == sizeof(event))
+        ;
+
+    aproxy->mixer_update_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (aproxy->mixer_update_stop_fd < 0)
+        return false;
+    if (pthread_create(&aproxy->mixer_update_thread, NULL, mixer_update_loop, aproxy) != 0) {
+        close(aproxy->mixer_update_stop_fd);
+        return false;
+    }
+    aproxy->mixer_update_running = true;
+    return true;
+}
+
+void test_join_mixer_update(void)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (!aproxy || !aproxy->mixer_update_running)
+        return;
+    pthread_join(aproxy->mixer_update_thread, NULL);
+    close(aproxy->mixer_update_stop_fd);
+    aproxy->mixer_update_running = false;
+}
+
+void test_stop_mixer_update(void)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (!aproxy || !aproxy->mixer_update_running)
+        return;
+    eventfd_write(aproxy->mixer_update_stop_fd, 1);
+    test_join_mixer_update();
+}
+
+void *test_telemetry_create(void)
+{
+    return calloc(1, sizeof(struct stream_telemetry));
+}
+
+void test_telemetry_destroy(void *telemetry)
+{
+    free(telemetry);
+}
+
+int64_t test_telemetry_now_ns(void)
+{
+    return telemetry_now_ns();
+}
+
+void test_telemetry_record_latency(void *telemetry, int64_t start_ns)
+{
+    telemetry_record_latency((struct stream_telemetry *)telemetry, start_ns);
+}
+
+void test_telemetry_record_position(void *telemetry, uint64_t frames,
+                                    const struct timespec *timestamp, unsigned int rate)
+{
+    telemetry_record_position((struct stream_telemetry *)telemetry, frames, timestamp, rate);
+}
+
+unsigned int test_calliope_nodes(void)
+{
+    return CALLIOPE_DUMP_NODE_CNT;
+}
+
+const char *test_calliope_node_file(unsigned int node)
+{
+    return node < CALLIOPE_DUMP_NODE_CNT ? calliope_dump_nodes[node].file : NULL;
+}
+
+void test_calliope_snapshot(const char *in_dir, const char *out_dir, const char *suffix)
+{
+    static char last_out_dir[PATH_MAX];
+    char *buf = malloc(CALLIOPE_COPY_BUFFERSIZE);
+
+    if (!buf)
+        return;
+    if (strcmp(last_out_dir, out_dir) != 0) {
+        memset(calliope_dump_index, 0, sizeof(calliope_dump_index));
+        strlcpy(last_out_dir, out_dir, sizeof(last_out_dir));
+    }
+    for (unsigned int node = 0; node < CALLIOPE_DUMP_NODE_CNT; node++)
+        __calliope_dump(node, in_dir, out_dir, suffix, buf);
+    free(buf);
+}
+
+void test_calliope_bytes(uint64_t *spliced, uint64_t *copied)
+{
+    *spliced = atomic_load_explicit(&calliope_dump_stats.bytes_spliced, memory_order_relaxed);
+    *copied = atomic_load_explicit(&calliope_dump_stats.bytes_copied, memory_order_relaxed);
+}
+
+ssize_t test_calliope_copy(int fd_in, int fd_out, bool *spliced)
+{
+    char *buf = malloc(CALLIOPE_COPY_BUFFERSIZE);
+    ssize_t ret = -ENOMEM;
+
+    if (buf) {
+        ret = calliope_copy(fd_in, fd_out, buf, spliced);
+        free(buf);
+    }
+    return ret;
+}
+
+void test_set_position_model(unsigned int refresh_ms, unsigned int drift_ppm)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (aproxy) {
+        aproxy->position_refresh_ms = refresh_ms;
+        aproxy->position_drift_ppm = drift_ppm;
+    }
+}
+
+void test_position_stats(void *proxy_stream, struct test_position_stats *stats)
+{
+    struct position_model *model = &((struct audio_proxy_stream *)proxy_stream)->pos_model;
+
+    stats->queries = model->queries;
+    stats->refreshes = model->refreshes;
+    stats->resets = model->resets;
+    stats->error_max_us = model->error_max_us;
+    stats->rate = model->valid ? model->rate * 1000000000.0 : 0.0;
+}
+
+bool test_raw_position(void *proxy_stream, uint64_t *frames, unsigned int *avail)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+    uint64_t kernel_buffer_size = (uint64_t)apstream->pcmconfig.period_size *
+                                  (uint64_t)apstream->pcmconfig.period_count;
+    struct timespec timestamp;
+
+    if (!apstream->pcm || pcm_get_htimestamp(apstream->pcm, avail, &timestamp) != 0 ||
+        apstream->frames + *avail < kernel_buffer_size)
+        return false;
+    *frames = apstream->frames - kernel_buffer_size + *avail;
+    return true;
+}
+
+void test_set_offload_writer(bool enable)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (aproxy)
+        aproxy->support_offload_writer = enable;
+}
+
+void test_skip_stats(void *proxy_stream, struct test_skip_stats *stats)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+
+    stats->frames = apstream->skip.frames;
+    stats->written_frames = apstream->frames;
+    stats->entries = apstream->skip.entries;
+    stats->resyncs = apstream->skip.resyncs;
+    stats->sleeps = apstream->skip.sleeps;
+    stats->late = apstream->skip.late;
+}
+
+void test_set_adaptive_period(bool enable)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (aproxy)
+        aproxy->support_adaptive_period = enable;
+}
+
+void test_period_policy(void *proxy_stream, struct test_period_policy *policy)
+{
+    struct period_policy *pp = &((struct audio_proxy_stream *)proxy_stream)->period_policy;
+
+    policy->size = pp->size;
+    policy->count = pp->count;
+    policy->base_size = pp->base_size;
+    policy->base_count = pp->base_count;
+    policy->shrinks = pp->shrinks;
+    policy->grows = pp->grows;
+    policy->restores = pp->restores;
+}
+
+void test_set_mmap_position_stale(unsigned int stale_us)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (aproxy)
+        aproxy->mmap_position_stale_us = stale_us;
+}
+
+void test_mmap_position_stats(void *proxy_stream, struct test_mmap_position_stats *stats)
+{
+    struct mmap_position_service *service = &((struct audio_proxy_stream *)proxy_stream)->mmap_pos;
+
+    stats->queries = atomic_load_explicit(&service->queries, memory_order_relaxed);
+    stats->cached = atomic_load_explicit(&service->cached, memory_order_relaxed);
+    stats->status_reads = atomic_load_explicit(&service->status_reads, memory_order_relaxed);
+    stats->hw_reads = atomic_load_explicit(&service->hw_reads, memory_order_relaxed);
+    stats->errors = atomic_load_explicit(&service->errors, memory_order_relaxed);
+    stats->status_mapped = service->status != NULL;
+}
+
+const char *test_load_board_info(unsigned int *num_mic)
+{
+    struct audio_proxy *aproxy = test_proxy();
+
+    if (!aproxy)
+        return NULL;
+    proxy_set_board_info(aproxy);
+    *num_mic = (unsigned int)aproxy->num_mic;
+    return aproxy->board_info_source;
+}
+
+static const struct capture_kernels *test_kernels(bool simd)
+{
+    return simd ? &capture_kernels_simd : &capture_kernels_c;
+}
+
+const char *test_capture_kernels_name(bool simd)
+{
+    return test_kernels(simd)->name;
+}
+
+void test_run_capture_kernel(bool simd, enum test_capture_kernel kernel, int16_t *buf, int16_t *out,
+                             size_t frames)
+{
+    const struct capture_kernels *kernels = test_kernels(simd);
+
+    switch (kernel) {
+        case TEST_KERNEL_SELECT_RX:
+            kernels->select_rx(buf, frames);
+            break;
+        case TEST_KERNEL_SELECT_TX:
+            kernels->select_tx(buf, frames);
+            break;
+        case TEST_KERNEL_MIX_RXTX:
+            kernels->mix_rxtx(buf, frames);
+            break;
+        case TEST_KERNEL_STEREO_TO_MONO:
+            kernels->stereo_to_mono(buf, out, frames);
+            break;
+    }
+}
+
+const char *test_capture_resampler(void *proxy_stream)
+{
+    struct audio_proxy_stream *apstream = (struct audio_proxy_stream *)proxy_stream;
+
+    if (!apstream || !apstream->resampler)
+        return NULL;
+    return resampler_engine_table[apstream->resampler_engine];
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EXYNOS_AUDIOPROXY_TEST_HOOKS_H__
+#define __EXYNOS_AUDIOPROXY_TEST_HOOKS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <system/audio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "audio_streams.h"
+#include "audio_usages.h"
+#include "audio_devices.h"
+#include "audio_proxy_interface.h"
+
+/*
+ * Test Hooks of Audio Proxy
+ *
+ * Host tests and benchmarks build Audio Proxy through proxy_test_hooks.c, which includes
+ * audio_proxy.c itself, so these hooks can reach its static functions and private state.
+ * They are not part of libaudioproxy.
+ */
+
+/* Audio Proxy with routes initialized on the fake backend, created at the first call */
+void *test_proxy(void);
+
+/* Capture Ring Buffer of Capture Streams opened from now on, as ro.vendor.config.capture_ring */
+void test_set_capture_ring(bool enable);
+
+/* Whether PCM Reader Thread of Capture Stream is running, and its counters */
+bool test_capture_ring_started(void *proxy_stream);
+unsigned int test_capture_ring_overruns(void *proxy_stream);
+unsigned int test_capture_ring_underruns(void *proxy_stream);
+
+/* Bytes of Capture Stream read straight into caller's buffer, and copied through actual read buffer */
+void test_capture_read_bytes(void *proxy_stream, uint64_t *direct, uint64_t *copied);
+
+/*
+ * Precompiled Route Table: enable builds it again, disable frees it so names are built at routing.
+ * Numbers of usages and devices it covers, and names of one route from it or built as fallback.
+ */
+void test_set_route_table(bool enable);
+unsigned int test_route_usages(void);
+unsigned int test_route_devices(void);
+const char *test_route_name(audio_usage ausage, device_type device, const char **gain);
+
+/* Moves route from old (usage, device) to new one in one transaction, as reroute of proxy_set_route */
+void test_reroute(audio_usage old_ausage, device_type old_device,
+                  audio_usage new_ausage, device_type new_device);
+
+/* Mixer control cache: disable frees it so names are looked up by mixer_get_ctl_by_name() */
+void test_set_mixer_ctl_cache(bool enable);
+void test_mixer_ctl_cache_stats(unsigned int *hits, unsigned int *misses);
+
+/*
+ * Mixer Updater Thread, which proxy_init_route() starts only if audio_route misses controls.
+ * Start returns false if it is already running. Stop wakes it up as proxy_deinit_route() does,
+ * join waits until it handles an add event and ends by itself. Both wait for it to exit.
+ */
+bool test_start_mixer_update(void);
+void test_stop_mixer_update(void);
+void test_join_mixer_update(void);
+
+/*
+ * Stream telemetry on its own, as each write/read records latency and each presentation
+ * position query records jitter. Created zeroed, and freed by destroy.
+ */
+void *test_telemetry_create(void);
+void test_telemetry_destroy(void *telemetry);
+int64_t test_telemetry_now_ns(void);
+void test_telemetry_record_latency(void *telemetry, int64_t start_ns);
+void test_telemetry_record_position(void *telemetry, uint64_t frames,
+                                    const struct timespec *timestamp, unsigned int rate);
+
+/*
+ * Calliope snapshot of all debug nodes from in_dir into out_dir, both ending with '/', done in
+ * caller's thread as Calliope Dump Worker does. Retention index is reloaded when out_dir changes.
+ */
+unsigned int test_calliope_nodes(void);
+const char *test_calliope_node_file(unsigned int node);
+void test_calliope_snapshot(const char *in_dir, const char *out_dir, const char *suffix);
+void test_calliope_bytes(uint64_t *spliced, uint64_t *copied);
+
+/* Copies one node as snapshot does, sendfile() first and read/write with 64KB buffer as fallback */
+ssize_t test_calliope_copy(int fd_in, int fd_out, bool *spliced);
+
+/* Presentation Position Model of PCM streams, as its properties would set it */
+void test_set_position_model(unsigned int refresh_ms, unsigned int drift_ppm);
+
+/* Accuracy of the model against hardware timestamps, as shown by dump */
+struct test_position_stats {
+    unsigned int queries;
+    unsigned int refreshes;
+    unsigned int resets;
+    unsigned int error_max_us;
+    double rate;                    // fitted rate in Hz, 0 if model is not valid
+};
+void test_position_stats(void *proxy_stream, struct test_position_stats *stats);
+
+/* Position from hardware timestamp as without the model, returns false if there is none */
+bool test_raw_position(void *proxy_stream, uint64_t *frames, unsigned int *avail);
+
+/* Offload Writer of Compress Offload Streams opened from now on, as ro.vendor.config.offload_writer */
+void test_set_offload_writer(bool enable);
+
+/* Skip Clock of Playback Stream while AUX Digital owns the playback path, as shown by dump */
+struct test_skip_stats {
+    uint64_t frames;                // skipped frames
+    uint64_t written_frames;        // all frames accounted as written
+    unsigned int entries;
+    unsigned int resyncs;
+    unsigned int sleeps;
+    unsigned int late;
+};
+void test_skip_stats(void *proxy_stream, struct test_skip_stats *stats);
+
+/* Adaptive Period Policy of Playback Streams created from now on, as ro.vendor.config.adaptive_period */
+void test_set_adaptive_period(bool enable);
+
+/* Period size and count for next open, and decisions so far, as shown by dump */
+struct test_period_policy {
+    unsigned int size;
+    unsigned int count;
+    unsigned int base_size;
+    unsigned int base_count;
+    unsigned int shrinks;
+    unsigned int grows;
+    unsigned int restores;
+};
+void test_period_policy(void *proxy_stream, struct test_period_policy *policy);
+
+/* MMAP Position Service of MMAP streams, with bound as ro.vendor.config.mmap_position_stale_us */
+void test_set_mmap_position_stale(unsigned int stale_us);
+
+/* Where positions were served from, as shown by dump */
+struct test_mmap_position_stats {
+    unsigned int queries;
+    unsigned int cached;
+    unsigned int status_reads;
+    unsigned int hw_reads;
+    unsigned int errors;
+    bool status_mapped;             // PCM status page is mapped
+};
+void test_mmap_position_stats(void *proxy_stream, struct test_mmap_position_stats *stats);
+
+/*
+ * Board info as proxy_init() loads it, from these host files instead of vendor/etc and /data/vendor.
+ * Returns where microphones came from, "xml", "cache" or "none", and how many there are.
+ */
+#define TEST_BOARD_INFO_XML_PATH    "/tmp/audio_proxy_test_board_info.xml"
+#define TEST_BOARD_INFO_CACHE_PATH  "/tmp/audio_proxy_test_board_info.cache"
+const char *test_load_board_info(unsigned int *num_mic);
+
+/* Channel kernels of Call Record and Mono Conversion, scalar ones or the ones selected at build */
+enum test_capture_kernel {
+    TEST_KERNEL_SELECT_RX,
+    TEST_KERNEL_SELECT_TX,
+    TEST_KERNEL_MIX_RXTX,
+    TEST_KERNEL_STEREO_TO_MONO,     // from buf to out, others work in place on buf
+};
+
+const char *test_capture_kernels_name(bool simd);
+void test_run_capture_kernel(bool simd, enum test_capture_kernel kernel, int16_t *buf, int16_t *out,
+                             size_t frames);
+
+/* Name of resampler engine of Capture Stream, or NULL if the stream doesn't resample */
+const char *test_capture_resampler(void *proxy_stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __EXYNOS_AUDIOPROXY_TEST_HOOKS_H__
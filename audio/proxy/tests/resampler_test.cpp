@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "audio_resampler.h"
+}
+
+namespace {
+
+constexpr unsigned int kInRate = 48000;
+constexpr double kAmplitude = 0.89 * 32767;  // -1 dBFS
+
+struct Tone {
+    double amplitude;       // of fundamental
+    double residual;        // RMS of everything else
+};
+
+/*
+ * Resamples 1 sec of a sine wave at freq from 48KHz mono, then fits a sine at freq to the
+ * output after the filter has settled. Analysis covers 500 msec, a whole number of periods
+ * of every tested frequency, so sine and cosine terms are orthogonal.
+ */
+Tone measure(unsigned int out_rate, resampler_engine engine, double freq) {
+    struct resampler_itfe *resampler = nullptr;
+    std::vector<int16_t> in(kInRate), out(out_rate);
+    size_t in_frames = in.size(), out_frames = out.size();
+    const size_t skip = out_rate / 4, count = out_rate / 2;
+    double c = 0, s = 0, power = 0;
+
+    for (size_t i = 0; i < in.size(); i++)
+        in[i] = static_cast<int16_t>(std::lround(kAmplitude * std::sin(2 * M_PI * freq * i / kInRate)));
+
+    EXPECT_EQ(0, create_polyphase_resampler(kInRate, out_rate, 1, engine, nullptr, &resampler));
+    if (resampler == nullptr)
+        return Tone{0, 0};
+    resampler->resample_from_input(resampler, in.data(), &in_frames, out.data(), &out_frames);
+    release_polyphase_resampler(resampler);
+    EXPECT_GE(out_frames, skip + count);
+
+    for (size_t i = skip; i < skip + count; i++) {
+        double phase = 2 * M_PI * freq * i / out_rate;
+        c += out[i] * std::cos(phase);
+        s += out[i] * std::sin(phase);
+        power += static_cast<double>(out[i]) * out[i];
+    }
+    c *= 2.0 / count;
+    s *= 2.0 / count;
+
+    double amplitude = std::hypot(c, s);
+    double residual = power / count - amplitude * amplitude / 2;
+    return Tone{amplitude, std::sqrt(residual > 0 ? residual : 0)};
+}
+
+double dB(double ratio) {
+    return 20 * std::log10(ratio);
+}
+
+struct ResamplerParam {
+    unsigned int rate;
+    resampler_engine engine;
+    double thdn_db;         // THD+N limit of 1KHz tone
+    double passband;        // passband edge relative to output rate, where transition band starts
+    double stopband_db;     // level limit of tones beyond Nyquist of output rate
+};
+
+std::ostream &operator<<(std::ostream &os, const ResamplerParam &param) {
+    return os << param.rate << " Hz with engine " << param.engine;
+}
+
+class ResamplerTest : public ::testing::TestWithParam<ResamplerParam> {
+  protected:
+    unsigned int rate() const { return GetParam().rate; }
+    resampler_engine engine() const { return GetParam().engine; }
+};
+
+TEST_P(ResamplerTest, ThdPlusNoise) {
+    Tone tone = measure(rate(), engine(), 1000);
+    double thdn = dB(tone.residual / (tone.amplitude / M_SQRT2));
+
+    std::cout << GetParam() << ": THD+N " << thdn << " dB" << std::endl;
+    EXPECT_LT(thdn, GetParam().thdn_db);
+}
+
+TEST_P(ResamplerTest, FlatPassband) {
+    for (double ratio : {0.02, 0.25, 0.5, 0.75, 1.0}) {
+        double freq = std::floor(ratio * GetParam().passband * rate() / 50) * 50;
+        double gain = dB(measure(rate(), engine(), freq).amplitude / kAmplitude);
+
+        EXPECT_NEAR(0.0, gain, 0.05) << freq << " Hz";
+    }
+}
+
+TEST_P(ResamplerTest, RejectsAliases) {
+    double worst = -200;
+
+    // Beyond Nyquist of output rate up to input one, a tone would fold back into passband
+    for (double ratio : {0.1, 0.25, 0.5, 0.75, 0.95}) {
+        double freq = std::round((rate() / 2 + ratio * (kInRate - rate()) / 2) / 50) * 50;
+        Tone tone = measure(rate(), engine(), freq);
+        double level = dB(std::hypot(tone.amplitude / M_SQRT2, tone.residual) / (kAmplitude / M_SQRT2));
+
+        EXPECT_LT(level, GetParam().stopband_db) << freq << " Hz";
+        worst = std::max(worst, level);
+    }
+    std::cout << GetParam() << ": stopband " << worst << " dB" << std::endl;
+}
+
+// VoIP rates and CD rate from 48KHz capture
+INSTANTIATE_TEST_SUITE_P(
+        Rates, ResamplerTest,
+        ::testing::Values(ResamplerParam{16000, RESAMPLER_ENGINE_POLYPHASE_HIGH, -94, 0.4, -84},
+                          ResamplerParam{8000, RESAMPLER_ENGINE_POLYPHASE_HIGH, -92, 0.4, -76},
+                          ResamplerParam{44100, RESAMPLER_ENGINE_POLYPHASE_HIGH, -80, 0.4, -80},
+                          ResamplerParam{16000, RESAMPLER_ENGINE_POLYPHASE_MEDIUM, -90, 0.35, -76},
+                          ResamplerParam{16000, RESAMPLER_ENGINE_POLYPHASE_LOW, -90, 0.3, -56}));
+
+}  // namespace
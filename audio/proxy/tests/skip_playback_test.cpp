@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_backend.h"
+#include "proxy_test_hooks.h"
+
+namespace {
+
+constexpr unsigned int kRate = 48000;
+constexpr unsigned int kChannels = 2;
+constexpr unsigned int kWriteFrames = 941;   // not a divisor of the rate, so deadlines round
+constexpr int64_t kMsec = 1000000;
+
+int64_t nowNs() {
+    struct timespec ts;
+
+    fake_clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Primary Playback Stream while AUX Digital owns the playback path, so all its writes are
+ * skipped and paced by Skip Clock. Audio Proxy sleeps on the virtual clock, so a session of
+ * minutes takes a fraction of a second.
+ */
+class SkipPlaybackTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        struct audio_config config = {};
+
+        ASSERT_NE(nullptr, test_proxy());
+        fake_backend_set_virtual_clock(true);
+        ASSERT_TRUE(proxy_set_route(test_proxy(), AUSAGE_MEDIA, DEVICE_AUX_DIGITAL, MODIFIER_NONE, true));
+
+        config.sample_rate = kRate;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        mStream = proxy_create_playback_stream(test_proxy(), ASTREAM_PLAYBACK_PRIMARY, &config,
+                                               NULL);
+        ASSERT_NE(nullptr, mStream);
+        ASSERT_EQ(0, proxy_open_playback_stream(mStream, 0, NULL));
+        mBuffer.resize(kWriteFrames * kChannels);
+    }
+
+    void TearDown() override {
+        if (mStream) {
+            proxy_stop_playback_stream(mStream);
+            proxy_close_playback_stream(mStream);
+            proxy_destroy_playback_stream(mStream);
+        }
+        proxy_set_route(test_proxy(), AUSAGE_MEDIA, DEVICE_AUX_DIGITAL, MODIFIER_NONE, false);
+        fake_backend_set_virtual_clock(false);
+    }
+
+    // Writes given msec of audio, the writer is late by late_ns before every late_every-th write
+    uint64_t play(int64_t msec, unsigned int late_every = 0, int64_t late_ns = 0) {
+        const int bytes = static_cast<int>(mBuffer.size() * sizeof(int16_t));
+        const uint64_t frames = static_cast<uint64_t>(msec) * kRate / 1000;
+        uint64_t written = 0;
+
+        for (unsigned int i = 1; written < frames; i++) {
+            if (late_every > 0 && i % late_every == 0)
+                fake_backend_advance_clock(late_ns);
+            EXPECT_EQ(bytes, proxy_write_playback_buffer(mStream, mBuffer.data(), bytes));
+            written += kWriteFrames;
+            mWrites++;
+        }
+        return written;
+    }
+
+    static int64_t durationNs(uint64_t frames) {
+        return static_cast<int64_t>(frames * 1000000000ULL / kRate);
+    }
+
+    void *mStream = nullptr;
+    std::vector<int16_t> mBuffer;
+    unsigned int mWrites = 0;
+};
+
+TEST_F(SkipPlaybackTest, TenMinutesStayAccurate) {
+    struct fake_backend_stats before, after;
+    struct test_skip_stats stats;
+    int64_t start_ns = nowNs();
+
+    fake_backend_get_stats(&before);
+    uint64_t frames = play(10 * 60 * 1000);
+    int64_t elapsed_ns = nowNs() - start_ns;
+    fake_backend_get_stats(&after);
+    test_skip_stats(mStream, &stats);
+
+    std::cout << frames << " frames in " << mWrites << " writes, elapsed " << elapsed_ns
+              << " ns for " << durationNs(frames) << " ns of audio" << std::endl;
+
+    EXPECT_EQ(frames, stats.frames);
+    EXPECT_EQ(frames, stats.written_frames);
+    EXPECT_EQ(1u, stats.entries);
+    // One sleep per write until its deadline, which never drifts from frames written
+    EXPECT_EQ(mWrites, stats.sleeps);
+    EXPECT_EQ(mWrites, after.sleeps - before.sleeps);
+    EXPECT_EQ(0u, stats.late);
+    EXPECT_EQ(0u, stats.resyncs);
+    EXPECT_LE(std::llabs(elapsed_ns - durationNs(frames)), 1 * kMsec);
+}
+
+TEST_F(SkipPlaybackTest, LateWriterCatchesUpWithoutDrift) {
+    struct test_skip_stats stats;
+    int64_t start_ns = nowNs();
+
+    // A 50 msec hiccup of the writer every 2 sec, below resync threshold
+    uint64_t frames = play(60 * 1000, 100, 50 * kMsec);
+    int64_t elapsed_ns = nowNs() - start_ns;
+    test_skip_stats(mStream, &stats);
+
+    EXPECT_EQ(frames, stats.frames);
+    EXPECT_GT(stats.late, 0u);
+    EXPECT_EQ(0u, stats.resyncs);
+    EXPECT_EQ(mWrites, stats.sleeps + stats.late);
+    EXPECT_LE(std::llabs(elapsed_ns - durationNs(frames)), 1 * kMsec);
+}
+
+TEST_F(SkipPlaybackTest, PausedWriterResyncsWithoutBurst) {
+    struct test_skip_stats stats;
+    int64_t start_ns = nowNs();
+
+    uint64_t frames = play(1000);
+    fake_backend_advance_clock(1000 * kMsec);
+    frames += play(1000);
+    int64_t elapsed_ns = nowNs() - start_ns;
+    test_skip_stats(mStream, &stats);
+
+    // Writes after the pause are paced from the time they resumed, not rushed to old deadline
+    EXPECT_EQ(1u, stats.resyncs);
+    EXPECT_EQ(0u, stats.late);
+    EXPECT_EQ(frames, stats.frames);
+    EXPECT_LE(std::llabs(elapsed_ns - (durationNs(frames) + 1000 * kMsec)), 1 * kMsec);
+}
+
+}  // namespace